@@ -0,0 +1,160 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file bench-log.c
+ * @brief Measure the cost of disabled debug logging on a frame trace
+ *
+ * The log facility is built in (log.c is not exported by the library): the
+ * frame trace of a transceive, a LOG_HEX() and a log_put() at debug priority,
+ * is timed with logging restricted to errors, as it is by default, against the
+ * former code path which formatted the frame then read LIBNFC_LOG_LEVEL in
+ * log_put().
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <nfc/nfc.h>
+
+#include "log.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_COM
+#define LOG_CATEGORY "libnfc.bench"
+
+#define DEFAULT_ITERATIONS 1000000
+#define MAX_ITERATIONS     100000000
+
+// Keeps the compiler from dropping the loops
+static volatile size_t sink;
+
+static double
+elapsed_ns(const struct timespec *start, const struct timespec *stop)
+{
+  return ((stop->tv_sec - start->tv_sec) * 1e9) + (stop->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * Former log_put() decision, made after the caller formatted the message
+ */
+static void
+legacy_log_put(const uint8_t group, const uint8_t priority, const char *message)
+{
+  uint32_t log_level;
+  char *env_log_level = getenv("LIBNFC_LOG_LEVEL");
+  if (NULL == env_log_level) {
+    log_level = 1;
+  } else {
+    log_level = atoi(env_log_level);
+  }
+  if (log_level) {
+    if (((log_level & 0x00000003) >= priority) ||
+        (((log_level >> (group * 2)) & 0x00000003) >= priority)) {
+      fprintf(stderr, "%s\n", message);
+    }
+  }
+  sink += strlen(message);
+}
+
+static void
+legacy_trace(const uint8_t *pbtFrame, const size_t szFrame)
+{
+  char acBuf[1024];
+  size_t szBuf = 0;
+
+  snprintf(acBuf + szBuf, sizeof(acBuf) - szBuf, "%s: ", "TX");
+  szBuf += strlen("TX") + 2;
+  for (size_t szPos = 0; (szPos < szFrame) && (szBuf < sizeof(acBuf)); szPos++) {
+    snprintf(acBuf + szBuf, sizeof(acBuf) - szBuf, "%02x ", pbtFrame[szPos]);
+    szBuf += 3;
+  }
+  legacy_log_put(LOG_GROUP, NFC_LOG_PRIORITY_DEBUG, acBuf);
+  snprintf(acBuf, sizeof(acBuf), "%s: %zu bytes", "Frame sent", szFrame);
+  legacy_log_put(LOG_GROUP, NFC_LOG_PRIORITY_DEBUG, acBuf);
+}
+
+static size_t
+frame_size(const size_t szFrame)
+{
+  // Only evaluated when the message is output
+  sink++;
+  return szFrame;
+}
+
+static void
+trace(const uint8_t *pbtFrame, const size_t szFrame)
+{
+  LOG_HEX(LOG_GROUP, "TX", pbtFrame, szFrame);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s: %zu bytes", "Frame sent", frame_size(szFrame));
+}
+
+int
+main(int argc, const char *argv[])
+{
+  struct timespec start, stop;
+  int iterations = DEFAULT_ITERATIONS;
+  // InDataExchange of a MIFARE READ, as traced by pn53x_usb
+  const uint8_t abtFrame[] = { 0x00, 0x00, 0xff, 0x05, 0xfb, 0xd4, 0x40, 0x01, 0x30, 0x04, 0xb7, 0x00 };
+
+  if (argc > 1) {
+    iterations = atoi(argv[1]);
+    if ((iterations <= 0) || (iterations > MAX_ITERATIONS)) {
+      fprintf(stderr, "usage: %s [iterations (1-%d)]\n", argv[0], MAX_ITERATIONS);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // A context with errors only, the default level
+  nfc_context context;
+  memset(&context, 0x00, sizeof(context));
+  context.log_level = 1;
+  log_init(&context);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int n = 0; n < iterations; n++)
+    legacy_trace(abtFrame, sizeof(abtFrame));
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  const double legacy = elapsed_ns(&start, &stop) / iterations;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int n = 0; n < iterations; n++)
+    trace(abtFrame, sizeof(abtFrame));
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  const double disabled = elapsed_ns(&start, &stop) / iterations;
+
+  log_exit(&context);
+
+  printf("%d frame traces, debug logging disabled\n", iterations);
+  printf("format then check:  %8.2f ns/trace\n", legacy);
+  printf("check first:        %8.2f ns/trace\n", disabled);
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,196 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file bench-stats.c
+ * @brief Run a transceive loop and print device statistics while it runs
+ *
+ * Without argument the loop runs against an emulated PN532. Given a
+ * connstring, it runs against that device with a MIFARE tag on it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <nfc/nfc.h>
+
+#include "pn532-emulator.h"
+
+#define DEFAULT_ITERATIONS 10000
+#define MAX_ITERATIONS     10000000
+#define REPORT_INTERVAL    1
+
+static volatile bool done = false;
+
+static void
+print_histogram(const char *name, const uint64_t histogram[NFC_STATS_LATENCY_BUCKETS])
+{
+  printf("%s:\n", name);
+  for (size_t i = 0; i < NFC_STATS_LATENCY_BUCKETS; i++) {
+    if (!histogram[i])
+      continue;
+    if (i == 0)
+      printf("  %10s < %8u us: %" PRIu64 "\n", "", 1u, histogram[i]);
+    else if (i == NFC_STATS_LATENCY_BUCKETS - 1)
+      printf("  %10s >= %7u us: %" PRIu64 "\n", "", 1u << (i - 1), histogram[i]);
+    else
+      printf("  %7u us .. %8u us: %" PRIu64 "\n", 1u << (i - 1), 1u << i, histogram[i]);
+  }
+}
+
+static void
+print_stats(const nfc_device_stats *pstats)
+{
+  printf("commands:\n");
+  for (size_t i = 0; i < 256; i++) {
+    if (pstats->commands[i])
+      printf("  0x%02x: %" PRIu64 "\n", (unsigned) i, pstats->commands[i]);
+  }
+  printf("bytes:        %" PRIu64 " tx, %" PRIu64 " rx\n", pstats->tx_bytes, pstats->rx_bytes);
+  printf("timeouts:     %" PRIu64 "\n", pstats->timeouts);
+  printf("io errors:    %" PRIu64 "\n", pstats->io_errors);
+  printf("retries:      %" PRIu64 "\n", pstats->retries);
+  for (size_t i = 0; i < 64; i++) {
+    if (pstats->errors[i])
+      printf("status 0x%02x: %" PRIu64 "\n", (unsigned) i, pstats->errors[i]);
+  }
+  print_histogram("bus latency", pstats->bus_latency);
+  print_histogram("chip latency", pstats->chip_latency);
+}
+
+static void *
+report(void *arg)
+{
+  nfc_device *pnd = arg;
+  nfc_device_stats stats;
+
+  // Counters can be read while the other thread is using the device
+  while (!done) {
+    sleep(REPORT_INTERVAL);
+    nfc_device_get_stats(pnd, &stats);
+    printf("--- %" PRIu64 " InDataExchange so far\n", stats.commands[0x40]);
+    print_stats(&stats);
+    fflush(stdout);
+  }
+  return NULL;
+}
+
+int
+main(int argc, const char *argv[])
+{
+  struct pn532_emulator pe;
+  bool emulated = true;
+  nfc_connstring connstring;
+  nfc_context *context;
+  nfc_device *pnd;
+  pthread_t reporter;
+  nfc_device_stats stats;
+  int iterations = DEFAULT_ITERATIONS;
+  int res = EXIT_FAILURE;
+
+  if (argc > 1) {
+    iterations = atoi(argv[1]);
+    if ((iterations <= 0) || (iterations > MAX_ITERATIONS)) {
+      fprintf(stderr, "usage: %s [iterations (1-%d) [connstring]]\n", argv[0], MAX_ITERATIONS);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (argc > 2) {
+    strncpy(connstring, argv[2], sizeof(connstring) - 1);
+    connstring[sizeof(connstring) - 1] = '\0';
+    emulated = false;
+  } else {
+    if (pn532_emulator_start(&pe) < 0) {
+      perror("pn532_emulator_start");
+      exit(EXIT_FAILURE);
+    }
+    pn532_emulator_connstring(&pe, connstring);
+  }
+
+  nfc_init(&context);
+  if (context == NULL) {
+    fprintf(stderr, "Unable to init libnfc (malloc)\n");
+    goto stop_emulator;
+  }
+  if ((pnd = nfc_open(context, connstring)) == NULL) {
+    fprintf(stderr, "Unable to open %s\n", connstring);
+    goto exit_context;
+  }
+  if (nfc_initiator_init(pnd) < 0) {
+    nfc_perror(pnd, "nfc_initiator_init");
+    goto close_device;
+  }
+  if (!emulated) {
+    const nfc_modulation nm = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+    if (nfc_initiator_select_passive_target(pnd, nm, NULL, 0, NULL) <= 0) {
+      fprintf(stderr, "No ISO14443A target found\n");
+      goto close_device;
+    }
+  }
+
+  // Only count the benchmark loop
+  nfc_device_reset_stats(pnd);
+  if (pthread_create(&reporter, NULL, report, pnd) != 0) {
+    perror("pthread_create");
+    goto close_device;
+  }
+
+  // MIFARE READ of block 4
+  const uint8_t abtRead[] = { 0x30, 0x04 };
+  uint8_t abtRx[16];
+  res = EXIT_SUCCESS;
+  for (int n = 0; n < iterations; n++) {
+    if (nfc_initiator_transceive_bytes(pnd, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), -1) < 0) {
+      nfc_perror(pnd, "nfc_initiator_transceive_bytes");
+      res = EXIT_FAILURE;
+      break;
+    }
+  }
+  done = true;
+  pthread_join(reporter, NULL);
+
+  nfc_device_get_stats(pnd, &stats);
+  printf("=== device:   %s\n", nfc_device_get_name(pnd));
+  print_stats(&stats);
+
+close_device:
+  nfc_close(pnd);
+exit_context:
+  nfc_exit(context);
+stop_emulator:
+  if (emulated)
+    pn532_emulator_stop(&pe);
+  exit(res);
+}
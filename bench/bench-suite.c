@@ -0,0 +1,813 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+
+/**
+ * @file bench-suite.c
+ * @brief Benchmark suite with machine-readable results
+ *
+ * Each benchmark runs for at least the given time (-t, in milliseconds) and
+ * is reported in JSON with its time per operation, operations per second and
+ * heap allocations per operation, so results can be compared between
+ * releases. Allocations are counted by wrapping the glibc allocator; they are
+ * reported as null elsewhere. Device benchmarks also report the number of
+ * commands sent to the chip per operation.
+ *
+ * Device benchmarks run against the in-process simulated chip (sim driver),
+ * which has an Ultralight tag in its field, and against the PN532 emulator
+ * through the pn532_uart driver. They are reported as skipped when the device
+ * can not be opened. Serial round-trips are also measured on a port opened
+ * straight to another emulator, with and without the low latency mode.
+ * The pn532_i2c driver runs against an emulator put behind the I2C bus code,
+ * which also reports the bytes transferred on the bus per operation.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nfc/nfc.h>
+
+#include "buses/uart.h"
+#include "chips/pn53x.h"
+#include "mirror-subr.h"
+#include "target-subr.h"
+
+#include "pn532-emulator.h"
+#if defined(DRIVER_PN532_I2C_ENABLED)
+#  include "pn532-i2c-emulator.h"
+#endif
+
+#define DEFAULT_MIN_TIME_MS 200
+#define MAX_MIN_TIME_MS     60000
+#define MAX_ITERATIONS      1000000000
+
+#if defined(__GLIBC__)
+#  define BENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static size_t allocs;
+
+void *
+malloc(size_t size)
+{
+  __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+  return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+  __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+  return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+  __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+  return __libc_realloc(ptr, size);
+}
+
+static size_t
+allocs_count(void)
+{
+  return __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+}
+#else
+static size_t
+allocs_count(void)
+{
+  return 0;
+}
+#endif
+
+struct bench_state {
+  nfc_context *context;
+  /** Simulated chip with an Ultralight tag, or NULL */
+  nfc_device *pndSim;
+  /** Emulated PN532 on a pseudo-terminal, or NULL */
+  nfc_device *pndEmulator;
+  struct pn532_emulator pe;
+  bool    bEmulator;
+  /** Emulated PN532 behind the I2C bus code, or NULL */
+  nfc_device *pndI2cEmulator;
+  bool    bI2cEmulator;
+  /** Serial port opened to a second emulator, or NULL */
+  serial_port spPort;
+  bool    bPortLowLatency;
+  struct pn532_emulator pePort;
+  bool    bPortEmulator;
+  /** ISO14443A target data as returned by InListPassiveTarget */
+  nfc_target nt;
+};
+
+typedef int (*bench_fn)(struct bench_state *bs, const size_t szIterations);
+
+// Keeps the compiler from dropping the loops
+static volatile uint32_t sink;
+
+static uint8_t abtPayload[256];
+
+static int
+bench_iso14443a_crc_16(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtCrc[2];
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    iso14443a_crc(abtPayload, 16, abtCrc);
+    sink += abtCrc[0];
+  }
+  return 0;
+}
+
+static int
+bench_iso14443a_crc_64(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtCrc[2];
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    iso14443a_crc(abtPayload, 64, abtCrc);
+    sink += abtCrc[0];
+  }
+  return 0;
+}
+
+static int
+bench_iso14443a_crc_256(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtCrc[2];
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    iso14443a_crc(abtPayload, sizeof(abtPayload), abtCrc);
+    sink += abtCrc[0];
+  }
+  return 0;
+}
+
+/*
+ * Former bit-wise CRC_A, for comparison
+ */
+static int
+bench_iso14443a_crc_bitwise_256(struct bench_state *bs, const size_t szIterations)
+{
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    uint32_t wCrc = 0x6363;
+    for (size_t i = 0; i < sizeof(abtPayload); i++) {
+      uint8_t bt = abtPayload[i];
+      bt = (bt ^ (uint8_t)(wCrc & 0x00FF));
+      bt = (bt ^ (bt << 4));
+      wCrc = (wCrc >> 8) ^ ((uint32_t) bt << 8) ^ ((uint32_t) bt << 3) ^ ((uint32_t) bt >> 4);
+    }
+    sink += wCrc;
+  }
+  return 0;
+}
+
+static int
+bench_iso14443b_crc_256(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtCrc[2];
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    iso14443b_crc(abtPayload, sizeof(abtPayload), abtCrc);
+    sink += abtCrc[0];
+  }
+  return 0;
+}
+
+static int
+bench_build_frame(struct bench_state *bs, const size_t szIterations)
+{
+  // InDataExchange of a MIFARE WRITE
+  uint8_t abtCmd[20] = { 0x40, 0x01, 0xa0, 0x04 };
+  uint8_t abtFrame[PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD] = { 0x00, 0x00, 0xff };
+  size_t szFrame;
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    if (pn53x_build_frame(abtFrame, &szFrame, abtCmd, sizeof(abtCmd)) < 0)
+      return -1;
+    sink += abtFrame[szFrame - 2];
+  }
+  return 0;
+}
+
+static int
+bench_decode_target_data(struct bench_state *bs, const size_t szIterations)
+{
+  // Tg, ATQA, SAK, 7 bytes UID, ATS
+  const uint8_t abtTarget[] = { 0x01, 0x03, 0x44, 0x20, 0x07, 0x04, 0x5e, 0x1d, 0xca, 0xfe, 0x01, 0x10, 0x06, 0x75, 0x77, 0x81, 0x02, 0x80 };
+  nfc_target_info nti;
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    if (pn53x_decode_target_data(abtTarget, sizeof(abtTarget), PN532, NMT_ISO14443A, &nti) < 0)
+      return -1;
+    sink += nti.nai.szAtsLen;
+  }
+  return 0;
+}
+
+static int
+bench_odd_parity(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtPar[64];
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    iso14443a_odd_parity(abtPayload, sizeof(abtPar), abtPar);
+    sink += abtPar[0];
+  }
+  return 0;
+}
+
+static int
+bench_wrap_frame(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtPar[16];
+  uint8_t abtFrame[16 * 2];
+  (void) bs;
+  iso14443a_odd_parity(abtPayload, sizeof(abtPar), abtPar);
+  for (size_t n = 0; n < szIterations; n++) {
+    if (pn53x_wrap_frame(abtPayload, 16 * 8, abtPar, abtFrame) < 0)
+      return -1;
+    sink += abtFrame[0];
+  }
+  return 0;
+}
+
+/*
+ * Odd parity computed along, as for anticollision frames
+ */
+static int
+bench_wrap_frame_odd_parity(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtFrame[64 * 2];
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    if (pn53x_wrap_frame(abtPayload, 64 * 8, NULL, abtFrame) < 0)
+      return -1;
+    sink += abtFrame[0];
+  }
+  return 0;
+}
+
+static int
+bench_unwrap_frame(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtPar[16];
+  uint8_t abtFrame[16 * 2];
+  uint8_t abtRx[16];
+  (void) bs;
+  iso14443a_odd_parity(abtPayload, sizeof(abtPar), abtPar);
+  const int szFrameBits = pn53x_wrap_frame(abtPayload, 16 * 8, abtPar, abtFrame);
+  for (size_t n = 0; n < szIterations; n++) {
+    if (pn53x_unwrap_frame(abtFrame, szFrameBits, abtRx, abtPar) < 0)
+      return -1;
+    sink += abtRx[0];
+  }
+  return 0;
+}
+
+/*
+ * Bit reversal of an extended frame, as done for LSB-first SPI transfers
+ */
+static int
+bench_mirror_buffer(struct bench_state *bs, const size_t szIterations)
+{
+  uint8_t abtFrame[sizeof(abtPayload)];
+  (void) bs;
+  for (size_t n = 0; n < szIterations; n++) {
+    mirror_buffer(abtFrame, abtPayload, sizeof(abtFrame));
+    sink += abtFrame[n % sizeof(abtFrame)];
+  }
+  return 0;
+}
+
+static int
+bench_snprint_nfc_target(struct bench_state *bs, const size_t szIterations)
+{
+  char acTarget[4096];
+  for (size_t n = 0; n < szIterations; n++) {
+    snprint_nfc_target(acTarget, sizeof(acTarget), &bs->nt, true);
+    sink += acTarget[0];
+  }
+  return 0;
+}
+
+static int
+bench_str_nfc_target(struct bench_state *bs, const size_t szIterations)
+{
+  char *pcTarget;
+  for (size_t n = 0; n < szIterations; n++) {
+    if (str_nfc_target(&pcTarget, &bs->nt, true) < 0)
+      return -1;
+    sink += pcTarget[0];
+    nfc_free(pcTarget);
+  }
+  return 0;
+}
+
+/*
+ * Toggle CRC handling through the register cache, written back before the
+ * next command.
+ */
+static int
+bench_register_writeback(struct bench_state *bs, const size_t szIterations)
+{
+  const uint8_t abtCmd[] = { 0x02 }; // GetFirmwareVersion
+  uint8_t abtRx[16];
+  for (size_t n = 0; n < szIterations; n++) {
+    const uint8_t btValue = (n & 1) ? 0x00 : 0x80;
+    if ((pn53x_write_register(bs->pndSim, PN53X_REG_CIU_TxMode, SYMBOL_TX_CRC_ENABLE, btValue) < 0) ||
+        (pn53x_write_register(bs->pndSim, PN53X_REG_CIU_RxMode, SYMBOL_RX_CRC_ENABLE, btValue) < 0) ||
+        (pn53x_transceive(bs->pndSim, abtCmd, sizeof(abtCmd), abtRx, sizeof(abtRx), -1) < 0))
+      return -1;
+  }
+  // Leave the chip as configured by nfc_initiator_init()
+  if ((pn53x_write_register(bs->pndSim, PN53X_REG_CIU_TxMode, SYMBOL_TX_CRC_ENABLE, 0x80) < 0) ||
+      (pn53x_write_register(bs->pndSim, PN53X_REG_CIU_RxMode, SYMBOL_RX_CRC_ENABLE, 0x80) < 0) ||
+      (pn53x_transceive(bs->pndSim, abtCmd, sizeof(abtCmd), abtRx, sizeof(abtRx), -1) < 0))
+    return -1;
+  return 0;
+}
+
+/*
+ * Switch between raw frames with a long timeout and the initiator defaults,
+ * then send a command, as done around a raw exchange. The batch version
+ * leaves it to the driver to skip and group commands.
+ */
+static const nfc_property_setting raw_settings[] = {
+  { NP_TIMEOUT_COM, 200 },
+  { NP_INFINITE_SELECT, false },
+  { NP_HANDLE_CRC, false },
+  { NP_HANDLE_PARITY, false },
+  { NP_EASY_FRAMING, false },
+};
+static const nfc_property_setting default_settings[] = {
+  { NP_TIMEOUT_COM, 52 },
+  { NP_INFINITE_SELECT, false },
+  { NP_HANDLE_CRC, true },
+  { NP_HANDLE_PARITY, true },
+  { NP_EASY_FRAMING, true },
+};
+#define SETTINGS_COUNT (sizeof(raw_settings) / sizeof(raw_settings[0]))
+
+static int
+set_properties_sequential(nfc_device *pnd, const nfc_property_setting settings[])
+{
+  for (size_t i = 0; i < SETTINGS_COUNT; i++) {
+    int res;
+    if (settings[i].property == NP_TIMEOUT_COM)
+      res = nfc_device_set_property_int(pnd, settings[i].property, settings[i].value);
+    else
+      res = nfc_device_set_property_bool(pnd, settings[i].property, settings[i].value != 0);
+    if (res < 0)
+      return res;
+  }
+  return 0;
+}
+
+static int
+bench_set_properties(struct bench_state *bs, const size_t szIterations, const bool bBatch)
+{
+  const uint8_t abtCmd[] = { 0x02 }; // GetFirmwareVersion
+  uint8_t abtRx[16];
+  for (size_t n = 0; n < szIterations + 1; n++) {
+    // The last round leaves the initiator defaults
+    const nfc_property_setting *settings = ((n & 1) || (n == szIterations)) ? default_settings : raw_settings;
+    const int res = bBatch ? nfc_device_set_properties(bs->pndSim, settings, SETTINGS_COUNT) : set_properties_sequential(bs->pndSim, settings);
+    if ((res < 0) || (pn53x_transceive(bs->pndSim, abtCmd, sizeof(abtCmd), abtRx, sizeof(abtRx), -1) < 0))
+      return -1;
+  }
+  return 0;
+}
+
+static int
+bench_set_properties_sequential(struct bench_state *bs, const size_t szIterations)
+{
+  return bench_set_properties(bs, szIterations, false);
+}
+
+static int
+bench_set_properties_batch(struct bench_state *bs, const size_t szIterations)
+{
+  return bench_set_properties(bs, szIterations, true);
+}
+
+/*
+ * Select the tag then read 4 pages, as done by inventory applications.
+ */
+static int
+select_read(nfc_device *pnd, const size_t szIterations)
+{
+  const nfc_modulation nm = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+  const uint8_t abtRead[] = { 0x30, 0x04 };
+  uint8_t abtRx[16];
+  nfc_target nt;
+  for (size_t n = 0; n < szIterations; n++) {
+    if ((nfc_initiator_select_passive_target(pnd, nm, NULL, 0, &nt) <= 0) ||
+        (nfc_initiator_transceive_bytes(pnd, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), -1) < 0))
+      return -1;
+    sink += abtRx[0];
+  }
+  return 0;
+}
+
+static int
+bench_sim_select_read(struct bench_state *bs, const size_t szIterations)
+{
+  return select_read(bs->pndSim, szIterations);
+}
+
+/*
+ * The emulator has no tag in its field, it answers any InDataExchange.
+ */
+static int
+bench_emulator_transceive(struct bench_state *bs, const size_t szIterations)
+{
+  const uint8_t abtRead[] = { 0x30, 0x04 };
+  uint8_t abtRx[16];
+  for (size_t n = 0; n < szIterations; n++) {
+    if (nfc_initiator_transceive_bytes(bs->pndEmulator, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), -1) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+static int
+bench_i2c_emulator_transceive(struct bench_state *bs, const size_t szIterations)
+{
+  const uint8_t abtRead[] = { 0x30, 0x04 };
+  uint8_t abtRx[16];
+  for (size_t n = 0; n < szIterations; n++) {
+    if (nfc_initiator_transceive_bytes(bs->pndI2cEmulator, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), -1) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+/*
+ * GetFirmwareVersion round-trip at the serial port level: frame out, ACK and
+ * reply in, as the driver does for every command.
+ */
+static int
+bench_port_ping(struct bench_state *bs, const size_t szIterations)
+{
+  const uint8_t abtPing[] = { 0x00, 0x00, 0xff, 0x02, 0xfe, 0xd4, 0x02, 0x2a, 0x00 };
+  uint8_t abtRx[PN53x_ACK_FRAME__LEN + 13];
+  for (size_t n = 0; n < szIterations; n++) {
+    if ((uart_send(bs->spPort, abtPing, sizeof(abtPing), 1000) < 0) ||
+        (uart_receive(bs->spPort, abtRx, sizeof(abtRx), NULL, 1000) < 0))
+      return -1;
+    sink += abtRx[sizeof(abtRx) - 1];
+  }
+  return 0;
+}
+
+typedef enum {
+  BENCH_NO_DEVICE,
+  BENCH_SIM,
+  BENCH_EMULATOR,
+  BENCH_I2C_EMULATOR,
+  BENCH_PORT,
+  BENCH_PORT_LOW_LATENCY,
+} bench_device;
+
+static const struct {
+  const char *name;
+  bench_fn fn;
+  bench_device device;
+} benchmarks[] = {
+  { "iso14443a_crc/16",                bench_iso14443a_crc_16,     BENCH_NO_DEVICE },
+  { "iso14443a_crc/64",                bench_iso14443a_crc_64,     BENCH_NO_DEVICE },
+  { "iso14443a_crc/256",               bench_iso14443a_crc_256,    BENCH_NO_DEVICE },
+  { "iso14443a_crc_bitwise/256",       bench_iso14443a_crc_bitwise_256, BENCH_NO_DEVICE },
+  { "iso14443b_crc/256",               bench_iso14443b_crc_256,    BENCH_NO_DEVICE },
+  { "pn53x_build_frame/20",            bench_build_frame,          BENCH_NO_DEVICE },
+  { "pn53x_decode_target_data/14443a", bench_decode_target_data,   BENCH_NO_DEVICE },
+  { "pn53x_wrap_frame/16",             bench_wrap_frame,           BENCH_NO_DEVICE },
+  { "pn53x_wrap_frame/64+odd_parity",  bench_wrap_frame_odd_parity, BENCH_NO_DEVICE },
+  { "pn53x_unwrap_frame/16",           bench_unwrap_frame,         BENCH_NO_DEVICE },
+  { "iso14443a_odd_parity/64",         bench_odd_parity,           BENCH_NO_DEVICE },
+  { "mirror_buffer/256",               bench_mirror_buffer,        BENCH_NO_DEVICE },
+  { "snprint_nfc_target/verbose",      bench_snprint_nfc_target,   BENCH_NO_DEVICE },
+  { "str_nfc_target/verbose",          bench_str_nfc_target,       BENCH_NO_DEVICE },
+  { "register_writeback/sim",          bench_register_writeback,   BENCH_SIM },
+  { "set_properties/sequential/sim",   bench_set_properties_sequential, BENCH_SIM },
+  { "set_properties/batch/sim",        bench_set_properties_batch,      BENCH_SIM },
+  { "select_read/sim",                 bench_sim_select_read,      BENCH_SIM },
+  { "transceive/pn532_uart",           bench_emulator_transceive,  BENCH_EMULATOR },
+  { "transceive/pn532_i2c",            bench_i2c_emulator_transceive, BENCH_I2C_EMULATOR },
+  { "ping/uart",                       bench_port_ping,            BENCH_PORT },
+  { "ping/uart+low_latency",           bench_port_ping,            BENCH_PORT_LOW_LATENCY },
+};
+
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static nfc_device *
+open_device(struct bench_state *bs, const char *pcConnstring)
+{
+  nfc_connstring connstring;
+  snprintf(connstring, sizeof(connstring), "%s", pcConnstring);
+  nfc_device *pnd = nfc_open(bs->context, connstring);
+  if (pnd && (nfc_initiator_init(pnd) < 0)) {
+    nfc_close(pnd);
+    pnd = NULL;
+  }
+  return pnd;
+}
+
+static nfc_device *
+bench_device_get(struct bench_state *bs, const bench_device device)
+{
+  switch (device) {
+    case BENCH_NO_DEVICE:
+    case BENCH_PORT:
+    case BENCH_PORT_LOW_LATENCY:
+      break;
+    case BENCH_SIM:
+      if (!bs->pndSim)
+        bs->pndSim = open_device(bs, "sim:ultralight");
+      return bs->pndSim;
+    case BENCH_EMULATOR:
+      if (!bs->bEmulator) {
+        nfc_connstring connstring;
+        if (pn532_emulator_start(&bs->pe) < 0)
+          return NULL;
+        bs->bEmulator = true;
+        pn532_emulator_connstring(&bs->pe, connstring);
+        bs->pndEmulator = open_device(bs, connstring);
+      }
+      return bs->pndEmulator;
+    case BENCH_I2C_EMULATOR:
+#if defined(DRIVER_PN532_I2C_ENABLED)
+      if (!bs->bI2cEmulator) {
+        nfc_connstring connstring;
+        pn532_i2c_emulator_install(bs->context);
+        bs->bI2cEmulator = true;
+        pn532_i2c_emulator_connstring(connstring);
+        bs->pndI2cEmulator = open_device(bs, connstring);
+      }
+#endif
+      return bs->pndI2cEmulator;
+  }
+  return NULL;
+}
+
+/*
+ * Open the serial port to the second emulator in the requested mode,
+ * reopening it when the mode changes.
+ */
+static serial_port
+bench_port_get(struct bench_state *bs, const bool bLowLatency)
+{
+  if (bs->spPort && (bs->bPortLowLatency != bLowLatency)) {
+    uart_close(bs->spPort);
+    bs->spPort = NULL;
+  }
+  if (!bs->spPort) {
+    if (!bs->bPortEmulator) {
+      if (pn532_emulator_start(&bs->pePort) < 0)
+        return NULL;
+      bs->bPortEmulator = true;
+    }
+    serial_port sp = uart_open_ext(bs->pePort.port, bLowLatency);
+    if ((sp == INVALID_SERIAL_PORT) || (sp == CLAIMED_SERIAL_PORT))
+      return NULL;
+    uart_set_speed(sp, 115200);
+    bs->spPort = sp;
+    bs->bPortLowLatency = bLowLatency;
+  }
+  return bs->spPort;
+}
+
+static uint64_t
+commands_count(nfc_device *pnd)
+{
+  nfc_device_stats stats;
+  uint64_t count = 0;
+  if (pnd && (nfc_device_get_stats(pnd, &stats) == 0)) {
+    for (size_t i = 0; i < sizeof(stats.commands) / sizeof(stats.commands[0]); i++)
+      count += stats.commands[i];
+  }
+  return count;
+}
+
+/*
+ * Bytes transferred on the emulated I2C bus, or 0 on devices not behind it.
+ */
+static uint64_t
+bus_bytes_count(const bench_device device)
+{
+#if defined(DRIVER_PN532_I2C_ENABLED)
+  if (device == BENCH_I2C_EMULATOR)
+    return pn532_i2c_emulator_bus_bytes();
+#else
+  (void) device;
+#endif
+  return 0;
+}
+
+static void
+print_usage(const char *progname)
+{
+  fprintf(stderr, "usage: %s [-t min_time_ms] [-f filter] [-o file]\n", progname);
+  fprintf(stderr, "  -t  run each benchmark for at least this time (default: %d ms)\n", DEFAULT_MIN_TIME_MS);
+  fprintf(stderr, "  -f  only run benchmarks whose name contains this string\n");
+  fprintf(stderr, "  -o  write JSON results to this file (default: standard output)\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct bench_state bs;
+  int min_time_ms = DEFAULT_MIN_TIME_MS;
+  const char *pcFilter = NULL;
+  const char *pcOutput = NULL;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "ht:f:o:")) != -1) {
+    switch (ch) {
+      case 't':
+        min_time_ms = atoi(optarg);
+        if ((min_time_ms <= 0) || (min_time_ms > MAX_MIN_TIME_MS)) {
+          print_usage(argv[0]);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'f':
+        pcFilter = optarg;
+        break;
+      case 'o':
+        pcOutput = optarg;
+        break;
+      case 'h':
+        print_usage(argv[0]);
+        exit(EXIT_SUCCESS);
+      default:
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  FILE *f = pcOutput ? fopen(pcOutput, "w") : stdout;
+  if (!f) {
+    perror(pcOutput);
+    exit(EXIT_FAILURE);
+  }
+
+  memset(&bs, 0x00, sizeof(bs));
+  for (size_t n = 0; n < sizeof(abtPayload); n++)
+    abtPayload[n] = (uint8_t)(n * 7 + 1);
+  // Target rendered by the snprint_nfc_target benchmarks
+  const uint8_t abtTarget[] = { 0x01, 0x03, 0x44, 0x20, 0x07, 0x04, 0x5e, 0x1d, 0xca, 0xfe, 0x01, 0x10, 0x06, 0x75, 0x77, 0x81, 0x02, 0x80 };
+  bs.nt.nm.nmt = NMT_ISO14443A;
+  bs.nt.nm.nbr = NBR_106;
+  pn53x_decode_target_data(abtTarget, sizeof(abtTarget), PN532, NMT_ISO14443A, &bs.nt.nti);
+
+  nfc_init(&bs.context);
+  if (bs.context == NULL) {
+    fprintf(stderr, "Unable to init libnfc (malloc)\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int res = EXIT_SUCCESS;
+  fprintf(f, "{\n  \"version\": \"%s\",\n  \"min_time_ms\": %d,\n  \"benchmarks\": [", nfc_version(), min_time_ms);
+  const char *pcSeparator = "\n";
+  for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+    if (pcFilter && !strstr(benchmarks[i].name, pcFilter))
+      continue;
+    fprintf(f, "%s    { \"name\": \"%s\", ", pcSeparator, benchmarks[i].name);
+    pcSeparator = ",\n";
+    fprintf(stderr, "%-34s ", benchmarks[i].name);
+
+    nfc_device *pnd = NULL;
+    const bench_device device = benchmarks[i].device;
+    if ((device == BENCH_PORT) || (device == BENCH_PORT_LOW_LATENCY)) {
+      if (!bench_port_get(&bs, device == BENCH_PORT_LOW_LATENCY)) {
+        fprintf(f, "\"skipped\": \"device unavailable\" }");
+        fprintf(stderr, "skipped, device unavailable\n");
+        continue;
+      }
+    } else if ((device != BENCH_NO_DEVICE) && !(pnd = bench_device_get(&bs, device))) {
+      fprintf(f, "\"skipped\": \"device unavailable\" }");
+      fprintf(stderr, "skipped, device unavailable\n");
+      continue;
+    }
+
+    // Grow the iteration count until a run lasts min_time_ms
+    const uint64_t min_time_ns = (uint64_t) min_time_ms * 1000000;
+    size_t szIterations = 1;
+    uint64_t elapsed_ns = 0;
+    size_t szAllocs = 0;
+    uint64_t commands = 0;
+    uint64_t bus_bytes = 0;
+    int bench_res;
+    for (;;) {
+      const size_t szAllocsBefore = allocs_count();
+      const uint64_t commandsBefore = commands_count(pnd);
+      const uint64_t busBytesBefore = bus_bytes_count(device);
+      const uint64_t start_ns = now_ns();
+      bench_res = benchmarks[i].fn(&bs, szIterations);
+      elapsed_ns = now_ns() - start_ns;
+      szAllocs = allocs_count() - szAllocsBefore;
+      commands = commands_count(pnd) - commandsBefore;
+      bus_bytes = bus_bytes_count(device) - busBytesBefore;
+      if ((bench_res < 0) || (elapsed_ns >= min_time_ns) || (szIterations >= MAX_ITERATIONS))
+        break;
+      // Aim 20% above the goal from the last run, growing at most a hundredfold
+      const double ns_per_op = (elapsed_ns ? (double) elapsed_ns : 1.0) / szIterations;
+      size_t szNext = (size_t)((min_time_ns * 1.2) / ns_per_op);
+      if (szNext > szIterations * 100)
+        szNext = szIterations * 100;
+      if (szNext <= szIterations)
+        szNext = szIterations + 1;
+      szIterations = (szNext > MAX_ITERATIONS) ? MAX_ITERATIONS : szNext;
+    }
+    if (bench_res < 0) {
+      fprintf(f, "\"failed\": true }");
+      fprintf(stderr, "failed\n");
+      res = EXIT_FAILURE;
+      continue;
+    }
+
+    const double ns_per_op = (double) elapsed_ns / szIterations;
+    fprintf(f, "\"iterations\": %zu, \"ns_per_op\": %.2f, \"ops_per_s\": %.1f, \"allocs_per_op\": ",
+            szIterations, ns_per_op, 1e9 / ns_per_op);
+#ifdef BENCH_COUNT_ALLOCS
+    fprintf(f, "%.2f", (double) szAllocs / szIterations);
+#else
+    (void) szAllocs;
+    fprintf(f, "null");
+#endif
+    if (pnd)
+      fprintf(f, ", \"commands_per_op\": %.2f", (double) commands / szIterations);
+    if (bus_bytes)
+      fprintf(f, ", \"bus_bytes_per_op\": %.2f", (double) bus_bytes / szIterations);
+    fprintf(f, " }");
+    fprintf(stderr, "%12.2f ns/op\n", ns_per_op);
+  }
+  fprintf(f, "\n  ]\n}\n");
+
+  if (bs.pndSim)
+    nfc_close(bs.pndSim);
+  if (bs.pndEmulator)
+    nfc_close(bs.pndEmulator);
+  if (bs.bEmulator)
+    pn532_emulator_stop(&bs.pe);
+  if (bs.pndI2cEmulator)
+    nfc_close(bs.pndI2cEmulator);
+#if defined(DRIVER_PN532_I2C_ENABLED)
+  if (bs.bI2cEmulator)
+    pn532_i2c_emulator_uninstall(bs.context);
+#endif
+  if (bs.spPort)
+    uart_close(bs.spPort);
+  if (bs.bPortEmulator)
+    pn532_emulator_stop(&bs.pePort);
+  nfc_exit(bs.context);
+  if (pcOutput && (fclose(f) != 0)) {
+    perror(pcOutput);
+    res = EXIT_FAILURE;
+  }
+  exit(res);
+}
@@ -0,0 +1,147 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file bench-transceive-batch.c
+ * @brief Compare nfc_initiator_transceive_bytes() loops with nfc_initiator_transceive_batch()
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <nfc/nfc.h>
+
+#include "pn532-emulator.h"
+
+#define DEFAULT_ITERATIONS 1000
+#define MAX_ITERATIONS     100000
+
+static double
+elapsed_us(const struct timespec *start, const struct timespec *stop)
+{
+  return ((stop->tv_sec - start->tv_sec) * 1e6) + ((stop->tv_nsec - start->tv_nsec) / 1e3);
+}
+
+int
+main(int argc, const char *argv[])
+{
+  struct pn532_emulator pe;
+  nfc_connstring connstring;
+  nfc_context *context;
+  nfc_device *pnd;
+  struct timespec start, stop;
+  int iterations = DEFAULT_ITERATIONS;
+  int res = EXIT_FAILURE;
+
+  if (argc > 1) {
+    iterations = atoi(argv[1]);
+    if ((iterations <= 0) || (iterations > MAX_ITERATIONS)) {
+      fprintf(stderr, "usage: %s [iterations (1-%d)]\n", argv[0], MAX_ITERATIONS);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (pn532_emulator_start(&pe) < 0) {
+    perror("pn532_emulator_start");
+    exit(EXIT_FAILURE);
+  }
+  pn532_emulator_connstring(&pe, connstring);
+
+  nfc_init(&context);
+  if (context == NULL) {
+    fprintf(stderr, "Unable to init libnfc (malloc)\n");
+    goto stop_emulator;
+  }
+  if ((pnd = nfc_open(context, connstring)) == NULL) {
+    fprintf(stderr, "Unable to open %s\n", connstring);
+    goto exit_context;
+  }
+  if (nfc_initiator_init(pnd) < 0) {
+    nfc_perror(pnd, "nfc_initiator_init");
+    goto close_device;
+  }
+
+  // MIFARE READ of block 4, answered with 16 bytes by the emulator
+  const uint8_t abtRead[] = { 0x30, 0x04 };
+  uint8_t abtRx[16];
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int n = 0; n < iterations; n++) {
+    if (nfc_initiator_transceive_bytes(pnd, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), -1) < 0) {
+      nfc_perror(pnd, "nfc_initiator_transceive_bytes");
+      goto close_device;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  const double single_us = elapsed_us(&start, &stop);
+
+  nfc_transceive_item *items = malloc(iterations * sizeof(nfc_transceive_item));
+  uint8_t *pbtRx = malloc(iterations * sizeof(abtRx));
+  if (!items || !pbtRx) {
+    perror("malloc");
+    free(items);
+    free(pbtRx);
+    goto close_device;
+  }
+  for (int n = 0; n < iterations; n++) {
+    items[n].pbtTx = abtRead;
+    items[n].szTx = sizeof(abtRead);
+    items[n].pbtRx = pbtRx + (n * sizeof(abtRx));
+    items[n].szRx = sizeof(abtRx);
+    items[n].res = 0;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  const int processed = nfc_initiator_transceive_batch(pnd, items, iterations, NBS_ANY_ERROR, -1);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  const double batch_us = elapsed_us(&start, &stop);
+
+  if (processed != iterations || items[iterations - 1].res < 0) {
+    nfc_perror(pnd, "nfc_initiator_transceive_batch");
+  } else {
+    printf("device:       %s\n", nfc_device_get_name(pnd));
+    printf("iterations:   %d\n", iterations);
+    printf("single:       %.2f us/command\n", single_us / iterations);
+    printf("batch:        %.2f us/command\n", batch_us / iterations);
+    printf("saved:        %.2f us/command\n", (single_us - batch_us) / iterations);
+    res = EXIT_SUCCESS;
+  }
+  free(items);
+  free(pbtRx);
+
+close_device:
+  nfc_close(pnd);
+exit_context:
+  nfc_exit(context);
+stop_emulator:
+  pn532_emulator_stop(&pe);
+  exit(res);
+}
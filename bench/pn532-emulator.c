@@ -0,0 +1,274 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file pn532-emulator.c
+ * @brief PN532 (HSU) emulator on a pseudo-terminal, used by benchmarks
+ *
+ * The emulator runs in a child process and answers on the master side of a
+ * pseudo-terminal, so the whole pn532_uart driver and UART bus code path is
+ * exercised without any hardware. It implements what libnfc needs to open
+ * and initialize the device, plus InDataExchange/InCommunicateThru which
+ * answer with a 16 bytes block, as a MIFARE READ would.
+ *
+ * pn532_emulator_start_ext() delays these answers, as a slow tag would. Any
+ * frame from the host while an answer is delayed aborts the command, as the
+ * ACK frame does on a PN532: the answer is then never sent.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pn532-emulator.h"
+
+const uint8_t pn532_emulator_ack[] = { 0x00, 0x00, 0xff, 0x00, 0xff, 0x00 };
+
+static int
+pn532_emulator_write(int fd, const uint8_t *pbtData, size_t szData)
+{
+  while (szData) {
+    ssize_t res = write(fd, pbtData, szData);
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    pbtData += res;
+    szData -= res;
+  }
+  return 0;
+}
+
+static size_t
+pn532_emulator_frame(uint8_t *pbtFrame, uint8_t ui8Command, const uint8_t *pbtData, size_t szData)
+{
+  size_t szFrame = 0;
+
+  pbtFrame[szFrame++] = 0x00;
+  pbtFrame[szFrame++] = 0x00;
+  pbtFrame[szFrame++] = 0xff;
+  pbtFrame[szFrame++] = szData + 2;
+  pbtFrame[szFrame++] = 256 - (szData + 2);
+  pbtFrame[szFrame++] = 0xd5;
+  pbtFrame[szFrame++] = ui8Command + 1;
+  memcpy(pbtFrame + szFrame, pbtData, szData);
+  szFrame += szData;
+
+  uint8_t btDCS = 256 - 0xd5 - (ui8Command + 1);
+  for (size_t n = 0; n < szData; n++) {
+    btDCS -= pbtData[n];
+  }
+  pbtFrame[szFrame++] = btDCS;
+  pbtFrame[szFrame++] = 0x00;
+  return szFrame;
+}
+
+size_t
+pn532_emulator_answer(uint8_t *pbtRegisters, const uint8_t *pbtCmd, size_t szCmd, uint8_t *pbtFrame)
+{
+  uint8_t abtRx[PN532_EMULATOR_BUFFER_LEN];
+  size_t szRx = 0;
+  const uint8_t *pbtParams = pbtCmd + 1;
+  const size_t szParams = szCmd - 1;
+
+  switch (pbtCmd[0]) {
+    case 0x00: // Diagnose: echo back
+      memcpy(abtRx, pbtParams, szParams);
+      szRx = szParams;
+      break;
+    case 0x02: // GetFirmwareVersion: PN532 v1.6
+      abtRx[szRx++] = 0x32;
+      abtRx[szRx++] = 0x01;
+      abtRx[szRx++] = 0x06;
+      abtRx[szRx++] = 0x07;
+      break;
+    case 0x06: // ReadRegister
+      for (size_t n = 0; n + 1 < szParams; n += 2) {
+        abtRx[szRx++] = pbtRegisters[(pbtParams[n] << 8) | pbtParams[n + 1]];
+      }
+      break;
+    case 0x08: // WriteRegister
+      for (size_t n = 0; n + 2 < szParams; n += 3) {
+        pbtRegisters[(pbtParams[n] << 8) | pbtParams[n + 1]] = pbtParams[n + 2];
+      }
+      break;
+    case 0x40: // InDataExchange
+    case 0x42: // InCommunicateThru
+      abtRx[szRx++] = 0x00;
+      for (uint8_t n = 0; n < 16; n++) {
+        abtRx[szRx++] = n;
+      }
+      break;
+    case 0x16: // PowerDown
+    case 0x44: // InDeselect
+    case 0x4a: // InListPassiveTarget: no target
+    case 0x52: // InRelease
+      abtRx[szRx++] = 0x00;
+      break;
+    default:
+      // SetParameters, SAMConfiguration, RFConfiguration, etc.
+      break;
+  }
+  return pn532_emulator_frame(pbtFrame, pbtCmd[0], abtRx, szRx);
+}
+
+static void
+pn532_emulator_run(int fd, int iExchangeDelay)
+{
+  uint8_t *pbtRegisters = calloc(1, 0x10000);
+  uint8_t abtBuf[PN532_EMULATOR_BUFFER_LEN];
+  size_t szBuf = 0;
+  uint8_t abtAnswer[PN532_EMULATOR_FRAME_MAX_LEN];
+
+  if (!pbtRegisters)
+    _exit(EXIT_FAILURE);
+
+  for (;;) {
+    ssize_t res = read(fd, abtBuf + szBuf, sizeof(abtBuf) - szBuf);
+    if (res < 0) {
+      if ((errno == EINTR) || (errno == EIO)) {
+        // EIO: no slave opened yet, or slave just closed
+        usleep(1000);
+        continue;
+      }
+      _exit(EXIT_FAILURE);
+    }
+    szBuf += res;
+
+    for (;;) {
+      size_t szStart = 0;
+      // Skip wake up preamble and junk until start code (00 FF)
+      while ((szStart + 1 < szBuf) && !((abtBuf[szStart] == 0x00) && (abtBuf[szStart + 1] == 0xff)))
+        szStart++;
+      memmove(abtBuf, abtBuf + szStart, szBuf - szStart);
+      szBuf -= szStart;
+      if (szBuf < 4)
+        break;
+
+      size_t szHeader = 4;
+      size_t szLen = abtBuf[2];
+      if ((abtBuf[2] == 0x00) && (abtBuf[3] == 0xff)) {
+        // ACK frame sent by host (abort), nothing to answer
+        memmove(abtBuf, abtBuf + 5, (szBuf > 5) ? szBuf - 5 : 0);
+        szBuf = (szBuf > 5) ? szBuf - 5 : 0;
+        continue;
+      }
+      if ((abtBuf[2] == 0xff) && (abtBuf[3] == 0xff)) {
+        // Extended frame
+        if (szBuf < 7)
+          break;
+        szLen = (abtBuf[4] << 8) | abtBuf[5];
+        szHeader = 7;
+      }
+      // Header + TFI/PD0..PDn + DCS + postamble
+      const size_t szFrame = szHeader + szLen + 2;
+      if (szBuf < szFrame)
+        break;
+      if ((szLen >= 2) && (abtBuf[szHeader] == 0xd4)) {
+        const uint8_t ui8Command = abtBuf[szHeader + 1];
+        const size_t szAnswer = pn532_emulator_answer(pbtRegisters, abtBuf + szHeader + 1, szLen - 1, abtAnswer);
+        if (pn532_emulator_write(fd, pn532_emulator_ack, sizeof(pn532_emulator_ack)) < 0)
+          _exit(EXIT_FAILURE);
+        bool bAborted = false;
+        if ((iExchangeDelay > 0) && ((ui8Command == 0x40) || (ui8Command == 0x42))) {
+          // Whatever the host sends meanwhile is handled with the next read
+          struct pollfd pfd = { .fd = fd, .events = POLLIN };
+          bAborted = (poll(&pfd, 1, iExchangeDelay) > 0);
+        }
+        if (!bAborted && (pn532_emulator_write(fd, abtAnswer, szAnswer) < 0))
+          _exit(EXIT_FAILURE);
+      }
+      memmove(abtBuf, abtBuf + szFrame, szBuf - szFrame);
+      szBuf -= szFrame;
+    }
+  }
+}
+
+int
+pn532_emulator_start(struct pn532_emulator *pe)
+{
+  return pn532_emulator_start_ext(pe, 0);
+}
+
+int
+pn532_emulator_start_ext(struct pn532_emulator *pe, int iExchangeDelay)
+{
+  const char *pcPort;
+  int iSlaveFd;
+
+  if ((pe->fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0)
+    return -1;
+  if ((grantpt(pe->fd) < 0) || (unlockpt(pe->fd) < 0) || !(pcPort = ptsname(pe->fd))) {
+    close(pe->fd);
+    return -1;
+  }
+  snprintf(pe->port, sizeof(pe->port), "%s", pcPort);
+
+  // Keep the slave side opened by the emulator, so the master never reports
+  // a hang up between two openings by the driver
+  if ((iSlaveFd = open(pe->port, O_RDWR | O_NOCTTY)) < 0) {
+    close(pe->fd);
+    return -1;
+  }
+
+  if ((pe->pid = fork()) < 0) {
+    close(iSlaveFd);
+    close(pe->fd);
+    return -1;
+  }
+  if (pe->pid == 0) {
+    pn532_emulator_run(pe->fd, iExchangeDelay);
+    _exit(EXIT_SUCCESS);
+  }
+  close(iSlaveFd);
+  return 0;
+}
+
+void
+pn532_emulator_stop(struct pn532_emulator *pe)
+{
+  kill(pe->pid, SIGTERM);
+  waitpid(pe->pid, NULL, 0);
+  close(pe->fd);
+}
+
+void
+pn532_emulator_connstring(const struct pn532_emulator *pe, nfc_connstring connstring)
+{
+  snprintf(connstring, sizeof(nfc_connstring), "pn532_uart:%s", pe->port);
+}
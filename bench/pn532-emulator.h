@@ -0,0 +1,61 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file pn532-emulator.h
+ * @brief PN532 (HSU) emulator on a pseudo-terminal, used by benchmarks
+ */
+
+#ifndef __PN532_EMULATOR_H__
+#  define __PN532_EMULATOR_H__
+
+#  include <sys/types.h>
+
+#  include <nfc/nfc-types.h>
+
+struct pn532_emulator {
+  /** Emulator process */
+  pid_t   pid;
+  /** Pseudo-terminal master side, owned by the emulator */
+  int     fd;
+  /** Pseudo-terminal slave side, to be opened by the pn532_uart driver */
+  char    port[64];
+};
+
+#  define PN532_EMULATOR_BUFFER_LEN 1024
+// Longest frame answered by the emulator: data and frame overhead
+#  define PN532_EMULATOR_FRAME_MAX_LEN (PN532_EMULATOR_BUFFER_LEN + 9)
+
+extern const uint8_t pn532_emulator_ack[6];
+
+size_t  pn532_emulator_answer(uint8_t *pbtRegisters, const uint8_t *pbtCmd, size_t szCmd, uint8_t *pbtFrame);
+
+int     pn532_emulator_start(struct pn532_emulator *pe);
+int     pn532_emulator_start_ext(struct pn532_emulator *pe, int iExchangeDelay);
+void    pn532_emulator_stop(struct pn532_emulator *pe);
+void    pn532_emulator_connstring(const struct pn532_emulator *pe, nfc_connstring connstring);
+
+#endif // __PN532_EMULATOR_H__
@@ -0,0 +1,212 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+
+/**
+ * @file pn532-i2c-emulator.c
+ * @brief PN532 emulator behind an I2C backend, used by benchmarks
+ *
+ * The emulator replaces Linux i2c-dev for the I2C devices opened through the
+ * context it is installed on, so the whole pn532_i2c driver code path is
+ * exercised without any hardware. It answers commands as the HSU emulator does and behaves as the
+ * chip on its I2C interface: each read starts with the status byte, the RDY
+ * bit being clear on the first read after a frame gets pending; a read with
+ * RDY set hands the frame over, and a NACK frame asks for it again.
+ *
+ * Bytes on the bus are counted, address bytes included, so that the cost of
+ * each command can be compared between implementations of the driver.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nfc-internal.h"
+#include "buses/i2c.h"
+
+#include "pn532-emulator.h"
+#include "pn532-i2c-emulator.h"
+
+// Status reads with RDY clear before a pending frame is ready
+#define PN532_I2C_EMULATOR_BUSY_READS 1
+
+struct pn532_i2c_emulator {
+  uint8_t *pbtRegisters;
+  /** Pending frames: the ACK, then the answer */
+  uint8_t abtFrames[2][PN532_EMULATOR_FRAME_MAX_LEN];
+  size_t  szFrames[2];
+  size_t  szPending;
+  /** Last frame handed over, sent again on NACK */
+  uint8_t abtLast[PN532_EMULATOR_FRAME_MAX_LEN];
+  size_t  szLast;
+  int     iBusyReads;
+};
+
+static const uint8_t pn532_i2c_emulator_nack[] = { 0x00, 0x00, 0xff, 0xff, 0x00, 0x00 };
+
+static uint64_t bus_bytes;
+
+static void
+pn532_i2c_emulator_push(struct pn532_i2c_emulator *pie, const uint8_t *pbtFrame, size_t szFrame)
+{
+  memcpy(pie->abtFrames[pie->szPending], pbtFrame, szFrame);
+  pie->szFrames[pie->szPending++] = szFrame;
+  pie->iBusyReads = PN532_I2C_EMULATOR_BUSY_READS;
+}
+
+static void *
+pn532_i2c_emulator_open(const char *pcI2C_busName, uint32_t devAddr)
+{
+  (void) pcI2C_busName;
+  (void) devAddr;
+  struct pn532_i2c_emulator *pie = calloc(1, sizeof(struct pn532_i2c_emulator));
+  if (!pie)
+    return INVALID_I2C_BUS;
+  if (!(pie->pbtRegisters = calloc(1, 0x10000))) {
+    free(pie);
+    return INVALID_I2C_BUS;
+  }
+  return pie;
+}
+
+static void
+pn532_i2c_emulator_close(void *data)
+{
+  struct pn532_i2c_emulator *pie = data;
+  free(pie->pbtRegisters);
+  free(pie);
+}
+
+static ssize_t
+pn532_i2c_emulator_read(void *data, uint8_t *pbtRx, size_t szRx)
+{
+  struct pn532_i2c_emulator *pie = data;
+
+  bus_bytes += 1 + szRx;
+  memset(pbtRx, 0x00, szRx);
+  if (!pie->szPending || (pie->iBusyReads > 0)) {
+    if (pie->szPending)
+      pie->iBusyReads--;
+    return szRx;
+  }
+
+  // RDY set: the frame is handed over, even when not read up to its end
+  pbtRx[0] = 0x01;
+  memcpy(pbtRx + 1, pie->abtFrames[0], (szRx - 1 < pie->szFrames[0]) ? szRx - 1 : pie->szFrames[0]);
+  memcpy(pie->abtLast, pie->abtFrames[0], pie->szFrames[0]);
+  pie->szLast = pie->szFrames[0];
+  if (--pie->szPending) {
+    memcpy(pie->abtFrames[0], pie->abtFrames[1], pie->szFrames[1]);
+    pie->szFrames[0] = pie->szFrames[1];
+    pie->iBusyReads = PN532_I2C_EMULATOR_BUSY_READS;
+  }
+  return szRx;
+}
+
+static ssize_t
+pn532_i2c_emulator_write(void *data, const uint8_t *pbtTx, size_t szTx)
+{
+  struct pn532_i2c_emulator *pie = data;
+
+  bus_bytes += 1 + szTx;
+  if ((szTx == sizeof(pn532_emulator_ack)) && !memcmp(pbtTx, pn532_emulator_ack, szTx)) {
+    // ACK frame sent by host (abort)
+    pie->szPending = 0;
+    return szTx;
+  }
+  if ((szTx == sizeof(pn532_i2c_emulator_nack)) && !memcmp(pbtTx, pn532_i2c_emulator_nack, szTx)) {
+    if (pie->szLast && !pie->szPending)
+      pn532_i2c_emulator_push(pie, pie->abtLast, pie->szLast);
+    return szTx;
+  }
+
+  size_t szHeader = 5;
+  size_t szLen = (szTx > 3) ? pbtTx[3] : 0;
+  if ((szTx > 7) && (pbtTx[3] == 0xff) && (pbtTx[4] == 0xff)) {
+    // Extended frame
+    szLen = (pbtTx[5] << 8) | pbtTx[6];
+    szHeader = 8;
+  }
+  if ((szTx < 5) || memcmp(pbtTx, pn532_emulator_ack, 3) || (szTx < szHeader + szLen + 2) ||
+      (szLen < 2) || (pbtTx[szHeader] != 0xd4)) {
+    errno = EIO;
+    return -1;
+  }
+
+  uint8_t abtAnswer[PN532_EMULATOR_FRAME_MAX_LEN];
+  const size_t szAnswer = pn532_emulator_answer(pie->pbtRegisters, pbtTx + szHeader + 1, szLen - 1, abtAnswer);
+  pie->szPending = 0;
+  pn532_i2c_emulator_push(pie, pn532_emulator_ack, sizeof(pn532_emulator_ack));
+  pn532_i2c_emulator_push(pie, abtAnswer, szAnswer);
+  return szTx;
+}
+
+static int
+pn532_i2c_emulator_write_read(void *data, const uint8_t *pbtTx, size_t szTx, uint8_t *pbtRx, size_t szRx)
+{
+  if (pn532_i2c_emulator_write(data, pbtTx, szTx) < 0)
+    return -1;
+  pn532_i2c_emulator_read(data, pbtRx, szRx);
+  return 0;
+}
+
+static const struct i2c_backend pn532_i2c_emulator_backend = {
+  .open       = pn532_i2c_emulator_open,
+  .close      = pn532_i2c_emulator_close,
+  .read       = pn532_i2c_emulator_read,
+  .write      = pn532_i2c_emulator_write,
+  .write_read = pn532_i2c_emulator_write_read,
+};
+
+void
+pn532_i2c_emulator_install(nfc_context *context)
+{
+  context->i2c_backend = &pn532_i2c_emulator_backend;
+}
+
+void
+pn532_i2c_emulator_uninstall(nfc_context *context)
+{
+  context->i2c_backend = NULL;
+}
+
+void
+pn532_i2c_emulator_connstring(nfc_connstring connstring)
+{
+  snprintf(connstring, sizeof(nfc_connstring), "pn532_i2c:emulator");
+}
+
+uint64_t
+pn532_i2c_emulator_bus_bytes(void)
+{
+  return bus_bytes;
+}
@@ -0,0 +1,45 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+
+/**
+ * @file pn532-i2c-emulator.h
+ * @brief PN532 emulator behind an I2C backend, used by benchmarks
+ */
+
+#ifndef __PN532_I2C_EMULATOR_H__
+#  define __PN532_I2C_EMULATOR_H__
+
+#  include <stdint.h>
+
+#  include <nfc/nfc-types.h>
+
+void    pn532_i2c_emulator_install(nfc_context *context);
+void    pn532_i2c_emulator_uninstall(nfc_context *context);
+void    pn532_i2c_emulator_connstring(nfc_connstring connstring);
+uint64_t pn532_i2c_emulator_bus_bytes(void);
+
+#endif // __PN532_I2C_EMULATOR_H__
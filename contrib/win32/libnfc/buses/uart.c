@@ -103,6 +103,14 @@ uart_open(const char *pcPortName)
   return sp;
 }
 
+serial_port
+uart_open_ext(const char *pcPortName, const bool low_latency)
+{
+  // USB-serial latency timers are set in the device manager on Windows
+  (void) low_latency;
+  return uart_open(pcPortName);
+}
+
 void
 uart_close(const serial_port sp)
 {
@@ -118,7 +126,7 @@ uart_flush_input(const serial_port sp, bool wait)
   PurgeComm(((struct serial_port_windows *) sp)->hPort, PURGE_RXABORT | PURGE_RXCLEAR);
 }
 
-void
+int
 uart_set_speed(serial_port sp, const uint32_t uiPortSpeed)
 {
   struct serial_port_windows *spw;
@@ -133,10 +141,11 @@ uart_set_speed(serial_port sp, const uint32_t uiPortSpeed)
     case 115200:
     case 230400:
     case 460800:
+    case 921600:
       break;
     default:
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set serial port speed to %d baud. Speed value must be one of these constants: 9600 (default), 19200, 38400, 57600, 115200, 230400 or 460800.", uiPortSpeed);
-      return;
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set serial port speed to %d baud. Speed value must be one of these constants: 9600 (default), 19200, 38400, 57600, 115200, 230400, 460800 or 921600.", uiPortSpeed);
+      return NFC_EINVARG;
   };
   spw = (struct serial_port_windows *) sp;
 
@@ -144,9 +153,10 @@ uart_set_speed(serial_port sp, const uint32_t uiPortSpeed)
   spw->dcb.BaudRate = uiPortSpeed;
   if (!SetCommState(spw->hPort, &spw->dcb)) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to apply new speed settings.");
-    return;
+    return NFC_EIO;
   }
   PurgeComm(spw->hPort, PURGE_RXABORT | PURGE_RXCLEAR);
+  return NFC_SUCCESS;
 }
 
 uint32_t
@@ -214,6 +224,13 @@ uart_receive(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, i
   return (dwTotalBytesReceived == (DWORD) szRx) ? 0 : NFC_EIO;
 }
 
+int
+uart_receive_exact(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, int timeout)
+{
+  // Nothing is ever read ahead here
+  return uart_receive(sp, pbtRx, szRx, abort_p, timeout);
+}
+
 int
 uart_send(serial_port sp, const uint8_t *pbtTx, const size_t szTx, int timeout)
 {
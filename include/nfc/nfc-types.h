@@ -62,6 +62,12 @@ typedef struct nfc_driver nfc_driver;
  */
 typedef char nfc_connstring[NFC_BUFSIZE_CONNSTRING];
 
+/**
+ * Completion callback of an asynchronous transceive
+ * \a res holds the received bytes count on success, otherwise libnfc's error code
+ */
+typedef void (*nfc_transceive_callback)(nfc_device *pnd, int res, void *user_data);
+
 /**
  * Properties
  */
@@ -142,6 +148,16 @@ typedef enum {
   NP_FORCE_SPEED_106,
 } nfc_property;
 
+/**
+ * @struct nfc_property_setting
+ * @brief One property change of nfc_device_set_properties()
+ */
+typedef struct {
+  nfc_property property;
+  /** Duration in ms for timeout properties, otherwise false (0) or true (any other value) */
+  int value;
+} nfc_property_setting;
+
 // Compiler directive, set struct alignment to 1 uint8_t for compatibility
 #  pragma pack(1)
 
@@ -356,4 +372,148 @@ typedef struct {
 // Reset struct alignment to default
 #  pragma pack()
 
+/**
+ * @enum nfc_batch_stop
+ * @brief Error classes which stop a batch of transceive early
+ */
+typedef enum {
+  /** Never stop, every item of the batch is processed */
+  NBS_NEVER = 0x00,
+  /** Stop on target errors (NFC_ERFTRANS, NFC_EMFCAUTHFAIL, NFC_ETGRELEASED) */
+  NBS_TARGET_ERROR = 0x01,
+  /** Stop on device errors (any other error, e.g. NFC_EIO, NFC_ETIMEOUT, NFC_ECHIP) */
+  NBS_DEVICE_ERROR = 0x02,
+  /** Stop on any error */
+  NBS_ANY_ERROR = NBS_TARGET_ERROR | NBS_DEVICE_ERROR,
+} nfc_batch_stop;
+
+/**
+ * @struct nfc_transceive_item
+ * @brief One frame exchange of a batch of transceive
+ */
+typedef struct {
+  /** Frame to transmit */
+  const uint8_t *pbtTx;
+  size_t szTx;
+  /** Buffer for the response of the target (may be NULL) */
+  uint8_t *pbtRx;
+  size_t szRx;
+  /** Received bytes count on success, otherwise libnfc's error code */
+  int res;
+} nfc_transceive_item;
+
+/**
+ * @enum nfc_inventory_event_type
+ * @brief Change reported by the inventory engine
+ */
+typedef enum {
+  /** A target entered the field */
+  NIE_ARRIVED = 0x01,
+  /** A target left the field */
+  NIE_DEPARTED,
+  /** A target which stayed in the field reported different information (e.g. ATS) */
+  NIE_CHANGED,
+} nfc_inventory_event_type;
+
+/**
+ * @struct nfc_inventory_event
+ * @brief Inventory event
+ */
+typedef struct {
+  nfc_inventory_event_type type;
+  /** Target as last seen */
+  nfc_target nt;
+} nfc_inventory_event;
+
+/** Number of buckets of nfc_device_stats latency histograms */
+#define NFC_STATS_LATENCY_BUCKETS 24
+
+/**
+ * @struct nfc_device_stats
+ * @brief Device performance counters
+ *
+ * Latency histograms are log2-bucketed in microseconds: bucket 0 counts
+ * latencies under 1 us, bucket n the ones in [2^(n-1), 2^n) us, and the last
+ * bucket all longer ones.
+ */
+typedef struct {
+  /** Commands sent, by PN53x command code */
+  uint64_t commands[256];
+  /** Command and reply bytes exchanged with the chip, frame overhead excluded */
+  uint64_t tx_bytes;
+  uint64_t rx_bytes;
+  /** Failed commands, by PN53x status byte (lower 6 bits) */
+  uint64_t errors[64];
+  /** Replies not received in time */
+  uint64_t timeouts;
+  /** Other failures to exchange frames with the chip */
+  uint64_t io_errors;
+  /** Frames sent again by the driver */
+  uint64_t retries;
+  /** Bus time: sending a command frame, until it is acknowledged */
+  uint64_t bus_latency[NFC_STATS_LATENCY_BUCKETS];
+  /** Chip time: from acknowledgement until the reply is received */
+  uint64_t chip_latency[NFC_STATS_LATENCY_BUCKETS];
+} nfc_device_stats;
+
+/** Payload bytes kept in each nfc_trace_record */
+#define NFC_TRACE_PAYLOAD_LEN 48
+
+/**
+ * @enum nfc_trace_direction
+ * @brief Kind of a trace record
+ */
+typedef enum {
+  /** Command sent to the chip */
+  NTD_TX = 0x01,
+  /** Reply received from the chip */
+  NTD_RX,
+  /** Failed exchange: payload holds the libnfc error code as int32_t */
+  NTD_ERROR,
+} nfc_trace_direction;
+
+/**
+ * @struct nfc_trace_record
+ * @brief Binary trace record, 64 bytes
+ *
+ * Frames are recorded without their link overhead: a command starts with its
+ * PN53x command code, a reply holds the data following its reply code. The
+ * payload is truncated to NFC_TRACE_PAYLOAD_LEN bytes, length is not.
+ */
+typedef struct {
+  /** Monotonic time in microseconds */
+  uint64_t timestamp;
+  /** Record number, starting at 1 */
+  uint32_t sequence;
+  /** Frame length */
+  uint16_t length;
+  /** nfc_trace_direction */
+  uint8_t direction;
+  /** PN53x command code of the exchange */
+  uint8_t command;
+  uint8_t payload[NFC_TRACE_PAYLOAD_LEN];
+} nfc_trace_record;
+
+/** Magic string starting a trace file */
+#define NFC_TRACE_MAGIC   "NFCTRACE"
+/** Trace file format version, also tells the byte order the file was written with */
+#define NFC_TRACE_VERSION 1
+
+/**
+ * @struct nfc_trace_header
+ * @brief Trace file header, followed by records in chronological order
+ */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  /** Size of each record: sizeof(nfc_trace_record) */
+  uint32_t record_size;
+  /** Number of records following the header */
+  uint32_t count;
+  /** Records overwritten before they could be dumped */
+  uint32_t dropped;
+  /** Device name, truncated */
+  char device[40];
+} nfc_trace_header;
+
 #endif // _LIBNFC_TYPES_H_
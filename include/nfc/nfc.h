@@ -91,6 +91,8 @@ NFC_EXPORT void nfc_close(nfc_device *pnd);
 NFC_EXPORT int nfc_abort_command(nfc_device *pnd);
 NFC_EXPORT size_t nfc_list_devices(nfc_context *context, nfc_connstring connstrings[], size_t connstrings_len) ATTRIBUTE_NONNULL(1);
 NFC_EXPORT int nfc_idle(nfc_device *pnd);
+NFC_EXPORT void nfc_device_lock(nfc_device *pnd);
+NFC_EXPORT void nfc_device_unlock(nfc_device *pnd);
 
 /* NFC initiator: act as "reader" */
 NFC_EXPORT int nfc_initiator_init(nfc_device *pnd);
@@ -106,6 +108,11 @@ NFC_EXPORT int nfc_initiator_transceive_bits(nfc_device *pnd, const uint8_t *pbt
 NFC_EXPORT int nfc_initiator_transceive_bytes_timed(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx, uint32_t *cycles);
 NFC_EXPORT int nfc_initiator_transceive_bits_timed(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar, uint8_t *pbtRx, const size_t szRx, uint8_t *pbtRxPar, uint32_t *cycles);
 NFC_EXPORT int nfc_initiator_target_is_present(nfc_device *pnd, const nfc_target *pnt);
+NFC_EXPORT int nfc_initiator_transceive_batch(nfc_device *pnd, nfc_transceive_item items[], const size_t szItems, const nfc_batch_stop stop, int timeout);
+NFC_EXPORT int nfc_inventory_start(nfc_device *pnd, const nfc_modulation *pnmModulations, const size_t szModulations, const int latency);
+NFC_EXPORT int nfc_inventory_next_event(nfc_device *pnd, nfc_inventory_event *pnie, const int timeout);
+NFC_EXPORT int nfc_inventory_stop(nfc_device *pnd);
+NFC_EXPORT int nfc_initiator_transceive_bytes_async(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx, int timeout, nfc_transceive_callback callback, void *user_data);
 
 /* NFC target: act as tag (i.e. MIFARE Classic) or NFC target device. */
 NFC_EXPORT int nfc_target_init(nfc_device *pnd, nfc_target *pnt, uint8_t *pbtRx, const size_t szRx, int timeout);
@@ -126,16 +133,28 @@ NFC_EXPORT const char *nfc_device_get_connstring(nfc_device *pnd);
 NFC_EXPORT int nfc_device_get_supported_modulation(nfc_device *pnd, const nfc_mode mode,  const nfc_modulation_type **const supported_mt);
 NFC_EXPORT int nfc_device_get_supported_baud_rate(nfc_device *pnd, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br);
 NFC_EXPORT int nfc_device_get_supported_baud_rate_target_mode(nfc_device *pnd, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br);
+NFC_EXPORT int nfc_device_get_pollfd(nfc_device *pnd);
+NFC_EXPORT int nfc_device_process_events(nfc_device *pnd);
+NFC_EXPORT int nfc_context_get_pollfd(nfc_context *context);
+NFC_EXPORT int nfc_context_process_events(nfc_context *context, int timeout);
+NFC_EXPORT int nfc_device_get_stats(nfc_device *pnd, nfc_device_stats *pstats);
+NFC_EXPORT void nfc_device_reset_stats(nfc_device *pnd);
+NFC_EXPORT int nfc_device_trace_start(nfc_device *pnd, const size_t szRecords, const char *pcErrorDump);
+NFC_EXPORT int nfc_device_trace_dump(nfc_device *pnd, const char *pcPath);
+NFC_EXPORT int nfc_device_trace_stop(nfc_device *pnd);
 
 /* Properties accessors */
 NFC_EXPORT int nfc_device_set_property_int(nfc_device *pnd, const nfc_property property, const int value);
 NFC_EXPORT int nfc_device_set_property_bool(nfc_device *pnd, const nfc_property property, const bool bEnable);
+NFC_EXPORT int nfc_device_set_properties(nfc_device *pnd, const nfc_property_setting settings[], const size_t szSettings);
 
 /* Misc. functions */
 NFC_EXPORT void iso14443a_crc(uint8_t *pbtData, size_t szLen, uint8_t *pbtCrc);
 NFC_EXPORT void iso14443a_crc_append(uint8_t *pbtData, size_t szLen);
+NFC_EXPORT uint16_t iso14443a_crc_update(uint16_t wCrc, const uint8_t *pbtData, size_t szLen);
 NFC_EXPORT void iso14443b_crc(uint8_t *pbtData, size_t szLen, uint8_t *pbtCrc);
 NFC_EXPORT void iso14443b_crc_append(uint8_t *pbtData, size_t szLen);
+NFC_EXPORT void iso14443a_odd_parity(const uint8_t *pbtData, const size_t szLen, uint8_t *pbtPar);
 NFC_EXPORT uint8_t *iso14443a_locate_historical_bytes(uint8_t *pbtAts, size_t szAts, size_t *pszTk);
 
 NFC_EXPORT void nfc_free(void *p);
@@ -198,6 +217,11 @@ NFC_EXPORT int str_nfc_target(char **buf, const nfc_target *pnt, bool verbose);
  * Target released
  */
 #define NFC_ETGRELEASED			-10
+/** @ingroup error
+ * @hideinitializer
+ * Device busy (an asynchronous operation is pending)
+ */
+#define NFC_EBUSY			-11
 /** @ingroup error
  * @hideinitializer
  * Error while RF transmission
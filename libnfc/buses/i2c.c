@@ -42,6 +42,7 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <ctype.h>
+#include <stdbool.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -51,6 +52,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
+#include <linux/i2c.h>
 
 #include <nfc/nfc.h>
 #include "nfc-internal.h"
@@ -68,19 +70,14 @@ const char *i2c_ports_device_radix[] =
 
 struct i2c_device_unix {
   int fd;             // I2C device file descriptor
+  uint16_t addr;      // Device address, for combined transfers
+  bool bCombined;     // Whether the adapter does combined transfers
 };
 
 #define I2C_DATA( X ) ((struct i2c_device_unix *) X)
 
-/**
- * @brief Open an I2C device
- *
- * @param pcI2C_busName I2C bus device name
- * @param devAddr address of the I2C device on the bus
- * @return pointer to the I2C device structure, or INVALID_I2C_BUS, INVALID_I2C_ADDRESS error codes.
- */
-i2c_device
-i2c_open(const char *pcI2C_busName, uint32_t devAddr)
+static void *
+i2c_dev_open(const char *pcI2C_busName, uint32_t devAddr)
 {
   struct i2c_device_unix *id = malloc(sizeof(struct i2c_device_unix));
 
@@ -90,15 +87,113 @@ i2c_open(const char *pcI2C_busName, uint32_t devAddr)
   id->fd = open(pcI2C_busName, O_RDWR | O_NOCTTY | O_NONBLOCK);
   if (id->fd == -1) {
     perror("Cannot open I2C bus");
-    i2c_close(id);
+    free(id);
     return INVALID_I2C_BUS ;
   }
 
   if (ioctl(id->fd, I2C_SLAVE, devAddr) < 0) {
     perror("Cannot select I2C device");
-    i2c_close(id);
+    close(id->fd);
+    free(id);
     return INVALID_I2C_ADDRESS ;
   }
+  id->addr = devAddr;
+
+  // SMBus only adapters can not issue I2C_RDWR transfers
+  unsigned long funcs = 0;
+  id->bCombined = (ioctl(id->fd, I2C_FUNCS, &funcs) == 0) && (funcs & I2C_FUNC_I2C);
+
+  return id;
+}
+
+static void
+i2c_dev_close(void *data)
+{
+  close(I2C_DATA(data)->fd);
+  free(data);
+}
+
+static ssize_t
+i2c_dev_read(void *data, uint8_t *pbtRx, size_t szRx)
+{
+  return read(I2C_DATA(data)->fd, pbtRx, szRx);
+}
+
+static ssize_t
+i2c_dev_write(void *data, const uint8_t *pbtTx, size_t szTx)
+{
+  return write(I2C_DATA(data)->fd, pbtTx, szTx);
+}
+
+static int
+i2c_dev_write_read(void *data, const uint8_t *pbtTx, size_t szTx, uint8_t *pbtRx, size_t szRx)
+{
+  if (!I2C_DATA(data)->bCombined) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  struct i2c_msg msgs[2] = {
+    { .addr = I2C_DATA(data)->addr, .flags = 0,        .len = szTx, .buf = (uint8_t *) pbtTx },
+    { .addr = I2C_DATA(data)->addr, .flags = I2C_M_RD, .len = szRx, .buf = pbtRx },
+  };
+  struct i2c_rdwr_ioctl_data rdwr = { msgs, 2 };
+  return (ioctl(I2C_DATA(data)->fd, I2C_RDWR, &rdwr) == 2) ? 0 : -1;
+}
+
+static const struct i2c_backend i2c_dev_backend = {
+  .open       = i2c_dev_open,
+  .close      = i2c_dev_close,
+  .read       = i2c_dev_read,
+  .write      = i2c_dev_write,
+  .write_read = i2c_dev_write_read,
+};
+
+struct i2c_port {
+  const struct i2c_backend *backend;
+  void   *data;
+};
+
+#define I2C_PORT( X ) ((struct i2c_port *) X)
+
+/**
+ * @brief Open an I2C device
+ *
+ * @param pcI2C_busName I2C bus device name
+ * @param devAddr address of the I2C device on the bus
+ * @return pointer to the I2C device structure, or INVALID_I2C_BUS, INVALID_I2C_ADDRESS error codes.
+ */
+i2c_device
+i2c_open(const char *pcI2C_busName, uint32_t devAddr)
+{
+  return i2c_open_ext(NULL, pcI2C_busName, devAddr);
+}
+
+/**
+ * @brief Open an I2C device through a given bus backend
+ *
+ * Tests and benchmarks put an emulated chip behind the I2C drivers this way,
+ * see nfc_context::i2c_backend.
+ *
+ * @param backend bus backend, or NULL for Linux i2c-dev
+ * @param pcI2C_busName I2C bus device name
+ * @param devAddr address of the I2C device on the bus
+ * @return pointer to the I2C device structure, or INVALID_I2C_BUS, INVALID_I2C_ADDRESS error codes.
+ */
+i2c_device
+i2c_open_ext(const struct i2c_backend *backend, const char *pcI2C_busName, uint32_t devAddr)
+{
+  struct i2c_port *id = malloc(sizeof(struct i2c_port));
+
+  if (id == 0)
+    return INVALID_I2C_BUS ;
+
+  id->backend = backend ? backend : &i2c_dev_backend;
+  id->data = id->backend->open(pcI2C_busName, devAddr);
+  if ((id->data == INVALID_I2C_BUS) || (id->data == INVALID_I2C_ADDRESS)) {
+    void *res = id->data;
+    free(id);
+    return res;
+  }
 
   return id;
 }
@@ -111,9 +206,7 @@ i2c_open(const char *pcI2C_busName, uint32_t devAddr)
 void
 i2c_close(const i2c_device id)
 {
-  if (I2C_DATA(id) ->fd >= 0) {
-    close(I2C_DATA(id) ->fd);
-  }
+  I2C_PORT(id)->backend->close(I2C_PORT(id)->data);
   free(id);
 }
 
@@ -131,7 +224,7 @@ i2c_read(i2c_device id, uint8_t *pbtRx, const size_t szRx)
   ssize_t res;
   ssize_t recCount;
 
-  recCount = read(I2C_DATA(id) ->fd, pbtRx, szRx);
+  recCount = I2C_PORT(id)->backend->read(I2C_PORT(id)->data, pbtRx, szRx);
 
   if (recCount < 0) {
     res = NFC_EIO;
@@ -161,7 +254,7 @@ i2c_write(i2c_device id, const uint8_t *pbtTx, const size_t szTx)
   LOG_HEX(LOG_GROUP, "TX", pbtTx, szTx);
 
   ssize_t writeCount;
-  writeCount = write(I2C_DATA(id) ->fd, pbtTx, szTx);
+  writeCount = I2C_PORT(id)->backend->write(I2C_PORT(id)->data, pbtTx, szTx);
 
   if ((const ssize_t) szTx == writeCount) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG,
@@ -174,6 +267,37 @@ i2c_write(i2c_device id, const uint8_t *pbtTx, const size_t szTx)
   }
 }
 
+/**
+ * @brief Write \a pbtTx then read into \a pbtRx in a single transfer, the
+ * read starting with a repeated START instead of a STOP and a new START
+ *
+ * @param id I2C device.
+ * @param pbtTx pointer on buffer containing data to write
+ * @param szTx length of data to write
+ * @param pbtRx pointer on buffer used to store read data
+ * @param szRx length of data to read
+ * @return length (in bytes) of read data, NFC_EDEVNOTSUPP when the adapter
+ * can not combine transfers, otherwise driver error code
+ */
+ssize_t
+i2c_write_read(i2c_device id, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx)
+{
+  const struct i2c_backend *backend = I2C_PORT(id)->backend;
+
+  if (!backend->write_read)
+    return NFC_EDEVNOTSUPP;
+
+  LOG_HEX(LOG_GROUP, "TX", pbtTx, szTx);
+  if (backend->write_read(I2C_PORT(id)->data, pbtTx, szTx, pbtRx, szRx) < 0) {
+    if (errno == EOPNOTSUPP)
+      return NFC_EDEVNOTSUPP;
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR,
+            "Error: combined transfer failed (%s).", strerror(errno));
+    return NFC_EIO;
+  }
+  return szRx;
+}
+
 /**
  * @brief Get the path of all I2C bus devices.
  *
@@ -47,7 +47,24 @@ typedef void *i2c_device;
 #  define INVALID_I2C_BUS (void*)(~1)
 #  define INVALID_I2C_ADDRESS (void*)(~2)
 
+/**
+ * @brief Transfers on an I2C bus, Linux i2c-dev unless another backend is
+ * given to i2c_open_ext()
+ *
+ * Transfer functions return like read(2) and write(2), setting errno.
+ */
+struct i2c_backend {
+  /** Returns the backend data, or INVALID_I2C_BUS or INVALID_I2C_ADDRESS */
+  void   *(*open)(const char *pcI2C_busName, uint32_t devAddr);
+  void    (*close)(void *data);
+  ssize_t (*read)(void *data, uint8_t *pbtRx, size_t szRx);
+  ssize_t (*write)(void *data, const uint8_t *pbtTx, size_t szTx);
+  /** Write then read with a repeated START, NULL or failing with EOPNOTSUPP when the adapter can not */
+  int     (*write_read)(void *data, const uint8_t *pbtTx, size_t szTx, uint8_t *pbtRx, size_t szRx);
+};
+
 i2c_device i2c_open(const char *pcI2C_busName, uint32_t devAddr);
+i2c_device i2c_open_ext(const struct i2c_backend *backend, const char *pcI2C_busName, uint32_t devAddr);
 
 void       i2c_close(const i2c_device id);
 
@@ -55,6 +72,8 @@ ssize_t    i2c_read(i2c_device id, uint8_t *pbtRx, const size_t szRx);
 
 int        i2c_write(i2c_device id, const uint8_t *pbtTx, const size_t szTx);
 
+ssize_t    i2c_write_read(i2c_device id, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx);
+
 char     **i2c_list_ports(void);
 
 #endif // __NFC_BUS_I2C_H__
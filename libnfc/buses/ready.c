@@ -0,0 +1,387 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file ready.c
+ * @brief Ready notifiers: when to check whether a chip has a reply ready
+ *
+ * Two notifiers are provided. The poller checks the chip at intervals
+ * doubling from a minimum to a maximum, so short commands are answered
+ * quickly while long ones do not keep the bus busy. The GPIO notifier waits
+ * for the IRQ line of the chip to be asserted, using the Linux GPIO character
+ * device, and only checks the chip then.
+ *
+ * Both wait with poll(2) on an abort pipe as well, so ready_notifier_abort()
+ * interrupts a wait at once.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include "ready.h"
+
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#  include <linux/gpio.h>
+#endif
+
+#include <nfc/nfc.h>
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_COM
+#define LOG_CATEGORY "libnfc.bus.ready"
+
+static int64_t
+ready_now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/*
+ * Time left before the deadline, -1 without timeout: suitable for poll(2).
+ * Returns 0 once the deadline has passed.
+ */
+static int
+ready_remaining(const int64_t deadline)
+{
+  if (deadline < 0)
+    return -1;
+  const int64_t remaining = deadline - ready_now_ms();
+  return (remaining > 0) ? (int) remaining : 0;
+}
+
+/*
+ * Wait for \a fd to be readable or the notifier to be aborted. Returns 1 when
+ * \a fd is readable, 0 on timeout, otherwise driver error code.
+ */
+static int
+ready_poll(struct ready_notifier *rn, const int fd, const int ms)
+{
+  struct pollfd pfds[2] = {
+    { .fd = rn->iAbortFds[0], .events = POLLIN },
+    { .fd = fd, .events = POLLIN },
+  };
+  const nfds_t nfds = (fd >= 0) ? 2 : 1;
+  int res;
+  do {
+    res = poll(pfds, nfds, ms);
+  } while ((res < 0) && (EINTR == errno));
+
+  if (res < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error: %s", strerror(errno));
+    return NFC_EIO;
+  }
+  if (pfds[0].revents) {
+    // Consume the abort request, see ready_notifier_abort()
+    char acDrain[16];
+    while (read(rn->iAbortFds[0], acDrain, sizeof(acDrain)) > 0)
+      ;
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Abort!");
+    return NFC_EOPABORTED;
+  }
+  return (res > 0) ? 1 : 0;
+}
+
+/**
+ * @brief Set up the part of a notifier common to all implementations
+ *
+ * @return NFC_SUCCESS, otherwise NFC_ESOFT
+ */
+int
+ready_notifier_init(struct ready_notifier *rn, const struct ready_notifier_ops *ops)
+{
+  rn->ops = ops;
+  if (pipe(rn->iAbortFds) < 0)
+    return NFC_ESOFT;
+  // Aborts must neither block the caller nor the drain of the pipe
+  fcntl(rn->iAbortFds[0], F_SETFL, O_NONBLOCK);
+  fcntl(rn->iAbortFds[1], F_SETFL, O_NONBLOCK);
+  return NFC_SUCCESS;
+}
+
+void
+ready_notifier_free(struct ready_notifier *rn)
+{
+  if (!rn)
+    return;
+  if (rn->ops->close)
+    rn->ops->close(rn);
+  close(rn->iAbortFds[0]);
+  close(rn->iAbortFds[1]);
+  free(rn);
+}
+
+/**
+ * @brief Wait until \a probe reports the chip ready
+ *
+ * @param timeout timeout in ms, 0 or less to wait indefinitely
+ * @return NFC_SUCCESS when the chip is ready, NFC_ETIMEOUT, NFC_EOPABORTED,
+ * otherwise the error code returned by \a probe
+ */
+int
+ready_notifier_wait(struct ready_notifier *rn, ready_probe probe, void *data, int timeout)
+{
+  return rn->ops->wait(rn, probe, data, timeout);
+}
+
+/**
+ * @brief Abort the current wait, or the next one if none is running
+ *
+ * May be called from any thread.
+ */
+int
+ready_notifier_abort(struct ready_notifier *rn)
+{
+  const char c = 0;
+  if ((write(rn->iAbortFds[1], &c, 1) < 0) && (EAGAIN != errno))
+    return NFC_ESOFT;
+  return NFC_SUCCESS;
+}
+
+/**
+ * @brief Sleep for \a ms milliseconds unless aborted
+ *
+ * @return NFC_SUCCESS, NFC_EOPABORTED, otherwise driver error code
+ */
+int
+ready_notifier_sleep(struct ready_notifier *rn, int ms)
+{
+  const int res = ready_poll(rn, -1, ms);
+  return (res < 0) ? res : NFC_SUCCESS;
+}
+
+/*
+ * Poller, for chips without IRQ line wired.
+ */
+struct ready_poller {
+  struct ready_notifier rn;
+  int     min_interval;
+  int     max_interval;
+};
+
+static int
+ready_poller_wait(struct ready_notifier *rn, ready_probe probe, void *data, int timeout)
+{
+  const struct ready_poller *rp = (struct ready_poller *) rn;
+  const int64_t deadline = (timeout > 0) ? ready_now_ms() + timeout : -1;
+  int interval = rp->min_interval;
+  int res;
+
+  for (;;) {
+    if ((res = probe(data)) != 0)
+      return (res < 0) ? res : NFC_SUCCESS;
+
+    int ms = interval;
+    const int remaining = ready_remaining(deadline);
+    if (remaining == 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Timeout!");
+      return NFC_ETIMEOUT;
+    }
+    if ((remaining > 0) && (remaining < ms))
+      ms = remaining;
+    if ((res = ready_notifier_sleep(rn, ms)) < 0)
+      return res;
+    interval = (interval * 2 < rp->max_interval) ? interval * 2 : rp->max_interval;
+  }
+}
+
+static const struct ready_notifier_ops ready_poller_ops = {
+  .wait  = ready_poller_wait,
+  .close = NULL,
+};
+
+/**
+ * @brief Create a notifier checking the chip at intervals, in ms, doubling
+ * from \a min_interval up to \a max_interval
+ */
+struct ready_notifier *
+ready_notifier_new_poller(const int min_interval, const int max_interval)
+{
+  struct ready_poller *rp = malloc(sizeof(struct ready_poller));
+  if (!rp)
+    return NULL;
+  if (ready_notifier_init(&rp->rn, &ready_poller_ops) < 0) {
+    free(rp);
+    return NULL;
+  }
+  rp->min_interval = (min_interval > 0) ? min_interval : 1;
+  rp->max_interval = (max_interval > rp->min_interval) ? max_interval : rp->min_interval;
+  return &rp->rn;
+}
+
+#if defined(__linux__)
+/*
+ * IRQ line of the chip, through the GPIO character device. The PN532 pulls
+ * its IRQ line low while a reply is ready.
+ */
+struct ready_gpio {
+  struct ready_notifier rn;
+  /** Line event descriptor, readable on falling edges */
+  int     fd;
+};
+
+// Interval between checks while the line is asserted but the chip not ready
+#define READY_GPIO_RETRY_INTERVAL 1
+
+static int
+ready_gpio_wait(struct ready_notifier *rn, ready_probe probe, void *data, int timeout)
+{
+  struct ready_gpio *rg = (struct ready_gpio *) rn;
+  const int64_t deadline = (timeout > 0) ? ready_now_ms() + timeout : -1;
+  int res;
+
+  for (;;) {
+    // Edges seen so far are stale: the line level tells the current state
+    struct gpioevent_data event;
+    while (read(rg->fd, &event, sizeof(event)) > 0)
+      ;
+
+    struct gpiohandle_data values;
+    if (ioctl(rg->fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &values) < 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to read IRQ line: %s", strerror(errno));
+      return NFC_EIO;
+    }
+    const bool asserted = (values.values[0] == 0);
+    if (asserted && ((res = probe(data)) != 0))
+      return (res < 0) ? res : NFC_SUCCESS;
+
+    const int remaining = ready_remaining(deadline);
+    if (remaining == 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Timeout!");
+      return NFC_ETIMEOUT;
+    }
+    if (asserted) {
+      // Wrong wiring or a late chip: do not spin on the asserted line
+      const int ms = ((remaining > 0) && (remaining < READY_GPIO_RETRY_INTERVAL)) ? remaining : READY_GPIO_RETRY_INTERVAL;
+      if ((res = ready_notifier_sleep(rn, ms)) < 0)
+        return res;
+    } else if ((res = ready_poll(rn, rg->fd, remaining)) < 0) {
+      return res;
+    }
+  }
+}
+
+static void
+ready_gpio_close(struct ready_notifier *rn)
+{
+  close(((struct ready_gpio *) rn)->fd);
+}
+
+static const struct ready_notifier_ops ready_gpio_ops = {
+  .wait  = ready_gpio_wait,
+  .close = ready_gpio_close,
+};
+
+/**
+ * @brief Create a notifier waiting for an IRQ line
+ *
+ * @param pcLine line as chip/offset, e.g. gpiochip0/25: the chip is a device
+ * name under /dev or a path
+ */
+struct ready_notifier *
+ready_notifier_new_gpio(const char *pcLine)
+{
+  const char *pcOffset = strrchr(pcLine, '/');
+  char *pcEnd;
+  if (!pcOffset || (pcOffset == pcLine)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Invalid IRQ line: %s", pcLine);
+    return NULL;
+  }
+  const unsigned long ulOffset = strtoul(pcOffset + 1, &pcEnd, 10);
+  if ((pcOffset[1] == '\0') || (*pcEnd != '\0') || (ulOffset > UINT32_MAX)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Invalid IRQ line: %s", pcLine);
+    return NULL;
+  }
+  char acChip[PATH_MAX];
+  snprintf(acChip, sizeof(acChip), "%s%.*s", (pcLine[0] == '/') ? "" : "/dev/", (int)(pcOffset - pcLine), pcLine);
+
+  int fdChip = open(acChip, O_RDONLY);
+  if (fdChip < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to open %s: %s", acChip, strerror(errno));
+    return NULL;
+  }
+  struct gpioevent_request req;
+  memset(&req, 0, sizeof(req));
+  req.lineoffset = (uint32_t) ulOffset;
+  req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+  req.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE;
+  snprintf(req.consumer_label, sizeof(req.consumer_label), "libnfc");
+  const int res = ioctl(fdChip, GPIO_GET_LINEEVENT_IOCTL, &req);
+  close(fdChip);
+  if (res < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to request IRQ line %s: %s", pcLine, strerror(errno));
+    return NULL;
+  }
+  // Stale events are drained before each wait
+  fcntl(req.fd, F_SETFL, O_NONBLOCK);
+
+  struct ready_gpio *rg = malloc(sizeof(struct ready_gpio));
+  if (!rg) {
+    close(req.fd);
+    return NULL;
+  }
+  if (ready_notifier_init(&rg->rn, &ready_gpio_ops) < 0) {
+    close(req.fd);
+    free(rg);
+    return NULL;
+  }
+  rg->fd = req.fd;
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Waiting for IRQ on %s line %lu.", acChip, ulOffset);
+  return &rg->rn;
+}
+#else
+struct ready_notifier *
+ready_notifier_new_gpio(const char *pcLine)
+{
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "IRQ line %s: GPIO lines are only supported on Linux", pcLine);
+  return NULL;
+}
+#endif
+
+/**
+ * @brief Create the notifier of a chip: waiting for \a pcIrqLine if set,
+ * polling otherwise
+ */
+struct ready_notifier *
+ready_notifier_new(const char *pcIrqLine, const int min_interval, const int max_interval)
+{
+  if (pcIrqLine)
+    return ready_notifier_new_gpio(pcIrqLine);
+  return ready_notifier_new_poller(min_interval, max_interval);
+}
@@ -0,0 +1,81 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file ready.h
+ * @brief Ready notifiers header
+ */
+
+#ifndef __NFC_BUS_READY_H__
+#  define __NFC_BUS_READY_H__
+
+#  include <stdbool.h>
+
+#  include <nfc/nfc-types.h>
+
+/**
+ * @brief Check whether the chip has a reply ready
+ *
+ * @return a positive value when ready, 0 when not ready yet, otherwise driver
+ * error code
+ */
+typedef int (*ready_probe)(void *data);
+
+struct ready_notifier;
+
+struct ready_notifier_ops {
+  /** Wait until \a probe reports the chip ready, see ready_notifier_wait() */
+  int   (*wait)(struct ready_notifier *rn, ready_probe probe, void *data, int timeout);
+  /** Release what the notifier holds, but the notifier itself */
+  void  (*close)(struct ready_notifier *rn);
+};
+
+/**
+ * @brief Source of the readiness of a chip on a bus without flow control
+ *
+ * SPI and I2C give no sign of a reply being ready but a status the host has
+ * to read. A notifier decides when to read it: when an IRQ line is asserted,
+ * or at growing intervals. Implementations embed this struct first.
+ */
+struct ready_notifier {
+  const struct ready_notifier_ops *ops;
+  /** Pipe written to by ready_notifier_abort(), watched while waiting */
+  int     iAbortFds[2];
+};
+
+int     ready_notifier_init(struct ready_notifier *rn, const struct ready_notifier_ops *ops);
+void    ready_notifier_free(struct ready_notifier *rn);
+
+int     ready_notifier_wait(struct ready_notifier *rn, ready_probe probe, void *data, int timeout);
+int     ready_notifier_abort(struct ready_notifier *rn);
+int     ready_notifier_sleep(struct ready_notifier *rn, int ms);
+
+struct ready_notifier *ready_notifier_new_poller(const int min_interval, const int max_interval);
+struct ready_notifier *ready_notifier_new_gpio(const char *pcLine);
+
+struct ready_notifier *ready_notifier_new(const char *pcIrqLine, const int min_interval, const int max_interval);
+
+#endif // __NFC_BUS_READY_H__
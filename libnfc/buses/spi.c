@@ -54,6 +54,7 @@
 
 #include <nfc/nfc.h>
 #include "nfc-internal.h"
+#include "mirror-subr.h"
 
 #define LOG_GROUP    NFC_LOG_GROUP_COM
 #define LOG_CATEGORY "libnfc.bus.spi"
@@ -69,10 +70,22 @@ const char *spi_ports_device_radix[] = { "spidev", NULL };
 #  endif
 
 
+// Large enough for a PN53x extended frame and its SPI command byte
+#define SPI_SCRATCH_LEN 512
+
+enum spi_lsb_first_support {
+  SPI_LSB_FIRST_UNKNOWN,
+  SPI_LSB_FIRST_SUPPORTED,
+  SPI_LSB_FIRST_UNSUPPORTED,
+};
+
 struct spi_port_unix {
   int 			fd; 			// Serial port file descriptor
   //~ struct termios 	termios_backup; 	// Terminal info before using the port
   //~ struct termios 	termios_new; 		// Terminal info during the transaction
+  enum spi_lsb_first_support lsb_first_support; // Whether the controller shifts LSB first itself
+  bool      lsb_first;        // Bit order currently set on the controller
+  uint8_t   abtScratch[SPI_SCRATCH_LEN]; // Bit-reversed TX data, when the controller can not do it
 };
 
 #define SPI_DATA( X ) ((struct spi_port_unix *) X)
@@ -86,12 +99,19 @@ spi_open(const char *pcPortName)
   if (sp == 0)
     return INVALID_SPI_PORT;
 
+  sp->lsb_first_support = SPI_LSB_FIRST_UNKNOWN;
   sp->fd = open(pcPortName, O_RDWR | O_NOCTTY | O_NONBLOCK);
   if (sp->fd == -1) {
     spi_close(sp);
     return INVALID_SPI_PORT;
   }
 
+  // spidev keeps the bit order set by its previous user
+  uint8_t lsb = 0;
+  if (ioctl(sp->fd, SPI_IOC_RD_LSB_FIRST, &lsb) == -1)
+    lsb = 0;
+  sp->lsb_first = (lsb != 0);
+
 
   return sp;
 }
@@ -118,6 +138,7 @@ spi_set_mode(spi_port sp, const uint32_t uiPortMode)
   ret = ioctl(SPI_DATA(sp)->fd, SPI_IOC_WR_MODE, &uiPortMode);
 
   if (ret == -1)  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error setting SPI mode.");
+  else SPI_DATA(sp)->lsb_first = (uiPortMode & SPI_LSB_FIRST) != 0;
 
 }
 
@@ -144,28 +165,39 @@ spi_close(const spi_port sp)
 
 
 /**
- * @brief Perform bit reversal on one byte \a x
+ * @brief Set the bit order of the controller to \a lsb_first, if it supports it
  *
- * @return reversed byte
+ * Support is probed on first use: once the controller refused SPI_LSB_FIRST,
+ * bits are always reversed by the host.
+ *
+ * @return true if the controller shifts bits in the requested order
  */
-
-static uint8_t
-bit_reversal(const uint8_t x)
+static bool
+spi_set_lsb_first(struct spi_port_unix *sp, bool lsb_first)
 {
-  uint8_t ret = x;
-  ret = (((ret & 0xaa) >> 1) | ((ret & 0x55) << 1));
-  ret = (((ret & 0xcc) >> 2) | ((ret & 0x33) << 2));
-  ret = (((ret & 0xf0) >> 4) | ((ret & 0x0f) << 4));
-  return ret;
+  if (sp->lsb_first == lsb_first)
+    return true;
+  if (sp->lsb_first_support == SPI_LSB_FIRST_UNSUPPORTED)
+    return false;
+
+  uint8_t lsb = lsb_first ? SPI_LSB_FIRST : 0;
+  if (ioctl(sp->fd, SPI_IOC_WR_LSB_FIRST, &lsb) == -1) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "SPI controller can not shift LSB first (%s), bits will be reversed by host.", strerror(errno));
+    sp->lsb_first_support = SPI_LSB_FIRST_UNSUPPORTED;
+    return false;
+  }
+  sp->lsb_first_support = SPI_LSB_FIRST_SUPPORTED;
+  sp->lsb_first = lsb_first;
+  return true;
 }
 
-
-
-
-
 /**
  * @brief Send \a pbtTx content to SPI then receive data from SPI and copy data to \a pbtRx. CS line stays active	 between transfers as well as during transfers.
  *
+ * LSB-first transfers use the controller's SPI_LSB_FIRST mode when it is
+ * available. Otherwise TX data is bit-reversed into the port's scratch buffer
+ * and RX data is bit-reversed in place.
+ *
  * @return 0 on success, otherwise a driver error is returned
  */
 int
@@ -174,22 +206,23 @@ spi_send_receive(spi_port sp, const uint8_t *pbtTx, const size_t szTx, uint8_t *
   size_t transfers = 0;
   struct spi_ioc_transfer tr[2];
 
+  // Either the controller shifts in the requested order, or the host reverses bits
+  const bool reverse = lsb_first && !spi_set_lsb_first(SPI_DATA(sp), true);
+  if (!lsb_first)
+    spi_set_lsb_first(SPI_DATA(sp), false);
 
   uint8_t *pbtTxLSB = 0;
 
   if (szTx) {
     LOG_HEX(LOG_GROUP, "TX", pbtTx, szTx);
-    if (lsb_first) {
-      pbtTxLSB = malloc(szTx * sizeof(uint8_t));
-      if (!pbtTxLSB) {
+    if (reverse) {
+      if (szTx <= SPI_SCRATCH_LEN) {
+        pbtTxLSB = SPI_DATA(sp)->abtScratch;
+      } else if (!(pbtTxLSB = malloc(szTx * sizeof(uint8_t)))) {
         return NFC_ESOFT;
       }
 
-      size_t i;
-      for (i = 0; i < szTx; ++i) {
-        pbtTxLSB[i] = bit_reversal(pbtTx[i]);
-      }
-
+      mirror_buffer(pbtTxLSB, pbtTx, szTx);
       pbtTx = pbtTxLSB;
     }
 
@@ -223,7 +256,7 @@ spi_send_receive(spi_port sp, const uint8_t *pbtTx, const size_t szTx, uint8_t *
 
   if (transfers) {
     int ret = ioctl(SPI_DATA(sp)->fd, SPI_IOC_MESSAGE(transfers), tr);
-    if (szTx && lsb_first) {
+    if (pbtTxLSB && pbtTxLSB != SPI_DATA(sp)->abtScratch) {
       free(pbtTxLSB);
     }
 
@@ -233,11 +266,8 @@ spi_send_receive(spi_port sp, const uint8_t *pbtTx, const size_t szTx, uint8_t *
 
     // Reverse received bytes if needed
     if (szRx) {
-      if (lsb_first) {
-        size_t i;
-        for (i = 0; i < szRx; ++i) {
-          pbtRx[i] = bit_reversal(pbtRx[i]);
-        }
+      if (reverse) {
+        mirror_buffer(pbtRx, pbtRx, szRx);
       }
 
       LOG_HEX(LOG_GROUP, "RX", pbtRx, szRx);
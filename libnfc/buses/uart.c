@@ -37,7 +37,6 @@
 #include "uart.h"
 
 #include <sys/ioctl.h>
-#include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -46,11 +45,16 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <termios.h>
 #include <unistd.h>
 #include <stdlib.h>
 
+#if defined(__linux__)
+#  include <linux/serial.h>
+#endif
+
 #include <nfc/nfc.h>
 #include "nfc-internal.h"
 
@@ -95,24 +99,145 @@ const char *serial_ports_device_radix[] = { "ttyUSB", "ttyS", "ttyACM", "ttyAMA"
 // Work-around to claim uart interface using the c_iflag (software input processing) from the termios struct
 #  define CCLAIMED 0x80000000
 
+// Large enough for a PN53x extended frame and its ACK
+#define UART_RX_BUFFER_LEN 512
+
+// Latency timer of USB-serial bridges in low latency mode, in ms
+#define UART_LATENCY_TIMER 1
+
 struct serial_port_unix {
   int 			fd; 			// Serial port file descriptor
   struct termios 	termios_backup; 	// Terminal info before using the port
   struct termios 	termios_new; 		// Terminal info during the transaction
+  uint8_t   abtRx[UART_RX_BUFFER_LEN]; // Bytes read ahead, not yet handed to the caller
+  size_t    szRxStart;        // Offset of the first pending byte in abtRx
+  size_t    szRxLen;          // Count of pending bytes in abtRx
+#if defined(__linux__)
+  int       iSerialFlags;     // serial_struct flags before low latency mode, or -1
+  char     *pcLatencyTimer;   // sysfs latency timer of the USB-serial bridge, or NULL
+  int       iLatencyTimer;    // Latency timer before low latency mode
+#endif
 };
 
 #define UART_DATA( X ) ((struct serial_port_unix *) X)
 
 void uart_close_ext(const serial_port sp, const bool restore_termios);
 
+#if defined(__linux__)
+static int
+uart_read_sysfs_int(const char *pcPath)
+{
+  char acValue[16];
+  int fd = open(pcPath, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  ssize_t res = read(fd, acValue, sizeof(acValue) - 1);
+  close(fd);
+  if (res <= 0)
+    return -1;
+  acValue[res] = '\0';
+  return atoi(acValue);
+}
+
+static int
+uart_write_sysfs_int(const char *pcPath, const int iValue)
+{
+  char acValue[16];
+  int fd = open(pcPath, O_WRONLY);
+  if (fd < 0)
+    return -1;
+  const int len = snprintf(acValue, sizeof(acValue), "%d", iValue);
+  ssize_t res = write(fd, acValue, len);
+  close(fd);
+  return (res == len) ? 0 : -1;
+}
+
+/*
+ * Ask the tty layer to push received bytes to readers at once, and lower the
+ * latency timer of USB-serial bridges (FTDI, ...) which otherwise hold
+ * replies up to 16 ms. Both are optional: ports not supporting them are left
+ * as is, and uart_close_ext() restores what was changed.
+ */
+static void
+uart_set_low_latency(struct serial_port_unix *sp, const char *pcPortName)
+{
+  struct serial_struct ss;
+  if ((ioctl(sp->fd, TIOCGSERIAL, &ss) == 0) && !(ss.flags & ASYNC_LOW_LATENCY)) {
+    const int iFlags = ss.flags;
+    ss.flags |= ASYNC_LOW_LATENCY;
+    if (ioctl(sp->fd, TIOCSSERIAL, &ss) == 0)
+      sp->iSerialFlags = iFlags;
+    else
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Unable to set ASYNC_LOW_LATENCY: %s", strerror(errno));
+  }
+
+  // The latency timer belongs to the USB device behind /dev/ttyUSBx
+  char *pcDevice = realpath(pcPortName, NULL);
+  if (!pcDevice)
+    return;
+  const char *pcName = strrchr(pcDevice, '/');
+  char acPath[PATH_MAX];
+  snprintf(acPath, sizeof(acPath), "/sys/class/tty/%s/device/latency_timer", pcName ? pcName + 1 : pcDevice);
+  free(pcDevice);
+
+  const int iLatencyTimer = uart_read_sysfs_int(acPath);
+  if ((iLatencyTimer <= UART_LATENCY_TIMER) || (access(acPath, W_OK) != 0))
+    return;
+  if (uart_write_sysfs_int(acPath, UART_LATENCY_TIMER) < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Unable to set %s", acPath);
+    return;
+  }
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Latency timer lowered from %d to %d ms.", iLatencyTimer, UART_LATENCY_TIMER);
+  sp->pcLatencyTimer = strdup(acPath);
+  sp->iLatencyTimer = iLatencyTimer;
+}
+
+static void
+uart_restore_low_latency(struct serial_port_unix *sp)
+{
+  struct serial_struct ss;
+  if ((sp->iSerialFlags >= 0) && (ioctl(sp->fd, TIOCGSERIAL, &ss) == 0)) {
+    ss.flags = sp->iSerialFlags;
+    ioctl(sp->fd, TIOCSSERIAL, &ss);
+  }
+  if (sp->pcLatencyTimer)
+    uart_write_sysfs_int(sp->pcLatencyTimer, sp->iLatencyTimer);
+}
+#endif
+
 serial_port
 uart_open(const char *pcPortName)
+{
+  return uart_open_ext(pcPortName, false);
+}
+
+/**
+ * @brief Open a serial port
+ *
+ * In low latency mode, received bytes are handed to readers as soon as they
+ * arrive: the tty is set ASYNC_LOW_LATENCY, and the latency timer of
+ * USB-serial bridges is lowered when its sysfs attribute is writable. This
+ * saves up to the bridge latency timer on every reply, at the cost of more
+ * USB traffic. uart_close() restores the former settings.
+ *
+ * VMIN and VTIME are not used in either mode: the port is non-blocking and
+ * readers wait for data with poll().
+ */
+serial_port
+uart_open_ext(const char *pcPortName, const bool low_latency)
 {
   struct serial_port_unix *sp = malloc(sizeof(struct serial_port_unix));
 
   if (sp == 0)
     return INVALID_SERIAL_PORT;
 
+  sp->szRxStart = 0;
+  sp->szRxLen = 0;
+#if defined(__linux__)
+  sp->iSerialFlags = -1;
+  sp->pcLatencyTimer = NULL;
+  sp->iLatencyTimer = 0;
+#endif
   sp->fd = open(pcPortName, O_RDWR | O_NOCTTY | O_NONBLOCK);
   if (sp->fd == -1) {
     uart_close_ext(sp, false);
@@ -143,6 +268,10 @@ uart_open(const char *pcPortName)
     uart_close_ext(sp, true);
     return INVALID_SERIAL_PORT;
   }
+#if defined(__linux__)
+  if (low_latency)
+    uart_set_low_latency(sp, pcPortName);
+#endif
   return sp;
 }
 
@@ -157,6 +286,12 @@ uart_flush_input(serial_port sp, bool wait)
     msleep(50); // 50 ms
   }
 
+  if (UART_DATA(sp)->szRxLen) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%zu buffered bytes have eaten.", UART_DATA(sp)->szRxLen);
+    UART_DATA(sp)->szRxStart = 0;
+    UART_DATA(sp)->szRxLen = 0;
+  }
+
   // This line seems to produce absolutely no effect on my system (GNU/Linux 2.6.35)
   tcflush(UART_DATA(sp)->fd, TCIFLUSH);
   // So, I wrote this byte-eater
@@ -185,7 +320,13 @@ uart_flush_input(serial_port sp, bool wait)
   free(rx);
 }
 
-void
+/**
+ * @brief Set the speed of the port, both ways
+ *
+ * @return 0 on success, NFC_EINVARG if the speed is not supported by the
+ * host, otherwise NFC_EIO
+ */
+int
 uart_set_speed(serial_port sp, const uint32_t uiPortSpeed)
 {
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Serial port speed requested to be set to %d baud.", uiPortSpeed);
@@ -222,11 +363,16 @@ uart_set_speed(serial_port sp, const uint32_t uiPortSpeed)
     case 460800:
       stPortSpeed = B460800;
       break;
+#  endif
+#  ifdef B921600
+    case 921600:
+      stPortSpeed = B921600;
+      break;
 #  endif
     default:
       log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set serial port speed to %d baud. Speed value must be one of those defined in termios(3).",
               uiPortSpeed);
-      return;
+      return NFC_EINVARG;
   };
 
   // Set port speed (Input and Output)
@@ -234,7 +380,9 @@ uart_set_speed(serial_port sp, const uint32_t uiPortSpeed)
   cfsetospeed(&(UART_DATA(sp)->termios_new), stPortSpeed);
   if (tcsetattr(UART_DATA(sp)->fd, TCSADRAIN, &(UART_DATA(sp)->termios_new)) == -1) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to apply new speed settings.");
+    return NFC_EIO;
   }
+  return NFC_SUCCESS;
 }
 
 uint32_t
@@ -270,6 +418,11 @@ uart_get_speed(serial_port sp)
     case B460800:
       uiPortSpeed = 460800;
       break;
+#  endif
+#  ifdef B921600
+    case B921600:
+      uiPortSpeed = 921600;
+      break;
 #  endif
   }
 
@@ -280,10 +433,17 @@ void
 uart_close_ext(const serial_port sp, const bool restore_termios)
 {
   if (UART_DATA(sp)->fd >= 0) {
-    if (restore_termios)
+    if (restore_termios) {
+#if defined(__linux__)
+      uart_restore_low_latency(UART_DATA(sp));
+#endif
       tcsetattr(UART_DATA(sp)->fd, TCSANOW, &UART_DATA(sp)->termios_backup);
+    }
     close(UART_DATA(sp)->fd);
   }
+#if defined(__linux__)
+  free(UART_DATA(sp)->pcLatencyTimer);
+#endif
   free(sp);
 }
 
@@ -294,79 +454,140 @@ uart_close(const serial_port sp)
 }
 
 /**
- * @brief Receive data from UART and copy data to \a pbtRx
+ * @brief Move up to \a szRx bytes read ahead to \a pbtRx
  *
- * @return 0 on success, otherwise driver error code
+ * @return count of bytes moved
  */
-int
-uart_receive(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, int timeout)
+static size_t
+uart_take_buffered(struct serial_port_unix *sp, uint8_t *pbtRx, const size_t szRx)
 {
-  int iAbortFd = abort_p ? *((int *)abort_p) : 0;
-  int received_bytes_count = 0;
-  int available_bytes_count = 0;
-  const int expected_bytes_count = (int)szRx;
+  const size_t sz = MIN(szRx, sp->szRxLen);
+  memcpy(pbtRx, sp->abtRx + sp->szRxStart, sz);
+  sp->szRxStart += sz;
+  sp->szRxLen -= sz;
+  if (!sp->szRxLen)
+    sp->szRxStart = 0;
+  return sz;
+}
+
+/**
+ * @brief Wait for the UART to be readable
+ *
+ * poll(2) is used rather than select(2), which can not watch descriptors
+ * above FD_SETSIZE: processes with many readers open easily exceed it.
+ *
+ * @return 0 when data is available, otherwise driver error code
+ */
+static int
+uart_wait_readable(struct serial_port_unix *sp, int iAbortFd, int timeout)
+{
+  struct pollfd pfds[2] = {
+    { .fd = sp->fd, .events = POLLIN },
+    { .fd = iAbortFd, .events = POLLIN },
+  };
+  const nfds_t nfds = iAbortFd ? 2 : 1;
   int res;
-  fd_set rfds;
   do {
-select:
-    // Reset file descriptor
-    FD_ZERO(&rfds);
-    FD_SET(UART_DATA(sp)->fd, &rfds);
+    res = poll(pfds, nfds, (timeout > 0) ? timeout : -1);
 
-    if (iAbortFd) {
-      FD_SET(iAbortFd, &rfds);
-    }
-
-    struct timeval timeout_tv;
-    if (timeout > 0) {
-      timeout_tv.tv_sec = (timeout / 1000);
-      timeout_tv.tv_usec = ((timeout % 1000) * 1000);
-    }
-
-    res = select(MAX(UART_DATA(sp)->fd, iAbortFd) + 1, &rfds, NULL, NULL, timeout ? &timeout_tv : NULL);
+    // The system call was interupted by a signal and a signal handler was
+    // run.  Restart the interupted system call.
+  } while ((res < 0) && (EINTR == errno));
 
-    if ((res < 0) && (EINTR == errno)) {
-      // The system call was interupted by a signal and a signal handler was
-      // run.  Restart the interupted system call.
-      goto select;
-    }
-
-    // Read error
-    if (res < 0) {
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error: %s", strerror(errno));
-      return NFC_EIO;
-    }
-    // Read time-out
-    if (res == 0) {
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Timeout!");
-      return NFC_ETIMEOUT;
-    }
+  // Read error
+  if (res < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error: %s", strerror(errno));
+    return NFC_EIO;
+  }
+  // Read time-out
+  if (res == 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Timeout!");
+    return NFC_ETIMEOUT;
+  }
 
-    if (FD_ISSET(iAbortFd, &rfds)) {
-      // Abort requested
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Abort!");
-      close(iAbortFd);
-      return NFC_EOPABORTED;
-    }
+  // The abort pipe signals by having its other end closed: any event counts
+  if ((nfds > 1) && pfds[1].revents) {
+    // Abort requested
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Abort!");
+    close(iAbortFd);
+    return NFC_EOPABORTED;
+  }
+  return NFC_SUCCESS;
+}
 
-    // Retrieve the count of the incoming bytes
-    res = ioctl(UART_DATA(sp)->fd, FIONREAD, &available_bytes_count);
-    if (res != 0) {
-      return NFC_EIO;
+static int
+uart_receive_ext(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, int timeout, const bool read_ahead)
+{
+  int iAbortFd = abort_p ? *((int *)abort_p) : 0;
+  size_t received_bytes_count = uart_take_buffered(UART_DATA(sp), pbtRx, szRx);
+  bool waited = false;
+
+  while (received_bytes_count < szRx) {
+    // Everything buffered has been taken: read as much as the kernel has
+    // into the buffer, or straight to pbtRx for what does not fit in it
+    const size_t szLeft = szRx - received_bytes_count;
+    const bool buffered = read_ahead && (szLeft < UART_RX_BUFFER_LEN);
+    uint8_t *pbt = buffered ? UART_DATA(sp)->abtRx : pbtRx + received_bytes_count;
+
+    // The port is non-blocking: data is often there already, then waiting for it is a wasted syscall
+    ssize_t res = read(UART_DATA(sp)->fd, pbt, buffered ? UART_RX_BUFFER_LEN : szLeft);
+    if (res > 0) {
+      if (buffered) {
+        UART_DATA(sp)->szRxLen = (size_t) res;
+        received_bytes_count += uart_take_buffered(UART_DATA(sp), pbtRx + received_bytes_count, szLeft);
+      } else {
+        received_bytes_count += (size_t) res;
+      }
+      waited = false;
+      continue;
     }
-    // There is something available, read the data
-    res = read(UART_DATA(sp)->fd, pbtRx + received_bytes_count, MIN(available_bytes_count, (expected_bytes_count - received_bytes_count)));
+    if ((res < 0) && (EINTR == errno))
+      continue;
     // Stop if the OS has some troubles reading the data
-    if (res <= 0) {
+    if (((res < 0) && (EAGAIN != errno) && (EWOULDBLOCK != errno)) || ((res == 0) && waited)) {
       return NFC_EIO;
     }
-    received_bytes_count += res;
 
-  } while (expected_bytes_count > received_bytes_count);
+    int ret;
+    if ((ret = uart_wait_readable(UART_DATA(sp), iAbortFd, timeout)) != NFC_SUCCESS) {
+      return ret;
+    }
+    waited = true;
+  }
   LOG_HEX(LOG_GROUP, "RX", pbtRx, szRx);
   return NFC_SUCCESS;
 }
 
+/**
+ * @brief Receive data from UART and copy data to \a pbtRx
+ *
+ * Bytes are read from the port in chunks as large as available: what follows
+ * \a szRx is kept for the next calls, so a frame read piecewise usually
+ * costs a single read(2).
+ *
+ * @return 0 on success, otherwise driver error code
+ */
+int
+uart_receive(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, int timeout)
+{
+  return uart_receive_ext(sp, pbtRx, szRx, abort_p, timeout, true);
+}
+
+/**
+ * @brief Receive exactly \a szRx bytes from UART and copy data to \a pbtRx
+ *
+ * Unlike uart_receive(), nothing is read ahead: bytes that follow stay in the
+ * kernel, so the port file descriptor still reports them as readable. This is
+ * meant for the last read before the caller waits on uart_get_fd().
+ *
+ * @return 0 on success, otherwise driver error code
+ */
+int
+uart_receive_exact(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, int timeout)
+{
+  return uart_receive_ext(sp, pbtRx, szRx, abort_p, timeout, false);
+}
+
 /**
  * @brief Send \a pbtTx content to UART
  *
@@ -383,6 +604,17 @@ uart_send(serial_port sp, const uint8_t *pbtTx, const size_t szTx, int timeout)
     return NFC_EIO;
 }
 
+/**
+ * @brief Get the file descriptor of the opened serial port
+ *
+ * @return file descriptor, suitable for select(2) or poll(2)
+ */
+int
+uart_get_fd(const serial_port sp)
+{
+  return UART_DATA(sp)->fd;
+}
+
 char **
 uart_list_ports(void)
 {
@@ -50,14 +50,17 @@ typedef void *serial_port;
 #  define CLAIMED_SERIAL_PORT (void*)(~2)
 
 serial_port uart_open(const char *pcPortName);
+serial_port uart_open_ext(const char *pcPortName, const bool low_latency);
 void    uart_close(const serial_port sp);
 void    uart_flush_input(const serial_port sp, bool wait);
 
-void    uart_set_speed(serial_port sp, const uint32_t uiPortSpeed);
+int     uart_set_speed(serial_port sp, const uint32_t uiPortSpeed);
 uint32_t uart_get_speed(const serial_port sp);
 
 int     uart_receive(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, int timeout);
+int     uart_receive_exact(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, int timeout);
 int     uart_send(serial_port sp, const uint8_t *pbtTx, const size_t szTx, int timeout);
+int     uart_get_fd(const serial_port sp);
 
 char  **uart_list_ports(void);
 
@@ -38,9 +38,28 @@
 
 #include "usbbus.h"
 #include "log.h"
+#include "nfc-internal.h"
 #define LOG_CATEGORY "libnfc.buses.usbbus"
 #define LOG_GROUP    NFC_LOG_GROUP_DRIVER
 
+// libusb 0.1 keeps a single bus list per process
+static nfc_mutex usb_bus_mutex = NFC_MUTEX_INITIALIZER;
+
+/*
+ * Take the bus lock: needed around usb_prepare() and walks of
+ * usb_get_busses(), which usb_prepare() may rebuild from another thread
+ * (e.g. two USB drivers scanning at once).
+ */
+void usb_bus_lock(void)
+{
+  nfc_mutex_lock(&usb_bus_mutex);
+}
+
+void usb_bus_unlock(void)
+{
+  nfc_mutex_unlock(&usb_bus_mutex);
+}
+
 int usb_prepare(void)
 {
   static bool usb_initialized = false;
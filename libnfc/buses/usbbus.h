@@ -49,6 +49,8 @@
 #include <stdbool.h>
 #include <string.h>
 
+void usb_bus_lock(void);
+void usb_bus_unlock(void);
 int usb_prepare(void);
 
 #endif // __NFC_BUS_USB_H__
@@ -45,8 +45,6 @@
 #include "pn53x.h"
 #include "pn53x-internal.h"
 
-#include "mirror-subr.h"
-
 #define LOG_CATEGORY "libnfc.chip.pn53x"
 #define LOG_GROUP NFC_LOG_GROUP_CHIP
 
@@ -66,6 +64,8 @@ const nfc_modulation_type pn53x_supported_modulation_as_target[] = {NMT_ISO14443
 /* prototypes */
 int pn53x_reset_settings(struct nfc_device *pnd);
 int pn53x_writeback_register(struct nfc_device *pnd);
+static void pn53x_shadow_track(struct nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt);
+static void pn53x_shadow_invalidate(struct nfc_device *pnd, const uint16_t ui16FirstAddress, const uint16_t ui16LastAddress);
 
 nfc_modulation pn53x_ptt_to_nm(const pn53x_target_type ptt);
 pn53x_modulation pn53x_nm_to_pm(const nfc_modulation nm);
@@ -144,6 +144,9 @@ int
 pn53x_reset_settings(struct nfc_device *pnd)
 {
   int res = 0;
+  // Registers still unknown will be read along with the next write-back needing
+  // a ReadRegister, e.g. after a target was selected
+  CHIP_DATA(pnd)->shadow_populate = true;
   // Reset the ending transmission bits register, it is unknown what the last tranmission used there
   CHIP_DATA(pnd)->ui8TxBits = 0;
   if ((res = pn53x_write_register(pnd, PN53X_REG_CIU_BitFraming, SYMBOL_TX_LAST_BITS, 0x00)) < 0) {
@@ -164,10 +167,80 @@ pn53x_reset_settings(struct nfc_device *pnd)
   return NFC_SUCCESS;
 }
 
-int
-pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRxLen, int timeout)
+static void
+pn53x_stats_io_error(struct nfc_device *pnd, const uint8_t btCmd, const int res)
+{
+  if (res == NFC_ETIMEOUT) {
+    NFC_STATS_ADD(pnd->stats.timeouts, 1);
+  } else if (res != NFC_EOPABORTED) {
+    NFC_STATS_ADD(pnd->stats.io_errors, 1);
+  }
+  nfc_trace_error(pnd, btCmd, res);
+}
+
+/*
+ * Record the first bytes of a frame of szFrame bytes held by iov in the
+ * device trace, if any.
+ */
+static void
+pn53x_trace(struct nfc_device *pnd, const nfc_trace_direction ntd, const uint8_t btCmd, const struct pn53x_iovec *iov, const size_t iovcnt, const size_t szFrame)
+{
+  nfc_trace_record *pntr;
+  if (!(pntr = nfc_trace_begin(pnd, ntd, btCmd, szFrame)))
+    return;
+  pn53x_iov_copy_from(iov, iovcnt, 0, pntr->payload, MIN(szFrame, NFC_TRACE_PAYLOAD_LEN));
+  nfc_trace_commit(pnd, pntr);
+}
+
+/*
+ * Write a PN53x frame of szFrame bytes held by iov to the context capture:
+ * a command starts with its code, a reply with the data following its code.
+ */
+static void
+pn53x_capture_host(struct nfc_device *pnd, const bool bReply, const uint8_t btCmd, const struct pn53x_iovec *iov, const size_t iovcnt, const size_t szFrame)
+{
+  uint8_t  abtFrame[2 + PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  size_t  szHeader = 0;
+  abtFrame[szHeader++] = bReply ? 0xD5 : 0xD4;
+  if (bReply)
+    abtFrame[szHeader++] = btCmd + 1;
+  const size_t sz = pn53x_iov_copy_from(iov, iovcnt, 0, abtFrame + szHeader, MIN(szFrame, sizeof(abtFrame) - szHeader));
+  nfc_capture_frame(pnd, NCL_HOST, bReply, abtFrame, szHeader + sz);
+}
+
+/*
+ * Write the RF frame carried by an InDataExchange or InCommunicateThru command
+ * or successful reply to the context capture.
+ */
+static void
+pn53x_capture_rf(struct nfc_device *pnd, const bool bReply, const uint8_t btCmd, const struct pn53x_iovec *iov, const size_t iovcnt, const size_t szFrame)
+{
+  size_t szOffset;
+  switch (btCmd) {
+    case InDataExchange:
+      // Command code and target number, or status byte
+      szOffset = bReply ? 1 : 2;
+      break;
+    case InCommunicateThru:
+      szOffset = 1;
+      break;
+    default:
+      return;
+  }
+  if (szFrame <= szOffset)
+    return;
+  uint8_t  abtFrame[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  const size_t sz = pn53x_iov_copy_from(iov, iovcnt, szOffset, abtFrame, MIN(szFrame - szOffset, sizeof(abtFrame)));
+  nfc_capture_frame(pnd, NCL_RF, bReply, abtFrame, sz);
+}
+
+/*
+ * Setup shared by the commands sent with pn53x_transceive_frame(): flush
+ * pending register writes and resolve \a timeout.
+ */
+static int
+pn53x_transceive_prepare(struct nfc_device *pnd, const uint8_t *pbtCmd, int *timeout)
 {
-  bool mi = false;
   int res = 0;
   if (CHIP_DATA(pnd)->wb_trigged) {
     if ((res = pn53x_writeback_register(pnd)) < 0) {
@@ -175,43 +248,130 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
     }
   }
 
-  PNCMD_TRACE(pbtTx[0]);
-  if (timeout > 0) {
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Timeout value: %d", timeout);
-  } else if (timeout == 0) {
+  PNCMD_TRACE(pbtCmd[0]);
+  if (*timeout > 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Timeout value: %d", *timeout);
+  } else if (*timeout == 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "No timeout");
-  } else if (timeout == -1) {
-    timeout = CHIP_DATA(pnd)->timeout_command;
+  } else if (*timeout == -1) {
+    *timeout = CHIP_DATA(pnd)->timeout_command;
   } else {
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Invalid timeout value: %d", timeout);
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Invalid timeout value: %d", *timeout);
   }
+  return NFC_SUCCESS;
+}
 
-  uint8_t  abtRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
-  size_t  szRx = sizeof(abtRx);
+/*
+ * Hand a command to the driver once pn53x_transceive_prepare() was done:
+ * only the trace, capture and statistics are kept per command.
+ */
+static int
+pn53x_transceive_frame(struct nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, const int timeout)
+{
+  const uint8_t btCmd = iov[0].pbt[0];
+  int res = 0;
 
-  // Check if receiving buffers are available, if not, replace them
-  if (szRxLen == 0 || !pbtRx) {
-    pbtRx = abtRx;
-  } else {
-    szRx = szRxLen;
+  if (pnd->trace)
+    pn53x_trace(pnd, NTD_TX, btCmd, iov, iovcnt, pn53x_iov_size(iov, iovcnt));
+  if (pnd->context->capture) {
+    pn53x_capture_host(pnd, false, btCmd, iov, iovcnt, pn53x_iov_size(iov, iovcnt));
+    pn53x_capture_rf(pnd, false, btCmd, iov, iovcnt, pn53x_iov_size(iov, iovcnt));
   }
 
-  // Call the send/receice callback functions of the current driver
-  if ((res = CHIP_DATA(pnd)->io->send(pnd, pbtTx, szTx, timeout)) < 0) {
+  // Call the send callback function of the current driver
+  const uint64_t start_us = nfc_monotonic_us();
+  if (CHIP_DATA(pnd)->io->sendv) {
+    res = CHIP_DATA(pnd)->io->sendv(pnd, iov, iovcnt, timeout);
+  } else if (iovcnt == 1) {
+    res = CHIP_DATA(pnd)->io->send(pnd, iov[0].pbt, iov[0].sz, timeout);
+  } else {
+    // This driver needs the command in one piece
+    uint8_t  abtCmd[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+    size_t  szCmd = 0;
+    if (pn53x_iov_size(iov, iovcnt) > sizeof(abtCmd)) {
+      return NFC_EINVARG;
+    }
+    for (size_t i = 0; i < iovcnt; i++) {
+      if (iov[i].sz) {
+        memcpy(abtCmd + szCmd, iov[i].pbt, iov[i].sz);
+        szCmd += iov[i].sz;
+      }
+    }
+    res = CHIP_DATA(pnd)->io->send(pnd, abtCmd, szCmd, timeout);
+  }
+  CHIP_DATA(pnd)->ack_us = nfc_monotonic_us();
+  nfc_stats_latency(pnd->stats.bus_latency, CHIP_DATA(pnd)->ack_us - start_us);
+  if (res < 0) {
+    pn53x_stats_io_error(pnd, btCmd, res);
     return res;
   }
 
   // Command is sent, we store the command
-  CHIP_DATA(pnd)->last_command = pbtTx[0];
+  CHIP_DATA(pnd)->last_command = btCmd;
+  pn53x_shadow_track(pnd, iov, iovcnt);
+  NFC_STATS_ADD(pnd->stats.commands[btCmd], 1);
+  NFC_STATS_ADD(pnd->stats.tx_bytes, pn53x_iov_size(iov, iovcnt));
 
   // Handle power mode for PN532
-  if ((CHIP_DATA(pnd)->type == PN532) && (TgInitAsTarget == pbtTx[0])) {  // PN532 automatically goes into PowerDown mode when TgInitAsTarget command will be sent
+  if ((CHIP_DATA(pnd)->type == PN532) && (TgInitAsTarget == btCmd)) {  // PN532 automatically goes into PowerDown mode when TgInitAsTarget command will be sent
     CHIP_DATA(pnd)->power_mode = POWERDOWN;
   }
+  return NFC_SUCCESS;
+}
 
-  if ((res = CHIP_DATA(pnd)->io->receive(pnd, pbtRx, szRx, timeout)) < 0) {
+/*
+ * First half of pn53x_transceive(): flush pending register writes and hand the
+ * command to the driver. On return \a timeout holds the resolved timeout value.
+ */
+static int
+pn53x_transceive_send(struct nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int *timeout)
+{
+  int res = 0;
+  if ((res = pn53x_transceive_prepare(pnd, iov[0].pbt, timeout)) < 0) {
     return res;
   }
+  return pn53x_transceive_frame(pnd, iov, iovcnt, *timeout);
+}
+
+/*
+ * Second half of pn53x_transceive(): fetch the reply of the command previously
+ * sent by pn53x_transceive_send(), follow MI chaining and decode the status byte.
+ * The reply is scattered to \a iov, whose first fragment receives the status byte.
+ */
+static int
+pn53x_transceive_receive(struct nfc_device *pnd, const uint8_t *pbtTx, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
+{
+  bool mi = false;
+  int res = 0;
+  size_t  szRx = pn53x_iov_size(iov, iovcnt);
+  uint8_t *pbtRx = iov[0].pbt;
+
+  // Call the receive callback function of the current driver
+  if (CHIP_DATA(pnd)->io->receivev) {
+    res = CHIP_DATA(pnd)->io->receivev(pnd, iov, iovcnt, timeout);
+  } else if (iovcnt == 1) {
+    res = CHIP_DATA(pnd)->io->receive(pnd, pbtRx, szRx, timeout);
+  } else {
+    // This driver needs a buffer in one piece
+    uint8_t  abtRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+    if ((res = CHIP_DATA(pnd)->io->receive(pnd, abtRx, MIN(szRx, sizeof(abtRx)), timeout)) >= 0) {
+      pn53x_iov_copy_to(iov, iovcnt, 0, abtRx, res);
+    }
+  }
+  nfc_stats_latency(pnd->stats.chip_latency, nfc_monotonic_us() - CHIP_DATA(pnd)->ack_us);
+  if (res < 0) {
+    pn53x_stats_io_error(pnd, pbtTx[0], res);
+    if (pbtTx[0] == WriteRegister) {
+      // Registers may or may not have been written
+      pn53x_shadow_invalidate(pnd, PN53X_CACHE_REGISTER_MIN_ADDRESS, PN53X_CACHE_REGISTER_MAX_ADDRESS);
+    }
+    return res;
+  }
+  NFC_STATS_ADD(pnd->stats.rx_bytes, res);
+  if (pnd->trace)
+    pn53x_trace(pnd, NTD_RX, pbtTx[0], iov, iovcnt, res);
+  if (pnd->context->capture)
+    pn53x_capture_host(pnd, true, pbtTx[0], iov, iovcnt, res);
 
   if ((CHIP_DATA(pnd)->type == PN532) && (TgInitAsTarget == pbtTx[0])) { // PN532 automatically wakeup on external RF field
     CHIP_DATA(pnd)->power_mode = NORMAL; // When TgInitAsTarget reply that means an external RF have waken up the chip
@@ -271,18 +431,32 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
     int res2;
     uint8_t  abtRx2[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
     // Send empty command to card
+    const struct pn53x_iovec iovTx = { (uint8_t *) pbtTx, 2 };
+    if (pnd->trace)
+      pn53x_trace(pnd, NTD_TX, pbtTx[0], &iovTx, 1, 2);
+    if (pnd->context->capture)
+      pn53x_capture_host(pnd, false, pbtTx[0], &iovTx, 1, 2);
     if ((res2 = CHIP_DATA(pnd)->io->send(pnd, pbtTx, 2, timeout)) < 0) {
+      pn53x_stats_io_error(pnd, pbtTx[0], res2);
       return res2;
     }
     if ((res2 = CHIP_DATA(pnd)->io->receive(pnd, abtRx2, sizeof(abtRx2), timeout)) < 0) {
+      pn53x_stats_io_error(pnd, pbtTx[0], res2);
       return res2;
     }
+    const struct pn53x_iovec iovRx = { abtRx2, (size_t) res2 };
+    if (pnd->trace)
+      pn53x_trace(pnd, NTD_RX, pbtTx[0], &iovRx, 1, res2);
+    if (pnd->context->capture)
+      pn53x_capture_host(pnd, true, pbtTx[0], &iovRx, 1, res2);
+    NFC_STATS_ADD(pnd->stats.tx_bytes, 2);
+    NFC_STATS_ADD(pnd->stats.rx_bytes, res2);
     mi = abtRx2[0] & 0x40;
     if ((size_t)(res + res2 - 1) > szRx) {
       CHIP_DATA(pnd)->last_status_byte = ESMALLBUF;
       break;
     }
-    memcpy(pbtRx + res, abtRx2 + 1, res2 - 1);
+    pn53x_iov_copy_to(iov, iovcnt, res, abtRx2 + 1, res2 - 1);
     // Copy last status byte
     pbtRx[0] = abtRx2[0];
     res += res2 - 1;
@@ -290,9 +464,14 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
 
   szRx = (size_t) res;
 
+  if (CHIP_DATA(pnd)->last_status_byte) {
+    NFC_STATS_ADD(pnd->stats.errors[CHIP_DATA(pnd)->last_status_byte & 0x3f], 1);
+  }
   switch (CHIP_DATA(pnd)->last_status_byte) {
     case 0:
       res = (int)szRx;
+      if (pnd->context->capture)
+        pn53x_capture_rf(pnd, true, pbtTx[0], iov, iovcnt, szRx);
       break;
     case ETIMEOUT:
     case ECRC:
@@ -339,6 +518,9 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
   };
 
   if (res < 0) {
+    if (pbtTx[0] == WriteRegister) {
+      pn53x_shadow_invalidate(pnd, PN53X_CACHE_REGISTER_MIN_ADDRESS, PN53X_CACHE_REGISTER_MAX_ADDRESS);
+    }
     pnd->last_error = res;
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Chip error: \"%s\" (%02x), returned error: \"%s\" (%d))", pn53x_strerror(pnd), CHIP_DATA(pnd)->last_status_byte, nfc_strerror(pnd), res);
   } else {
@@ -347,6 +529,68 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
   return res;
 }
 
+int
+pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRxLen, int timeout)
+{
+  uint8_t  abtRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  const struct pn53x_iovec iovTx = { (uint8_t *) pbtTx, szTx };
+  struct pn53x_iovec iovRx = { pbtRx, szRxLen };
+  int res = 0;
+
+  // Check if receiving buffers are available, if not, replace them
+  if (szRxLen == 0 || !pbtRx) {
+    iovRx.pbt = abtRx;
+    iovRx.sz = sizeof(abtRx);
+  }
+
+  if ((res = pn53x_transceive_send(pnd, &iovTx, 1, &timeout)) < 0) {
+    return res;
+  }
+  return pn53x_transceive_receive(pnd, pbtTx, &iovRx, 1, timeout);
+}
+
+/*
+ * Send a command made of a header and the caller's payload, without
+ * assembling them in an intermediate buffer.
+ */
+static int
+pn53x_transceive_payload_send(struct nfc_device *pnd, const uint8_t *pbtCmd, const size_t szCmd, const uint8_t *pbtTx, const size_t szTx, int *timeout)
+{
+  const struct pn53x_iovec iov[2] = {
+    { (uint8_t *) pbtCmd, szCmd },
+    { (uint8_t *) pbtTx, szTx },
+  };
+  return pn53x_transceive_send(pnd, iov, 2, timeout);
+}
+
+/*
+ * Receive the reply payload straight to the caller's buffer: the status byte
+ * is split off, and bytes beyond \a szRx land in a scratch tail so the size
+ * of an oversized reply is still known. Returns the reply payload size.
+ */
+static int
+pn53x_transceive_payload_receive(struct nfc_device *pnd, const uint8_t *pbtCmd, uint8_t *pbtRx, const size_t szRx, int timeout)
+{
+  uint8_t  btStatus;
+  uint8_t  abtOverflow[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  const struct pn53x_iovec iov[3] = {
+    { &btStatus, 1 },
+    { pbtRx, pbtRx ? szRx : 0 },
+    { abtOverflow, sizeof(abtOverflow) },
+  };
+  int res = 0;
+
+  if ((res = pn53x_transceive_receive(pnd, pbtCmd, iov, 3, timeout)) < 0) {
+    return res;
+  }
+  const size_t szRxLen = (size_t)res - 1;
+  if ((pbtRx != NULL) && (szRxLen > szRx)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Buffer size is too short: %" PRIuPTR " available(s), %" PRIuPTR " needed", szRx, szRxLen);
+    return NFC_EOVFLOW;
+  }
+  return szRxLen;
+}
+
 int
 pn53x_set_parameters(struct nfc_device *pnd, const uint8_t ui8Parameter, const bool bEnable)
 {
@@ -373,107 +617,120 @@ pn53x_set_tx_bits(struct nfc_device *pnd, const uint8_t ui8Bits)
   return NFC_SUCCESS;
 }
 
+/*
+ * On air, each byte is sent least significant bit first and followed by its
+ * parity bit: the frame is a stream of 9-bit symbols packed LSB first. Eight
+ * symbols make 9 bytes, they are packed in a 64-bit word and one byte.
+ */
+static void
+pn53x_wrap_symbols(const uint8_t *pbtTx, const uint8_t *pbtTxPar, const size_t szSymbols, uint8_t *pbtFrame)
+{
+  uint64_t uiBits = 0;
+  size_t szBits = 0;
+
+  for (size_t i = 0; i < szSymbols; i++) {
+    uiBits |= (uint64_t)(pbtTx[i] | ((pbtTxPar[i] & 0x01) << 8)) << szBits;
+    szBits += 9;
+    while (szBits >= 8) {
+      *pbtFrame++ = (uint8_t) uiBits;
+      uiBits >>= 8;
+      szBits -= 8;
+    }
+  }
+  if (szBits)
+    *pbtFrame = (uint8_t) uiBits;
+}
+
 int
 pn53x_wrap_frame(const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar,
                  uint8_t *pbtFrame)
 {
-  uint8_t  btData;
-  uint32_t uiBitPos;
-  uint32_t uiDataPos = 0;
-  size_t  szBitsLeft = szTxBits;
-  size_t szFrameBits = 0;
+  uint8_t abtPar[8];
 
   // Make sure we should frame at least something
-  if (szBitsLeft == 0)
+  if (szTxBits == 0)
     return NFC_ECHIP;
 
   // Handle a short response (1byte) as a special case
-  if (szBitsLeft < 9) {
+  if (szTxBits < 9) {
     *pbtFrame = *pbtTx;
-    szFrameBits = szTxBits;
-    return szFrameBits;
-  }
-  // We start by calculating the frame length in bits
-  szFrameBits = szTxBits + (szTxBits / 8);
-
-  // Parse the data bytes and add the parity bits
-  // This is really a sensitive process, mirror the frame bytes and append parity bits
-  // buffer = mirror(frame-byte) + parity + mirror(frame-byte) + parity + ...
-  // split "buffer" up in segments of 8 bits again and mirror them
-  // air-bytes = mirror(buffer-byte) + mirror(buffer-byte) + mirror(buffer-byte) + ..
-  while (true) {
-    // Reset the temporary frame byte;
-    uint8_t  btFrame = 0;
-
-    for (uiBitPos = 0; uiBitPos < 8; uiBitPos++) {
-      // Copy as much data that fits in the frame byte
-      btData = mirror(pbtTx[uiDataPos]);
-      btFrame |= (btData >> uiBitPos);
-      // Save this frame byte
-      *pbtFrame = mirror(btFrame);
-      // Set the remaining bits of the date in the new frame byte and append the parity bit
-      btFrame = (btData << (8 - uiBitPos));
-      btFrame |= ((pbtTxPar[uiDataPos] & 0x01) << (7 - uiBitPos));
-      // Backup the frame bits we have so far
-      pbtFrame++;
-      *pbtFrame = mirror(btFrame);
-      // Increase the data (without parity bit) position
-      uiDataPos++;
-      // Test if we are done
-      if (szBitsLeft < 9)
-        return szFrameBits;
-      szBitsLeft -= 8;
-    }
-    // Every 8 data bytes we lose one frame byte to the parities
-    pbtFrame++;
-  }
+    return szTxBits;
+  }
+
+  // A trailing incomplete byte is sent whole, with its parity bit
+  const size_t szSymbols = (szTxBits + 7) / 8;
+  size_t szPos = 0;
+  for (; szPos + 8 <= szSymbols; szPos += 8) {
+    // Without parity bits, compute odd parity along
+    const uint8_t *pbtPar = pbtTxPar ? pbtTxPar + szPos : abtPar;
+    if (!pbtTxPar)
+      iso14443a_odd_parity(pbtTx + szPos, 8, abtPar);
+
+    uint64_t uiBits = 0;
+    for (size_t i = 0; i < 7; i++)
+      uiBits |= (uint64_t)(pbtTx[szPos + i] | ((pbtPar[i] & 0x01) << 8)) << (9 * i);
+    const uint32_t uiLast = pbtTx[szPos + 7] | ((pbtPar[7] & 0x01) << 8);
+    uiBits |= (uint64_t) uiLast << 63;
+    for (size_t i = 0; i < 8; i++)
+      *pbtFrame++ = (uint8_t)(uiBits >> (8 * i));
+    *pbtFrame++ = (uint8_t)(uiLast >> 1);
+  }
+  if (szPos < szSymbols) {
+    if (!pbtTxPar)
+      iso14443a_odd_parity(pbtTx + szPos, szSymbols - szPos, abtPar);
+    pn53x_wrap_symbols(pbtTx + szPos, pbtTxPar ? pbtTxPar + szPos : abtPar, szSymbols - szPos, pbtFrame);
+  }
+  return szTxBits + (szTxBits / 8);
 }
 
 int
 pn53x_unwrap_frame(const uint8_t *pbtFrame, const size_t szFrameBits, uint8_t *pbtRx, uint8_t *pbtRxPar)
 {
-  uint8_t  btFrame;
-  uint8_t  btData;
-  uint8_t uiBitPos;
-  uint32_t uiDataPos = 0;
-  uint8_t *pbtFramePos = (uint8_t *) pbtFrame;
-  size_t  szBitsLeft = szFrameBits;
-  size_t szRxBits = 0;
-
   // Make sure we should frame at least something
-  if (szBitsLeft == 0)
+  if (szFrameBits == 0)
     return NFC_ECHIP;
 
   // Handle a short response (1byte) as a special case
-  if (szBitsLeft < 9) {
+  if (szFrameBits < 9) {
     *pbtRx = *pbtFrame;
-    szRxBits = szFrameBits;
-    return szRxBits;
-  }
-  // Calculate the data length in bits
-  szRxBits = szFrameBits - (szFrameBits / 9);
-
-  // Parse the frame bytes, remove the parity bits and store them in the parity array
-  // This process is the reverse of WrapFrame(), look there for more info
-  while (true) {
-    for (uiBitPos = 0; uiBitPos < 8; uiBitPos++) {
-      btFrame = mirror(pbtFramePos[uiDataPos]);
-      btData = (btFrame << uiBitPos);
-      btFrame = mirror(pbtFramePos[uiDataPos + 1]);
-      btData |= (btFrame >> (8 - uiBitPos));
-      pbtRx[uiDataPos] = mirror(btData);
-      if (pbtRxPar != NULL)
-        pbtRxPar[uiDataPos] = ((btFrame >> (7 - uiBitPos)) & 0x01);
-      // Increase the data (without parity bit) position
-      uiDataPos++;
-      // Test if we are done
-      if (szBitsLeft < 9)
-        return szRxBits;
-      szBitsLeft -= 9;
-    }
-    // Every 8 data bytes we lose one frame byte to the parities
-    pbtFramePos++;
+    return szFrameBits;
+  }
+
+  // Symbols are unpacked until less than 9 bits are left, the last one
+  // being possibly incomplete (see pn53x_wrap_frame())
+  const size_t szSymbols = (szFrameBits / 9) + 1;
+  size_t szPos = 0;
+  for (; szPos + 8 <= szSymbols; szPos += 8) {
+    uint64_t uiBits = 0;
+    for (size_t i = 0; i < 8; i++)
+      uiBits |= (uint64_t) pbtFrame[i] << (8 * i);
+    const uint8_t btLast = pbtFrame[8];
+    pbtFrame += 9;
+
+    for (size_t i = 0; i < 7; i++)
+      pbtRx[szPos + i] = (uint8_t)(uiBits >> (9 * i));
+    pbtRx[szPos + 7] = (uint8_t)((uiBits >> 63) | (btLast << 1));
+    if (pbtRxPar != NULL) {
+      for (size_t i = 0; i < 7; i++)
+        pbtRxPar[szPos + i] = (uint8_t)(uiBits >> (9 * i + 8)) & 0x01;
+      pbtRxPar[szPos + 7] = btLast >> 7;
+    }
+  }
+  // Remaining symbols, from a bit stream
+  uint64_t uiBits = 0;
+  size_t szBits = 0;
+  for (; szPos < szSymbols; szPos++) {
+    while (szBits < 9) {
+      uiBits |= (uint64_t)(*pbtFrame++) << szBits;
+      szBits += 8;
+    }
+    pbtRx[szPos] = (uint8_t) uiBits;
+    if (pbtRxPar != NULL)
+      pbtRxPar[szPos] = (uint8_t)(uiBits >> 8) & 0x01;
+    uiBits >>= 9;
+    szBits -= 9;
   }
+  return szFrameBits - (szFrameBits / 9);
 }
 
 int
@@ -633,6 +890,156 @@ pn53x_decode_target_data(const uint8_t *pbtRawData, size_t szRawData, pn53x_type
   return NFC_SUCCESS;
 }
 
+/*
+ * Bits of the write-back cache area registers a shadow copy cannot account
+ * for: updated by the chip (command, interrupts, status, FIFO, timer counter,
+ * CRC result...), write-only triggers or not implemented at all. Registers
+ * with volatile bits are always read live.
+ */
+static uint8_t
+pn53x_register_volatile_bits(const uint16_t ui16RegisterAddress)
+{
+  switch (ui16RegisterAddress) {
+    case PN53X_REG_CIU_Status2:
+      return SYMBOL_MF_CRYPTO1_ON | 0x07;  // and ModemState
+    case PN53X_REG_CIU_Control:
+      return 0xc0 | SYMBOL_RX_LAST_BITS;  // TStopNow, TStartNow
+    case PN53X_REG_CIU_BitFraming:
+      return SYMBOL_START_SEND;
+    case PN53X_REG_CIU_Coll:
+      return 0x7f;  // All but ValuesAfterColl
+    case 0x630F:  // Reserved
+    case 0x6310:  // Reserved
+    case PN53X_REG_CIU_CRCResultMSB:
+    case PN53X_REG_CIU_CRCResultLSB:
+    case PN53X_REG_CIU_TCounterVal_hi:
+    case PN53X_REG_CIU_TCounterVal_lo:
+    case 0x6320:  // Reserved
+    case PN53X_REG_CIU_TestPinValue:
+    case PN53X_REG_CIU_TestBus:
+    case PN53X_REG_CIU_TestADC:
+    case 0x632C:  // Reserved
+    case 0x632D:  // Reserved
+    case 0x632E:  // Reserved
+    case PN53X_REG_CIU_Command:
+    case PN53X_REG_CIU_CommIrq:
+    case PN53X_REG_CIU_DivIrq:
+    case PN53X_REG_CIU_Error:
+    case PN53X_REG_CIU_Status1:
+    case PN53X_REG_CIU_FIFOData:
+    case PN53X_REG_CIU_FIFOLevel:
+      return 0xff;
+    default:
+      return 0x00;
+  }
+}
+
+/*
+ * Volatile bits a partial write cannot fill in from the shadow copy, as the
+ * chip sets them and they are writable too. Other volatile bits are either
+ * read-only or triggers, which are written as zero unless requested.
+ */
+static uint8_t
+pn53x_register_live_bits(const uint16_t ui16RegisterAddress)
+{
+  switch (ui16RegisterAddress) {
+    case PN53X_REG_CIU_Status2:
+      return SYMBOL_MF_CRYPTO1_ON;
+    case PN53X_REG_CIU_Control:
+    case PN53X_REG_CIU_BitFraming:
+    case PN53X_REG_CIU_Coll:
+      return 0x00;
+    default:
+      return pn53x_register_volatile_bits(ui16RegisterAddress);
+  }
+}
+
+static bool
+pn53x_register_is_shadowed(const uint16_t ui16RegisterAddress)
+{
+  return (ui16RegisterAddress >= PN53X_CACHE_REGISTER_MIN_ADDRESS) && (ui16RegisterAddress <= PN53X_CACHE_REGISTER_MAX_ADDRESS) &&
+         (pn53x_register_volatile_bits(ui16RegisterAddress) != 0xff);
+}
+
+static void
+pn53x_shadow_set(struct nfc_device *pnd, const uint16_t ui16RegisterAddress, const uint8_t ui8Value)
+{
+  if (pn53x_register_is_shadowed(ui16RegisterAddress)) {
+    const size_t n = ui16RegisterAddress - PN53X_CACHE_REGISTER_MIN_ADDRESS;
+    CHIP_DATA(pnd)->shadow_data[n] = ui8Value & ~pn53x_register_volatile_bits(ui16RegisterAddress);
+    CHIP_DATA(pnd)->shadow_valid[n] = true;
+  }
+}
+
+static void
+pn53x_shadow_invalidate(struct nfc_device *pnd, const uint16_t ui16FirstAddress, const uint16_t ui16LastAddress)
+{
+  memset(CHIP_DATA(pnd)->shadow_valid + (ui16FirstAddress - PN53X_CACHE_REGISTER_MIN_ADDRESS), false, (ui16LastAddress - ui16FirstAddress) + 1);
+}
+
+/*
+ * Keep the shadow copy coherent with a command sent to the chip: registers
+ * given to WriteRegister are known, commands run by the firmware may change
+ * the CIU configuration behind our back.
+ */
+static void
+pn53x_shadow_track(struct nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt)
+{
+  switch (iov[0].pbt[0]) {
+    case WriteRegister: {
+      uint8_t  abtCmd[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+      const size_t szCmd = pn53x_iov_copy_from(iov, iovcnt, 0, abtCmd, sizeof(abtCmd));
+      for (size_t i = 1; i + 3 <= szCmd; i += 3) {
+        pn53x_shadow_set(pnd, (abtCmd[i] << 8) | abtCmd[i + 1], abtCmd[i + 2]);
+      }
+      break;
+    }
+    case ReadRegister:
+    case GetFirmwareVersion:
+    case GetGeneralStatus:
+    case ReadGPIO:
+    case WriteGPIO:
+    case SetParameters:
+    case TgGetTargetStatus:
+      break;
+    case InDataExchange:
+    case InCommunicateThru:
+    case TgGetData:
+    case TgSetData:
+    case TgGetInitiatorCommand:
+    case TgResponseToInitiator:
+    case TgSetGeneralBytes:
+    case TgSetMetaData:
+      // The firmware uses the timer and interrupts to exchange frames,
+      // e.g. SCL3711 resets timer settings on InCommunicateThru
+      pn53x_shadow_invalidate(pnd, PN53X_REG_CIU_TMode, PN53X_REG_CIU_TReloadVal_lo);
+      pn53x_shadow_invalidate(pnd, PN53X_REG_CIU_CommIEn, PN53X_REG_CIU_DivIEn);
+      pn53x_shadow_invalidate(pnd, PN53X_REG_CIU_WaterLevel, PN53X_REG_CIU_WaterLevel);
+      break;
+    case RFConfiguration:
+      switch (iov[0].pbt[1]) {
+        case RFCI_RETRY_DATA:
+        case RFCI_RETRY_SELECT:
+          break;
+        case RFCI_TIMING:
+          pn53x_shadow_invalidate(pnd, PN53X_REG_CIU_TMode, PN53X_REG_CIU_TReloadVal_lo);
+          break;
+        default:
+          // RF field and analog settings, i.e. antenna drivers and receiver
+          pn53x_shadow_invalidate(pnd, PN53X_REG_CIU_TxControl, PN53X_REG_CIU_TxAuto);
+          pn53x_shadow_invalidate(pnd, PN53X_REG_CIU_RxThreshold, PN53X_REG_CIU_Demod);
+          pn53x_shadow_invalidate(pnd, PN53X_REG_CIU_MifNFC, PN53X_REG_CIU_MifNFC);
+          pn53x_shadow_invalidate(pnd, PN53X_REG_CIU_GsNOFF, PN53X_REG_CIU_ModGsP);
+          break;
+      }
+      break;
+    default:
+      // Polling, activation, power modes... may set any register
+      pn53x_shadow_invalidate(pnd, PN53X_CACHE_REGISTER_MIN_ADDRESS, PN53X_CACHE_REGISTER_MAX_ADDRESS);
+      break;
+  }
+}
+
 static int
 pn53x_ReadRegister(struct nfc_device *pnd, uint16_t ui16RegisterAddress, uint8_t *ui8Value)
 {
@@ -651,11 +1058,20 @@ pn53x_ReadRegister(struct nfc_device *pnd, uint16_t ui16RegisterAddress, uint8_t
   } else {
     *ui8Value = abtRegValue[0];
   }
+  pn53x_shadow_set(pnd, ui16RegisterAddress, *ui8Value);
   return NFC_SUCCESS;
 }
 
 int pn53x_read_register(struct nfc_device *pnd, uint16_t ui16RegisterAddress, uint8_t *ui8Value)
 {
+  if (pn53x_register_is_shadowed(ui16RegisterAddress) && !pn53x_register_volatile_bits(ui16RegisterAddress)) {
+    const size_t n = ui16RegisterAddress - PN53X_CACHE_REGISTER_MIN_ADDRESS;
+    if (CHIP_DATA(pnd)->shadow_valid[n]) {
+      // Pending bits are what the chip will hold once written back
+      *ui8Value = (CHIP_DATA(pnd)->wb_data[n] & CHIP_DATA(pnd)->wb_mask[n]) | (CHIP_DATA(pnd)->shadow_data[n] & ~CHIP_DATA(pnd)->wb_mask[n]);
+      return NFC_SUCCESS;
+    }
+  }
   return pn53x_ReadRegister(pnd, ui16RegisterAddress, ui8Value);
 }
 
@@ -698,22 +1114,35 @@ int
 pn53x_writeback_register(struct nfc_device *pnd)
 {
   int res = 0;
+  bool abRead[PN53X_CACHE_REGISTER_SIZE];
+  uint8_t abtCurrent[PN53X_CACHE_REGISTER_SIZE];
   // TODO Check at each step (ReadRegister, WriteRegister) if we didn't exceed max supported frame length
   BUFFER_INIT(abtReadRegisterCmd, PN53x_EXTENDED_FRAME__DATA_MAX_LEN);
   BUFFER_APPEND(abtReadRegisterCmd, ReadRegister);
 
   // First step, it looks for registers to be read before applying the requested mask
   CHIP_DATA(pnd)->wb_trigged = false;
+  bool bNeedRead = false;
   for (size_t n = 0; n < PN53X_CACHE_REGISTER_SIZE; n++) {
-    if ((CHIP_DATA(pnd)->wb_mask[n]) && (CHIP_DATA(pnd)->wb_mask[n] != 0xff)) {
-      // This register needs to be read: mask is present but does not cover full data width (ie. mask != 0xff)
-      const uint16_t pn53x_register_address = PN53X_CACHE_REGISTER_MIN_ADDRESS + n;
-      BUFFER_APPEND(abtReadRegisterCmd, pn53x_register_address  >> 8);
-      BUFFER_APPEND(abtReadRegisterCmd, pn53x_register_address & 0xff);
+    const uint16_t pn53x_register_address = PN53X_CACHE_REGISTER_MIN_ADDRESS + n;
+    // Mask is present but does not cover full data width (ie. mask != 0xff): the
+    // register needs to be read, unless the shadow copy holds the other bits
+    abRead[n] = (CHIP_DATA(pnd)->wb_mask[n]) && (CHIP_DATA(pnd)->wb_mask[n] != 0xff) &&
+                (!CHIP_DATA(pnd)->shadow_valid[n] || (pn53x_register_live_bits(pn53x_register_address) & ~CHIP_DATA(pnd)->wb_mask[n]));
+    bNeedRead |= abRead[n];
+    // Unknown registers are read along when populating the shadow copy
+    abRead[n] |= CHIP_DATA(pnd)->shadow_populate && pn53x_register_is_shadowed(pn53x_register_address) && !CHIP_DATA(pnd)->shadow_valid[n];
+    abtCurrent[n] = CHIP_DATA(pnd)->shadow_data[n];
+  }
+
+  if (bNeedRead) {
+    for (size_t n = 0; n < PN53X_CACHE_REGISTER_SIZE; n++) {
+      if (abRead[n]) {
+        const uint16_t pn53x_register_address = PN53X_CACHE_REGISTER_MIN_ADDRESS + n;
+        BUFFER_APPEND(abtReadRegisterCmd, pn53x_register_address  >> 8);
+        BUFFER_APPEND(abtReadRegisterCmd, pn53x_register_address & 0xff);
+      }
     }
-  }
-
-  if (BUFFER_SIZE(abtReadRegisterCmd) > 1) {
     // It needs to read some registers
     uint8_t abtRes[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
     size_t szRes = sizeof(abtRes);
@@ -726,19 +1155,31 @@ pn53x_writeback_register(struct nfc_device *pnd)
       // PN533 prepends its answer by a status byte
       i = 1;
     }
+    if ((size_t) res < i + ((BUFFER_SIZE(abtReadRegisterCmd) - 1) / 2)) {
+      return NFC_EIO;
+    }
+    CHIP_DATA(pnd)->shadow_populate = false;
     for (size_t n = 0; n < PN53X_CACHE_REGISTER_SIZE; n++) {
-      if ((CHIP_DATA(pnd)->wb_mask[n]) && (CHIP_DATA(pnd)->wb_mask[n] != 0xff)) {
-        CHIP_DATA(pnd)->wb_data[n] = ((CHIP_DATA(pnd)->wb_data[n] & CHIP_DATA(pnd)->wb_mask[n]) | (abtRes[i] & (~CHIP_DATA(pnd)->wb_mask[n])));
-        if (CHIP_DATA(pnd)->wb_data[n] != abtRes[i]) {
-          // Requested value is different from read one
-          CHIP_DATA(pnd)->wb_mask[n] = 0xff;  // We can now apply whole data bits
-        } else {
-          CHIP_DATA(pnd)->wb_mask[n] = 0x00;  // We already have the right value
-        }
+      if (abRead[n]) {
+        abtCurrent[n] = abtRes[i];
+        pn53x_shadow_set(pnd, PN53X_CACHE_REGISTER_MIN_ADDRESS + n, abtRes[i]);
         i++;
       }
     }
   }
+  for (size_t n = 0; n < PN53X_CACHE_REGISTER_SIZE; n++) {
+    if ((CHIP_DATA(pnd)->wb_mask[n]) && (CHIP_DATA(pnd)->wb_mask[n] != 0xff)) {
+      CHIP_DATA(pnd)->wb_data[n] = ((CHIP_DATA(pnd)->wb_data[n] & CHIP_DATA(pnd)->wb_mask[n]) | (abtCurrent[n] & (~CHIP_DATA(pnd)->wb_mask[n])));
+      CHIP_DATA(pnd)->wb_mask[n] = 0xff;  // We can now apply whole data bits
+    }
+    if (CHIP_DATA(pnd)->wb_mask[n] != 0xff)
+      continue;
+    if (abRead[n] || (CHIP_DATA(pnd)->shadow_valid[n] && !pn53x_register_live_bits(PN53X_CACHE_REGISTER_MIN_ADDRESS + n))) {
+      if (CHIP_DATA(pnd)->wb_data[n] == abtCurrent[n]) {
+        CHIP_DATA(pnd)->wb_mask[n] = 0x00;  // We already have the right value
+      }
+    }
+  }
   // Now, the writeback-cache only has masks with 0xff, we can start to WriteRegister
   BUFFER_INIT(abtWriteRegisterCmd, PN53x_EXTENDED_FRAME__DATA_MAX_LEN);
   BUFFER_APPEND(abtWriteRegisterCmd, WriteRegister);
@@ -831,6 +1272,17 @@ pn53x_int_to_timeout(const int ms)
   return res;
 }
 
+static int
+pn53x_set_timings(struct nfc_device *pnd)
+{
+  int res = 0;
+  CHIP_DATA(pnd)->timings_synced = false;
+  if ((res = pn53x_RFConfiguration__Various_timings(pnd, pn53x_int_to_timeout(CHIP_DATA(pnd)->timeout_atr), pn53x_int_to_timeout(CHIP_DATA(pnd)->timeout_communication))) < 0)
+    return res;
+  CHIP_DATA(pnd)->timings_synced = true;
+  return NFC_SUCCESS;
+}
+
 int
 pn53x_set_property_int(struct nfc_device *pnd, const nfc_property property, const int value)
 {
@@ -840,10 +1292,10 @@ pn53x_set_property_int(struct nfc_device *pnd, const nfc_property property, cons
       break;
     case NP_TIMEOUT_ATR:
       CHIP_DATA(pnd)->timeout_atr = value;
-      return pn53x_RFConfiguration__Various_timings(pnd, pn53x_int_to_timeout(CHIP_DATA(pnd)->timeout_atr), pn53x_int_to_timeout(CHIP_DATA(pnd)->timeout_communication));
+      return pn53x_set_timings(pnd);
     case NP_TIMEOUT_COM:
       CHIP_DATA(pnd)->timeout_communication = value;
-      return pn53x_RFConfiguration__Various_timings(pnd, pn53x_int_to_timeout(CHIP_DATA(pnd)->timeout_atr), pn53x_int_to_timeout(CHIP_DATA(pnd)->timeout_communication));
+      return pn53x_set_timings(pnd);
     // Following properties are invalid (not integer)
     case NP_HANDLE_CRC:
     case NP_HANDLE_PARITY:
@@ -862,11 +1314,44 @@ pn53x_set_property_int(struct nfc_device *pnd, const nfc_property property, cons
   return NFC_SUCCESS;
 }
 
+/*
+ * Check a property can be set to value on this chip, without sending anything.
+ */
+static int
+pn53x_check_property(const struct nfc_device *pnd, const nfc_property property, const int value)
+{
+  switch (property) {
+    case NP_FORCE_ISO14443_B:
+      // PN531 has no ISO14443-B framing
+      if (value && !(pnd->btSupportByte & SUPPORT_ISO14443B))
+        return NFC_EDEVNOTSUPP;
+      return NFC_SUCCESS;
+    case NP_TIMEOUT_COMMAND:
+    case NP_TIMEOUT_ATR:
+    case NP_TIMEOUT_COM:
+    case NP_HANDLE_CRC:
+    case NP_HANDLE_PARITY:
+    case NP_ACTIVATE_FIELD:
+    case NP_ACTIVATE_CRYPTO1:
+    case NP_INFINITE_SELECT:
+    case NP_ACCEPT_INVALID_FRAMES:
+    case NP_ACCEPT_MULTIPLE_FRAMES:
+    case NP_AUTO_ISO14443_4:
+    case NP_EASY_FRAMING:
+    case NP_FORCE_ISO14443_A:
+    case NP_FORCE_SPEED_106:
+      return NFC_SUCCESS;
+  }
+  return NFC_EINVARG;
+}
+
 int
 pn53x_set_property_bool(struct nfc_device *pnd, const nfc_property property, const bool bEnable)
 {
   uint8_t  btValue;
   int res = 0;
+  if ((res = pn53x_check_property(pnd, property, bEnable)) < 0)
+    return res;
   switch (property) {
     case NP_HANDLE_CRC:
       // Enable or disable automatic receiving/sending of CRC bytes
@@ -910,11 +1395,15 @@ pn53x_set_property_bool(struct nfc_device *pnd, const nfc_property property, con
       // timings could be tweak better than this, and maybe we can tweak timings
       // to "gain" a sort-of hardware polling (ie. like PN532 does)
       pnd->bInfiniteSelect = bEnable;
-      return pn53x_RFConfiguration__MaxRetries(pnd,
-                                               (bEnable) ? 0xff : 0x00,        // MxRtyATR, default: active = 0xff, passive = 0x02
-                                               (bEnable) ? 0xff : 0x01,        // MxRtyPSL, default: 0x01
-                                               (bEnable) ? 0xff : 0x02         // MxRtyPassiveActivation, default: 0xff (0x00 leads to problems with PN531)
-                                              );
+      CHIP_DATA(pnd)->max_retries_synced = false;
+      if ((res = pn53x_RFConfiguration__MaxRetries(pnd,
+                                                   (bEnable) ? 0xff : 0x00,        // MxRtyATR, default: active = 0xff, passive = 0x02
+                                                   (bEnable) ? 0xff : 0x01,        // MxRtyPSL, default: 0x01
+                                                   (bEnable) ? 0xff : 0x02         // MxRtyPassiveActivation, default: 0xff (0x00 leads to problems with PN531)
+                                                  )) < 0)
+        return res;
+      CHIP_DATA(pnd)->max_retries_synced = true;
+      return NFC_SUCCESS;
 
     case NP_ACCEPT_INVALID_FRAMES:
       btValue = (bEnable) ? SYMBOL_RX_NO_ERROR : 0x00;
@@ -977,6 +1466,85 @@ pn53x_set_property_bool(struct nfc_device *pnd, const nfc_property property, con
   return NFC_EINVARG;
 }
 
+/*
+ * Apply property changes with as few commands as possible: at most one
+ * SetParameters and one RFConfiguration per item, register changes being left
+ * in the write-back cache to be written along with the next command.
+ *
+ * Every setting is checked for this chip before anything is sent, so invalid
+ * or unsupported settings change nothing. A command failing afterwards leaves
+ * the settings applied so far in place.
+ */
+int
+pn53x_set_properties(struct nfc_device *pnd, const nfc_property_setting settings[], const size_t szSettings)
+{
+  bool abSet[NP_FORCE_SPEED_106 + 1];
+  int aiValue[NP_FORCE_SPEED_106 + 1];
+  int res = 0;
+
+  // Check everything before changing anything, the last setting of a property wins
+  memset(abSet, false, sizeof(abSet));
+  for (size_t i = 0; i < szSettings; i++) {
+    if ((unsigned) settings[i].property > NP_FORCE_SPEED_106)
+      return NFC_EINVARG;
+    if ((res = pn53x_check_property(pnd, settings[i].property, settings[i].value)) < 0)
+      return res;
+    abSet[settings[i].property] = true;
+    aiValue[settings[i].property] = settings[i].value;
+  }
+
+  if (abSet[NP_TIMEOUT_COMMAND])
+    CHIP_DATA(pnd)->timeout_command = aiValue[NP_TIMEOUT_COMMAND];
+
+  // SetParameters
+  if (abSet[NP_AUTO_ISO14443_4]) {
+    if ((res = pn53x_set_property_bool(pnd, NP_AUTO_ISO14443_4, aiValue[NP_AUTO_ISO14443_4] != 0)) < 0)
+      return res;
+  }
+
+  // RFConfiguration, both timeouts share the same item
+  if (abSet[NP_TIMEOUT_ATR] || abSet[NP_TIMEOUT_COM]) {
+    const int timeout_atr = abSet[NP_TIMEOUT_ATR] ? aiValue[NP_TIMEOUT_ATR] : CHIP_DATA(pnd)->timeout_atr;
+    const int timeout_communication = abSet[NP_TIMEOUT_COM] ? aiValue[NP_TIMEOUT_COM] : CHIP_DATA(pnd)->timeout_communication;
+    if (!CHIP_DATA(pnd)->timings_synced ||
+        (pn53x_int_to_timeout(timeout_atr) != pn53x_int_to_timeout(CHIP_DATA(pnd)->timeout_atr)) ||
+        (pn53x_int_to_timeout(timeout_communication) != pn53x_int_to_timeout(CHIP_DATA(pnd)->timeout_communication))) {
+      CHIP_DATA(pnd)->timeout_atr = timeout_atr;
+      CHIP_DATA(pnd)->timeout_communication = timeout_communication;
+      if ((res = pn53x_set_timings(pnd)) < 0)
+        return res;
+    }
+    CHIP_DATA(pnd)->timeout_atr = timeout_atr;
+    CHIP_DATA(pnd)->timeout_communication = timeout_communication;
+  }
+  if (abSet[NP_INFINITE_SELECT]) {
+    const bool bEnable = aiValue[NP_INFINITE_SELECT] != 0;
+    if (!CHIP_DATA(pnd)->max_retries_synced || (bEnable != pnd->bInfiniteSelect)) {
+      if ((res = pn53x_set_property_bool(pnd, NP_INFINITE_SELECT, bEnable)) < 0)
+        return res;
+    }
+  }
+  // The RF field state is not known, it is always set. Go through the driver,
+  // which may switch a LED along.
+  if (abSet[NP_ACTIVATE_FIELD]) {
+    if ((res = pnd->driver->device_set_property_bool(pnd, NP_ACTIVATE_FIELD, aiValue[NP_ACTIVATE_FIELD] != 0)) < 0)
+      return res;
+  }
+
+  // Registers and host side flags
+  const nfc_property anpRegisters[] = {
+    NP_HANDLE_CRC, NP_HANDLE_PARITY, NP_ACTIVATE_CRYPTO1, NP_ACCEPT_INVALID_FRAMES, NP_ACCEPT_MULTIPLE_FRAMES,
+    NP_EASY_FRAMING, NP_FORCE_ISO14443_A, NP_FORCE_ISO14443_B, NP_FORCE_SPEED_106
+  };
+  for (size_t i = 0; i < sizeof(anpRegisters) / sizeof(anpRegisters[0]); i++) {
+    if (abSet[anpRegisters[i]]) {
+      if ((res = pn53x_set_property_bool(pnd, anpRegisters[i], aiValue[anpRegisters[i]] != 0)) < 0)
+        return res;
+    }
+  }
+  return NFC_SUCCESS;
+}
+
 int
 pn53x_idle(struct nfc_device *pnd)
 {
@@ -1595,56 +2163,158 @@ pn53x_initiator_transceive_bits(struct nfc_device *pnd, const uint8_t *pbtTx, co
   return szRxBits;
 }
 
-int
-pn53x_initiator_transceive_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx,
-                                 const size_t szRx, int timeout)
+/*
+ * Write the InDataExchange/InCommunicateThru header in \a pbtCmd and prepare
+ * the chip for byte frames. Returns the header length.
+ */
+static int
+pn53x_initiator_prepare_transceive_bytes(struct nfc_device *pnd, uint8_t *pbtCmd)
 {
-  size_t  szExtraTxLen;
-  uint8_t  abtCmd[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
   int res = 0;
+  int szExtraTxLen;
 
   // We can not just send bytes without parity if while the PN53X expects we handled them
   if (!pnd->bPar) {
-    pnd->last_error = NFC_EINVARG;
-    return pnd->last_error;
+    return NFC_EINVARG;
   }
 
-  // Copy the data into the command frame
   if (pnd->bEasyFraming) {
-    abtCmd[0] = InDataExchange;
-    abtCmd[1] = 1;              /* target number */
-    memcpy(abtCmd + 2, pbtTx, szTx);
+    pbtCmd[0] = InDataExchange;
+    pbtCmd[1] = 1;              /* target number */
     szExtraTxLen = 2;
   } else {
-    abtCmd[0] = InCommunicateThru;
-    memcpy(abtCmd + 1, pbtTx, szTx);
+    pbtCmd[0] = InCommunicateThru;
     szExtraTxLen = 1;
   }
 
   // To transfer command frames bytes we can not have any leading bits, reset this to zero
   if ((res = pn53x_set_tx_bits(pnd, 0)) < 0) {
+    return res;
+  }
+  return szExtraTxLen;
+}
+
+int
+pn53x_initiator_transceive_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx,
+                                 const size_t szRx, int timeout)
+{
+  uint8_t  abtCmd[2];
+  size_t  szCmd;
+  int res = 0;
+
+  if ((res = pn53x_initiator_prepare_transceive_bytes(pnd, abtCmd)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
-
-  // Send the frame to the PN53X chip and get the answer
   // We have to give the amount of bytes + (the two command bytes 0xD4, 0x42)
-  uint8_t  abtRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
-  if ((res = pn53x_transceive(pnd, abtCmd, szTx + szExtraTxLen, abtRx, sizeof(abtRx), timeout)) < 0) {
+  szCmd = (size_t)res;
+
+  // Send the frame to the PN53X chip and get the answer, the payload goes
+  // from and to the caller's buffers
+  if (((res = pn53x_transceive_payload_send(pnd, abtCmd, szCmd, pbtTx, szTx, &timeout)) < 0) ||
+      ((res = pn53x_transceive_payload_receive(pnd, abtCmd, pbtRx, szRx, timeout)) < 0)) {
     pnd->last_error = res;
     return pnd->last_error;
   }
-  const size_t szRxLen = (size_t)res - 1;
-  if (pbtRx != NULL) {
-    if (szRxLen >  szRx) {
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Buffer size is too short: %" PRIuPTR " available(s), %" PRIuPTR " needed", szRx, szRxLen);
-      return NFC_EOVFLOW;
+  return res;
+}
+
+int
+pn53x_initiator_transceive_bytes_submit(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout)
+{
+  uint8_t  abtCmd[2];
+  int res = 0;
+
+  if ((res = pn53x_initiator_prepare_transceive_bytes(pnd, abtCmd)) < 0) {
+    pnd->last_error = res;
+    return pnd->last_error;
+  }
+
+  // Only send the frame: the reply will be fetched by pn53x_initiator_transceive_bytes_complete()
+  if ((res = pn53x_transceive_payload_send(pnd, abtCmd, (size_t)res, pbtTx, szTx, &timeout)) < 0) {
+    pnd->last_error = res;
+    return pnd->last_error;
+  }
+  // Keep what is needed to decode the reply (command code and target number)
+  memcpy(CHIP_DATA(pnd)->async_command, abtCmd, sizeof(CHIP_DATA(pnd)->async_command));
+  pnd->async.timeout = timeout;
+  return NFC_SUCCESS;
+}
+
+int
+pn53x_initiator_transceive_bytes_complete(struct nfc_device *pnd, uint8_t *pbtRx, const size_t szRx)
+{
+  int res = 0;
+
+  if ((res = pn53x_transceive_payload_receive(pnd, CHIP_DATA(pnd)->async_command, pbtRx, szRx, pnd->async.timeout)) < 0) {
+    pnd->last_error = res;
+    return pnd->last_error;
+  }
+  return res;
+}
+
+int
+pn53x_initiator_transceive_bytes_cancel(struct nfc_device *pnd)
+{
+  // Without a way to stop it, the chip is left to answer: the next command
+  // will see its reply as an unexpected frame and fail
+  if (!CHIP_DATA(pnd)->io->cancel) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+  return CHIP_DATA(pnd)->io->cancel(pnd);
+}
+
+int
+pn53x_initiator_transceive_batch(struct nfc_device *pnd, nfc_transceive_item items[], const size_t szItems, const nfc_batch_stop stop, int timeout)
+{
+  uint8_t  abtCmd[2];
+  size_t  szExtraTxLen;
+  size_t  szProcessed = 0;
+  int res = 0;
+
+  // Per-command setup is done once for the whole batch: command header, TX
+  // bits, register writeback and timeout resolution.
+  if ((res = pn53x_initiator_prepare_transceive_bytes(pnd, abtCmd)) < 0) {
+    pnd->last_error = res;
+    return pnd->last_error;
+  }
+  szExtraTxLen = (size_t)res;
+
+  if ((res = pn53x_transceive_prepare(pnd, abtCmd, &timeout)) < 0) {
+    pnd->last_error = res;
+    return pnd->last_error;
+  }
+
+  while (szProcessed < szItems) {
+    nfc_transceive_item *pti = &items[szProcessed++];
+    const struct pn53x_iovec iov[2] = {
+      { abtCmd, szExtraTxLen },
+      { (uint8_t *) pti->pbtTx, pti->szTx },
+    };
+    if (pti->szTx > PN53x_EXTENDED_FRAME__DATA_MAX_LEN - szExtraTxLen) {
+      pti->res = NFC_EINVARG;
+    } else if ((pti->res = pn53x_transceive_frame(pnd, iov, 2, timeout)) >= 0) {
+      pti->res = pn53x_transceive_payload_receive(pnd, abtCmd, pti->pbtRx, pti->szRx, timeout);
+    }
+    if (pti->res < 0) {
+      pnd->last_error = pti->res;
+      if (nfc_batch_stop_on(stop, pti->res)) {
+        break;
+      }
     }
-    // Copy the received bytes
-    memcpy(pbtRx, abtRx + 1, szRxLen);
   }
-  // Everything went successful, we return received bytes count
-  return szRxLen;
+  return (int)szProcessed;
+}
+
+int
+pn53x_get_pollfd(struct nfc_device *pnd)
+{
+  if (!CHIP_DATA(pnd)->io->get_pollfd) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+  return CHIP_DATA(pnd)->io->get_pollfd(pnd);
 }
 
 static void __pn53x_init_timer(struct nfc_device *pnd, const uint32_t max_cycles)
@@ -2680,24 +3350,14 @@ pn53x_target_receive_bytes(struct nfc_device *pnd, uint8_t *pbtRx, const size_t
     abtCmd[0] = TgGetInitiatorCommand;
   }
 
-  // Try to gather a received frame from the reader
-  uint8_t abtRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
-  size_t szRx = sizeof(abtRx);
+  // Try to gather a received frame from the reader, straight to pbtRx
   int res = 0;
-  if ((res = pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), abtRx, szRx, timeout)) < 0)
-    return pnd->last_error;
-  szRx = (size_t) res;
-  // Save the received bytes count
-  szRx -= 1;
-
-  if (szRx > szRxLen)
-    return NFC_EOVFLOW;
-
-  // Copy the received bytes
-  memcpy(pbtRx, abtRx + 1, szRx);
+  if (((res = pn53x_transceive_payload_send(pnd, abtCmd, sizeof(abtCmd), NULL, 0, &timeout)) < 0) ||
+      ((res = pn53x_transceive_payload_receive(pnd, abtCmd, pbtRx, szRxLen, timeout)) < 0))
+    return (res == NFC_EOVFLOW) ? res : pnd->last_error;
 
   // Everyting seems ok, return received bytes count
-  return szRx;
+  return res;
 }
 
 int
@@ -2744,7 +3404,7 @@ pn53x_target_send_bits(struct nfc_device *pnd, const uint8_t *pbtTx, const size_
 int
 pn53x_target_send_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout)
 {
-  uint8_t  abtCmd[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  uint8_t  abtCmd[1];
   int res = 0;
 
   // We can not just send bytes without parity if while the PN53X expects we handled them
@@ -2788,11 +3448,9 @@ pn53x_target_send_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, const size
     abtCmd[0] = TgResponseToInitiator;
   }
 
-  // Copy the data into the command frame
-  memcpy(abtCmd + 1, pbtTx, szTx);
-
-  // Try to send the bits to the reader
-  if ((res = pn53x_transceive(pnd, abtCmd, szTx + 1, NULL, 0, timeout)) < 0)
+  // Try to send the bits to the reader, straight from pbtTx
+  if (((res = pn53x_transceive_payload_send(pnd, abtCmd, sizeof(abtCmd), pbtTx, szTx, &timeout)) < 0) ||
+      ((res = pn53x_transceive_payload_receive(pnd, abtCmd, NULL, 0, timeout)) < 0))
     return res;
 
   // Everyting seems ok, return sent byte count
@@ -3341,6 +3999,20 @@ pn53x_check_error_frame(struct nfc_device *pnd, const uint8_t *pbtRxFrame, const
 int
 pn53x_build_frame(uint8_t *pbtFrame, size_t *pszFrame, const uint8_t *pbtData, const size_t szData)
 {
+  const struct pn53x_iovec iov = { (uint8_t *) pbtData, szData };
+  return pn53x_build_frame_iov(pbtFrame, pszFrame, &iov, 1);
+}
+
+/*
+ * pn53x_build_frame() taking the PN53X command as fragments: each byte is
+ * copied once, straight to its place in the frame.
+ */
+int
+pn53x_build_frame_iov(uint8_t *pbtFrame, size_t *pszFrame, const struct pn53x_iovec *iov, const size_t iovcnt)
+{
+  const size_t szData = pn53x_iov_size(iov, iovcnt);
+  uint8_t *pbtData;
+
   if (szData <= PN53x_NORMAL_FRAME__DATA_MAX_LEN) {
     // LEN - Packet length = data length (len) + checksum (1) + end of stream marker (1)
     pbtFrame[3] = szData + 1;
@@ -3348,19 +4020,7 @@ pn53x_build_frame(uint8_t *pbtFrame, size_t *pszFrame, const uint8_t *pbtData, c
     pbtFrame[4] = 256 - (szData + 1);
     // TFI
     pbtFrame[5] = 0xD4;
-    // DATA - Copy the PN53X command into the packet buffer
-    memcpy(pbtFrame + 6, pbtData, szData);
-
-    // DCS - Calculate data payload checksum
-    uint8_t btDCS = (256 - 0xD4);
-    for (size_t szPos = 0; szPos < szData; szPos++) {
-      btDCS -= pbtData[szPos];
-    }
-    pbtFrame[6 + szData] = btDCS;
-
-    // 0x00 - End of stream marker
-    pbtFrame[szData + 7] = 0x00;
-
+    pbtData = pbtFrame + 6;
     (*pszFrame) = szData + PN53x_NORMAL_FRAME__OVERHEAD;
   } else if (szData <= PN53x_EXTENDED_FRAME__DATA_MAX_LEN) {
     // Extended frame marker
@@ -3374,26 +4034,103 @@ pn53x_build_frame(uint8_t *pbtFrame, size_t *pszFrame, const uint8_t *pbtData, c
     pbtFrame[7] = 256 - ((pbtFrame[5] + pbtFrame[6]) & 0xff);
     // TFI
     pbtFrame[8] = 0xD4;
-    // DATA - Copy the PN53X command into the packet buffer
-    memcpy(pbtFrame + 9, pbtData, szData);
-
-    // DCS - Calculate data payload checksum
-    uint8_t btDCS = (256 - 0xD4);
-    for (size_t szPos = 0; szPos < szData; szPos++) {
-      btDCS -= pbtData[szPos];
-    }
-    pbtFrame[9 + szData] = btDCS;
-
-    // 0x00 - End of stream marker
-    pbtFrame[szData + 10] = 0x00;
-
+    pbtData = pbtFrame + 9;
     (*pszFrame) = szData + PN53x_EXTENDED_FRAME__OVERHEAD;
   } else {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "We can't send more than %d bytes in a raw (requested: %" PRIdPTR ")", PN53x_EXTENDED_FRAME__DATA_MAX_LEN, szData);
     return NFC_ECHIP;
   }
+
+  // DATA - Copy the PN53X command into the packet buffer
+  size_t szPos = 0;
+  for (size_t i = 0; i < iovcnt; i++) {
+    if (iov[i].sz) {
+      memcpy(pbtData + szPos, iov[i].pbt, iov[i].sz);
+      szPos += iov[i].sz;
+    }
+  }
+
+  // DCS - Calculate data payload checksum
+  uint8_t btDCS = (256 - 0xD4);
+  for (szPos = 0; szPos < szData; szPos++) {
+    btDCS -= pbtData[szPos];
+  }
+  pbtData[szData] = btDCS;
+
+  // 0x00 - End of stream marker
+  pbtData[szData + 1] = 0x00;
+
   return NFC_SUCCESS;
 }
+
+size_t
+pn53x_iov_size(const struct pn53x_iovec *iov, const size_t iovcnt)
+{
+  size_t sz = 0;
+  for (size_t i = 0; i < iovcnt; i++) {
+    sz += iov[i].sz;
+  }
+  return sz;
+}
+
+/*
+ * Copy szSrc bytes to the fragments, starting szOffset bytes in. What does
+ * not fit is dropped.
+ */
+void
+pn53x_iov_copy_to(const struct pn53x_iovec *iov, const size_t iovcnt, size_t szOffset, const uint8_t *pbtSrc, size_t szSrc)
+{
+  for (size_t i = 0; (i < iovcnt) && szSrc; i++) {
+    if (szOffset >= iov[i].sz) {
+      szOffset -= iov[i].sz;
+      continue;
+    }
+    const size_t sz = MIN(iov[i].sz - szOffset, szSrc);
+    memcpy(iov[i].pbt + szOffset, pbtSrc, sz);
+    pbtSrc += sz;
+    szSrc -= sz;
+    szOffset = 0;
+  }
+}
+
+/*
+ * Copy szDst bytes held by the fragments, starting szOffset bytes in, to
+ * pbtDst. Returns the number of bytes copied, less if the fragments are shorter.
+ */
+size_t
+pn53x_iov_copy_from(const struct pn53x_iovec *iov, const size_t iovcnt, size_t szOffset, uint8_t *pbtDst, size_t szDst)
+{
+  size_t szCopied = 0;
+  for (size_t i = 0; (i < iovcnt) && (szCopied < szDst); i++) {
+    if (szOffset >= iov[i].sz) {
+      szOffset -= iov[i].sz;
+      continue;
+    }
+    const size_t sz = MIN(iov[i].sz - szOffset, szDst - szCopied);
+    memcpy(pbtDst + szCopied, iov[i].pbt + szOffset, sz);
+    szCopied += sz;
+    szOffset = 0;
+  }
+  return szCopied;
+}
+
+/*
+ * Subtract the first szData bytes held by the fragments from btDCS, as done
+ * to compute or check a frame data checksum.
+ */
+uint8_t
+pn53x_iov_checksum(const struct pn53x_iovec *iov, const size_t iovcnt, size_t szData, uint8_t btDCS)
+{
+  for (size_t i = 0; (i < iovcnt) && szData; i++) {
+    const size_t sz = MIN(iov[i].sz, szData);
+    for (size_t szPos = 0; szPos < sz; szPos++) {
+      btDCS -= iov[i].pbt[szPos];
+    }
+    szData -= sz;
+  }
+  return btDCS;
+}
+
 pn53x_modulation
 pn53x_nm_to_pm(const nfc_modulation nm)
 {
@@ -3836,6 +4573,10 @@ pn53x_data_new(struct nfc_device *pnd, const struct pn53x_io *io)
   CHIP_DATA(pnd)->wb_trigged = false;
   memset(CHIP_DATA(pnd)->wb_mask, 0x00, PN53X_CACHE_REGISTER_SIZE);
 
+  // Nothing is known about the registers yet
+  memset(CHIP_DATA(pnd)->shadow_valid, false, PN53X_CACHE_REGISTER_SIZE);
+  CHIP_DATA(pnd)->shadow_populate = false;
+
   // Set default command timeout (350 ms)
   CHIP_DATA(pnd)->timeout_command = 350;
 
@@ -3845,6 +4586,10 @@ pn53x_data_new(struct nfc_device *pnd, const struct pn53x_io *io)
   // Set default communication timeout (52 ms)
   CHIP_DATA(pnd)->timeout_communication = 52;
 
+  // RF settings are unknown until sent
+  CHIP_DATA(pnd)->timings_synced = false;
+  CHIP_DATA(pnd)->max_retries_synced = false;
+
   CHIP_DATA(pnd)->supported_modulation_as_initiator = NULL;
 
   CHIP_DATA(pnd)->supported_modulation_as_target = NULL;
@@ -3852,6 +4597,9 @@ pn53x_data_new(struct nfc_device *pnd, const struct pn53x_io *io)
   // Set default progressive field flag
   CHIP_DATA(pnd)->progressive_field = false;
 
+  // No asynchronous command pending
+  memset(CHIP_DATA(pnd)->async_command, 0x00, sizeof(CHIP_DATA(pnd)->async_command));
+
   return pnd->chip_data;
 }
 
@@ -151,6 +151,16 @@ typedef enum {
   PSM_DUAL_CARD = 0x04
 } pn532_sam_mode;
 
+/**
+ * @internal
+ * @struct pn53x_iovec
+ * @brief Fragment of a PN53x command or reply
+ */
+struct pn53x_iovec {
+  uint8_t *pbt;
+  size_t  sz;
+};
+
 /**
  * @internal
  * @struct pn53x_io
@@ -159,6 +169,14 @@ typedef enum {
 struct pn53x_io {
   int (*send)(struct nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout);
   int (*receive)(struct nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout);
+  /** Optional: file descriptor which becomes readable when \a receive would not block */
+  int (*get_pollfd)(struct nfc_device *pnd);
+  /** Optional: stop the command the chip is running and drop its reply, if any */
+  int (*cancel)(struct nfc_device *pnd);
+  /** Optional: \a send gathering the command from fragments, so payloads are not copied to an intermediate buffer */
+  int (*sendv)(struct nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout);
+  /** Optional: \a receive scattering the reply to fragments */
+  int (*receivev)(struct nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout);
 };
 
 /* defines */
@@ -202,16 +220,29 @@ struct pn53x_data {
   uint8_t wb_data[PN53X_CACHE_REGISTER_SIZE];
   uint8_t wb_mask[PN53X_CACHE_REGISTER_SIZE];
   bool wb_trigged;
+  /** Shadow copy of the write-back cache area, as last read from or written to the chip */
+  uint8_t shadow_data[PN53X_CACHE_REGISTER_SIZE];
+  bool shadow_valid[PN53X_CACHE_REGISTER_SIZE];
+  /** Read all unknown registers on the next write-back, see pn53x_reset_settings() */
+  bool shadow_populate;
   /** Command timeout */
   int timeout_command;
   /** ATR timeout */
   int timeout_atr;
   /** Communication timeout */
   int timeout_communication;
+  /** Whether the chip holds timeout_atr and timeout_communication (RFCI_TIMING) */
+  bool timings_synced;
+  /** Whether the chip holds the retries matching pnd->bInfiniteSelect (RFCI_RETRY_SELECT) */
+  bool max_retries_synced;
   /** Supported modulation type */
   nfc_modulation_type *supported_modulation_as_initiator;
   nfc_modulation_type *supported_modulation_as_target;
   bool progressive_field;
+  /** Command code and target number of the pending asynchronous command */
+  uint8_t async_command[2];
+  /** When the last command was acknowledged, for chip latency statistics */
+  uint64_t ack_us;
 };
 
 #define CHIP_DATA(pnd) ((struct pn53x_data*)(pnd->chip_data))
@@ -317,6 +348,7 @@ int    pn53x_write_register(struct nfc_device *pnd, uint16_t ui16Reg, uint8_t ui
 int    pn53x_decode_firmware_version(struct nfc_device *pnd);
 int    pn53x_set_property_int(struct nfc_device *pnd, const nfc_property property, const int value);
 int    pn53x_set_property_bool(struct nfc_device *pnd, const nfc_property property, const bool bEnable);
+int    pn53x_set_properties(struct nfc_device *pnd, const nfc_property_setting settings[], const size_t szSettings);
 
 int    pn53x_check_communication(struct nfc_device *pnd);
 int    pn53x_idle(struct nfc_device *pnd);
@@ -342,6 +374,10 @@ int    pn53x_initiator_transceive_bits(struct nfc_device *pnd, const uint8_t *pb
                                        const uint8_t *pbtTxPar, uint8_t *pbtRx, uint8_t *pbtRxPar);
 int    pn53x_initiator_transceive_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx,
                                         uint8_t *pbtRx, const size_t szRx, int timeout);
+int    pn53x_initiator_transceive_batch(struct nfc_device *pnd, nfc_transceive_item items[], const size_t szItems, const nfc_batch_stop stop, int timeout);
+int    pn53x_initiator_transceive_bytes_submit(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
+int    pn53x_initiator_transceive_bytes_complete(struct nfc_device *pnd, uint8_t *pbtRx, const size_t szRx);
+int    pn53x_initiator_transceive_bytes_cancel(struct nfc_device *pnd);
 int    pn53x_initiator_transceive_bits_timed(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits,
                                              const uint8_t *pbtTxPar, uint8_t *pbtRx, uint8_t *pbtRxPar, uint32_t *cycles);
 int    pn53x_initiator_transceive_bytes_timed(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx,
@@ -396,9 +432,15 @@ int    pn53x_RFConfiguration__MaxRetries(struct nfc_device *pnd, const uint8_t M
 int    pn53x_check_ack_frame(struct nfc_device *pnd, const uint8_t *pbtRxFrame, const size_t szRxFrameLen);
 int    pn53x_check_error_frame(struct nfc_device *pnd, const uint8_t *pbtRxFrame, const size_t szRxFrameLen);
 int    pn53x_build_frame(uint8_t *pbtFrame, size_t *pszFrame, const uint8_t *pbtData, const size_t szData);
+int    pn53x_build_frame_iov(uint8_t *pbtFrame, size_t *pszFrame, const struct pn53x_iovec *iov, const size_t iovcnt);
+size_t pn53x_iov_size(const struct pn53x_iovec *iov, const size_t iovcnt);
+void   pn53x_iov_copy_to(const struct pn53x_iovec *iov, const size_t iovcnt, size_t szOffset, const uint8_t *pbtSrc, size_t szSrc);
+size_t pn53x_iov_copy_from(const struct pn53x_iovec *iov, const size_t iovcnt, size_t szOffset, uint8_t *pbtDst, size_t szDst);
+uint8_t pn53x_iov_checksum(const struct pn53x_iovec *iov, const size_t iovcnt, size_t szData, uint8_t btDCS);
 int    pn53x_get_supported_modulation(nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type **const supported_mt);
 int    pn53x_get_supported_baud_rate(nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br);
 int    pn53x_get_information_about(nfc_device *pnd, char **pbuf);
+int    pn53x_get_pollfd(struct nfc_device *pnd);
 
 void   *pn53x_data_new(struct nfc_device *pnd, const struct pn53x_io *io);
 void    pn53x_data_free(struct nfc_device *pnd);
@@ -215,6 +215,14 @@ conf_keyvalue_context(void *data, const char *key, const char *value)
     string_as_boolean(value, &(context->allow_autoscan));
   } else if (strcmp(key, "allow_intrusive_scan") == 0) {
     string_as_boolean(value, &(context->allow_intrusive_scan));
+  } else if (strcmp(key, "scan_timeout") == 0) {
+    context->scan_timeout = atoi(value);
+  } else if (strcmp(key, "scan_cache") == 0) {
+    strncpy(context->scan_cache, value, SCAN_CACHE_PATH_LENGTH - 1);
+    context->scan_cache[SCAN_CACHE_PATH_LENGTH - 1] = '\0';
+  } else if (strcmp(key, "capture_file") == 0) {
+    strncpy(context->capture_file, value, SCAN_CACHE_PATH_LENGTH - 1);
+    context->capture_file[SCAN_CACHE_PATH_LENGTH - 1] = '\0';
   } else if (strcmp(key, "log_level") == 0) {
     context->log_level = atoi(value);
   } else if (strcmp(key, "device.name") == 0) {
@@ -113,15 +113,20 @@ struct acr122_pcsc_data {
 
 static SCARDCONTEXT _SCardContext;
 static int _iSCardContextRefCount = 0;
+static nfc_mutex _SCardContextLock = NFC_MUTEX_INITIALIZER;
 
 static SCARDCONTEXT *
 acr122_pcsc_get_scardcontext(void)
 {
+  nfc_mutex_lock(&_SCardContextLock);
   if (_iSCardContextRefCount == 0) {
-    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &_SCardContext) != SCARD_S_SUCCESS)
+    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &_SCardContext) != SCARD_S_SUCCESS) {
+      nfc_mutex_unlock(&_SCardContextLock);
       return NULL;
+    }
   }
   _iSCardContextRefCount++;
+  nfc_mutex_unlock(&_SCardContextLock);
 
   return &_SCardContext;
 }
@@ -129,12 +134,14 @@ acr122_pcsc_get_scardcontext(void)
 static void
 acr122_pcsc_free_scardcontext(void)
 {
+  nfc_mutex_lock(&_SCardContextLock);
   if (_iSCardContextRefCount) {
     _iSCardContextRefCount--;
     if (!_iSCardContextRefCount) {
       SCardReleaseContext(_SCardContext);
     }
   }
+  nfc_mutex_unlock(&_SCardContextLock);
 }
 
 #define PCSC_MAX_DEVICES 16
@@ -494,6 +501,7 @@ const struct nfc_driver acr122_pcsc_driver = {
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
   .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
 
   .target_init           = pn53x_target_init,
   .target_send_bytes     = pn53x_target_send_bytes,
@@ -503,6 +511,7 @@ const struct nfc_driver acr122_pcsc_driver = {
 
   .device_set_property_bool     = pn53x_set_property_bool,
   .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
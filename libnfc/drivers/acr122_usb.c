@@ -302,6 +302,7 @@ acr122_usb_scan(const nfc_context *context, nfc_connstring connstrings[], const
 {
   (void)context;
 
+  usb_bus_lock();
   usb_prepare();
 
   size_t device_found = 0;
@@ -340,6 +341,7 @@ acr122_usb_scan(const nfc_context *context, nfc_connstring connstrings[], const
           device_found++;
           // Test if we reach the maximum "wanted" devices
           if (device_found == connstrings_len) {
+            usb_bus_unlock();
             return device_found;
           }
         }
@@ -347,6 +349,7 @@ acr122_usb_scan(const nfc_context *context, nfc_connstring connstrings[], const
     }
   }
 
+  usb_bus_unlock();
   return device_found;
 }
 
@@ -402,6 +405,8 @@ acr122_usb_open(const nfc_context *context, const nfc_connstring connstring)
   struct usb_bus *bus;
   struct usb_device *dev;
 
+  // Held until the device is opened, other threads may rebuild the bus list
+  usb_bus_lock();
   usb_prepare();
 
   for (bus = usb_get_busses(); bus; bus = bus->next) {
@@ -485,6 +490,9 @@ error:
   nfc_device_free(pnd);
   pnd = NULL;
 free_mem:
+  // The bus list is only locked once the connstring is decoded
+  if (connstring_decode_level >= 1)
+    usb_bus_unlock();
   free(desc.dirname);
   free(desc.filename);
   return pnd;
@@ -849,6 +857,7 @@ const struct nfc_driver acr122_usb_driver = {
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
   .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
 
   .target_init           = pn53x_target_init,
   .target_send_bytes     = pn53x_target_send_bytes,
@@ -858,6 +867,7 @@ const struct nfc_driver acr122_usb_driver = {
 
   .device_set_property_bool     = pn53x_set_property_bool,
   .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
@@ -411,106 +411,81 @@ struct acr122s_descriptor {
   uint32_t speed;
 };
 
-static size_t
-acr122s_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+static bool
+acr122s_probe(const nfc_context *context, const char *acPort, nfc_connstring connstring)
 {
-  size_t device_found = 0;
   serial_port sp;
-  char **acPorts = uart_list_ports();
-  const char *acPort;
-  int     iDevice = 0;
 
-  while ((acPort = acPorts[iDevice++])) {
-    sp = uart_open(acPort);
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find ACR122S device on serial port: %s at %d baud.", acPort, ACR122S_DEFAULT_SPEED);
-
-    if ((sp != INVALID_SERIAL_PORT) && (sp != CLAIMED_SERIAL_PORT)) {
-      // We need to flush input to be sure first reply does not comes from older byte transceive
-      uart_flush_input(sp, true);
-      uart_set_speed(sp, ACR122S_DEFAULT_SPEED);
-
-      nfc_connstring connstring;
-      snprintf(connstring, sizeof(nfc_connstring), "%s:%s:%"PRIu32, ACR122S_DRIVER_NAME, acPort, ACR122S_DEFAULT_SPEED);
-      nfc_device *pnd = nfc_device_new(context, connstring);
-      if (!pnd) {
-        perror("malloc");
-        uart_close(sp);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-
-      pnd->driver = &acr122s_driver;
-      pnd->driver_data = malloc(sizeof(struct acr122s_data));
-      if (!pnd->driver_data) {
-        perror("malloc");
-        uart_close(sp);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      DRIVER_DATA(pnd)->port = sp;
-      DRIVER_DATA(pnd)->seq = 0;
+  sp = uart_open(acPort);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find ACR122S device on serial port: %s at %d baud.", acPort, ACR122S_DEFAULT_SPEED);
+
+  if ((sp != INVALID_SERIAL_PORT) && (sp != CLAIMED_SERIAL_PORT)) {
+    // We need to flush input to be sure first reply does not comes from older byte transceive
+    uart_flush_input(sp, true);
+    uart_set_speed(sp, ACR122S_DEFAULT_SPEED);
+
+    snprintf(connstring, sizeof(nfc_connstring), "%s:%s:%"PRIu32, ACR122S_DRIVER_NAME, acPort, ACR122S_DEFAULT_SPEED);
+    nfc_device *pnd = nfc_device_new(context, connstring);
+    if (!pnd) {
+      perror("malloc");
+      uart_close(sp);
+      return false;
+    }
+
+    pnd->driver = &acr122s_driver;
+    pnd->driver_data = malloc(sizeof(struct acr122s_data));
+    if (!pnd->driver_data) {
+      perror("malloc");
+      uart_close(sp);
+      nfc_device_free(pnd);
+      return false;
+    }
+    DRIVER_DATA(pnd)->port = sp;
+    DRIVER_DATA(pnd)->seq = 0;
 
 #ifndef WIN32
-      if (pipe(DRIVER_DATA(pnd)->abort_fds) < 0) {
-        uart_close(DRIVER_DATA(pnd)->port);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
+    if (pipe(DRIVER_DATA(pnd)->abort_fds) < 0) {
+      uart_close(DRIVER_DATA(pnd)->port);
+      nfc_device_free(pnd);
+      return false;
+    }
 #else
-      DRIVER_DATA(pnd)->abort_flag = false;
+    DRIVER_DATA(pnd)->abort_flag = false;
 #endif
 
-      if (pn53x_data_new(pnd, &acr122s_io) == NULL) {
-        perror("malloc");
-        uart_close(DRIVER_DATA(pnd)->port);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      CHIP_DATA(pnd)->type = PN532;
-      CHIP_DATA(pnd)->power_mode = NORMAL;
-
-      char version[32];
-      int ret = acr122s_get_firmware_version(pnd, version, sizeof(version));
-      if (ret == 0 && strncmp("ACR122S", version, 7) != 0) {
-        ret = -1;
-      }
-
+    if (pn53x_data_new(pnd, &acr122s_io) == NULL) {
+      perror("malloc");
       uart_close(DRIVER_DATA(pnd)->port);
-      pn53x_data_free(pnd);
       nfc_device_free(pnd);
+      return false;
+    }
+    CHIP_DATA(pnd)->type = PN532;
+    CHIP_DATA(pnd)->power_mode = NORMAL;
 
-      if (ret != 0)
-        continue;
-
-      // ACR122S reader is found
-      memcpy(connstrings[device_found], connstring, sizeof(nfc_connstring));
-      device_found++;
-
-      // Test if we reach the maximum "wanted" devices
-      if (device_found >= connstrings_len)
-        break;
+    char version[32];
+    int ret = acr122s_get_firmware_version(pnd, version, sizeof(version));
+    if (ret == 0 && strncmp("ACR122S", version, 7) != 0) {
+      ret = -1;
     }
+
+    uart_close(DRIVER_DATA(pnd)->port);
+    pn53x_data_free(pnd);
+    nfc_device_free(pnd);
+    return ret == 0;
   }
-  iDevice = 0;
+  return false;
+}
+
+static size_t
+acr122s_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  char **acPorts = uart_list_ports();
+  const char *acPort;
+  int     iDevice = 0;
+
+  // Ports are probed concurrently, found devices are kept in ports order
+  size_t device_found = nfc_scan_ports(context, acPorts, acr122s_probe, connstrings, connstrings_len);
+
   while ((acPort = acPorts[iDevice++])) {
     free((void *)acPort);
   }
@@ -752,6 +727,7 @@ const struct nfc_driver acr122s_driver = {
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
   .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
 
   .target_init           = pn53x_target_init,
   .target_send_bytes     = pn53x_target_send_bytes,
@@ -761,6 +737,7 @@ const struct nfc_driver acr122s_driver = {
 
   .device_set_property_bool     = pn53x_set_property_bool,
   .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
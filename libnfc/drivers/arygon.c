@@ -97,101 +97,76 @@ static const uint8_t arygon_error_unknown_mode[] = "FF060000\x0d\x0a";
 int     arygon_reset_tama(nfc_device *pnd);
 void    arygon_firmware(nfc_device *pnd, char *str);
 
-static size_t
-arygon_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+static bool
+arygon_probe(const nfc_context *context, const char *acPort, nfc_connstring connstring)
 {
-  size_t device_found = 0;
   serial_port sp;
-  char **acPorts = uart_list_ports();
-  const char *acPort;
-  int     iDevice = 0;
 
-  while ((acPort = acPorts[iDevice++])) {
-    sp = uart_open(acPort);
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find ARYGON device on serial port: %s at %d baud.", acPort, ARYGON_DEFAULT_SPEED);
-
-    if ((sp != INVALID_SERIAL_PORT) && (sp != CLAIMED_SERIAL_PORT)) {
-      // We need to flush input to be sure first reply does not comes from older byte transceive
-      uart_flush_input(sp, true);
-      uart_set_speed(sp, ARYGON_DEFAULT_SPEED);
-
-      nfc_connstring connstring;
-      snprintf(connstring, sizeof(nfc_connstring), "%s:%s:%"PRIu32, ARYGON_DRIVER_NAME, acPort, ARYGON_DEFAULT_SPEED);
-      nfc_device *pnd = nfc_device_new(context, connstring);
-      if (!pnd) {
-        perror("malloc");
-        uart_close(sp);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-
-      pnd->driver = &arygon_driver;
-      pnd->driver_data = malloc(sizeof(struct arygon_data));
-      if (!pnd->driver_data) {
-        perror("malloc");
-        uart_close(sp);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      DRIVER_DATA(pnd)->port = sp;
-
-      // Alloc and init chip's data
-      if (pn53x_data_new(pnd, &arygon_tama_io) == NULL) {
-        perror("malloc");
-        uart_close(DRIVER_DATA(pnd)->port);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
+  sp = uart_open(acPort);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find ARYGON device on serial port: %s at %d baud.", acPort, ARYGON_DEFAULT_SPEED);
 
-#ifndef WIN32
-      // pipe-based abort mechanism
-      if (pipe(DRIVER_DATA(pnd)->iAbortFds) < 0) {
-        uart_close(DRIVER_DATA(pnd)->port);
-        pn53x_data_free(pnd);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-#else
-      DRIVER_DATA(pnd)->abort_flag = false;
-#endif
+  if ((sp != INVALID_SERIAL_PORT) && (sp != CLAIMED_SERIAL_PORT)) {
+    // We need to flush input to be sure first reply does not comes from older byte transceive
+    uart_flush_input(sp, true);
+    uart_set_speed(sp, ARYGON_DEFAULT_SPEED);
 
-      int res = arygon_reset_tama(pnd);
-      uart_close(DRIVER_DATA(pnd)->port);
-      pn53x_data_free(pnd);
+    snprintf(connstring, sizeof(nfc_connstring), "%s:%s:%"PRIu32, ARYGON_DRIVER_NAME, acPort, ARYGON_DEFAULT_SPEED);
+    nfc_device *pnd = nfc_device_new(context, connstring);
+    if (!pnd) {
+      perror("malloc");
+      uart_close(sp);
+      return false;
+    }
+
+    pnd->driver = &arygon_driver;
+    pnd->driver_data = malloc(sizeof(struct arygon_data));
+    if (!pnd->driver_data) {
+      perror("malloc");
+      uart_close(sp);
       nfc_device_free(pnd);
-      if (res < 0) {
-        continue;
-      }
+      return false;
+    }
+    DRIVER_DATA(pnd)->port = sp;
 
-      // ARYGON reader is found
-      memcpy(connstrings[device_found], connstring, sizeof(nfc_connstring));
-      device_found++;
+    // Alloc and init chip's data
+    if (pn53x_data_new(pnd, &arygon_tama_io) == NULL) {
+      perror("malloc");
+      uart_close(DRIVER_DATA(pnd)->port);
+      nfc_device_free(pnd);
+      return false;
+    }
 
-      // Test if we reach the maximum "wanted" devices
-      if (device_found >= connstrings_len)
-        break;
+#ifndef WIN32
+    // pipe-based abort mechanism
+    if (pipe(DRIVER_DATA(pnd)->iAbortFds) < 0) {
+      uart_close(DRIVER_DATA(pnd)->port);
+      pn53x_data_free(pnd);
+      nfc_device_free(pnd);
+      return false;
     }
+#else
+    DRIVER_DATA(pnd)->abort_flag = false;
+#endif
+
+    int res = arygon_reset_tama(pnd);
+    uart_close(DRIVER_DATA(pnd)->port);
+    pn53x_data_free(pnd);
+    nfc_device_free(pnd);
+    return res >= 0;
   }
-  iDevice = 0;
+  return false;
+}
+
+static size_t
+arygon_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  char **acPorts = uart_list_ports();
+  const char *acPort;
+  int     iDevice = 0;
+
+  // Ports are probed concurrently, found devices are kept in ports order
+  size_t device_found = nfc_scan_ports(context, acPorts, arygon_probe, connstrings, connstrings_len);
+
   while ((acPort = acPorts[iDevice++])) {
     free((void *)acPort);
   }
@@ -335,8 +310,9 @@ arygon_open(const nfc_context *context, const nfc_connstring connstring)
 #define ARYGON_TX_BUFFER_LEN (PN53x_NORMAL_FRAME__DATA_MAX_LEN + PN53x_NORMAL_FRAME__OVERHEAD + 1)
 #define ARYGON_RX_BUFFER_LEN (PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD)
 static int
-arygon_tama_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+arygon_tama_sendv(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
 {
+  const size_t szData = pn53x_iov_size(iov, iovcnt);
   int res = 0;
   // Before sending anything, we need to discard from any junk bytes
   uart_flush_input(DRIVER_DATA(pnd)->port, false);
@@ -351,7 +327,7 @@ arygon_tama_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, i
     return pnd->last_error;
   }
 
-  if ((res = pn53x_build_frame(abtFrame + 1, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_iov(abtFrame + 1, &szFrame, iov, iovcnt)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
@@ -363,7 +339,8 @@ arygon_tama_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, i
   }
 
   uint8_t abtRxBuf[PN53x_ACK_FRAME__LEN];
-  if ((res = uart_receive(DRIVER_DATA(pnd)->port, abtRxBuf, sizeof(abtRxBuf), 0, timeout)) != 0) {
+  // The reply may follow right away: leave it to wake up pollers of the port
+  if ((res = uart_receive_exact(DRIVER_DATA(pnd)->port, abtRxBuf, sizeof(abtRxBuf), 0, timeout)) != 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to read ACK");
     pnd->last_error = res;
     return pnd->last_error;
@@ -383,6 +360,13 @@ arygon_tama_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, i
   return NFC_SUCCESS;
 }
 
+static int
+arygon_tama_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  const struct pn53x_iovec iov = { (uint8_t *) pbtData, szData };
+  return arygon_tama_sendv(pnd, &iov, 1, timeout);
+}
+
 static int
 arygon_abort(nfc_device *pnd)
 {
@@ -396,8 +380,9 @@ arygon_abort(nfc_device *pnd)
 }
 
 static int
-arygon_tama_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+arygon_tama_receivev(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
 {
+  const size_t szDataLen = pn53x_iov_size(iov, iovcnt);
   uint8_t  abtRxBuf[5];
   size_t len;
   void *abort_p = NULL;
@@ -478,12 +463,17 @@ arygon_tama_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, i
     return pnd->last_error;
   }
 
-  if (len) {
-    pnd->last_error = uart_receive(DRIVER_DATA(pnd)->port, pbtData, len, 0, timeout);
+  // Data goes straight to the caller's fragments
+  for (size_t i = 0, szLeft = len; (i < iovcnt) && szLeft; i++) {
+    const size_t sz = MIN(iov[i].sz, szLeft);
+    if (!sz)
+      continue;
+    pnd->last_error = uart_receive(DRIVER_DATA(pnd)->port, iov[i].pbt, sz, 0, timeout);
     if (pnd->last_error != 0) {
       log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to receive data. (RX)");
       return pnd->last_error;
     }
+    szLeft -= sz;
   }
 
   pnd->last_error = uart_receive(DRIVER_DATA(pnd)->port, abtRxBuf, 2, 0, timeout);
@@ -494,9 +484,7 @@ arygon_tama_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, i
 
   uint8_t btDCS = (256 - 0xD5);
   btDCS -= CHIP_DATA(pnd)->last_command + 1;
-  for (size_t szPos = 0; szPos < len; szPos++) {
-    btDCS -= pbtData[szPos];
-  }
+  btDCS = pn53x_iov_checksum(iov, iovcnt, len, btDCS);
 
   if (btDCS != abtRxBuf[0]) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Data checksum mismatch");
@@ -513,6 +501,13 @@ arygon_tama_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, i
   return len;
 }
 
+static int
+arygon_tama_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  const struct pn53x_iovec iov = { pbtData, szDataLen };
+  return arygon_tama_receivev(pnd, &iov, 1, timeout);
+}
+
 void
 arygon_firmware(nfc_device *pnd, char *str)
 {
@@ -587,9 +582,31 @@ arygon_abort_command(nfc_device *pnd)
 }
 
 
+#ifndef WIN32
+static int
+arygon_get_pollfd(nfc_device *pnd)
+{
+  return uart_get_fd(DRIVER_DATA(pnd)->port);
+}
+#endif
+
+static int
+arygon_cancel(nfc_device *pnd)
+{
+  // Drop a reply already sent, then stop a command still running
+  uart_flush_input(DRIVER_DATA(pnd)->port, true);
+  return arygon_abort(pnd);
+}
+
 const struct pn53x_io arygon_tama_io = {
   .send       = arygon_tama_send,
   .receive    = arygon_tama_receive,
+#ifndef WIN32
+  .get_pollfd = arygon_get_pollfd,
+#endif
+  .cancel     = arygon_cancel,
+  .sendv      = arygon_tama_sendv,
+  .receivev   = arygon_tama_receivev,
 };
 
 const struct nfc_driver arygon_driver = {
@@ -611,6 +628,10 @@ const struct nfc_driver arygon_driver = {
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
   .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
+  .initiator_transceive_bytes_submit   = pn53x_initiator_transceive_bytes_submit,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
+  .initiator_transceive_bytes_cancel   = pn53x_initiator_transceive_bytes_cancel,
 
   .target_init           = pn53x_target_init,
   .target_send_bytes     = pn53x_target_send_bytes,
@@ -620,9 +641,11 @@ const struct nfc_driver arygon_driver = {
 
   .device_set_property_bool     = pn53x_set_property_bool,
   .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = arygon_abort_command,
   .idle           = pn53x_idle,
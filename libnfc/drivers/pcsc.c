@@ -105,6 +105,7 @@ struct pcsc_data {
 
 static SCARDCONTEXT _SCardContext;
 static int _iSCardContextRefCount = 0;
+static nfc_mutex _SCardContextLock = NFC_MUTEX_INITIALIZER;
 
 const nfc_baud_rate pcsc_supported_brs[] = {NBR_106, NBR_424, 0};
 const nfc_modulation_type pcsc_supported_mts[] = {NMT_ISO14443A, NMT_ISO14443B, 0};
@@ -112,11 +113,15 @@ const nfc_modulation_type pcsc_supported_mts[] = {NMT_ISO14443A, NMT_ISO14443B,
 static SCARDCONTEXT *
 pcsc_get_scardcontext(void)
 {
+  nfc_mutex_lock(&_SCardContextLock);
   if (_iSCardContextRefCount == 0) {
-    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &_SCardContext) != SCARD_S_SUCCESS)
+    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &_SCardContext) != SCARD_S_SUCCESS) {
+      nfc_mutex_unlock(&_SCardContextLock);
       return NULL;
+    }
   }
   _iSCardContextRefCount++;
+  nfc_mutex_unlock(&_SCardContextLock);
 
   return &_SCardContext;
 }
@@ -124,12 +129,14 @@ pcsc_get_scardcontext(void)
 static void
 pcsc_free_scardcontext(void)
 {
+  nfc_mutex_lock(&_SCardContextLock);
   if (_iSCardContextRefCount) {
     _iSCardContextRefCount--;
     if (!_iSCardContextRefCount) {
       SCardReleaseContext(_SCardContext);
     }
   }
+  nfc_mutex_unlock(&_SCardContextLock);
 }
 
 #define ICC_TYPE_UNKNOWN 0
@@ -28,6 +28,10 @@
 /**
  * @file pn532_i2c.c
  * @brief PN532 driver using I2C bus.
+ *
+ * Connstring is pn532_i2c:bus[:irq=chip/line], where chip/line is the GPIO
+ * line wired to the PN532 IRQ pin, e.g. gpiochip0/25, waited for instead of
+ * polling the chip status.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -50,6 +54,7 @@
 #include "chips/pn53x.h"
 #include "chips/pn53x-internal.h"
 #include "buses/i2c.h"
+#include "buses/ready.h"
 
 #define PN532_I2C_DRIVER_NAME "pn532_i2c"
 
@@ -66,12 +71,18 @@
  */
 #define PN532_SEND_RETRIES 3
 
+// Bounds of the interval between status reads without IRQ line, in ms
+#define PN532_I2C_POLL_MIN_INTERVAL 1
+#define PN532_I2C_POLL_MAX_INTERVAL 8
+
 // Internal data structs
 const struct pn53x_io pn532_i2c_io;
 
 struct pn532_i2c_data {
   i2c_device dev;
-  volatile bool abort_flag;
+  struct ready_notifier *ready;
+  /** End of the last transaction on this device, see pn532_i2c_wait_bus_free() */
+  struct timespec transaction_stop;
 };
 
 /* preamble and start bytes, see pn532-internal.h for details */
@@ -105,33 +116,48 @@ static size_t pn532_i2c_scan(const nfc_context *context, nfc_connstring connstri
  * table 320. I2C timing specification, page 211, rev. 3.2 - 2007-12-07.
  */
 #define PN532_BUS_FREE_TIME 5
-static struct timespec __transaction_stop;
+
+/**
+ * @brief Sleep for what remains of the bus free time since the last
+ *        transaction on this device.
+ *
+ * @param pnd pointer on the NFC device
+ */
+static void
+pn532_i2c_wait_bus_free(nfc_device *pnd)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  const struct timespec *stop = &DRIVER_DATA(pnd)->transaction_stop;
+  int64_t elapsed_ns = ((int64_t)(now.tv_sec - stop->tv_sec) * 1000000000) + (now.tv_nsec - stop->tv_nsec);
+  int64_t remaining_ns = ((int64_t)PN532_BUS_FREE_TIME * 1000 * 1000) - elapsed_ns;
+  if (remaining_ns > 0) {
+    struct timespec bus_free_time = { 0, (long) remaining_ns };
+    nanosleep(&bus_free_time, NULL);
+  }
+}
 
 /**
  * @brief Wrapper around i2c_read to ensure proper timing by respecting the
  * 	  minimal free bus time between a STOP condition and a START condition.
  *
- * @note This is not thread safe, but since libnfc is single threaded
- * 	 this should be okay.
+ * @note The timing state is kept per device, so distinct devices may be
+ * 	 driven from distinct threads.
  *
- * @param id I2C device
+ * @param pnd pointer on the NFC device
  * @param buf pointer on buffer used to store data
  * @param len length of the buffer
  * @return length (in bytes) of read data, or driver error code (negative value)
  */
-static ssize_t pn532_i2c_read(const i2c_device id,
+static ssize_t pn532_i2c_read(nfc_device *pnd,
                               uint8_t *buf, const size_t len)
 {
-  struct timespec transaction_start, bus_free_time = { 0, 0 };
   ssize_t ret;
 
-  clock_gettime(CLOCK_MONOTONIC, &transaction_start);
-  bus_free_time.tv_nsec = (PN532_BUS_FREE_TIME * 1000 * 1000) -
-                          (transaction_start.tv_nsec - __transaction_stop.tv_nsec);
-  nanosleep(&bus_free_time, NULL);
-
-  ret = i2c_read(id, buf, len);
-  clock_gettime(CLOCK_MONOTONIC, &__transaction_stop);
+  pn532_i2c_wait_bus_free(pnd);
+  ret = i2c_read(DRIVER_DATA(pnd)->dev, buf, len);
+  clock_gettime(CLOCK_MONOTONIC, &DRIVER_DATA(pnd)->transaction_stop);
   return ret;
 }
 
@@ -139,30 +165,55 @@ static ssize_t pn532_i2c_read(const i2c_device id,
  * @brief Wrapper around i2c_write to ensure proper timing by respecting the
  * 	  minimal free bus time between a STOP condition and a START condition.
  *
- * @note This is not thread safe, but since libnfc is single threaded
- * 	 this should be okay.
+ * @note The timing state is kept per device, so distinct devices may be
+ * 	 driven from distinct threads.
  *
- * @param id I2C device
+ * @param pnd pointer on the NFC device
  * @param buf pointer on buffer containing data
  * @param len length of the buffer
  * @return NFC_SUCCESS on success, otherwise driver error code
  */
-static ssize_t pn532_i2c_write(const i2c_device id,
+static ssize_t pn532_i2c_write(nfc_device *pnd,
                                const uint8_t *buf, const size_t len)
 {
-  struct timespec transaction_start, bus_free_time = { 0, 0 };
   ssize_t ret;
 
-  clock_gettime(CLOCK_MONOTONIC, &transaction_start);
-  bus_free_time.tv_nsec = (PN532_BUS_FREE_TIME * 1000 * 1000) -
-                          (transaction_start.tv_nsec - __transaction_stop.tv_nsec);
-  nanosleep(&bus_free_time, NULL);
-
-  ret = i2c_write(id, buf, len);
-  clock_gettime(CLOCK_MONOTONIC, &__transaction_stop);
+  pn532_i2c_wait_bus_free(pnd);
+  ret = i2c_write(DRIVER_DATA(pnd)->dev, buf, len);
+  clock_gettime(CLOCK_MONOTONIC, &DRIVER_DATA(pnd)->transaction_stop);
   return ret;
 }
 
+/**
+ * @brief Wrapper around i2c_write_read to ensure proper timing, as
+ * pn532_i2c_read() does, for a write followed by a read.
+ *
+ * Adapters which can not combine transfers get a write then a read.
+ *
+ * @param pnd pointer on the NFC device
+ * @param tx pointer on buffer containing data to write
+ * @param txLen length of data to write
+ * @param rx pointer on buffer used to store read data
+ * @param rxLen length of data to read
+ * @return length (in bytes) of read data, or driver error code (negative value)
+ */
+static ssize_t pn532_i2c_write_read(nfc_device *pnd,
+                                    const uint8_t *tx, const size_t txLen,
+                                    uint8_t *rx, const size_t rxLen)
+{
+  ssize_t ret;
+
+  pn532_i2c_wait_bus_free(pnd);
+  ret = i2c_write_read(DRIVER_DATA(pnd)->dev, tx, txLen, rx, rxLen);
+  clock_gettime(CLOCK_MONOTONIC, &DRIVER_DATA(pnd)->transaction_stop);
+  if (ret != NFC_EDEVNOTSUPP)
+    return ret;
+
+  if ((ret = pn532_i2c_write(pnd, tx, txLen)) < 0)
+    return ret;
+  return pn532_i2c_read(pnd, rx, rxLen);
+}
+
 /**
  * @brief Scan all available I2C buses to find PN532 devices.
  *
@@ -172,86 +223,76 @@ static ssize_t pn532_i2c_write(const i2c_device id,
  * @param connstrings_len length of the connstrings array.
  * @return number of PN532 devices found on all I2C buses.
  */
-static size_t
-pn532_i2c_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+static bool
+pn532_i2c_probe(const nfc_context *context, const char *i2cPort, nfc_connstring connstring)
 {
-  size_t device_found = 0;
   i2c_device id;
-  char **i2cPorts = i2c_list_ports();
-  const char *i2cPort;
-  int iDevice = 0;
-
-  while ((i2cPort = i2cPorts[iDevice++])) {
-    id = i2c_open(i2cPort, PN532_I2C_ADDR);
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find PN532 device on I2C bus %s.", i2cPort);
-
-    if ((id != INVALID_I2C_ADDRESS) && (id != INVALID_I2C_BUS)) {
-      nfc_connstring connstring;
-      snprintf(connstring, sizeof(nfc_connstring), "%s:%s", PN532_I2C_DRIVER_NAME, i2cPort);
-      nfc_device *pnd = nfc_device_new(context, connstring);
-      if (!pnd) {
-        perror("malloc");
-        i2c_close(id);
-        iDevice = 0;
-        while ((i2cPort = i2cPorts[iDevice++])) {
-          free((void *)i2cPort);
-        }
-        free(i2cPorts);
-        return 0;
-      }
-      pnd->driver = &pn532_i2c_driver;
-      pnd->driver_data = malloc(sizeof(struct pn532_i2c_data));
-      if (!pnd->driver_data) {
-        perror("malloc");
-        i2c_close(id);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((i2cPort = i2cPorts[iDevice++])) {
-          free((void *)i2cPort);
-        }
-        free(i2cPorts);
-        return 0;
-      }
-      DRIVER_DATA(pnd)->dev = id;
-
-      // Alloc and init chip's data
-      if (pn53x_data_new(pnd, &pn532_i2c_io) == NULL) {
-        perror("malloc");
-        i2c_close(DRIVER_DATA(pnd)->dev);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((i2cPort = i2cPorts[iDevice++])) {
-          free((void *)i2cPort);
-        }
-        free(i2cPorts);
-        return 0;
-      }
 
-      // SAMConfiguration command if needed to wakeup the chip and pn53x_SAMConfiguration check if the chip is a PN532
-      CHIP_DATA(pnd)->type = PN532;
-      // This device starts in LowVBat power mode
-      CHIP_DATA(pnd)->power_mode = LOWVBAT;
+  id = i2c_open_ext(context->i2c_backend, i2cPort, PN532_I2C_ADDR);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find PN532 device on I2C bus %s.", i2cPort);
 
-      DRIVER_DATA(pnd)->abort_flag = false;
+  if ((id != INVALID_I2C_ADDRESS) && (id != INVALID_I2C_BUS)) {
+    snprintf(connstring, sizeof(nfc_connstring), "%s:%s", PN532_I2C_DRIVER_NAME, i2cPort);
+    nfc_device *pnd = nfc_device_new(context, connstring);
+    if (!pnd) {
+      perror("malloc");
+      i2c_close(id);
+      return false;
+    }
+    pnd->driver = &pn532_i2c_driver;
+    pnd->driver_data = malloc(sizeof(struct pn532_i2c_data));
+    if (!pnd->driver_data) {
+      perror("malloc");
+      i2c_close(id);
+      nfc_device_free(pnd);
+      return false;
+    }
+    DRIVER_DATA(pnd)->dev = id;
+    DRIVER_DATA(pnd)->transaction_stop.tv_sec = 0;
+    DRIVER_DATA(pnd)->transaction_stop.tv_nsec = 0;
 
-      // Check communication using "Diagnose" command, with "Communication test" (0x00)
-      int res = pn53x_check_communication(pnd);
+    // Alloc and init chip's data
+    if (pn53x_data_new(pnd, &pn532_i2c_io) == NULL) {
+      perror("malloc");
       i2c_close(DRIVER_DATA(pnd)->dev);
-      pn53x_data_free(pnd);
       nfc_device_free(pnd);
-      if (res < 0) {
-        continue;
-      }
+      return false;
+    }
 
-      memcpy(connstrings[device_found], connstring, sizeof(nfc_connstring));
-      device_found++;
+    // SAMConfiguration command if needed to wakeup the chip and pn53x_SAMConfiguration check if the chip is a PN532
+    CHIP_DATA(pnd)->type = PN532;
+    // This device starts in LowVBat power mode
+    CHIP_DATA(pnd)->power_mode = LOWVBAT;
 
-      // Test if we reach the maximum "wanted" devices
-      if (device_found >= connstrings_len)
-        break;
+    DRIVER_DATA(pnd)->ready = ready_notifier_new_poller(PN532_I2C_POLL_MIN_INTERVAL, PN532_I2C_POLL_MAX_INTERVAL);
+    if (!DRIVER_DATA(pnd)->ready) {
+      i2c_close(DRIVER_DATA(pnd)->dev);
+      pn53x_data_free(pnd);
+      nfc_device_free(pnd);
+      return false;
     }
+
+    // Check communication using "Diagnose" command, with "Communication test" (0x00)
+    int res = pn53x_check_communication(pnd);
+    ready_notifier_free(DRIVER_DATA(pnd)->ready);
+    i2c_close(DRIVER_DATA(pnd)->dev);
+    pn53x_data_free(pnd);
+    nfc_device_free(pnd);
+    return res >= 0;
   }
-  iDevice = 0;
+  return false;
+}
+
+static size_t
+pn532_i2c_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  char **i2cPorts = i2c_list_ports();
+  const char *i2cPort;
+  int     iDevice = 0;
+
+  // Ports are probed concurrently, found devices are kept in ports order
+  size_t device_found = nfc_scan_ports(context, i2cPorts, pn532_i2c_probe, connstrings, connstrings_len);
+
   while ((i2cPort = i2cPorts[iDevice++])) {
     free((void *)i2cPort);
   }
@@ -269,6 +310,7 @@ pn532_i2c_close(nfc_device *pnd)
 {
   pn53x_idle(pnd);
   i2c_close(DRIVER_DATA(pnd)->dev);
+  ready_notifier_free(DRIVER_DATA(pnd)->ready);
 
   pn53x_data_free(pnd);
   nfc_device_free(pnd);
@@ -278,19 +320,30 @@ pn532_i2c_close(nfc_device *pnd)
  * @brief Open an I2C connection to the PN532 device.
  *
  * @param context NFC context.
- * @param connstring connection info to the device  ( pn532_i2c:<i2c_devname> ).
+ * @param connstring connection info to the device  ( pn532_i2c:<i2c_devname>[:irq=<chip>/<line>] ).
  * @return pointer to the device, or NULL in case of error.
  */
 static nfc_device *
 pn532_i2c_open(const nfc_context *context, const nfc_connstring connstring)
 {
   char *i2c_devname;
+  char *options = NULL;
+  const char *irq = NULL;
   i2c_device i2c_dev;
   nfc_device *pnd;
 
-  int connstring_decode_level = connstring_decode(connstring, PN532_I2C_DRIVER_NAME, NULL, &i2c_devname, NULL);
+  int connstring_decode_level = connstring_decode(connstring, PN532_I2C_DRIVER_NAME, NULL, &i2c_devname, &options);
 
   switch (connstring_decode_level) {
+    case 3:
+      if (strncmp(options, "irq=", 4) != 0) {
+        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unknown pn532_i2c option: %s", options);
+        free(i2c_devname);
+        free(options);
+        return NULL;
+      }
+      irq = options + 4;
+      break;
     case 2:
       break;
     case 1:
@@ -299,15 +352,17 @@ pn532_i2c_open(const nfc_context *context, const nfc_connstring connstring)
       return NULL;
   }
 
-  i2c_dev = i2c_open(i2c_devname, PN532_I2C_ADDR);
+  i2c_dev = i2c_open_ext(context->i2c_backend, i2c_devname, PN532_I2C_ADDR);
 
   if (i2c_dev == INVALID_I2C_BUS || i2c_dev == INVALID_I2C_ADDRESS) {
+    free(options);
     return NULL;
   }
 
   pnd = nfc_device_new(context, connstring);
   if (!pnd) {
     perror("malloc");
+    free(options);
     i2c_close(i2c_dev);
     return NULL;
   }
@@ -316,15 +371,26 @@ pn532_i2c_open(const nfc_context *context, const nfc_connstring connstring)
   pnd->driver_data = malloc(sizeof(struct pn532_i2c_data));
   if (!pnd->driver_data) {
     perror("malloc");
+    free(options);
     i2c_close(i2c_dev);
     nfc_device_free(pnd);
     return NULL;
   }
   DRIVER_DATA(pnd)->dev = i2c_dev;
+  DRIVER_DATA(pnd)->transaction_stop.tv_sec = 0;
+  DRIVER_DATA(pnd)->transaction_stop.tv_nsec = 0;
+  DRIVER_DATA(pnd)->ready = ready_notifier_new(irq, PN532_I2C_POLL_MIN_INTERVAL, PN532_I2C_POLL_MAX_INTERVAL);
+  free(options);
+  if (!DRIVER_DATA(pnd)->ready) {
+    i2c_close(i2c_dev);
+    nfc_device_free(pnd);
+    return NULL;
+  }
 
   // Alloc and init chip's data
   if (pn53x_data_new(pnd, &pn532_i2c_io) == NULL) {
     perror("malloc");
+    ready_notifier_free(DRIVER_DATA(pnd)->ready);
     i2c_close(i2c_dev);
     nfc_device_free(pnd);
     return NULL;
@@ -339,8 +405,6 @@ pn532_i2c_open(const nfc_context *context, const nfc_connstring connstring)
   CHIP_DATA(pnd)->timer_correction = 48;
   pnd->driver = &pn532_i2c_driver;
 
-  DRIVER_DATA(pnd)->abort_flag = false;
-
   // Check communication using "Diagnose" command, with "Communication test" (0x00)
   if (pn53x_check_communication(pnd) < 0) {
     nfc_perror(pnd, "pn53x_check_communication");
@@ -372,7 +436,7 @@ pn532_i2c_wakeup(nfc_device *pnd)
  * @return NFC_SUCCESS if operation is successful, or error code.
  */
 static int
-pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+pn532_i2c_sendv(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
 {
   int res = 0;
   uint8_t retries;
@@ -406,13 +470,15 @@ pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
   size_t szFrame = 0;
 
   memcpy(abtFrame, pn53x_preamble_and_start, PN53X_PREAMBLE_AND_START_LEN);	// Every packet must start with the preamble and start bytes.
-  if ((res = pn53x_build_frame(abtFrame, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_iov(abtFrame, &szFrame, iov, iovcnt)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
 
   for (retries = PN532_SEND_RETRIES; retries > 0; retries--) {
-    res = pn532_i2c_write(DRIVER_DATA(pnd)->dev, abtFrame, szFrame);
+    if (retries < PN532_SEND_RETRIES)
+      NFC_STATS_ADD(pnd->stats.retries, 1);
+    res = pn532_i2c_write(pnd, abtFrame, szFrame);
     if (res >= 0)
       break;
 
@@ -446,6 +512,105 @@ pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
   return NFC_SUCCESS;
 }
 
+static int
+pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  const struct pn53x_iovec iov = { (uint8_t *) pbtData, szData };
+  return pn532_i2c_sendv(pnd, &iov, 1, timeout);
+}
+
+/*
+ * Bytes read after the status byte while waiting for a frame: enough for the
+ * header of a normal frame, and for a whole ACK frame.
+ */
+#define PN532_I2C_POLL_LEN PN53x_ACK_FRAME__LEN
+
+/**
+ * @brief Get the length of a frame from its first bytes
+ *
+ * @param pbtFrame first bytes of the frame
+ * @param szFrame number of bytes available
+ * @return length of the frame, more than \a szFrame when its header is not
+ * complete yet, or \a szFrame when it is not a valid frame header
+ */
+static size_t
+pn532_i2c_frame_len(const uint8_t *pbtFrame, const size_t szFrame)
+{
+  if ((szFrame < 5) || memcmp(pbtFrame, pn53x_preamble_and_start, PN53X_PREAMBLE_AND_START_LEN))
+    return szFrame;
+  if ((0x00 == pbtFrame[3]) && (0xff == pbtFrame[4]))
+    return PN53x_ACK_FRAME__LEN;
+  if ((0xff == pbtFrame[3]) && (0xff == pbtFrame[4])) {
+    // Extended frame: 00 00 ff ff ff LENm LENl LCS TFI PD0..PDn DCS 00
+    if (szFrame < 8)
+      return 8;
+    return 8 + ((pbtFrame[5] << 8) + pbtFrame[6]) + 2;
+  }
+  if ((uint8_t)(pbtFrame[3] + pbtFrame[4]))
+    return szFrame;
+  // Normal frame: 00 00 ff LEN LCS TFI PD0..PDn DCS 00
+  return 5 + pbtFrame[3] + 2;
+}
+
+/*
+ * State of a wait for a READY frame, see pn532_i2c_read_rdyframe().
+ */
+struct pn532_i2c_rdyframe {
+  nfc_device *pnd;
+  uint8_t *pbtData;
+  size_t  szDataLen;
+  /** Bytes of the frame to read after the status byte */
+  size_t  szRead;
+  /** Ask the chip to send the frame again before reading it */
+  bool    bResend;
+  /** Length of the frame read once ready */
+  int     res;
+};
+
+/*
+ * Read the status byte and the beginning of the frame, and the whole frame
+ * once its length is known.
+ *
+ * Each read starts with the status byte, and the PN532 considers a frame
+ * sent once read with RDY set, whatever its length: polling reads the
+ * header only, then a NACK frame asks for the frame again, which is read
+ * with its exact length in the same combined transfer.
+ */
+static int
+pn532_i2c_read_rdyframe(void *data)
+{
+  struct pn532_i2c_rdyframe *rf = data;
+
+  // Actual I2C response frame includes an additional status byte,
+  // so we use a temporary buffer to read the I2C frame
+  uint8_t i2cRx[PN532_BUFFER_LEN + 1];
+
+  for (;;) {
+    ssize_t recCount;
+    if (rf->bResend) {
+      rf->bResend = false;
+      recCount = pn532_i2c_write_read(rf->pnd, pn53x_nack_frame, sizeof(pn53x_nack_frame), i2cRx, rf->szRead + 1);
+    } else {
+      recCount = pn532_i2c_read(rf->pnd, i2cRx, rf->szRead + 1);
+    }
+    if (recCount <= 0)
+      return NFC_EIO;
+
+    const uint8_t rdy = i2cRx[0];
+    if (!(rdy & 1))
+      return 0;
+
+    const size_t szFrame = MIN(pn532_i2c_frame_len(&i2cRx[1], rf->szRead), rf->szDataLen);
+    if (szFrame <= rf->szRead) {
+      rf->res = rf->szRead;
+      memcpy(rf->pbtData, &(i2cRx[1]), rf->szRead);
+      return 1;
+    }
+    rf->szRead = szFrame;
+    rf->bResend = true;
+  }
+}
+
 /**
  * @brief Read data from the PN532 device until getting a frame with RDY bit set
  *
@@ -459,66 +624,17 @@ pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
 static int
 pn532_i2c_wait_rdyframe(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
 {
-  bool done = false;
-  int res;
-
-  struct timeval start_tv, cur_tv;
-  long long duration;
-
-  // Actual I2C response frame includes an additional status byte,
-  // so we use a temporary buffer to read the I2C frame
-  uint8_t i2cRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN + 1];
-
-  if (timeout > 0) {
-    // If a timeout is specified, get current timestamp
-    gettimeofday(&start_tv, NULL);
+  struct pn532_i2c_rdyframe rf = { pnd, pbtData, szDataLen, MIN(szDataLen, PN532_I2C_POLL_LEN), false, 0 };
+
+  int res = ready_notifier_wait(DRIVER_DATA(pnd)->ready, pn532_i2c_read_rdyframe, &rf, timeout);
+  if (res == NFC_EOPABORTED) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG,
+            "Wait for a READY frame has been aborted.");
+  } else if (res == NFC_ETIMEOUT) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG,
+            "timeout reached with no READY frame.");
   }
-
-  do {
-    int recCount = pn532_i2c_read(DRIVER_DATA(pnd)->dev, i2cRx, szDataLen + 1);
-
-    if (DRIVER_DATA(pnd)->abort_flag) {
-      // Reset abort flag
-      DRIVER_DATA(pnd)->abort_flag = false;
-
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG,
-              "Wait for a READY frame has been aborted.");
-      return NFC_EOPABORTED;
-    }
-
-    if (recCount <= 0) {
-      done = true;
-      res = NFC_EIO;
-    } else {
-      const uint8_t rdy = i2cRx[0];
-      if (rdy & 1) {
-        int copyLength;
-
-        done = true;
-        res = recCount - 1;
-        copyLength = MIN(res, (int)szDataLen);
-        memcpy(pbtData, &(i2cRx[1]), copyLength);
-      } else {
-        /* Not ready yet. Check for elapsed timeout. */
-
-        if (timeout > 0) {
-          gettimeofday(&cur_tv, NULL);
-          duration = (cur_tv.tv_sec - start_tv.tv_sec) * 1000000L
-                     + (cur_tv.tv_usec - start_tv.tv_usec);
-
-          if (duration / 1000 > timeout) {
-            res = NFC_ETIMEOUT;
-            done = true;
-
-            log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG,
-                    "timeout reached with no READY frame.");
-          }
-        }
-      }
-    }
-  } while (!done);
-
-  return res;
+  return (res < 0) ? res : rf.res;
 }
 
 /**
@@ -532,8 +648,9 @@ pn532_i2c_wait_rdyframe(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLe
  *         NFC_EOPABORTED if operation has been aborted, NFC_EIO in case of IO failure
  */
 static int
-pn532_i2c_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+pn532_i2c_receivev(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
 {
+  const size_t szDataLen = pn53x_iov_size(iov, iovcnt);
   uint8_t frameBuf[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
   int frameLength;
   int TFI_idx;
@@ -625,7 +742,7 @@ pn532_i2c_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int
     goto error;
   }
 
-  memcpy(pbtData, &frameBuf[TFI_idx + 2], len - 2);
+  pn53x_iov_copy_to(iov, iovcnt, 0, &frameBuf[TFI_idx + 2], len - 2);
 
   /* The PN53x command is done and we successfully received the reply */
   return len - 2;
@@ -633,6 +750,13 @@ error:
   return pnd->last_error;
 }
 
+static int
+pn532_i2c_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  const struct pn53x_iovec iov = { pbtData, szDataLen };
+  return pn532_i2c_receivev(pnd, &iov, 1, timeout);
+}
+
 /**
  * @brief Send an ACK frame to the PN532 device.
  *
@@ -642,20 +766,20 @@ error:
 int
 pn532_i2c_ack(nfc_device *pnd)
 {
-  return pn532_i2c_write(DRIVER_DATA(pnd)->dev, pn53x_ack_frame, sizeof(pn53x_ack_frame));
+  return pn532_i2c_write(pnd, pn53x_ack_frame, sizeof(pn53x_ack_frame));
 }
 
 /**
  * @brief Abort any pending operation
  *
  * @param pnd pointer on the NFC device.
- * @return NFC_SUCCESS
+ * @return NFC_SUCCESS, otherwise NFC_ESOFT
  */
 static int
 pn532_i2c_abort_command(nfc_device *pnd)
 {
   if (pnd) {
-    DRIVER_DATA(pnd)->abort_flag = true;
+    return ready_notifier_abort(DRIVER_DATA(pnd)->ready);
   }
   return NFC_SUCCESS;
 }
@@ -663,6 +787,8 @@ pn532_i2c_abort_command(nfc_device *pnd)
 const struct pn53x_io pn532_i2c_io = {
   .send       = pn532_i2c_send,
   .receive    = pn532_i2c_receive,
+  .sendv      = pn532_i2c_sendv,
+  .receivev   = pn532_i2c_receivev,
 };
 
 const struct nfc_driver pn532_i2c_driver = {
@@ -684,6 +810,7 @@ const struct nfc_driver pn532_i2c_driver = {
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
   .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
 
   .target_init           = pn53x_target_init,
   .target_send_bytes     = pn53x_target_send_bytes,
@@ -693,6 +820,7 @@ const struct nfc_driver pn532_i2c_driver = {
 
   .device_set_property_bool     = pn53x_set_property_bool,
   .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
@@ -28,6 +28,12 @@
 /**
  * @file pn532_spi.c
  * @brief PN532 driver using SPI bus
+ *
+ * Connstring is pn532_spi:port[:options], where options is a comma separated
+ * list of:
+ *  - N: SPI clock speed in Hz (default: 1 MHz)
+ *  - irq=chip/line: GPIO line wired to the PN532 IRQ pin, e.g. gpiochip0/25,
+ *    waited for instead of polling the chip status
  */
 
 #ifdef HAVE_CONFIG_H
@@ -46,10 +52,14 @@
 #include "chips/pn53x.h"
 #include "chips/pn53x-internal.h"
 #include "spi.h"
+#include "ready.h"
 
 #define PN532_SPI_DEFAULT_SPEED 1000000 // 1 MHz
 #define PN532_SPI_DRIVER_NAME "pn532_spi"
 #define PN532_SPI_MODE SPI_MODE_0
+// Bounds of the interval between status reads without IRQ line, in ms
+#define PN532_SPI_POLL_MIN_INTERVAL 1
+#define PN532_SPI_POLL_MAX_INTERVAL 8
 
 #define LOG_CATEGORY "libnfc.driver.pn532_spi"
 #define LOG_GROUP    NFC_LOG_GROUP_DRIVER
@@ -74,7 +84,7 @@
 const struct pn53x_io pn532_spi_io;
 struct pn532_spi_data {
   spi_port port;
-  volatile bool abort_flag;
+  struct ready_notifier *ready;
 };
 
 static const uint8_t pn532_spi_cmd_dataread = 0x03;
@@ -87,89 +97,77 @@ int     pn532_spi_wakeup(nfc_device *pnd);
 
 #define DRIVER_DATA(pnd) ((struct pn532_spi_data*)(pnd->driver_data))
 
-static size_t
-pn532_spi_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+static bool
+pn532_spi_probe(const nfc_context *context, const char *acPort, nfc_connstring connstring)
 {
-  size_t device_found = 0;
   spi_port sp;
-  char **acPorts = spi_list_ports();
-  const char *acPort;
-  int     iDevice = 0;
 
-  while ((acPort = acPorts[iDevice++])) {
-    sp = spi_open(acPort);
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find PN532 device on SPI port: %s at %d Hz.", acPort, PN532_SPI_DEFAULT_SPEED);
-
-    if ((sp != INVALID_SPI_PORT) && (sp != CLAIMED_SPI_PORT)) {
-      // Serial port claimed but we need to check if a PN532_SPI is opened.
-      spi_set_speed(sp, PN532_SPI_DEFAULT_SPEED);
-      spi_set_mode(sp, PN532_SPI_MODE);
-
-      nfc_connstring connstring;
-      snprintf(connstring, sizeof(nfc_connstring), "%s:%s:%"PRIu32, PN532_SPI_DRIVER_NAME, acPort, PN532_SPI_DEFAULT_SPEED);
-      nfc_device *pnd = nfc_device_new(context, connstring);
-      if (!pnd) {
-        perror("malloc");
-        spi_close(sp);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      pnd->driver = &pn532_spi_driver;
-      pnd->driver_data = malloc(sizeof(struct pn532_spi_data));
-      if (!pnd->driver_data) {
-        perror("malloc");
-        spi_close(sp);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      DRIVER_DATA(pnd)->port = sp;
-
-      // Alloc and init chip's data
-      if (pn53x_data_new(pnd, &pn532_spi_io) == NULL) {
-        perror("malloc");
-        spi_close(DRIVER_DATA(pnd)->port);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      // SAMConfiguration command if needed to wakeup the chip and pn53x_SAMConfiguration check if the chip is a PN532
-      CHIP_DATA(pnd)->type = PN532;
-      // This device starts in LowVBat power mode
-      CHIP_DATA(pnd)->power_mode = LOWVBAT;
+  sp = spi_open(acPort);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find PN532 device on SPI port: %s at %d Hz.", acPort, PN532_SPI_DEFAULT_SPEED);
 
-      DRIVER_DATA(pnd)->abort_flag = false;
+  if ((sp != INVALID_SPI_PORT) && (sp != CLAIMED_SPI_PORT)) {
+    // Serial port claimed but we need to check if a PN532_SPI is opened.
+    spi_set_speed(sp, PN532_SPI_DEFAULT_SPEED);
+    spi_set_mode(sp, PN532_SPI_MODE);
 
-      // Check communication using "Diagnose" command, with "Communication test" (0x00)
-      int res = pn53x_check_communication(pnd);
-      spi_close(DRIVER_DATA(pnd)->port);
-      pn53x_data_free(pnd);
+    snprintf(connstring, sizeof(nfc_connstring), "%s:%s:%"PRIu32, PN532_SPI_DRIVER_NAME, acPort, PN532_SPI_DEFAULT_SPEED);
+    nfc_device *pnd = nfc_device_new(context, connstring);
+    if (!pnd) {
+      perror("malloc");
+      spi_close(sp);
+      return false;
+    }
+    pnd->driver = &pn532_spi_driver;
+    pnd->driver_data = malloc(sizeof(struct pn532_spi_data));
+    if (!pnd->driver_data) {
+      perror("malloc");
+      spi_close(sp);
       nfc_device_free(pnd);
-      if (res < 0) {
-        continue;
-      }
+      return false;
+    }
+    DRIVER_DATA(pnd)->port = sp;
 
-      memcpy(connstrings[device_found], connstring, sizeof(nfc_connstring));
-      device_found++;
+    // Alloc and init chip's data
+    if (pn53x_data_new(pnd, &pn532_spi_io) == NULL) {
+      perror("malloc");
+      spi_close(DRIVER_DATA(pnd)->port);
+      nfc_device_free(pnd);
+      return false;
+    }
+    // SAMConfiguration command if needed to wakeup the chip and pn53x_SAMConfiguration check if the chip is a PN532
+    CHIP_DATA(pnd)->type = PN532;
+    // This device starts in LowVBat power mode
+    CHIP_DATA(pnd)->power_mode = LOWVBAT;
 
-      // Test if we reach the maximum "wanted" devices
-      if (device_found >= connstrings_len)
-        break;
+    DRIVER_DATA(pnd)->ready = ready_notifier_new_poller(PN532_SPI_POLL_MIN_INTERVAL, PN532_SPI_POLL_MAX_INTERVAL);
+    if (!DRIVER_DATA(pnd)->ready) {
+      spi_close(DRIVER_DATA(pnd)->port);
+      pn53x_data_free(pnd);
+      nfc_device_free(pnd);
+      return false;
     }
+
+    // Check communication using "Diagnose" command, with "Communication test" (0x00)
+    int res = pn53x_check_communication(pnd);
+    ready_notifier_free(DRIVER_DATA(pnd)->ready);
+    spi_close(DRIVER_DATA(pnd)->port);
+    pn53x_data_free(pnd);
+    nfc_device_free(pnd);
+    return res >= 0;
   }
-  iDevice = 0;
+  return false;
+}
+
+static size_t
+pn532_spi_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  char **acPorts = spi_list_ports();
+  const char *acPort;
+  int     iDevice = 0;
+
+  // Ports are probed concurrently, found devices are kept in ports order
+  size_t device_found = nfc_scan_ports(context, acPorts, pn532_spi_probe, connstrings, connstrings_len);
+
   while ((acPort = acPorts[iDevice++])) {
     free((void *)acPort);
   }
@@ -180,8 +178,33 @@ pn532_spi_scan(const nfc_context *context, nfc_connstring connstrings[], const s
 struct pn532_spi_descriptor {
   char *port;
   uint32_t speed;
+  char *irq;
 };
 
+static int
+pn532_spi_parse_options(struct pn532_spi_descriptor *ndd, const char *pcOptions)
+{
+  char *pcList = strdup(pcOptions);
+  if (!pcList)
+    return NFC_ESOFT;
+
+  int res = NFC_SUCCESS;
+  for (char *pcOption = pcList, *pcNext; pcOption; pcOption = pcNext) {
+    if ((pcNext = strchr(pcOption, ',')))
+      *pcNext++ = '\0';
+    if (strncmp(pcOption, "irq=", 4) == 0) {
+      free(ndd->irq);
+      if (!(ndd->irq = strdup(pcOption + 4)))
+        res = NFC_ESOFT;
+    } else if (sscanf(pcOption, "%10"PRIu32, &ndd->speed) != 1) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unknown pn532_spi option: %s", pcOption);
+      res = NFC_EINVARG;
+    }
+  }
+  free(pcList);
+  return res;
+}
+
 static void
 pn532_spi_close(nfc_device *pnd)
 {
@@ -189,6 +212,7 @@ pn532_spi_close(nfc_device *pnd)
 
   // Release SPI port
   spi_close(DRIVER_DATA(pnd)->port);
+  ready_notifier_free(DRIVER_DATA(pnd)->ready);
 
   pn53x_data_free(pnd);
   nfc_device_free(pnd);
@@ -200,11 +224,12 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
   struct pn532_spi_descriptor ndd;
   char *speed_s;
   int connstring_decode_level = connstring_decode(connstring, PN532_SPI_DRIVER_NAME, NULL, &ndd.port, &speed_s);
+  ndd.speed = PN532_SPI_DEFAULT_SPEED;
+  ndd.irq = NULL;
   if (connstring_decode_level == 3) {
-    ndd.speed = 0;
-    if (sscanf(speed_s, "%10"PRIu32, &ndd.speed) != 1) {
-      // speed_s is not a number
+    if (pn532_spi_parse_options(&ndd, speed_s) < 0) {
       free(ndd.port);
+      free(ndd.irq);
       free(speed_s);
       return NULL;
     }
@@ -213,9 +238,6 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
   if (connstring_decode_level < 2) {
     return NULL;
   }
-  if (connstring_decode_level < 3) {
-    ndd.speed = PN532_SPI_DEFAULT_SPEED;
-  }
   spi_port sp;
   nfc_device *pnd = NULL;
 
@@ -228,6 +250,7 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "SPI port already claimed: %s", ndd.port);
   if ((sp == CLAIMED_SPI_PORT) || (sp == INVALID_SPI_PORT)) {
     free(ndd.port);
+    free(ndd.irq);
     return NULL;
   }
   spi_set_speed(sp, ndd.speed);
@@ -238,6 +261,7 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
   if (!pnd) {
     perror("malloc");
     free(ndd.port);
+    free(ndd.irq);
     spi_close(sp);
     return NULL;
   }
@@ -247,15 +271,24 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
   pnd->driver_data = malloc(sizeof(struct pn532_spi_data));
   if (!pnd->driver_data) {
     perror("malloc");
+    free(ndd.irq);
     spi_close(sp);
     nfc_device_free(pnd);
     return NULL;
   }
   DRIVER_DATA(pnd)->port = sp;
+  DRIVER_DATA(pnd)->ready = ready_notifier_new(ndd.irq, PN532_SPI_POLL_MIN_INTERVAL, PN532_SPI_POLL_MAX_INTERVAL);
+  free(ndd.irq);
+  if (!DRIVER_DATA(pnd)->ready) {
+    spi_close(sp);
+    nfc_device_free(pnd);
+    return NULL;
+  }
 
   // Alloc and init chip's data
   if (pn53x_data_new(pnd, &pn532_spi_io) == NULL) {
     perror("malloc");
+    ready_notifier_free(DRIVER_DATA(pnd)->ready);
     spi_close(DRIVER_DATA(pnd)->port);
     nfc_device_free(pnd);
     return NULL;
@@ -269,8 +302,6 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
   CHIP_DATA(pnd)->timer_correction = 48;
   pnd->driver = &pn532_spi_driver;
 
-  DRIVER_DATA(pnd)->abort_flag = false;
-
   // Check communication using "Diagnose" command, with "Communication test" (0x00)
   if (pn53x_check_communication(pnd) < 0) {
     nfc_perror(pnd, "pn53x_check_communication");
@@ -340,36 +371,18 @@ pn532_spi_wakeup(nfc_device *pnd)
 
 
 static int
-pn532_spi_wait_for_data(nfc_device *pnd, int timeout)
+pn532_spi_is_ready(void *data)
 {
   static const uint8_t pn532_spi_ready = 0x01;
-  static const int pn532_spi_poll_interval = 10; //ms
 
+  const int ret = pn532_spi_read_spi_status((nfc_device *) data);
+  return (ret < 0) ? ret : (ret == pn532_spi_ready);
+}
 
-  int timer = 0;
-
-  int ret;
-  while ((ret = pn532_spi_read_spi_status(pnd)) != pn532_spi_ready) {
-    if (ret < 0) {
-      return ret;
-    }
-
-    if (DRIVER_DATA(pnd)->abort_flag) {
-      DRIVER_DATA(pnd)->abort_flag = false;
-      return NFC_EOPABORTED;
-    }
-
-    if (timeout > 0) {
-      timer += pn532_spi_poll_interval;
-      if (timer > timeout) {
-        return NFC_ETIMEOUT;
-      }
-
-      msleep(pn532_spi_poll_interval);
-    }
-  }
-
-  return NFC_SUCCESS;
+static int
+pn532_spi_wait_for_data(nfc_device *pnd, int timeout)
+{
+  return ready_notifier_wait(DRIVER_DATA(pnd)->ready, pn532_spi_is_ready, pnd, timeout);
 }
 
 
@@ -417,8 +430,9 @@ pn532_spi_receive_next_chunk(nfc_device *pnd, uint8_t *pbtData, const size_t szD
 }
 
 static int
-pn532_spi_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+pn532_spi_receivev(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
 {
+  const size_t szDataLen = pn53x_iov_size(iov, iovcnt);
   uint8_t  abtRxBuf[5];
   size_t len;
 
@@ -526,13 +540,18 @@ pn532_spi_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int
     goto error;
   }
 
-  if (len) {
-    pnd->last_error = pn532_spi_receive_next_chunk(pnd, pbtData, len);
+  // Data goes straight to the caller's fragments, one chunk each
+  for (size_t i = 0, szLeft = len; (i < iovcnt) && szLeft; i++) {
+    const size_t sz = MIN(iov[i].sz, szLeft);
+    if (!sz)
+      continue;
+    pnd->last_error = pn532_spi_receive_next_chunk(pnd, iov[i].pbt, sz);
 
     if (pnd->last_error != 0) {
       log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to receive data. (RX)");
       goto error;
     }
+    szLeft -= sz;
   }
 
   pnd->last_error = pn532_spi_receive_next_chunk(pnd, abtRxBuf, 2);
@@ -544,9 +563,7 @@ pn532_spi_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int
 
   uint8_t btDCS = (256 - 0xD5);
   btDCS -= CHIP_DATA(pnd)->last_command + 1;
-  for (size_t szPos = 0; szPos < len; szPos++) {
-    btDCS -= pbtData[szPos];
-  }
+  btDCS = pn53x_iov_checksum(iov, iovcnt, len, btDCS);
 
   if (btDCS != abtRxBuf[0]) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Data checksum mismatch");
@@ -566,7 +583,14 @@ error:
 }
 
 static int
-pn532_spi_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+pn532_spi_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  const struct pn53x_iovec iov = { pbtData, szDataLen };
+  return pn532_spi_receivev(pnd, &iov, 1, timeout);
+}
+
+static int
+pn532_spi_sendv(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
 {
   int res = 0;
 
@@ -596,7 +620,7 @@ pn532_spi_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
   uint8_t  abtFrame[PN532_BUFFER_LEN + 1] = { pn532_spi_cmd_datawrite, 0x00, 0x00, 0xff };       // SPI data transfer starts with DATAWRITE (0x01) byte,  Every packet must start with "00 00 ff"
   size_t szFrame = 0;
 
-  if ((res = pn53x_build_frame(abtFrame + 1, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_iov(abtFrame + 1, &szFrame, iov, iovcnt)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
@@ -634,6 +658,13 @@ pn532_spi_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
   return NFC_SUCCESS;
 }
 
+static int
+pn532_spi_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  const struct pn53x_iovec iov = { (uint8_t *) pbtData, szData };
+  return pn532_spi_sendv(pnd, &iov, 1, timeout);
+}
+
 
 int
 pn532_spi_ack(nfc_device *pnd)
@@ -653,7 +684,7 @@ static int
 pn532_spi_abort_command(nfc_device *pnd)
 {
   if (pnd) {
-    DRIVER_DATA(pnd)->abort_flag = true;
+    return ready_notifier_abort(DRIVER_DATA(pnd)->ready);
   }
 
   return NFC_SUCCESS;
@@ -662,6 +693,8 @@ pn532_spi_abort_command(nfc_device *pnd)
 const struct pn53x_io pn532_spi_io = {
   .send       = pn532_spi_send,
   .receive    = pn532_spi_receive,
+  .sendv      = pn532_spi_sendv,
+  .receivev   = pn532_spi_receivev,
 };
 
 const struct nfc_driver pn532_spi_driver = {
@@ -683,6 +716,7 @@ const struct nfc_driver pn532_spi_driver = {
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
   .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
 
   .target_init           = pn53x_target_init,
   .target_send_bytes     = pn53x_target_send_bytes,
@@ -692,6 +726,7 @@ const struct nfc_driver pn532_spi_driver = {
 
   .device_set_property_bool     = pn53x_set_property_bool,
   .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
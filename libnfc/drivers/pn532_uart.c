@@ -50,6 +50,9 @@
 
 #define PN532_UART_DEFAULT_SPEED 115200
 #define PN532_UART_DRIVER_NAME "pn532_uart"
+#define PN532_UART_LOW_LATENCY "low_latency"
+// Timeout of the commands exchanged while the link speed is being changed
+#define PN532_UART_PING_TIMEOUT 100
 
 #define LOG_CATEGORY "libnfc.driver.pn532_uart"
 #define LOG_GROUP    NFC_LOG_GROUP_DRIVER
@@ -63,6 +66,22 @@ struct pn532_uart_data {
 #else
   volatile bool abort_flag;
 #endif
+  // Current link speed, and the one the chip was found at
+  uint32_t speed;
+  uint32_t open_speed;
+  // The chip answered when opening: there is something to restore on close
+  bool    bFound;
+};
+
+// Link speeds to try when negotiating, fastest first, with their SetSerialBaudRate code
+static const struct {
+  uint32_t speed;
+  uint8_t  btBR;
+} pn532_uart_speeds[] = {
+  { 921600, 0x07 },
+  { 460800, 0x06 },
+  { 230400, 0x05 },
+  { 115200, 0x04 },
 };
 
 // Prototypes
@@ -71,105 +90,81 @@ int     pn532_uart_wakeup(nfc_device *pnd);
 
 #define DRIVER_DATA(pnd) ((struct pn532_uart_data*)(pnd->driver_data))
 
-static size_t
-pn532_uart_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+static bool
+pn532_uart_probe(const nfc_context *context, const char *acPort, nfc_connstring connstring)
 {
-  size_t device_found = 0;
   serial_port sp;
-  char **acPorts = uart_list_ports();
-  const char *acPort;
-  int     iDevice = 0;
 
-  while ((acPort = acPorts[iDevice++])) {
-    sp = uart_open(acPort);
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find PN532 device on serial port: %s at %d baud.", acPort, PN532_UART_DEFAULT_SPEED);
-
-    if ((sp != INVALID_SERIAL_PORT) && (sp != CLAIMED_SERIAL_PORT)) {
-      // We need to flush input to be sure first reply does not comes from older byte transceive
-      uart_flush_input(sp, true);
-      // Serial port claimed but we need to check if a PN532_UART is opened.
-      uart_set_speed(sp, PN532_UART_DEFAULT_SPEED);
-
-      nfc_connstring connstring;
-      snprintf(connstring, sizeof(nfc_connstring), "%s:%s:%"PRIu32, PN532_UART_DRIVER_NAME, acPort, PN532_UART_DEFAULT_SPEED);
-      nfc_device *pnd = nfc_device_new(context, connstring);
-      if (!pnd) {
-        perror("malloc");
-        uart_close(sp);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      pnd->driver = &pn532_uart_driver;
-      pnd->driver_data = malloc(sizeof(struct pn532_uart_data));
-      if (!pnd->driver_data) {
-        perror("malloc");
-        uart_close(sp);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      DRIVER_DATA(pnd)->port = sp;
-
-      // Alloc and init chip's data
-      if (pn53x_data_new(pnd, &pn532_uart_io) == NULL) {
-        perror("malloc");
-        uart_close(DRIVER_DATA(pnd)->port);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-      // SAMConfiguration command if needed to wakeup the chip and pn53x_SAMConfiguration check if the chip is a PN532
-      CHIP_DATA(pnd)->type = PN532;
-      // This device starts in LowVBat power mode
-      CHIP_DATA(pnd)->power_mode = LOWVBAT;
+  sp = uart_open(acPort);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Trying to find PN532 device on serial port: %s at %d baud.", acPort, PN532_UART_DEFAULT_SPEED);
+
+  if ((sp != INVALID_SERIAL_PORT) && (sp != CLAIMED_SERIAL_PORT)) {
+    // We need to flush input to be sure first reply does not comes from older byte transceive
+    uart_flush_input(sp, true);
+    // Serial port claimed but we need to check if a PN532_UART is opened.
+    uart_set_speed(sp, PN532_UART_DEFAULT_SPEED);
+
+    snprintf(connstring, sizeof(nfc_connstring), "%s:%s:%"PRIu32, PN532_UART_DRIVER_NAME, acPort, PN532_UART_DEFAULT_SPEED);
+    nfc_device *pnd = nfc_device_new(context, connstring);
+    if (!pnd) {
+      perror("malloc");
+      uart_close(sp);
+      return false;
+    }
+    pnd->driver = &pn532_uart_driver;
+    pnd->driver_data = malloc(sizeof(struct pn532_uart_data));
+    if (!pnd->driver_data) {
+      perror("malloc");
+      uart_close(sp);
+      nfc_device_free(pnd);
+      return false;
+    }
+    DRIVER_DATA(pnd)->port = sp;
 
-#ifndef WIN32
-      // pipe-based abort mechanism
-      if (pipe(DRIVER_DATA(pnd)->iAbortFds) < 0) {
-        uart_close(DRIVER_DATA(pnd)->port);
-        pn53x_data_free(pnd);
-        nfc_device_free(pnd);
-        iDevice = 0;
-        while ((acPort = acPorts[iDevice++])) {
-          free((void *)acPort);
-        }
-        free(acPorts);
-        return 0;
-      }
-#else
-      DRIVER_DATA(pnd)->abort_flag = false;
-#endif
+    // Alloc and init chip's data
+    if (pn53x_data_new(pnd, &pn532_uart_io) == NULL) {
+      perror("malloc");
+      uart_close(DRIVER_DATA(pnd)->port);
+      nfc_device_free(pnd);
+      return false;
+    }
+    // SAMConfiguration command if needed to wakeup the chip and pn53x_SAMConfiguration check if the chip is a PN532
+    CHIP_DATA(pnd)->type = PN532;
+    // This device starts in LowVBat power mode
+    CHIP_DATA(pnd)->power_mode = LOWVBAT;
 
-      // Check communication using "Diagnose" command, with "Communication test" (0x00)
-      int res = pn53x_check_communication(pnd);
+#ifndef WIN32
+    // pipe-based abort mechanism
+    if (pipe(DRIVER_DATA(pnd)->iAbortFds) < 0) {
       uart_close(DRIVER_DATA(pnd)->port);
       pn53x_data_free(pnd);
       nfc_device_free(pnd);
-      if (res < 0) {
-        continue;
-      }
-
-      memcpy(connstrings[device_found], connstring, sizeof(nfc_connstring));
-      device_found++;
-
-      // Test if we reach the maximum "wanted" devices
-      if (device_found >= connstrings_len)
-        break;
+      return false;
     }
+#else
+    DRIVER_DATA(pnd)->abort_flag = false;
+#endif
+
+    // Check communication using "Diagnose" command, with "Communication test" (0x00)
+    int res = pn53x_check_communication(pnd);
+    uart_close(DRIVER_DATA(pnd)->port);
+    pn53x_data_free(pnd);
+    nfc_device_free(pnd);
+    return res >= 0;
   }
-  iDevice = 0;
+  return false;
+}
+
+static size_t
+pn532_uart_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  char **acPorts = uart_list_ports();
+  const char *acPort;
+  int     iDevice = 0;
+
+  // Ports are probed concurrently, found devices are kept in ports order
+  size_t device_found = nfc_scan_ports(context, acPorts, pn532_uart_probe, connstrings, connstrings_len);
+
   while ((acPort = acPorts[iDevice++])) {
     free((void *)acPort);
   }
@@ -182,10 +177,152 @@ struct pn532_uart_descriptor {
   uint32_t speed;
 };
 
+/*
+ * Check the link with a GetFirmwareVersion command, which only a PN532 that
+ * understood the whole frame answers with its IC code.
+ */
+static int
+pn532_uart_ping(nfc_device *pnd)
+{
+  const uint8_t abtCmd[] = { GetFirmwareVersion };
+  uint8_t abtFw[4];
+  int res;
+  if ((res = pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), abtFw, sizeof(abtFw), PN532_UART_PING_TIMEOUT)) < 0) {
+    return res;
+  }
+  return ((res == sizeof(abtFw)) && (abtFw[0] == 0x32)) ? NFC_SUCCESS : NFC_EIO;
+}
+
+/*
+ * Switch both the PN532 and the host to \a uiSpeed. The chip changes its
+ * speed once it has received the ACK of SetSerialBaudRate, so the ACK is sent
+ * at the former speed and the host only follows after it.
+ */
+static int
+pn532_uart_set_baud_rate(nfc_device *pnd, const uint32_t uiSpeed)
+{
+  uint8_t abtCmd[] = { SetSerialBaudRate, 0x00 };
+  size_t n;
+  int res;
+
+  for (n = 0; n < sizeof(pn532_uart_speeds) / sizeof(pn532_uart_speeds[0]); n++) {
+    if (pn532_uart_speeds[n].speed == uiSpeed)
+      break;
+  }
+  if (n == sizeof(pn532_uart_speeds) / sizeof(pn532_uart_speeds[0])) {
+    return NFC_EINVARG;
+  }
+  abtCmd[1] = pn532_uart_speeds[n].btBR;
+
+  if ((res = pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), NULL, 0, PN532_UART_PING_TIMEOUT)) < 0) {
+    return res;
+  }
+  if ((res = uart_send(DRIVER_DATA(pnd)->port, pn53x_ack_frame, sizeof(pn53x_ack_frame), 0)) < 0) {
+    return res;
+  }
+  // uart_set_speed() lets the ACK drain before changing the line settings
+  if ((res = uart_set_speed(DRIVER_DATA(pnd)->port, uiSpeed)) < 0) {
+    return res;
+  }
+  DRIVER_DATA(pnd)->speed = uiSpeed;
+  // Give the HSU time to settle on its new speed
+  nfc_sleep_ms(1);
+  return NFC_SUCCESS;
+}
+
+/*
+ * Bring the link back to \a uiSpeed after switching to \a uiFailedSpeed did
+ * not give a working link. Either the chip missed the command and still runs
+ * at the former speed, or it switched and the line does not carry the new
+ * speed reliably: then it is asked back blindly at that speed.
+ */
+static int
+pn532_uart_recover_speed(nfc_device *pnd, const uint32_t uiSpeed, const uint32_t uiFailedSpeed)
+{
+  uart_set_speed(DRIVER_DATA(pnd)->port, uiSpeed);
+  DRIVER_DATA(pnd)->speed = uiSpeed;
+  if (pn532_uart_ping(pnd) == NFC_SUCCESS) {
+    return NFC_SUCCESS;
+  }
+  uart_set_speed(DRIVER_DATA(pnd)->port, uiFailedSpeed);
+  if (pn532_uart_set_baud_rate(pnd, uiSpeed) < 0) {
+    // The reply may have been lost while the command went through
+    uart_set_speed(DRIVER_DATA(pnd)->port, uiSpeed);
+    DRIVER_DATA(pnd)->speed = uiSpeed;
+  }
+  return pn532_uart_ping(pnd);
+}
+
+/*
+ * Move the link to the fastest speed both the host and the PN532 handle,
+ * keeping the current one when no faster speed passes the check.
+ */
+static int
+pn532_uart_negotiate_speed(nfc_device *pnd)
+{
+  const uint32_t uiSpeed = DRIVER_DATA(pnd)->speed;
+
+  for (size_t n = 0; n < sizeof(pn532_uart_speeds) / sizeof(pn532_uart_speeds[0]); n++) {
+    const uint32_t uiCandidate = pn532_uart_speeds[n].speed;
+    if (uiCandidate <= uiSpeed)
+      break;
+    // Skip the speeds this host cannot set before the chip is told about them
+    if (uart_set_speed(DRIVER_DATA(pnd)->port, uiCandidate) < 0) {
+      uart_set_speed(DRIVER_DATA(pnd)->port, uiSpeed);
+      continue;
+    }
+    uart_set_speed(DRIVER_DATA(pnd)->port, uiSpeed);
+
+    if ((pn532_uart_set_baud_rate(pnd, uiCandidate) == NFC_SUCCESS) && (pn532_uart_ping(pnd) == NFC_SUCCESS)) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Link speed set to %" PRIu32 " baud.", uiCandidate);
+      return NFC_SUCCESS;
+    }
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Link speed %" PRIu32 " baud is not usable.", uiCandidate);
+    int res;
+    if ((res = pn532_uart_recover_speed(pnd, uiSpeed, uiCandidate)) < 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to get back to %" PRIu32 " baud.", uiSpeed);
+      return res;
+    }
+  }
+  return NFC_SUCCESS;
+}
+
+/*
+ * Find the speed a PN532 that may have been left at a negotiated speed runs
+ * at, trying the default one first.
+ */
+static int
+pn532_uart_find_speed(nfc_device *pnd)
+{
+  if (pn53x_check_communication(pnd) >= 0) {
+    return NFC_SUCCESS;
+  }
+  for (size_t n = 0; n < sizeof(pn532_uart_speeds) / sizeof(pn532_uart_speeds[0]); n++) {
+    const uint32_t uiSpeed = pn532_uart_speeds[n].speed;
+    if ((uiSpeed == DRIVER_DATA(pnd)->speed) || (uart_set_speed(DRIVER_DATA(pnd)->port, uiSpeed) < 0))
+      continue;
+    DRIVER_DATA(pnd)->speed = uiSpeed;
+    uart_flush_input(DRIVER_DATA(pnd)->port, true);
+    // The failed attempt left the wake up sequence undone
+    CHIP_DATA(pnd)->power_mode = LOWVBAT;
+    if (pn53x_check_communication(pnd) >= 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "PN532 found at %" PRIu32 " baud.", uiSpeed);
+      return NFC_SUCCESS;
+    }
+  }
+  return NFC_EIO;
+}
+
 static void
 pn532_uart_close(nfc_device *pnd)
 {
-  pn53x_idle(pnd);
+  if (DRIVER_DATA(pnd)->bFound) {
+    // Leave the chip at the speed it was found at, for the next user of the port
+    if (DRIVER_DATA(pnd)->speed != DRIVER_DATA(pnd)->open_speed) {
+      pn532_uart_set_baud_rate(pnd, DRIVER_DATA(pnd)->open_speed);
+    }
+    pn53x_idle(pnd);
+  }
 
   // Release UART port
   uart_close(DRIVER_DATA(pnd)->port);
@@ -205,10 +342,24 @@ pn532_uart_open(const nfc_context *context, const nfc_connstring connstring)
 {
   struct pn532_uart_descriptor ndd;
   char *speed_s;
-  int connstring_decode_level = connstring_decode(connstring, PN532_UART_DRIVER_NAME, NULL, &ndd.port, &speed_s);
+  bool bAutoSpeed = false;
+  bool bLowLatency = false;
+  // An optional ":low_latency" ends the connstring, see uart_open_ext()
+  nfc_connstring ncs;
+  snprintf(ncs, sizeof(ncs), "%s", connstring);
+  char *pcOption = strrchr(ncs, ':');
+  if (pcOption && (strcmp(pcOption + 1, PN532_UART_LOW_LATENCY) == 0)) {
+    *pcOption = '\0';
+    bLowLatency = true;
+  }
+  int connstring_decode_level = connstring_decode(ncs, PN532_UART_DRIVER_NAME, NULL, &ndd.port, &speed_s);
   if (connstring_decode_level == 3) {
     ndd.speed = 0;
-    if (sscanf(speed_s, "%10"PRIu32, &ndd.speed) != 1) {
+    if (strcmp(speed_s, "auto") == 0) {
+      // Start at the default speed and negotiate the fastest one once the chip is found
+      bAutoSpeed = true;
+      ndd.speed = PN532_UART_DEFAULT_SPEED;
+    } else if (sscanf(speed_s, "%10"PRIu32, &ndd.speed) != 1) {
       // speed_s is not a number
       free(ndd.port);
       free(speed_s);
@@ -225,8 +376,8 @@ pn532_uart_open(const nfc_context *context, const nfc_connstring connstring)
   serial_port sp;
   nfc_device *pnd = NULL;
 
-  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Attempt to open: %s at %d baud.", ndd.port, ndd.speed);
-  sp = uart_open(ndd.port);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Attempt to open: %s at %d baud%s.", ndd.port, ndd.speed, bLowLatency ? " in low latency mode" : "");
+  sp = uart_open_ext(ndd.port, bLowLatency);
 
   if (sp == INVALID_SERIAL_PORT)
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Invalid serial port: %s", ndd.port);
@@ -259,6 +410,9 @@ pn532_uart_open(const nfc_context *context, const nfc_connstring connstring)
     return NULL;
   }
   DRIVER_DATA(pnd)->port = sp;
+  DRIVER_DATA(pnd)->speed = ndd.speed;
+  DRIVER_DATA(pnd)->open_speed = ndd.speed;
+  DRIVER_DATA(pnd)->bFound = false;
 
   // Alloc and init chip's data
   if (pn53x_data_new(pnd, &pn532_uart_io) == NULL) {
@@ -289,13 +443,22 @@ pn532_uart_open(const nfc_context *context, const nfc_connstring connstring)
 #endif
 
   // Check communication using "Diagnose" command, with "Communication test" (0x00)
-  if (pn53x_check_communication(pnd) < 0) {
+  if ((bAutoSpeed ? pn532_uart_find_speed(pnd) : pn53x_check_communication(pnd)) < 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "pn53x_check_communication error");
+    // No chip answered: the speed left by pn532_uart_find_speed() means nothing
+    DRIVER_DATA(pnd)->speed = DRIVER_DATA(pnd)->open_speed;
     pn532_uart_close(pnd);
     return NULL;
   }
+  DRIVER_DATA(pnd)->open_speed = DRIVER_DATA(pnd)->speed;
+  DRIVER_DATA(pnd)->bFound = true;
 
   pn53x_init(pnd);
+
+  if (bAutoSpeed && (pn532_uart_negotiate_speed(pnd) < 0)) {
+    pn532_uart_close(pnd);
+    return NULL;
+  }
   return pnd;
 }
 
@@ -311,7 +474,7 @@ pn532_uart_wakeup(nfc_device *pnd)
 
 #define PN532_BUFFER_LEN (PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD)
 static int
-pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+pn532_uart_sendv(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
 {
   int res = 0;
   // Before sending anything, we need to discard from any junk bytes
@@ -343,7 +506,7 @@ pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, in
   uint8_t  abtFrame[PN532_BUFFER_LEN] = { 0x00, 0x00, 0xff };       // Every packet must start with "00 00 ff"
   size_t szFrame = 0;
 
-  if ((res = pn53x_build_frame(abtFrame, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_iov(abtFrame, &szFrame, iov, iovcnt)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
@@ -356,7 +519,8 @@ pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, in
   }
 
   uint8_t abtRxBuf[PN53x_ACK_FRAME__LEN];
-  res = uart_receive(DRIVER_DATA(pnd)->port, abtRxBuf, sizeof(abtRxBuf), 0, timeout);
+  // The reply may follow right away: leave it to wake up pollers of the port
+  res = uart_receive_exact(DRIVER_DATA(pnd)->port, abtRxBuf, sizeof(abtRxBuf), 0, timeout);
   if (res != 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Unable to read ACK");
     pnd->last_error = res;
@@ -372,8 +536,16 @@ pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, in
 }
 
 static int
-pn532_uart_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  const struct pn53x_iovec iov = { (uint8_t *) pbtData, szData };
+  return pn532_uart_sendv(pnd, &iov, 1, timeout);
+}
+
+static int
+pn532_uart_receivev(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
 {
+  const size_t szDataLen = pn53x_iov_size(iov, iovcnt);
   uint8_t  abtRxBuf[5];
   size_t len;
   void *abort_p = NULL;
@@ -460,12 +632,17 @@ pn532_uart_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, in
     goto error;
   }
 
-  if (len) {
-    pnd->last_error = uart_receive(DRIVER_DATA(pnd)->port, pbtData, len, 0, timeout);
+  // Data goes straight to the caller's fragments
+  for (size_t i = 0, szLeft = len; (i < iovcnt) && szLeft; i++) {
+    const size_t sz = MIN(iov[i].sz, szLeft);
+    if (!sz)
+      continue;
+    pnd->last_error = uart_receive(DRIVER_DATA(pnd)->port, iov[i].pbt, sz, 0, timeout);
     if (pnd->last_error != 0) {
       log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to receive data. (RX)");
       goto error;
     }
+    szLeft -= sz;
   }
 
   pnd->last_error = uart_receive(DRIVER_DATA(pnd)->port, abtRxBuf, 2, 0, timeout);
@@ -476,9 +653,7 @@ pn532_uart_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, in
 
   uint8_t btDCS = (256 - 0xD5);
   btDCS -= CHIP_DATA(pnd)->last_command + 1;
-  for (size_t szPos = 0; szPos < len; szPos++) {
-    btDCS -= pbtData[szPos];
-  }
+  btDCS = pn53x_iov_checksum(iov, iovcnt, len, btDCS);
 
   if (btDCS != abtRxBuf[0]) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Data checksum mismatch");
@@ -498,6 +673,13 @@ error:
   return pnd->last_error;
 }
 
+static int
+pn532_uart_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  const struct pn53x_iovec iov = { pbtData, szDataLen };
+  return pn532_uart_receivev(pnd, &iov, 1, timeout);
+}
+
 int
 pn532_uart_ack(nfc_device *pnd)
 {
@@ -526,9 +708,35 @@ pn532_uart_abort_command(nfc_device *pnd)
   return NFC_SUCCESS;
 }
 
+#ifndef WIN32
+static int
+pn532_uart_get_pollfd(nfc_device *pnd)
+{
+  return uart_get_fd(DRIVER_DATA(pnd)->port);
+}
+#endif
+
+static int
+pn532_uart_cancel(nfc_device *pnd)
+{
+  int res;
+  // An ACK frame makes the PN532 drop the running command
+  if ((res = pn532_uart_ack(pnd)) < 0)
+    return res;
+  // Then drop a reply sent before the ACK was seen
+  uart_flush_input(DRIVER_DATA(pnd)->port, true);
+  return NFC_SUCCESS;
+}
+
 const struct pn53x_io pn532_uart_io = {
   .send       = pn532_uart_send,
   .receive    = pn532_uart_receive,
+#ifndef WIN32
+  .get_pollfd = pn532_uart_get_pollfd,
+#endif
+  .cancel     = pn532_uart_cancel,
+  .sendv      = pn532_uart_sendv,
+  .receivev   = pn532_uart_receivev,
 };
 
 const struct nfc_driver pn532_uart_driver = {
@@ -550,6 +758,10 @@ const struct nfc_driver pn532_uart_driver = {
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
   .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
+  .initiator_transceive_bytes_submit   = pn53x_initiator_transceive_bytes_submit,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
+  .initiator_transceive_bytes_cancel   = pn53x_initiator_transceive_bytes_cancel,
 
   .target_init           = pn53x_target_init,
   .target_send_bytes     = pn53x_target_send_bytes,
@@ -559,9 +771,11 @@ const struct nfc_driver pn532_uart_driver = {
 
   .device_set_property_bool     = pn53x_set_property_bool,
   .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = pn532_uart_abort_command,
   .idle           = pn53x_idle,
@@ -294,6 +294,7 @@ pn53x_usb_scan(const nfc_context *context, nfc_connstring connstrings[], const s
 {
   (void)context;
 
+  usb_bus_lock();
   usb_prepare();
 
   size_t device_found = 0;
@@ -346,6 +347,7 @@ pn53x_usb_scan(const nfc_context *context, nfc_connstring connstrings[], const s
           device_found++;
           // Test if we reach the maximum "wanted" devices
           if (device_found == connstrings_len) {
+            usb_bus_unlock();
             return device_found;
           }
         }
@@ -353,6 +355,7 @@ pn53x_usb_scan(const nfc_context *context, nfc_connstring connstrings[], const s
     }
   }
 
+  usb_bus_unlock();
   return device_found;
 }
 
@@ -409,6 +412,8 @@ pn53x_usb_open(const nfc_context *context, const nfc_connstring connstring)
   struct usb_bus *bus;
   struct usb_device *dev;
 
+  // Held until the device is opened, other threads may rebuild the bus list
+  usb_bus_lock();
   usb_prepare();
 
   for (bus = usb_get_busses(); bus; bus = bus->next) {
@@ -522,6 +527,9 @@ error:
   nfc_device_free(pnd);
   pnd = NULL;
 free_mem:
+  // The bus list is only locked once the connstring is decoded
+  if (connstring_decode_level >= 1)
+    usb_bus_unlock();
   free(desc.dirname);
   free(desc.filename);
   return pnd;
@@ -558,18 +566,18 @@ pn53x_usb_close(nfc_device *pnd)
 #define PN53X_USB_BUFFER_LEN (PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD)
 
 static int
-pn53x_usb_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, const int timeout)
+pn53x_usb_sendv(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, const int timeout)
 {
   uint8_t  abtFrame[PN53X_USB_BUFFER_LEN] = { 0x00, 0x00, 0xff };  // Every packet must start with "00 00 ff"
   size_t szFrame = 0;
   int res = 0;
 
-  if ((res = pn53x_build_frame(abtFrame, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_iov(abtFrame, &szFrame, iov, iovcnt)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
 
-  DRIVER_DATA(pnd)->possibly_corrupted_usbdesc |= szData > 17;
+  DRIVER_DATA(pnd)->possibly_corrupted_usbdesc |= pn53x_iov_size(iov, iovcnt) > 17;
   if ((res = pn53x_usb_bulk_write(DRIVER_DATA(pnd), abtFrame, szFrame, timeout)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
@@ -593,6 +601,7 @@ pn53x_usb_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, con
     // pn53x_usb_receive()) will be able to retrieve the correct response
     // packet.
     // FIXME Sony reader is also affected by this bug but NACK is not supported
+    NFC_STATS_ADD(pnd->stats.retries, 1);
     if ((res = pn53x_usb_bulk_write(DRIVER_DATA(pnd), (uint8_t *)pn53x_nack_frame, sizeof(pn53x_nack_frame), timeout)) < 0) {
       pnd->last_error = res;
       // try to interrupt current device state
@@ -603,10 +612,18 @@ pn53x_usb_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, con
   return NFC_SUCCESS;
 }
 
+static int
+pn53x_usb_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, const int timeout)
+{
+  const struct pn53x_iovec iov = { (uint8_t *) pbtData, szData };
+  return pn53x_usb_sendv(pnd, &iov, 1, timeout);
+}
+
 #define USB_TIMEOUT_PER_PASS 200
 static int
-pn53x_usb_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, const int timeout)
+pn53x_usb_receivev(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, const int timeout)
 {
+  const size_t szDataLen = pn53x_iov_size(iov, iovcnt);
   size_t len;
   off_t offset = 0;
 
@@ -714,14 +731,14 @@ read:
   }
   offset += 1;
 
-  memcpy(pbtData, abtRxBuf + offset, len);
-  offset += len;
+  pn53x_iov_copy_to(iov, iovcnt, 0, abtRxBuf + offset, len);
 
   uint8_t btDCS = (256 - 0xD5);
   btDCS -= CHIP_DATA(pnd)->last_command + 1;
   for (size_t szPos = 0; szPos < len; szPos++) {
-    btDCS -= pbtData[szPos];
+    btDCS -= abtRxBuf[offset + szPos];
   }
+  offset += len;
 
   if (btDCS != abtRxBuf[offset]) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Data checksum mismatch");
@@ -741,6 +758,13 @@ read:
   return len;
 }
 
+static int
+pn53x_usb_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, const int timeout)
+{
+  const struct pn53x_iovec iov = { pbtData, szDataLen };
+  return pn53x_usb_receivev(pnd, &iov, 1, timeout);
+}
+
 int
 pn53x_usb_ack(nfc_device *pnd)
 {
@@ -868,6 +892,8 @@ pn53x_usb_get_supported_modulation(nfc_device *pnd, const nfc_mode mode, const n
 const struct pn53x_io pn53x_usb_io = {
   .send       = pn53x_usb_send,
   .receive    = pn53x_usb_receive,
+  .sendv      = pn53x_usb_sendv,
+  .receivev   = pn53x_usb_receivev,
 };
 
 const struct nfc_driver pn53x_usb_driver = {
@@ -889,6 +915,7 @@ const struct nfc_driver pn53x_usb_driver = {
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
   .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
 
   .target_init           = pn53x_target_init,
   .target_send_bytes     = pn53x_target_send_bytes,
@@ -898,6 +925,7 @@ const struct nfc_driver pn53x_usb_driver = {
 
   .device_set_property_bool     = pn53x_usb_set_property_bool,
   .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
   .get_supported_modulation     = pn53x_usb_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
@@ -0,0 +1,468 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+
+/**
+ * @file replay.c
+ * @brief Driver replaying the host link of a pcapng capture
+ *
+ * Connstring is replay:/path/to/capture.pcapng, or
+ * replay:/path/to/capture.pcapng:timed to wait before each reply for the delay
+ * it took in the capture (the default is full speed).
+ *
+ * The capture is one written by libnfc (capture_file option): the PN53x frames
+ * of the first LINKTYPE_USER0 interface are loaded at open, then each command
+ * sent is checked against the next recorded one and answered with the
+ * recorded reply, so a workload runs deterministically without a device.
+ * Commands the original driver issued on its own (e.g. SAMConfiguration to
+ * wake a PN532 up) show up as exchanges nested in another one, and are
+ * skipped. A recorded command without reply replays as a timeout.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include "replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "drivers.h"
+#include "nfc-internal.h"
+#include "pcapng.h"
+#include "chips/pn53x.h"
+#include "chips/pn53x-internal.h"
+
+#define REPLAY_DRIVER_NAME "replay"
+
+#define LOG_CATEGORY "libnfc.driver.replay"
+#define LOG_GROUP    NFC_LOG_GROUP_DRIVER
+
+struct replay_frame {
+  /** Capture timestamp, in microseconds */
+  uint64_t timestamp;
+  /** Reply from the chip, otherwise command from the host */
+  bool    bIncoming;
+  /** Command code, or command code + 1 for a reply */
+  uint8_t btCode;
+  /** Data following the command code */
+  const uint8_t *pbtData;
+  size_t  szData;
+};
+
+// Internal data structs
+const struct pn53x_io replay_io;
+struct replay_data {
+  /** Capture file contents, frames point into it */
+  uint8_t *pbtCapture;
+  struct replay_frame *frames;
+  size_t  szFrames;
+  /** Next frame to replay */
+  size_t  szCursor;
+  /** Command waiting for its reply */
+  size_t  szPending;
+  /** When the pending command was sent, in microseconds */
+  uint64_t send_us;
+  /** Reproduce the recorded reply delays */
+  bool    bTimed;
+};
+
+#define DRIVER_DATA(pnd) ((struct replay_data*)(pnd->driver_data))
+
+static uint32_t
+get32(const uint8_t *pbt)
+{
+  uint32_t v;
+  memcpy(&v, pbt, sizeof(v));
+  return v;
+}
+
+static uint16_t
+get16(const uint8_t *pbt)
+{
+  uint16_t v;
+  memcpy(&v, pbt, sizeof(v));
+  return v;
+}
+
+static uint8_t *
+replay_read_file(const char *pcPath, size_t *pszCapture)
+{
+  uint8_t *pbtCapture = NULL;
+  FILE *f = fopen(pcPath, "rb");
+  if (!f) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to open capture file %s", pcPath);
+    return NULL;
+  }
+  long lSize;
+  if ((fseek(f, 0, SEEK_END) == 0) && ((lSize = ftell(f)) > 0) && (fseek(f, 0, SEEK_SET) == 0)) {
+    if ((pbtCapture = malloc((size_t) lSize))) {
+      if (fread(pbtCapture, (size_t) lSize, 1, f) == 1) {
+        *pszCapture = (size_t) lSize;
+      } else {
+        free(pbtCapture);
+        pbtCapture = NULL;
+      }
+    }
+  }
+  if (!pbtCapture)
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to read capture file %s", pcPath);
+  fclose(f);
+  return pbtCapture;
+}
+
+/*
+ * Load the PN53x frames of the first host link interface of the capture.
+ */
+static int
+replay_load(struct replay_data *data, const char *pcPath)
+{
+  size_t szCapture = 0;
+  size_t szAllocated = 0;
+  int64_t iHostInterface = -1;
+  uint32_t uiInterfaces = 0;
+
+  if (!(data->pbtCapture = replay_read_file(pcPath, &szCapture)))
+    return NFC_EIO;
+
+  for (size_t szOffset = 0; szOffset + 12 <= szCapture;) {
+    const uint8_t *pbtBlock = data->pbtCapture + szOffset;
+    const uint32_t uiType = get32(pbtBlock);
+    const uint32_t uiLength = get32(pbtBlock + 4);
+    if ((uiLength < 12) || (uiLength % 4) || (uiLength > szCapture - szOffset) ||
+        ((szOffset == 0) && (uiType != PCAPNG_SHB))) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s is not a valid pcapng file (offset %" PRIuPTR ")", pcPath, szOffset);
+      return NFC_EIO;
+    }
+    switch (uiType) {
+      case PCAPNG_SHB:
+        if ((uiLength < 28) || (get32(pbtBlock + 8) != PCAPNG_BYTE_ORDER_MAGIC)) {
+          log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s: unsupported section byte order", pcPath);
+          return NFC_EIO;
+        }
+        // Only the first section is replayed
+        if (szOffset) {
+          szCapture = szOffset;
+          continue;
+        }
+        break;
+      case PCAPNG_IDB:
+        if ((uiLength >= 20) && (get16(pbtBlock + 8) == LINKTYPE_USER0) && (iHostInterface < 0))
+          iHostInterface = uiInterfaces;
+        uiInterfaces++;
+        break;
+      case PCAPNG_EPB: {
+        if (uiLength < 32)
+          break;
+        const uint32_t uiCaptured = get32(pbtBlock + 20);
+        if ((get32(pbtBlock + 8) != iHostInterface) || (uiCaptured < 2) || (uiCaptured > uiLength - 32))
+          break;
+        const uint8_t *pbtPacket = pbtBlock + 28;
+        if ((pbtPacket[0] != 0xD4) && (pbtPacket[0] != 0xD5))
+          break;
+        if (data->szFrames == szAllocated) {
+          szAllocated = szAllocated ? szAllocated * 2 : 256;
+          struct replay_frame *frames = realloc(data->frames, szAllocated * sizeof(struct replay_frame));
+          if (!frames)
+            return NFC_ESOFT;
+          data->frames = frames;
+        }
+        struct replay_frame *prf = &data->frames[data->szFrames++];
+        prf->timestamp = ((uint64_t) get32(pbtBlock + 12) << 32) | get32(pbtBlock + 16);
+        prf->bIncoming = (pbtPacket[0] == 0xD5);
+        prf->btCode = pbtPacket[1];
+        prf->pbtData = pbtPacket + 2;
+        prf->szData = uiCaptured - 2;
+      }
+      break;
+      default:
+        break;
+    }
+    szOffset += uiLength;
+  }
+
+  if (!data->szFrames) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s: no PN53x frame found", pcPath);
+    return NFC_EIO;
+  }
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%" PRIuPTR " frames loaded from %s", data->szFrames, pcPath);
+  return NFC_SUCCESS;
+}
+
+/*
+ * Whether frame szFrame is a command immediately followed by its reply.
+ */
+static bool
+replay_is_exchange(const struct replay_data *data, const size_t szFrame)
+{
+  return (szFrame + 1 < data->szFrames) &&
+         !data->frames[szFrame].bIncoming && data->frames[szFrame + 1].bIncoming &&
+         (data->frames[szFrame + 1].btCode == (uint8_t)(data->frames[szFrame].btCode + 1));
+}
+
+static void
+replay_free(struct replay_data *data)
+{
+  free(data->frames);
+  free(data->pbtCapture);
+  free(data);
+}
+
+static void
+replay_close(nfc_device *pnd)
+{
+  pn53x_idle(pnd);
+
+  replay_free(DRIVER_DATA(pnd));
+  pnd->driver_data = NULL;
+
+  pn53x_data_free(pnd);
+  nfc_device_free(pnd);
+}
+
+static nfc_device *
+replay_open(const nfc_context *context, const nfc_connstring connstring)
+{
+  char *pcPath;
+  char *pcMode;
+  int connstring_decode_level = connstring_decode(connstring, REPLAY_DRIVER_NAME, NULL, &pcPath, &pcMode);
+  if (connstring_decode_level < 2) {
+    return NULL;
+  }
+  bool bTimed = false;
+  if (connstring_decode_level == 3) {
+    bTimed = (strcmp(pcMode, "timed") == 0);
+    if (!bTimed && (strcmp(pcMode, "fast") != 0)) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unknown replay mode: %s", pcMode);
+      free(pcPath);
+      free(pcMode);
+      return NULL;
+    }
+    free(pcMode);
+  }
+
+  struct replay_data *data = calloc(1, sizeof(struct replay_data));
+  if (!data) {
+    perror("malloc");
+    free(pcPath);
+    return NULL;
+  }
+  data->bTimed = bTimed;
+  if (replay_load(data, pcPath) < 0) {
+    replay_free(data);
+    free(pcPath);
+    return NULL;
+  }
+
+  nfc_device *pnd = nfc_device_new(context, connstring);
+  if (!pnd) {
+    perror("malloc");
+    replay_free(data);
+    free(pcPath);
+    return NULL;
+  }
+  snprintf(pnd->name, sizeof(pnd->name), "%s:%s", REPLAY_DRIVER_NAME, pcPath);
+  free(pcPath);
+  pnd->driver_data = data;
+
+  // Alloc and init chip's data
+  if (pn53x_data_new(pnd, &replay_io) == NULL) {
+    perror("malloc");
+    replay_free(data);
+    nfc_device_free(pnd);
+    return NULL;
+  }
+  // Chip type is told by the recorded GetFirmwareVersion reply, the chip was
+  // woken up by the original driver
+  pnd->driver = &replay_driver;
+
+  // Replays the "Diagnose" command of the capture
+  if (pn53x_check_communication(pnd) < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "pn53x_check_communication error");
+    replay_close(pnd);
+    return NULL;
+  }
+
+  pn53x_init(pnd);
+  return pnd;
+}
+
+static int
+replay_sendv(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
+{
+  struct replay_data *data = DRIVER_DATA(pnd);
+  const uint8_t btCmd = iov[0].pbt[0];
+  (void) timeout;
+
+  // Skip replies nobody waited for and exchanges the original driver made on its own
+  size_t szFrame = data->szCursor;
+  while (szFrame < data->szFrames) {
+    if (data->frames[szFrame].bIncoming) {
+      szFrame++;
+    } else if ((data->frames[szFrame].btCode != btCmd) && replay_is_exchange(data, szFrame)) {
+      szFrame += 2;
+    } else {
+      break;
+    }
+  }
+  if (szFrame == data->szFrames) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Replay ended, command 0x%02x not recorded", btCmd);
+    return pnd->last_error = NFC_EIO;
+  }
+  const struct replay_frame *prf = &data->frames[szFrame];
+  if (prf->btCode != btCmd) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Replay diverged at frame %" PRIuPTR ": command 0x%02x sent, 0x%02x recorded", szFrame, btCmd, prf->btCode);
+    return pnd->last_error = NFC_EIO;
+  }
+
+  // Same command with other parameters: the reply is replayed anyway
+  bool bSame = (pn53x_iov_size(iov, iovcnt) == prf->szData + 1);
+  for (size_t i = 0, szOffset = 0; bSame && (i < iovcnt); i++) {
+    const size_t szSkip = (i == 0) ? 1 : 0;
+    if (iov[i].sz <= szSkip)
+      continue;
+    bSame = (memcmp(iov[i].pbt + szSkip, prf->pbtData + szOffset, iov[i].sz - szSkip) == 0);
+    szOffset += iov[i].sz - szSkip;
+  }
+  if (!bSame)
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "Frame %" PRIuPTR ": command 0x%02x data differs from the capture", szFrame, btCmd);
+
+  data->szPending = szFrame;
+  data->szCursor = szFrame + 1;
+  data->send_us = nfc_monotonic_us();
+  return NFC_SUCCESS;
+}
+
+static int
+replay_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  const struct pn53x_iovec iov = { (uint8_t *) pbtData, szData };
+  return replay_sendv(pnd, &iov, 1, timeout);
+}
+
+static int
+replay_receivev(nfc_device *pnd, const struct pn53x_iovec *iov, const size_t iovcnt, int timeout)
+{
+  struct replay_data *data = DRIVER_DATA(pnd);
+  const struct replay_frame *prfCommand = &data->frames[data->szPending];
+  const uint8_t btCode = prfCommand->btCode + 1;
+
+  // Skip exchanges the original driver nested in this one
+  size_t szFrame = data->szCursor;
+  while ((szFrame < data->szFrames) && (data->frames[szFrame].btCode != prfCommand->btCode) && replay_is_exchange(data, szFrame))
+    szFrame += 2;
+  if ((szFrame == data->szFrames) || !data->frames[szFrame].bIncoming || (data->frames[szFrame].btCode != btCode)) {
+    // No reply was recorded
+    if (data->bTimed && (timeout > 0))
+      nfc_sleep_ms(timeout);
+    return pnd->last_error = NFC_ETIMEOUT;
+  }
+
+  const struct replay_frame *prf = &data->frames[szFrame];
+  if (prf->szData > pn53x_iov_size(iov, iovcnt)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: buffer too small. (szDataLen: %" PRIuPTR ", len: %" PRIuPTR ")", pn53x_iov_size(iov, iovcnt), prf->szData);
+    return pnd->last_error = NFC_EIO;
+  }
+  if (data->bTimed && (prf->timestamp > prfCommand->timestamp)) {
+    const uint64_t reply_us = data->send_us + (prf->timestamp - prfCommand->timestamp);
+    const uint64_t now_us = nfc_monotonic_us();
+    if (reply_us > now_us)
+      nfc_sleep_us(reply_us - now_us);
+  }
+  pn53x_iov_copy_to(iov, iovcnt, 0, prf->pbtData, prf->szData);
+  data->szCursor = szFrame + 1;
+  return (int) prf->szData;
+}
+
+static int
+replay_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  const struct pn53x_iovec iov = { pbtData, szDataLen };
+  return replay_receivev(pnd, &iov, 1, timeout);
+}
+
+static int
+replay_abort_command(nfc_device *pnd)
+{
+  // Replies are never waited for, except for the recorded delay
+  (void) pnd;
+  return NFC_SUCCESS;
+}
+
+const struct pn53x_io replay_io = {
+  .send       = replay_send,
+  .receive    = replay_receive,
+  .sendv      = replay_sendv,
+  .receivev   = replay_receivev,
+};
+
+const struct nfc_driver replay_driver = {
+  .name                             = REPLAY_DRIVER_NAME,
+  .scan_type                        = NOT_AVAILABLE,
+  .scan                             = NULL,
+  .open                             = replay_open,
+  .close                            = replay_close,
+  .strerror                         = pn53x_strerror,
+
+  .initiator_init                   = pn53x_initiator_init,
+  .initiator_init_secure_element    = NULL, // No secure-element support
+  .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_poll_target            = pn53x_initiator_poll_target,
+  .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
+  .initiator_deselect_target        = pn53x_initiator_deselect_target,
+  .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
+  .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
+  .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
+  .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
+  .initiator_transceive_bytes_submit   = pn53x_initiator_transceive_bytes_submit,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
+  .initiator_transceive_bytes_cancel   = pn53x_initiator_transceive_bytes_cancel,
+
+  .target_init           = pn53x_target_init,
+  .target_send_bytes     = pn53x_target_send_bytes,
+  .target_receive_bytes  = pn53x_target_receive_bytes,
+  .target_send_bits      = pn53x_target_send_bits,
+  .target_receive_bits   = pn53x_target_receive_bits,
+
+  .device_set_property_bool     = pn53x_set_property_bool,
+  .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
+  .get_supported_modulation     = pn53x_get_supported_modulation,
+  .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
+  .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
+
+  .abort_command  = replay_abort_command,
+  .idle           = pn53x_idle,
+  .powerdown      = pn53x_PowerDown,
+};
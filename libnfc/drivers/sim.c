@@ -0,0 +1,1394 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+
+/**
+ * @file sim.c
+ * @brief Driver for an in-process simulated PN53x and its tags
+ *
+ * Connstring is sim[:tags[:options]], where tags is a comma separated list of
+ * tag models in the field, each optionally followed by =UID in hex:
+ *  - mfc1k, mfc4k: MIFARE Classic, keys are checked by the simulated chip
+ *  - ultralight, ntag213, ntag215, ntag216: MIFARE Ultralight and NTAG
+ *  - felica: FeliCa with 16 blocks readable and writable without encryption
+ *  - iso14443-4: ISO/IEC 14443-4 card holding an NFC Forum Type 4 NDEF file
+ * (default: a single mfc1k) and options is a comma separated list of:
+ *  - pn533: simulate a PN533 instead of a PN532
+ *  - latency=N: answer each command after N microseconds
+ *  - airtime: add the time frames take on the air at 106 kbps
+ *
+ * Commands are answered as soon as they are sent, from the same thread,
+ * without any I/O. As a target, the chip is activated at once by a simulated
+ * reader which sends a few commands then releases it.
+ *
+ * The chip handles MIFARE Classic authentication (crypto1) itself, so only
+ * InDataExchange is supported for MIFARE Classic data commands: keys are
+ * checked, traffic is not ciphered.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "drivers.h"
+#include "nfc-internal.h"
+#include "chips/pn53x.h"
+#include "chips/pn53x-internal.h"
+
+#define SIM_DRIVER_NAME "sim"
+#define SIM_DEFAULT_TAGS "mfc1k"
+#define SIM_MAX_TAGS 8
+
+#define LOG_CATEGORY "libnfc.driver.sim"
+#define LOG_GROUP    NFC_LOG_GROUP_DRIVER
+
+// PN53x status bytes
+#define SIM_STATUS_OK         0x00
+#define SIM_STATUS_TIMEOUT    0x01
+#define SIM_STATUS_MIFARE     0x14
+#define SIM_STATUS_RELEASED   0x29
+
+// Tag answers other than a frame
+#define SIM_NO_RESPONSE -1
+#define SIM_NAK         -2
+
+// 4-bit MIFARE acknowledge
+#define SIM_ACK 0x0A
+#define SIM_NAK_VALUE 0x04
+
+typedef enum {
+  SIM_MIFARE_CLASSIC,
+  SIM_ULTRALIGHT,
+  SIM_NTAG,
+  SIM_FELICA,
+  SIM_ISO14443_4,
+} sim_tag_family;
+
+struct sim_tag_model {
+  const char *name;
+  sim_tag_family family;
+  uint8_t abtAtqa[2];
+  uint8_t btSak;
+  size_t  szUid;
+  size_t  szMemory;
+  /** GET_VERSION answer, for NTAG */
+  uint8_t abtVersion[8];
+};
+
+static const struct sim_tag_model sim_tag_models[] = {
+  { "mfc1k",      SIM_MIFARE_CLASSIC, { 0x00, 0x04 }, 0x08, 4, 1024,    { 0 } },
+  { "mfc4k",      SIM_MIFARE_CLASSIC, { 0x00, 0x02 }, 0x18, 4, 4096,    { 0 } },
+  { "ultralight", SIM_ULTRALIGHT,     { 0x00, 0x44 }, 0x00, 7, 16 * 4,  { 0 } },
+  { "ntag213",    SIM_NTAG,           { 0x00, 0x44 }, 0x00, 7, 45 * 4,  { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x0F, 0x03 } },
+  { "ntag215",    SIM_NTAG,           { 0x00, 0x44 }, 0x00, 7, 135 * 4, { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x11, 0x03 } },
+  { "ntag216",    SIM_NTAG,           { 0x00, 0x44 }, 0x00, 7, 231 * 4, { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x13, 0x03 } },
+  { "felica",     SIM_FELICA,         { 0x00, 0x00 }, 0x00, 8, 16 * 16, { 0 } },
+  { "iso14443-4", SIM_ISO14443_4,     { 0x03, 0x44 }, 0x20, 7, 128,     { 0 } },
+};
+
+// DESFire EV1 like, TL included
+static const uint8_t sim_ats[] = { 0x06, 0x75, 0x77, 0x81, 0x02, 0x80 };
+// FeliCa manufacture parameter and system code (NFC Forum Type 3)
+static const uint8_t sim_felica_pmm[] = { 0x00, 0xf0, 0x00, 0x00, 0x02, 0x06, 0x03, 0x00 };
+static const uint8_t sim_felica_system_code[] = { 0x12, 0xfc };
+// NFC Forum Type 4 application and capability container (NDEF file E104, 128 bytes)
+static const uint8_t sim_ndef_aid[] = { 0xd2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01 };
+static const uint8_t sim_ndef_cc[] = { 0x00, 0x0f, 0x20, 0x00, 0x3b, 0x00, 0x34, 0x04, 0x06, 0xe1, 0x04, 0x00, 0x80, 0x00, 0x00 };
+
+typedef enum {
+  SIM_IDLE,
+  SIM_READY,
+  SIM_ACTIVE,
+  SIM_HALT,
+} sim_tag_state;
+
+struct sim_tag {
+  const struct sim_tag_model *model;
+  uint8_t abtUid[10];
+  sim_tag_state state;
+  /** Anticollision cascade level reached by raw frames */
+  uint8_t ui8Level;
+  /** MIFARE Classic: authenticated sector, or -1 */
+  int     iAuthSector;
+  /** MIFARE Classic: value operation result waiting for a transfer */
+  int32_t iValue;
+  bool    bValue;
+  /** ISO14443-4: NDEF application and file selected */
+  bool    bApplication;
+  uint16_t ui16File;
+  uint8_t *pbtMemory;
+};
+
+/** Commands sent by the simulated reader to the chip as a target, then released */
+struct sim_script {
+  uint8_t btMode;
+  const uint8_t *pbtActivation;
+  size_t  szActivation;
+  const uint8_t *const *ppbtCommands;
+  const size_t *pszCommands;
+  size_t  szCommands;
+};
+
+static const uint8_t sim_rats[] = { 0xe0, 0x50 };
+static const uint8_t sim_select_ndef[] = { 0x00, 0xa4, 0x04, 0x00, 0x07, 0xd2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01, 0x00 };
+static const uint8_t sim_select_cc[] = { 0x00, 0xa4, 0x00, 0x0c, 0x02, 0xe1, 0x03 };
+static const uint8_t sim_read_cc[] = { 0x00, 0xb0, 0x00, 0x00, 0x0f };
+static const uint8_t *const sim_picc_commands[] = { sim_select_ndef, sim_select_cc, sim_read_cc };
+static const size_t sim_picc_sizes[] = { sizeof(sim_select_ndef), sizeof(sim_select_cc), sizeof(sim_read_cc) };
+
+static const uint8_t sim_atr_req[] = { 0xd4, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x00, 0x00, 0x00, 0x32 };
+static const uint8_t sim_dep_data[] = { 'H', 'e', 'l', 'l', 'o', ' ', 's', 'i', 'm' };
+static const uint8_t *const sim_dep_commands[] = { sim_dep_data };
+static const size_t sim_dep_sizes[] = { sizeof(sim_dep_data) };
+
+static const uint8_t sim_read0[] = { 0x30, 0x00 };
+
+static const struct sim_script sim_script_picc = { 0x00, sim_rats, sizeof(sim_rats), sim_picc_commands, sim_picc_sizes, 3 };
+static const struct sim_script sim_script_dep = { 0x04, sim_atr_req, sizeof(sim_atr_req), sim_dep_commands, sim_dep_sizes, 1 };
+static const struct sim_script sim_script_raw = { 0x00, sim_read0, sizeof(sim_read0), NULL, NULL, 0 };
+
+// Internal data structs
+const struct pn53x_io sim_io;
+struct sim_data {
+  struct sim_tag tags[SIM_MAX_TAGS];
+  size_t  szTags;
+  /** Target selected as Tg 1, if any */
+  struct sim_tag *ptSelected;
+  /** Tag answering raw frames */
+  struct sim_tag *ptRaw;
+  /** Raw frames are FeliCa frames, as the last poll was */
+  bool    bFelica;
+  bool    bField;
+  bool    bPN533;
+  uint8_t *pbtRegisters;
+  /** As a target, the reader script and the next command in it */
+  const struct sim_script *pScript;
+  size_t  szScript;
+  /** Latency model */
+  uint32_t ui32Latency;
+  bool    bAirTime;
+  size_t  szAir;
+  /** Pending reply, when it is due */
+  uint8_t abtReply[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  int     iReply;
+  bool    bReply;
+  uint64_t reply_us;
+  /** GET CHALLENGE generator */
+  uint32_t ui32Random;
+};
+
+#define DRIVER_DATA(pnd) ((struct sim_data*)(pnd->driver_data))
+
+/*
+ * UID bytes sent at anticollision cascade level ui8Level.
+ */
+static void
+sim_cascade(const struct sim_tag *pt, const uint8_t ui8Level, uint8_t *pbtCl)
+{
+  const size_t szUid = pt->model->szUid;
+  const size_t szLevels = (szUid == 4) ? 1 : ((szUid == 7) ? 2 : 3);
+  if (ui8Level + 1u == szLevels) {
+    memcpy(pbtCl, pt->abtUid + (3 * ui8Level), 4);
+  } else {
+    pbtCl[0] = 0x88;
+    memcpy(pbtCl + 1, pt->abtUid + (3 * ui8Level), 3);
+  }
+}
+
+static size_t
+sim_levels(const struct sim_tag *pt)
+{
+  return (pt->model->szUid == 4) ? 1 : ((pt->model->szUid == 7) ? 2 : 3);
+}
+
+static bool
+sim_is_type_a(const struct sim_tag *pt)
+{
+  return pt->model->family != SIM_FELICA;
+}
+
+static size_t
+sim_mfc_blocks(const struct sim_tag *pt)
+{
+  return pt->model->szMemory / 16;
+}
+
+static int
+sim_mfc_sector(const uint8_t btBlock)
+{
+  return (btBlock < 128) ? (btBlock / 4) : (32 + ((btBlock - 128) / 16));
+}
+
+static uint8_t
+sim_mfc_trailer(const uint8_t btBlock)
+{
+  return (btBlock < 128) ? (btBlock | 0x03) : (btBlock | 0x0f);
+}
+
+static void
+sim_tag_reset(struct sim_tag *pt)
+{
+  pt->state = SIM_IDLE;
+  pt->ui8Level = 0;
+  pt->iAuthSector = -1;
+  pt->bValue = false;
+  pt->bApplication = false;
+  pt->ui16File = 0;
+}
+
+static void
+sim_tag_init(struct sim_tag *pt)
+{
+  const struct sim_tag_model *pm = pt->model;
+  uint8_t *pbt = pt->pbtMemory;
+  const uint8_t *pbtUid = pt->abtUid;
+
+  sim_tag_reset(pt);
+  switch (pm->family) {
+    case SIM_MIFARE_CLASSIC:
+      // Manufacturer block then transport configuration
+      memcpy(pbt, pbtUid, 4);
+      pbt[4] = pbtUid[0] ^ pbtUid[1] ^ pbtUid[2] ^ pbtUid[3];
+      pbt[5] = pm->btSak;
+      pbt[6] = pm->abtAtqa[1];
+      pbt[7] = pm->abtAtqa[0];
+      for (size_t szBlock = 0; szBlock < sim_mfc_blocks(pt); szBlock++) {
+        if (sim_mfc_trailer((uint8_t) szBlock) == szBlock) {
+          uint8_t *pbtTrailer = pbt + (szBlock * 16);
+          memset(pbtTrailer, 0xff, 16);
+          pbtTrailer[6] = 0xff;
+          pbtTrailer[7] = 0x07;
+          pbtTrailer[8] = 0x80;
+          pbtTrailer[9] = 0x69;
+        }
+      }
+      break;
+    case SIM_ULTRALIGHT:
+    case SIM_NTAG: {
+      const size_t szPages = pm->szMemory / 4;
+      memcpy(pbt, pbtUid, 3);
+      pbt[3] = 0x88 ^ pbtUid[0] ^ pbtUid[1] ^ pbtUid[2];
+      memcpy(pbt + 4, pbtUid + 3, 4);
+      pbt[8] = pbtUid[3] ^ pbtUid[4] ^ pbtUid[5] ^ pbtUid[6];
+      pbt[9] = 0x48;
+      if (pm->family == SIM_NTAG) {
+        // Capability container, empty NDEF message
+        pbt[12] = 0xe1;
+        pbt[13] = 0x10;
+        pbt[14] = (uint8_t)((pm->szMemory - 5 * 4 - 4 * 4) / 8);
+        memcpy(pbt + 16, "\x03\x00\xfe", 3);
+        // AUTH0 disables password protection, default password
+        pbt[(szPages - 4) * 4 + 3] = 0xff;
+        memset(pbt + (szPages - 2) * 4, 0xff, 4);
+      }
+    }
+    break;
+    case SIM_FELICA: {
+      // NFC Forum Type 3 attribute information block, empty NDEF message
+      const uint8_t abtAttributes[] = { 0x10, 0x04, 0x01, 0x00, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x25 };
+      memcpy(pbt, abtAttributes, sizeof(abtAttributes));
+    }
+    break;
+    case SIM_ISO14443_4:
+      // Empty NDEF file
+      break;
+  }
+}
+
+/*
+ * Parse "model[=UID],..." into data->tags.
+ */
+static int
+sim_parse_tags(struct sim_data *data, const char *pcTags)
+{
+  char *pcList = strdup(pcTags);
+  if (!pcList)
+    return NFC_ESOFT;
+
+  for (char *pcTag = pcList, *pcNext; pcTag; pcTag = pcNext) {
+    if ((pcNext = strchr(pcTag, ',')))
+      *pcNext++ = '\0';
+    char *pcUid = strchr(pcTag, '=');
+    if (pcUid)
+      *pcUid++ = '\0';
+    const struct sim_tag_model *pm = NULL;
+    for (size_t i = 0; i < sizeof(sim_tag_models) / sizeof(sim_tag_models[0]); i++) {
+      if (strcmp(pcTag, sim_tag_models[i].name) == 0)
+        pm = &sim_tag_models[i];
+    }
+    if (!pm || (data->szTags == SIM_MAX_TAGS)) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unknown tag model or too many tags: %s", pcTag);
+      free(pcList);
+      return NFC_EINVARG;
+    }
+    struct sim_tag *pt = &data->tags[data->szTags];
+    pt->model = pm;
+    if (pcUid) {
+      size_t szUid = 0;
+      unsigned int uiByte;
+      while ((szUid < pm->szUid) && (sscanf(pcUid + (2 * szUid), "%2x", &uiByte) == 1))
+        pt->abtUid[szUid++] = (uint8_t) uiByte;
+      if ((szUid != pm->szUid) || (strlen(pcUid) != 2 * szUid)) {
+        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s needs a %" PRIuPTR " bytes UID", pm->name, pm->szUid);
+        free(pcList);
+        return NFC_EINVARG;
+      }
+    } else {
+      // NXP manufacturer code first for 7 bytes UIDs, the last byte tells tags apart
+      const uint8_t abtUid[] = { 0x04, 0x5e, 0x1d, 0xca, 0xfe, 0x01, 0x02, 0x03, 0x04, 0x05 };
+      memcpy(pt->abtUid, abtUid + ((pm->szUid == 4) ? 1 : 0), pm->szUid);
+      pt->abtUid[pm->szUid - 1] = (uint8_t)(0x10 + data->szTags);
+    }
+    if (!(pt->pbtMemory = calloc(1, pm->szMemory))) {
+      free(pcList);
+      return NFC_ESOFT;
+    }
+    data->szTags++;
+    sim_tag_init(pt);
+  }
+  free(pcList);
+  return NFC_SUCCESS;
+}
+
+static int
+sim_parse_options(struct sim_data *data, const char *pcOptions)
+{
+  char *pcList = strdup(pcOptions);
+  if (!pcList)
+    return NFC_ESOFT;
+
+  int res = NFC_SUCCESS;
+  for (char *pcOption = pcList, *pcNext; pcOption; pcOption = pcNext) {
+    if ((pcNext = strchr(pcOption, ',')))
+      *pcNext++ = '\0';
+    if (strcmp(pcOption, "pn533") == 0) {
+      data->bPN533 = true;
+    } else if (strcmp(pcOption, "airtime") == 0) {
+      data->bAirTime = true;
+    } else if (sscanf(pcOption, "latency=%" SCNu32, &data->ui32Latency) == 1) {
+      // Done
+    } else {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unknown sim option: %s", pcOption);
+      res = NFC_EINVARG;
+    }
+  }
+  free(pcList);
+  return res;
+}
+
+/*
+ * MIFARE Classic commands, as carried out by the chip (InDataExchange).
+ */
+static int
+sim_mfc_exchange(struct sim_tag *pt, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  uint8_t *pbtMemory = pt->pbtMemory;
+  const uint8_t btBlock = (szTx > 1) ? pbtTx[1] : 0;
+
+  if (pbtTx[0] == 0x50) {
+    pt->state = SIM_HALT;
+    return SIM_NO_RESPONSE;
+  }
+  if ((szTx < 2) || (btBlock >= sim_mfc_blocks(pt)))
+    goto nak;
+
+  switch (pbtTx[0]) {
+    case 0x60: // Authentication with key A
+    case 0x61: { // Authentication with key B
+      if (szTx < 8)
+        goto nak;
+      const uint8_t *pbtKey = pbtMemory + (sim_mfc_trailer(btBlock) * 16) + ((pbtTx[0] == 0x60) ? 0 : 10);
+      if (memcmp(pbtKey, pbtTx + 2, 6) != 0)
+        goto nak;
+      pt->iAuthSector = sim_mfc_sector(btBlock);
+      pt->bValue = false;
+      return 0;
+    }
+  }
+
+  if (pt->iAuthSector != sim_mfc_sector(btBlock))
+    goto nak;
+  uint8_t *pbtBlock = pbtMemory + (btBlock * 16);
+  switch (pbtTx[0]) {
+    case 0x30: // Read
+      memcpy(pbtRx, pbtBlock, 16);
+      if (sim_mfc_trailer(btBlock) == btBlock)
+        memset(pbtRx, 0x00, 6); // Key A is never readable
+      return 16;
+    case 0xa0: // Write
+      if ((szTx < 18) || (btBlock == 0))
+        goto nak;
+      memcpy(pbtBlock, pbtTx + 2, 16);
+      return 0;
+    case 0xc0: // Decrement
+    case 0xc1: // Increment
+    case 0xc2: { // Restore
+      if (szTx < 6)
+        goto nak;
+      uint32_t ui32Value, ui32Inverted, ui32Copy, ui32Operand;
+      memcpy(&ui32Value, pbtBlock, 4);
+      memcpy(&ui32Inverted, pbtBlock + 4, 4);
+      memcpy(&ui32Copy, pbtBlock + 8, 4);
+      if ((ui32Value != ui32Copy) || (ui32Value != ~ui32Inverted))
+        goto nak;
+      ui32Operand = (uint32_t) pbtTx[2] | ((uint32_t) pbtTx[3] << 8) | ((uint32_t) pbtTx[4] << 16) | ((uint32_t) pbtTx[5] << 24);
+      if (pbtTx[0] == 0xc0)
+        ui32Value -= ui32Operand;
+      else if (pbtTx[0] == 0xc1)
+        ui32Value += ui32Operand;
+      pt->iValue = (int32_t) ui32Value;
+      pt->bValue = true;
+      return 0;
+    }
+    case 0xb0: { // Transfer
+      if (!pt->bValue || (btBlock == 0))
+        goto nak;
+      const uint32_t ui32Value = (uint32_t) pt->iValue;
+      const uint32_t ui32Inverted = ~ui32Value;
+      memcpy(pbtBlock, &ui32Value, 4);
+      memcpy(pbtBlock + 4, &ui32Inverted, 4);
+      memcpy(pbtBlock + 8, &ui32Value, 4);
+      pt->bValue = false;
+      return 0;
+    }
+  }
+
+nak:
+  // The tag stops answering until it is selected again
+  pt->state = SIM_IDLE;
+  pt->iAuthSector = -1;
+  return SIM_NAK;
+}
+
+/*
+ * MIFARE Ultralight and NTAG commands. bChip tells whether the chip carries
+ * out the command (InDataExchange), which does not forward acknowledges.
+ */
+static int
+sim_ultralight_exchange(struct sim_tag *pt, const bool bChip, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  const struct sim_tag_model *pm = pt->model;
+  const size_t szPages = pm->szMemory / 4;
+  uint8_t *pbtMemory = pt->pbtMemory;
+  const uint8_t btPage = (szTx > 1) ? pbtTx[1] : 0;
+
+  switch (pbtTx[0]) {
+    case 0x30: // Read 4 pages, rolling over
+      if ((szTx < 2) || (btPage >= szPages))
+        return SIM_NAK;
+      for (size_t n = 0; n < 16; n++)
+        pbtRx[n] = pbtMemory[((btPage * 4) + n) % pm->szMemory];
+      return 16;
+    case 0xa2: // Write
+    case 0xa0: // Compatibility write, 16 bytes of which only 4 are written
+      if ((szTx < ((pbtTx[0] == 0xa2) ? 6u : 18u)) || (btPage < 2) || (btPage >= szPages))
+        return SIM_NAK;
+      if (btPage < 4) {
+        // Lock and OTP bits can only be set
+        for (size_t n = 0; n < 4; n++)
+          pbtMemory[(btPage * 4) + n] |= pbtTx[2 + n];
+      } else {
+        memcpy(pbtMemory + (btPage * 4), pbtTx + 2, 4);
+      }
+      break;
+    case 0x60: // GET_VERSION
+      if (pm->family != SIM_NTAG)
+        return SIM_NO_RESPONSE;
+      memcpy(pbtRx, pm->abtVersion, sizeof(pm->abtVersion));
+      return sizeof(pm->abtVersion);
+    case 0x3a: // FAST_READ
+      if ((pm->family != SIM_NTAG) || (szTx < 3) || (btPage > pbtTx[2]) || (pbtTx[2] >= szPages))
+        return SIM_NAK;
+      memcpy(pbtRx, pbtMemory + (btPage * 4), (pbtTx[2] - btPage + 1) * 4);
+      return (pbtTx[2] - btPage + 1) * 4;
+    case 0x1b: // PWD_AUTH
+      if ((pm->family != SIM_NTAG) || (szTx < 5) || (memcmp(pbtMemory + ((szPages - 2) * 4), pbtTx + 1, 4) != 0))
+        return SIM_NAK;
+      memcpy(pbtRx, pbtMemory + ((szPages - 1) * 4), 2);
+      return 2;
+    case 0x50: // HALT
+      pt->state = SIM_HALT;
+      return SIM_NO_RESPONSE;
+    default:
+      return SIM_NAK;
+  }
+  if (bChip)
+    return 0;
+  pbtRx[0] = SIM_ACK;
+  return 1;
+}
+
+/*
+ * FeliCa commands, the frame starts with its length byte.
+ */
+static int
+sim_felica_exchange(struct sim_tag *pt, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  if ((szTx < 2) || (pbtTx[0] != szTx))
+    return SIM_NO_RESPONSE;
+  if (pbtTx[1] == 0x00) {
+    // Polling
+    if (szTx < 6)
+      return SIM_NO_RESPONSE;
+    size_t szRx = 0;
+    pbtRx[szRx++] = 0;
+    pbtRx[szRx++] = 0x01;
+    memcpy(pbtRx + szRx, pt->abtUid, 8);
+    szRx += 8;
+    memcpy(pbtRx + szRx, sim_felica_pmm, sizeof(sim_felica_pmm));
+    szRx += sizeof(sim_felica_pmm);
+    if (pbtTx[4] == 0x01) {
+      memcpy(pbtRx + szRx, sim_felica_system_code, sizeof(sim_felica_system_code));
+      szRx += sizeof(sim_felica_system_code);
+    }
+    pbtRx[0] = (uint8_t) szRx;
+    return (int) szRx;
+  }
+  if ((szTx < 10) || (memcmp(pbtTx + 2, pt->abtUid, 8) != 0))
+    return SIM_NO_RESPONSE;
+
+  size_t szRx = 0;
+  pbtRx[szRx++] = 0;
+  pbtRx[szRx++] = pbtTx[1] + 1;
+  memcpy(pbtRx + szRx, pt->abtUid, 8);
+  szRx += 8;
+  switch (pbtTx[1]) {
+    case 0x04: // Request Response: mode 0
+      pbtRx[szRx++] = 0x00;
+      break;
+    case 0x06: // Read Without Encryption
+    case 0x08: { // Write Without Encryption
+      // Service list, then block list of 2 or 3 bytes elements
+      size_t szPos = 10;
+      if (szPos >= szTx)
+        return SIM_NO_RESPONSE;
+      szPos += 1 + (2 * pbtTx[szPos]);
+      if (szPos >= szTx)
+        return SIM_NO_RESPONSE;
+      const uint8_t ui8Blocks = pbtTx[szPos++];
+      uint8_t abtBlocks[16];
+      if (ui8Blocks > sizeof(abtBlocks))
+        return SIM_NO_RESPONSE;
+      bool bValid = true;
+      for (size_t n = 0; n < ui8Blocks; n++) {
+        if (szPos + 2 > szTx)
+          return SIM_NO_RESPONSE;
+        const bool bShort = pbtTx[szPos] & 0x80;
+        const uint16_t ui16Block = bShort ? pbtTx[szPos + 1] : (pbtTx[szPos + 1] | (pbtTx[szPos + 2] << 8));
+        szPos += bShort ? 2 : 3;
+        bValid = bValid && (ui16Block < pt->model->szMemory / 16);
+        abtBlocks[n] = (uint8_t) ui16Block;
+      }
+      if (!bValid || ((pbtTx[1] == 0x08) && (szPos + (16 * ui8Blocks) > szTx))) {
+        // Status flags: block number error
+        pbtRx[szRx++] = 0x01;
+        pbtRx[szRx++] = 0xa8;
+        if (pbtTx[1] == 0x06)
+          pbtRx[szRx++] = 0x00;
+        break;
+      }
+      pbtRx[szRx++] = 0x00;
+      pbtRx[szRx++] = 0x00;
+      if (pbtTx[1] == 0x06) {
+        pbtRx[szRx++] = ui8Blocks;
+        for (size_t n = 0; n < ui8Blocks; n++) {
+          memcpy(pbtRx + szRx, pt->pbtMemory + (abtBlocks[n] * 16), 16);
+          szRx += 16;
+        }
+      } else {
+        for (size_t n = 0; n < ui8Blocks; n++)
+          memcpy(pt->pbtMemory + (abtBlocks[n] * 16), pbtTx + szPos + (16 * n), 16);
+      }
+    }
+    break;
+    default:
+      return SIM_NO_RESPONSE;
+  }
+  pbtRx[0] = (uint8_t) szRx;
+  return (int) szRx;
+}
+
+/*
+ * ISO7816-4 APDUs of an NFC Forum Type 4 tag.
+ */
+static int
+sim_apdu_exchange(struct sim_data *data, struct sim_tag *pt, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  size_t szRx = 0;
+  uint16_t ui16Sw = 0x9000;
+
+  if (szTx < 4) {
+    ui16Sw = 0x6700;
+  } else if ((pbtTx[1] == 0xa4) && (pbtTx[2] == 0x04)) {
+    // SELECT by name
+    pt->bApplication = (szTx >= 5 + sizeof(sim_ndef_aid)) && (pbtTx[4] == sizeof(sim_ndef_aid)) &&
+                       (memcmp(pbtTx + 5, sim_ndef_aid, sizeof(sim_ndef_aid)) == 0);
+    pt->ui16File = 0;
+    if (!pt->bApplication)
+      ui16Sw = 0x6a82;
+  } else if ((pbtTx[1] == 0xa4) && (pbtTx[2] == 0x00)) {
+    // SELECT by file identifier
+    const uint16_t ui16File = (szTx >= 7) ? ((pbtTx[5] << 8) | pbtTx[6]) : 0;
+    if (pt->bApplication && ((ui16File == 0xe103) || (ui16File == 0xe104))) {
+      pt->ui16File = ui16File;
+    } else {
+      ui16Sw = 0x6a82;
+    }
+  } else if ((pbtTx[1] == 0xb0) || (pbtTx[1] == 0xd6)) {
+    // READ BINARY, UPDATE BINARY
+    const uint8_t *pbtFile = (pt->ui16File == 0xe103) ? sim_ndef_cc : pt->pbtMemory;
+    const size_t szFile = (pt->ui16File == 0xe103) ? sizeof(sim_ndef_cc) : pt->model->szMemory;
+    const size_t szOffset = (pbtTx[2] << 8) | pbtTx[3];
+    const size_t szLength = (szTx > 4) ? pbtTx[4] : 0;
+    if (!pt->ui16File) {
+      ui16Sw = 0x6986;
+    } else if (szOffset + szLength > szFile) {
+      ui16Sw = 0x6b00;
+    } else if (pbtTx[1] == 0xb0) {
+      memcpy(pbtRx, pbtFile + szOffset, szLength);
+      szRx = szLength;
+    } else if ((pt->ui16File == 0xe103) || (szTx < 5 + szLength)) {
+      ui16Sw = 0x6982;
+    } else {
+      memcpy(pt->pbtMemory + szOffset, pbtTx + 5, szLength);
+    }
+  } else if (pbtTx[1] == 0x84) {
+    // GET CHALLENGE
+    const size_t szLength = ((szTx > 4) && pbtTx[4]) ? pbtTx[4] : 8;
+    for (; szRx < szLength; szRx++) {
+      // xorshift32
+      data->ui32Random ^= data->ui32Random << 13;
+      data->ui32Random ^= data->ui32Random >> 17;
+      data->ui32Random ^= data->ui32Random << 5;
+      pbtRx[szRx] = (uint8_t) data->ui32Random;
+    }
+  } else {
+    ui16Sw = 0x6d00;
+  }
+  pbtRx[szRx++] = (uint8_t)(ui16Sw >> 8);
+  pbtRx[szRx++] = (uint8_t) ui16Sw;
+  return (int) szRx;
+}
+
+/*
+ * Exchange with the selected tag through the chip (InDataExchange).
+ */
+static int
+sim_tag_exchange(struct sim_data *data, struct sim_tag *pt, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  if (!pt || (pt->state != SIM_ACTIVE) || !szTx)
+    return SIM_NO_RESPONSE;
+  switch (pt->model->family) {
+    case SIM_MIFARE_CLASSIC:
+      return sim_mfc_exchange(pt, pbtTx, szTx, pbtRx);
+    case SIM_ULTRALIGHT:
+    case SIM_NTAG:
+      return sim_ultralight_exchange(pt, true, pbtTx, szTx, pbtRx);
+    case SIM_FELICA:
+      return sim_felica_exchange(pt, pbtTx, szTx, pbtRx);
+    case SIM_ISO14443_4:
+      return sim_apdu_exchange(data, pt, pbtTx, szTx, pbtRx);
+  }
+  return SIM_NO_RESPONSE;
+}
+
+/*
+ * Raw frame (InCommunicateThru). Anticollision and ISO14443-4 block framing
+ * are handled here, other frames go to the tag. *pbCrc tells whether the
+ * answer is followed by a CRC on the air, *pui8Bits its last bits count.
+ */
+static int
+sim_raw_exchange(struct sim_data *data, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, bool *pbCrc, uint8_t *pui8Bits)
+{
+  struct sim_tag *pt = data->ptRaw;
+  *pbCrc = false;
+  *pui8Bits = 0;
+
+  if (!szTx)
+    return SIM_NO_RESPONSE;
+  if (data->bFelica) {
+    // The chip handles FeliCa CRC, a polling reaches any FeliCa tag
+    if ((szTx > 1) && (pbtTx[1] == 0x00)) {
+      for (size_t n = 0; n < data->szTags; n++) {
+        if (data->tags[n].model->family == SIM_FELICA) {
+          data->ptSelected = &data->tags[n];
+          data->ptSelected->state = SIM_ACTIVE;
+          break;
+        }
+      }
+    }
+    pt = data->ptSelected;
+    if (!pt || (pt->model->family != SIM_FELICA))
+      return SIM_NO_RESPONSE;
+    return sim_felica_exchange(pt, pbtTx, szTx, pbtRx);
+  }
+  if ((szTx == 1) && ((pbtTx[0] == 0x26) || (pbtTx[0] == 0x52))) {
+    // REQA, WUPA: the first tag which answers wins the anticollision
+    data->ptRaw = NULL;
+    for (size_t n = 0; n < data->szTags; n++) {
+      struct sim_tag *ptCandidate = &data->tags[n];
+      if (!sim_is_type_a(ptCandidate))
+        continue;
+      if ((ptCandidate->state == SIM_IDLE) || ((pbtTx[0] == 0x52) && (ptCandidate->state == SIM_HALT))) {
+        sim_tag_reset(ptCandidate);
+        if (!data->ptRaw) {
+          ptCandidate->state = SIM_READY;
+          data->ptRaw = ptCandidate;
+        }
+      }
+    }
+    if (!data->ptRaw)
+      return SIM_NO_RESPONSE;
+    pbtRx[0] = data->ptRaw->model->abtAtqa[1];
+    pbtRx[1] = data->ptRaw->model->abtAtqa[0];
+    return 2;
+  }
+  if (!pt)
+    return SIM_NO_RESPONSE;
+
+  if ((pbtTx[0] == 0x93) || (pbtTx[0] == 0x95) || (pbtTx[0] == 0x97)) {
+    const uint8_t ui8Level = (pbtTx[0] - 0x93) / 2;
+    uint8_t abtCl[4];
+    if ((pt->state != SIM_READY) || (ui8Level != pt->ui8Level) || (szTx < 2))
+      return SIM_NO_RESPONSE;
+    sim_cascade(pt, ui8Level, abtCl);
+    if (pbtTx[1] == 0x20) {
+      // Anticollision
+      memcpy(pbtRx, abtCl, 4);
+      pbtRx[4] = abtCl[0] ^ abtCl[1] ^ abtCl[2] ^ abtCl[3];
+      return 5;
+    }
+    if ((pbtTx[1] == 0x70) && (szTx >= 6) && (memcmp(pbtTx + 2, abtCl, 4) == 0)) {
+      // Select
+      *pbCrc = true;
+      if (ui8Level + 1u < sim_levels(pt)) {
+        pt->ui8Level++;
+        pbtRx[0] = 0x04;
+      } else {
+        pt->state = SIM_ACTIVE;
+        pbtRx[0] = pt->model->btSak;
+      }
+      return 1;
+    }
+    return SIM_NO_RESPONSE;
+  }
+  if (pt->state != SIM_ACTIVE)
+    return SIM_NO_RESPONSE;
+  if ((pbtTx[0] == 0x50) && (szTx >= 2) && (pbtTx[1] == 0x00)) {
+    // HLTA
+    pt->state = SIM_HALT;
+    data->ptRaw = NULL;
+    return SIM_NO_RESPONSE;
+  }
+
+  int res = SIM_NO_RESPONSE;
+  switch (pt->model->family) {
+    case SIM_MIFARE_CLASSIC:
+      // Frames would be ciphered by crypto1
+      break;
+    case SIM_ULTRALIGHT:
+    case SIM_NTAG:
+      res = sim_ultralight_exchange(pt, false, pbtTx, szTx, pbtRx);
+      if (res == SIM_NAK) {
+        pbtRx[0] = SIM_NAK_VALUE;
+        res = 1;
+      }
+      if ((res == 1) && (pbtRx[0] == SIM_ACK || pbtRx[0] == SIM_NAK_VALUE) && (pbtTx[0] == 0xa2 || pbtRx[0] == SIM_NAK_VALUE)) {
+        *pui8Bits = 4;
+        return res;
+      }
+      break;
+    case SIM_FELICA:
+      break;
+    case SIM_ISO14443_4:
+      if (pbtTx[0] == 0xe0) {
+        // RATS
+        memcpy(pbtRx, sim_ats, sizeof(sim_ats));
+        res = sizeof(sim_ats);
+      } else if ((pbtTx[0] & 0xf6) == 0xb2) {
+        // R(NAK): R(ACK) with the same block number
+        pbtRx[0] = 0xa2 | (pbtTx[0] & 0x01);
+        res = 1;
+      } else if (pbtTx[0] == 0xc2) {
+        // S(DESELECT)
+        pbtRx[0] = 0xc2;
+        pt->state = SIM_HALT;
+        res = 1;
+      } else if ((pbtTx[0] & 0xe6) == 0x02) {
+        // I-block without CID nor NAD
+        pbtRx[0] = pbtTx[0];
+        res = sim_apdu_exchange(data, pt, pbtTx + 1, szTx - 1, pbtRx + 1) + 1;
+      }
+      break;
+  }
+  *pbCrc = (res >= 0);
+  return res;
+}
+
+/*
+ * Target data of InListPassiveTarget and InAutoPoll, Tg included.
+ */
+static size_t
+sim_target_data(const struct sim_tag *pt, uint8_t *pbt)
+{
+  size_t sz = 0;
+  pbt[sz++] = 0x01;
+  if (pt->model->family == SIM_FELICA) {
+    uint8_t abtPolling[] = { 0x06, 0x00, 0xff, 0xff, 0x01, 0x00 };
+    sz += (size_t) sim_felica_exchange((struct sim_tag *) pt, abtPolling, sizeof(abtPolling), pbt + sz);
+    return sz;
+  }
+  pbt[sz++] = pt->model->abtAtqa[0];
+  pbt[sz++] = pt->model->abtAtqa[1];
+  pbt[sz++] = pt->model->btSak;
+  pbt[sz++] = (uint8_t) pt->model->szUid;
+  memcpy(pbt + sz, pt->abtUid, pt->model->szUid);
+  sz += pt->model->szUid;
+  if (pt->model->btSak & 0x20) {
+    memcpy(pbt + sz, sim_ats, sizeof(sim_ats));
+    sz += sizeof(sim_ats);
+  }
+  return sz;
+}
+
+/*
+ * Whether pt answers a poll at pm (InListPassiveTarget BrTy).
+ */
+static bool
+sim_tag_answers(const struct sim_tag *pt, const pn53x_modulation pm, const uint8_t *pbtInit, const size_t szInit)
+{
+  switch (pm) {
+    case PM_ISO14443A_106: {
+      if (!sim_is_type_a(pt) || (pt->state == SIM_HALT))
+        return false;
+      if (!szInit)
+        return true;
+      // Cascaded UID, see iso14443_cascade_uid()
+      uint8_t abtUid[12];
+      size_t szUid = 0;
+      for (size_t szLevel = 0; szLevel < sim_levels(pt); szLevel++) {
+        sim_cascade(pt, (uint8_t) szLevel, abtUid + szUid);
+        szUid += 4;
+      }
+      return (szInit == szUid) && (memcmp(pbtInit, abtUid, szUid) == 0);
+    }
+    case PM_FELICA_212:
+    case PM_FELICA_424:
+      if (pt->model->family != SIM_FELICA)
+        return false;
+      return (szInit < 3) || ((pbtInit[1] == 0xff) && (pbtInit[2] == 0xff)) ||
+             ((pbtInit[1] == sim_felica_system_code[0]) && (pbtInit[2] == sim_felica_system_code[1]));
+    default:
+      return false;
+  }
+}
+
+static int
+sim_list_passive_target(struct sim_data *data, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtRx)
+{
+  size_t szRx = 1;
+  pbtRx[0] = 0;
+  if ((szParams < 2) || !data->bField)
+    return 1;
+  data->ptSelected = NULL;
+  data->ptRaw = NULL;
+  data->bFelica = (pbtParams[1] == PM_FELICA_212) || (pbtParams[1] == PM_FELICA_424);
+  for (size_t n = 0; n < data->szTags; n++) {
+    struct sim_tag *pt = &data->tags[n];
+    if (!sim_tag_answers(pt, (pn53x_modulation) pbtParams[1], pbtParams + 2, szParams - 2))
+      continue;
+    if (sim_is_type_a(pt)) {
+      sim_tag_reset(pt);
+      pt->state = SIM_ACTIVE;
+      data->ptRaw = pt;
+    }
+    pt->state = SIM_ACTIVE;
+    data->ptSelected = pt;
+    szRx += sim_target_data(pt, pbtRx + szRx);
+    // REQA and ATQA, then anticollision and select at each cascade level
+    data->szAir += 1 + 2 + (2 + 5 + 7 + 3) * sim_levels(pt);
+    // Only one target is simulated as selected
+    pbtRx[0] = 1;
+    break;
+  }
+  return (int) szRx;
+}
+
+static int
+sim_auto_poll(struct sim_data *data, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtRx)
+{
+  size_t szRx = 1;
+  pbtRx[0] = 0;
+  for (size_t i = 2; (i < szParams) && !pbtRx[0]; i++) {
+    const pn53x_target_type ptt = (pn53x_target_type) pbtParams[i];
+    pn53x_modulation pm;
+    switch (ptt) {
+      case PTT_GENERIC_PASSIVE_106:
+      case PTT_MIFARE:
+      case PTT_ISO14443_4A_106:
+        pm = PM_ISO14443A_106;
+        break;
+      case PTT_GENERIC_PASSIVE_212:
+      case PTT_FELICA_212:
+        pm = PM_FELICA_212;
+        break;
+      case PTT_GENERIC_PASSIVE_424:
+      case PTT_FELICA_424:
+        pm = PM_FELICA_424;
+        break;
+      default:
+        continue;
+    }
+    for (size_t n = 0; n < data->szTags; n++) {
+      struct sim_tag *pt = &data->tags[n];
+      if (!data->bField || !sim_tag_answers(pt, pm, NULL, 0))
+        continue;
+      if ((ptt == PTT_MIFARE) && !(pt->model->btSak & 0x08))
+        continue;
+      if ((ptt == PTT_ISO14443_4A_106) && !(pt->model->btSak & 0x20))
+        continue;
+      sim_tag_reset(pt);
+      pt->state = SIM_ACTIVE;
+      data->ptSelected = pt;
+      data->ptRaw = sim_is_type_a(pt) ? pt : NULL;
+      data->bFelica = !sim_is_type_a(pt);
+      pbtRx[0] = 1;
+      pbtRx[szRx++] = (uint8_t) ptt;
+      const size_t szData = sim_target_data(pt, pbtRx + szRx + 1);
+      pbtRx[szRx++] = (uint8_t) szData;
+      szRx += szData;
+      break;
+    }
+  }
+  return (int) szRx;
+}
+
+static int
+sim_target_init(struct sim_data *data, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtRx)
+{
+  if (szParams < 1)
+    return NFC_EIO;
+  const uint8_t ptm = pbtParams[0];
+  if (ptm & PTM_DEP_ONLY) {
+    data->pScript = &sim_script_dep;
+  } else if (ptm & PTM_ISO14443_4_PICC_ONLY) {
+    data->pScript = &sim_script_picc;
+  } else {
+    data->pScript = &sim_script_raw;
+  }
+  data->szScript = 0;
+  pbtRx[0] = data->pScript->btMode;
+  memcpy(pbtRx + 1, data->pScript->pbtActivation, data->pScript->szActivation);
+  data->szAir += data->pScript->szActivation;
+  return (int)(1 + data->pScript->szActivation);
+}
+
+/*
+ * Next command of the simulated reader, or release.
+ */
+static int
+sim_target_get(struct sim_data *data, uint8_t *pbtRx)
+{
+  const struct sim_script *pScript = data->pScript;
+  if (!pScript || (data->szScript >= pScript->szCommands)) {
+    data->pScript = NULL;
+    pbtRx[0] = SIM_STATUS_RELEASED;
+    return 1;
+  }
+  pbtRx[0] = SIM_STATUS_OK;
+  memcpy(pbtRx + 1, pScript->ppbtCommands[data->szScript], pScript->pszCommands[data->szScript]);
+  data->szAir += pScript->pszCommands[data->szScript];
+  return (int)(1 + pScript->pszCommands[data->szScript++]);
+}
+
+/*
+ * Answer of the chip to a command, status byte and data included.
+ */
+static int
+sim_process(struct sim_data *data, const uint8_t *pbtCmd, const size_t szCmd, uint8_t *pbtRx)
+{
+  const uint8_t *pbtParams = pbtCmd + 1;
+  const size_t szParams = szCmd - 1;
+  size_t szRx = 0;
+  int res;
+
+  switch (pbtCmd[0]) {
+    case Diagnose:
+      if (szParams && ((pbtParams[0] == 0x01) || (pbtParams[0] == 0x02))) {
+        // ROM and RAM tests
+        pbtRx[szRx++] = SIM_STATUS_OK;
+      } else if (szParams && (pbtParams[0] == 0x06)) {
+        // Attention request
+        pbtRx[szRx++] = (data->ptSelected && (data->ptSelected->state == SIM_ACTIVE)) ? SIM_STATUS_OK : SIM_STATUS_TIMEOUT;
+      } else {
+        memcpy(pbtRx, pbtParams, szParams);
+        szRx = szParams;
+      }
+      break;
+    case GetFirmwareVersion:
+      if (data->bPN533) {
+        memcpy(pbtRx, "\x33\x02\x08\x07", 4);
+      } else {
+        memcpy(pbtRx, "\x32\x01\x06\x07", 4);
+      }
+      szRx = 4;
+      break;
+    case GetGeneralStatus:
+      pbtRx[szRx++] = 0x00;
+      pbtRx[szRx++] = data->bField ? 0x01 : 0x00;
+      if (data->ptSelected && (data->ptSelected->state == SIM_ACTIVE)) {
+        pbtRx[szRx++] = 1;
+        pbtRx[szRx++] = 0x01;
+        pbtRx[szRx++] = 0x00;
+        pbtRx[szRx++] = 0x00;
+        pbtRx[szRx++] = (data->ptSelected->model->family == SIM_FELICA) ? PTT_FELICA_212 : PTT_GENERIC_PASSIVE_106;
+      } else {
+        pbtRx[szRx++] = 0;
+      }
+      if (!data->bPN533)
+        pbtRx[szRx++] = 0x00; // SAM status
+      break;
+    case ReadRegister:
+      if (data->bPN533)
+        pbtRx[szRx++] = SIM_STATUS_OK;
+      for (size_t n = 0; n + 1 < szParams; n += 2)
+        pbtRx[szRx++] = data->pbtRegisters[(pbtParams[n] << 8) | pbtParams[n + 1]];
+      break;
+    case WriteRegister:
+      if (data->bPN533)
+        pbtRx[szRx++] = SIM_STATUS_OK;
+      for (size_t n = 0; n + 2 < szParams; n += 3)
+        data->pbtRegisters[(pbtParams[n] << 8) | pbtParams[n + 1]] = pbtParams[n + 2];
+      break;
+    case ReadGPIO:
+      memcpy(pbtRx, "\xff\xff\x00", 3);
+      szRx = 3;
+      break;
+    case SAMConfiguration:
+      if (data->bPN533)
+        return NFC_EIO;
+      break;
+    case WriteGPIO:
+    case SetSerialBaudRate:
+    case SetParameters:
+      break;
+    case RFConfiguration:
+      if ((szParams >= 2) && (pbtParams[0] == 0x01)) {
+        // Tags are reset when the field goes off
+        data->bField = pbtParams[1] & 0x01;
+        if (!data->bField) {
+          for (size_t n = 0; n < data->szTags; n++)
+            sim_tag_reset(&data->tags[n]);
+          data->ptSelected = NULL;
+          data->ptRaw = NULL;
+        }
+      }
+      break;
+    case PowerDown:
+      pbtRx[szRx++] = SIM_STATUS_OK;
+      break;
+    case InListPassiveTarget:
+      return sim_list_passive_target(data, pbtParams, szParams, pbtRx);
+    case InAutoPoll:
+      if (data->bPN533)
+        return NFC_EIO;
+      return sim_auto_poll(data, pbtParams, szParams, pbtRx);
+    case InDataExchange:
+      if (szParams < 1)
+        return NFC_EIO;
+      data->szAir += szParams - 1;
+      res = data->bField ? sim_tag_exchange(data, data->ptSelected, pbtParams + 1, szParams - 1, pbtRx + 1) : SIM_NO_RESPONSE;
+      if (res >= 0) {
+        pbtRx[0] = SIM_STATUS_OK;
+        szRx = 1 + (size_t) res;
+        data->szAir += (size_t) res;
+      } else {
+        pbtRx[szRx++] = (res == SIM_NAK) ? SIM_STATUS_MIFARE : SIM_STATUS_TIMEOUT;
+      }
+      break;
+    case InCommunicateThru: {
+      // Without CRC handled by the chip, the frame carries its own CRC
+      size_t szTx = szParams;
+      uint8_t abtCrc[2];
+      if (!(data->pbtRegisters[PN53X_REG_CIU_TxMode] & SYMBOL_TX_CRC_ENABLE) && (szTx > 2)) {
+        iso14443a_crc((uint8_t *) pbtParams, szTx - 2, abtCrc);
+        if (memcmp(abtCrc, pbtParams + szTx - 2, 2) == 0)
+          szTx -= 2;
+      }
+      data->szAir += szParams;
+      bool bCrc;
+      uint8_t ui8Bits;
+      res = data->bField ? sim_raw_exchange(data, pbtParams, szTx, pbtRx + 1, &bCrc, &ui8Bits) : SIM_NO_RESPONSE;
+      if (res < 0) {
+        pbtRx[szRx++] = SIM_STATUS_TIMEOUT;
+        break;
+      }
+      pbtRx[0] = SIM_STATUS_OK;
+      szRx = 1 + (size_t) res;
+      if (bCrc && !(data->pbtRegisters[PN53X_REG_CIU_RxMode] & SYMBOL_RX_CRC_ENABLE)) {
+        iso14443a_crc_append(pbtRx + 1, (size_t) res);
+        szRx += 2;
+      }
+      data->pbtRegisters[PN53X_REG_CIU_Control] = (data->pbtRegisters[PN53X_REG_CIU_Control] & ~SYMBOL_RX_LAST_BITS) | ui8Bits;
+      data->szAir += szRx - 1;
+    }
+    break;
+    case InDeselect:
+    case InRelease:
+      if (data->ptSelected && sim_is_type_a(data->ptSelected))
+        data->ptSelected->state = SIM_HALT;
+      data->ptSelected = NULL;
+      data->ptRaw = NULL;
+      pbtRx[szRx++] = SIM_STATUS_OK;
+      break;
+    case InPSL:
+      pbtRx[szRx++] = SIM_STATUS_OK;
+      break;
+    case InJumpForDEP:
+    case InJumpForPSL:
+    case InATR:
+    case InSelect:
+      // No DEP target
+      pbtRx[szRx++] = SIM_STATUS_TIMEOUT;
+      break;
+    case TgInitAsTarget:
+      return sim_target_init(data, pbtParams, szParams, pbtRx);
+    case TgGetData:
+    case TgGetInitiatorCommand:
+      return sim_target_get(data, pbtRx);
+    case TgSetData:
+    case TgSetMetaData:
+    case TgResponseToInitiator:
+      data->szAir += szParams;
+      pbtRx[szRx++] = data->pScript ? SIM_STATUS_OK : SIM_STATUS_RELEASED;
+      break;
+    case TgGetTargetStatus:
+      pbtRx[szRx++] = data->pScript ? 0x01 : 0x00;
+      pbtRx[szRx++] = 0x00;
+      break;
+    default:
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Command 0x%02x is not simulated", pbtCmd[0]);
+      return NFC_EIO;
+  }
+  return (int) szRx;
+}
+
+static int
+sim_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  struct sim_data *data = DRIVER_DATA(pnd);
+  (void) timeout;
+
+  if (!szData) {
+    return pnd->last_error = NFC_EINVARG;
+  }
+  data->szAir = 0;
+  data->iReply = sim_process(data, pbtData, szData, data->abtReply);
+  data->bReply = true;
+  // 106 kbps, 9 bits per byte with parity
+  data->reply_us = nfc_monotonic_us() + data->ui32Latency + (data->bAirTime ? ((data->szAir * 9 * 1000000) / 106000) : 0);
+  return NFC_SUCCESS;
+}
+
+static int
+sim_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  struct sim_data *data = DRIVER_DATA(pnd);
+
+  if (!data->bReply) {
+    return pnd->last_error = NFC_EIO;
+  }
+  const uint64_t now_us = nfc_monotonic_us();
+  if (data->reply_us > now_us) {
+    if ((timeout > 0) && (data->reply_us - now_us > (uint64_t) timeout * 1000)) {
+      // The reply is still pending, as a slow chip's would be. reply_us is
+      // a deadline: time spent here already counts for the next receive.
+      nfc_sleep_ms(timeout);
+      return pnd->last_error = NFC_ETIMEOUT;
+    }
+    nfc_sleep_us(data->reply_us - now_us);
+  }
+  data->bReply = false;
+  if (data->iReply < 0) {
+    return pnd->last_error = data->iReply;
+  }
+  if ((size_t) data->iReply > szDataLen) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: buffer too small. (szDataLen: %" PRIuPTR ", len: %d)", szDataLen, data->iReply);
+    return pnd->last_error = NFC_EIO;
+  }
+  memcpy(pbtData, data->abtReply, data->iReply);
+  return data->iReply;
+}
+
+static void
+sim_free(struct sim_data *data)
+{
+  for (size_t n = 0; n < data->szTags; n++)
+    free(data->tags[n].pbtMemory);
+  free(data->pbtRegisters);
+  free(data);
+}
+
+static void
+sim_close(nfc_device *pnd)
+{
+  pn53x_idle(pnd);
+
+  sim_free(DRIVER_DATA(pnd));
+  pnd->driver_data = NULL;
+
+  pn53x_data_free(pnd);
+  nfc_device_free(pnd);
+}
+
+static nfc_device *
+sim_open(const nfc_context *context, const nfc_connstring connstring)
+{
+  char *pcTags = NULL;
+  char *pcOptions = NULL;
+  int connstring_decode_level = connstring_decode(connstring, SIM_DRIVER_NAME, NULL, &pcTags, &pcOptions);
+  if (connstring_decode_level < 1) {
+    return NULL;
+  }
+
+  struct sim_data *data = calloc(1, sizeof(struct sim_data));
+  if (!data || !(data->pbtRegisters = calloc(1, 0x10000))) {
+    perror("malloc");
+    free(data);
+    free(pcTags);
+    free(pcOptions);
+    return NULL;
+  }
+  data->bField = true;
+  data->ui32Random = 0x2545f491;
+  // Reset values of the CRC settings
+  data->pbtRegisters[PN53X_REG_CIU_TxMode] = SYMBOL_TX_CRC_ENABLE;
+  data->pbtRegisters[PN53X_REG_CIU_RxMode] = SYMBOL_RX_CRC_ENABLE;
+  if ((sim_parse_tags(data, pcTags ? pcTags : SIM_DEFAULT_TAGS) < 0) ||
+      (pcOptions && (sim_parse_options(data, pcOptions) < 0))) {
+    sim_free(data);
+    free(pcTags);
+    free(pcOptions);
+    return NULL;
+  }
+  free(pcOptions);
+
+  nfc_device *pnd = nfc_device_new(context, connstring);
+  if (!pnd) {
+    perror("malloc");
+    sim_free(data);
+    free(pcTags);
+    return NULL;
+  }
+  snprintf(pnd->name, sizeof(pnd->name), "%s:%s", SIM_DRIVER_NAME, pcTags ? pcTags : SIM_DEFAULT_TAGS);
+  free(pcTags);
+  pnd->driver_data = data;
+
+  // Alloc and init chip's data
+  if (pn53x_data_new(pnd, &sim_io) == NULL) {
+    perror("malloc");
+    sim_free(data);
+    nfc_device_free(pnd);
+    return NULL;
+  }
+  CHIP_DATA(pnd)->type = data->bPN533 ? PN533 : PN532;
+  pnd->driver = &sim_driver;
+
+  // Check communication using "Diagnose" command, with "Communication test" (0x00)
+  if (pn53x_check_communication(pnd) < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "pn53x_check_communication error");
+    sim_close(pnd);
+    return NULL;
+  }
+
+  pn53x_init(pnd);
+  return pnd;
+}
+
+static int
+sim_abort_command(nfc_device *pnd)
+{
+  // Commands never block
+  (void) pnd;
+  return NFC_SUCCESS;
+}
+
+const struct pn53x_io sim_io = {
+  .send       = sim_send,
+  .receive    = sim_receive,
+};
+
+const struct nfc_driver sim_driver = {
+  .name                             = SIM_DRIVER_NAME,
+  .scan_type                        = NOT_AVAILABLE,
+  .scan                             = NULL,
+  .open                             = sim_open,
+  .close                            = sim_close,
+  .strerror                         = pn53x_strerror,
+
+  .initiator_init                   = pn53x_initiator_init,
+  .initiator_init_secure_element    = NULL, // No secure-element support
+  .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_poll_target            = pn53x_initiator_poll_target,
+  .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
+  .initiator_deselect_target        = pn53x_initiator_deselect_target,
+  .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
+  .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
+  .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
+  .initiator_target_is_present      = pn53x_initiator_target_is_present,
+  .initiator_transceive_batch       = pn53x_initiator_transceive_batch,
+  .initiator_transceive_bytes_submit   = pn53x_initiator_transceive_bytes_submit,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
+  .initiator_transceive_bytes_cancel   = pn53x_initiator_transceive_bytes_cancel,
+
+  .target_init           = pn53x_target_init,
+  .target_send_bytes     = pn53x_target_send_bytes,
+  .target_receive_bytes  = pn53x_target_receive_bytes,
+  .target_send_bits      = pn53x_target_send_bits,
+  .target_receive_bits   = pn53x_target_receive_bits,
+
+  .device_set_property_bool     = pn53x_set_property_bool,
+  .device_set_property_int      = pn53x_set_property_int,
+  .device_set_properties        = pn53x_set_properties,
+  .get_supported_modulation     = pn53x_get_supported_modulation,
+  .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
+  .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
+
+  .abort_command  = sim_abort_command,
+  .idle           = pn53x_idle,
+  .powerdown      = pn53x_PowerDown,
+};
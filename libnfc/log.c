@@ -54,54 +54,140 @@ log_priority_to_str(const int priority)
 
 #include "log-internal.h"
 
+#if defined(_MSC_VER)
+#  define LOG_THREAD_LOCAL __declspec(thread)
+#else
+#  define LOG_THREAD_LOCAL __thread
+#endif
+
+#if defined(__GNUC__)
+#  define LOG_THRESHOLDS_STORE(t) __atomic_store_n(&log_thresholds, (t), __ATOMIC_RELAXED)
+#else
+#  define LOG_THRESHOLDS_STORE(t) (log_thresholds = (t))
+#endif
+
+#define LOG_GROUPS 7
+
+// See log_enabled(): read without lock by every log_put() call site
+volatile uint32_t log_thresholds = LOG_THRESHOLDS_UNDECIDED;
+// Number of live contexts using each group threshold, the most verbose wins
+static unsigned int log_threshold_users[LOG_GROUPS][5];
+static unsigned int log_contexts = 0;
+static nfc_mutex log_lock = NFC_MUTEX_INITIALIZER;
+// Per-thread silencing, see log_mute()
+static LOG_THREAD_LOCAL int log_muted = 0;
+
+/*
+ * Threshold of a group for a log_level value (see log_enabled())
+ */
+static uint32_t
+log_level_threshold(const uint32_t log_level, const uint8_t group)
+{
+  if (!log_level)
+    return 0;
+  return MAX(log_level & 0x00000003, (log_level >> (group * 2)) & 0x00000003) + 1;
+}
+
+static uint32_t
+log_level_to_thresholds(const uint32_t log_level)
+{
+  uint32_t thresholds = 0;
+  for (uint8_t group = 0; group < LOG_GROUPS; group++)
+    thresholds |= log_level_threshold(log_level, group) << (group * 3);
+  return thresholds;
+}
+
+static void
+log_register(const nfc_context *context, const bool add)
+{
+  nfc_mutex_lock(&log_lock);
+  for (uint8_t group = 0; group < LOG_GROUPS; group++) {
+    unsigned int *users = &log_threshold_users[group][log_level_threshold(context->log_level, group)];
+    if (add)
+      (*users)++;
+    else if (*users)
+      (*users)--;
+  }
+  if (add)
+    log_contexts++;
+  else if (log_contexts)
+    log_contexts--;
+
+  uint32_t thresholds = 0;
+  if (log_contexts) {
+    for (uint8_t group = 0; group < LOG_GROUPS; group++) {
+      uint32_t threshold = 4;
+      while (threshold && !log_threshold_users[group][threshold])
+        threshold--;
+      thresholds |= threshold << (group * 3);
+    }
+  } else {
+    // Back to the process environment, as before the first context
+    thresholds = LOG_THRESHOLDS_UNDECIDED;
+  }
+  LOG_THRESHOLDS_STORE(thresholds);
+  nfc_mutex_unlock(&log_lock);
+}
+
 void
 log_init(const nfc_context *context)
 {
-#ifdef ENVVARS
-  char str[32];
-  sprintf(str, "%"PRIu32, context->log_level);
-  setenv("LIBNFC_LOG_LEVEL", str, 1);
-#else
-  (void)context;
-#endif
+  log_register(context, true);
+}
+
+void
+log_exit(const nfc_context *context)
+{
+  log_register(context, false);
 }
 
 void
-log_exit(void)
+log_mute(const bool mute)
 {
+  if (mute) {
+    log_muted++;
+  } else if (log_muted) {
+    log_muted--;
+  }
 }
 
+// Callers go through the log_put() macro, which already checked log_enabled()
+#undef log_put
+
 void
 log_put(const uint8_t group, const char *category, const uint8_t priority, const char *format, ...)
 {
-  char *env_log_level = NULL;
+  if (log_muted)
+    return;
+
+  uint32_t thresholds = LOG_THRESHOLDS_LOAD();
+  if (thresholds == LOG_THRESHOLDS_UNDECIDED) {
+    // No context yet: the process environment is only read, never written
+    uint32_t log_level;
+    char *env_log_level = NULL;
 #ifdef ENVVARS
-  env_log_level = getenv("LIBNFC_LOG_LEVEL");
+    env_log_level = getenv("LIBNFC_LOG_LEVEL");
 #endif
-  uint32_t log_level;
-  if (NULL == env_log_level) {
-    // LIBNFC_LOG_LEVEL is not set
+    if (NULL == env_log_level) {
+      // LIBNFC_LOG_LEVEL is not set
 #ifdef DEBUG
-    log_level = 3;
+      log_level = 3;
 #else
-    log_level = 1;
+      log_level = 1;
 #endif
-  } else {
-    log_level = atoi(env_log_level);
+    } else {
+      log_level = atoi(env_log_level);
+    }
+    thresholds = log_level_to_thresholds(log_level);
   }
 
-  //  printf("log_level = %"PRIu32" group = %"PRIu8" priority = %"PRIu8"\n", log_level, group, priority);
-  if (log_level) { // If log is not disabled by log_level=none
-    if (((log_level & 0x00000003) >= priority) ||   // Global log level
-        (((log_level >> (group * 2)) & 0x00000003) >= priority)) { // Group log level
-
-      va_list va;
-      va_start(va, format);
-      log_put_internal("%s\t%s\t", log_priority_to_str(priority), category);
-      log_vput_internal(format, va);
-      log_put_internal("\n");
-      va_end(va);
-    }
+  if (((thresholds >> (group * 3)) & 0x7) > priority) {
+    va_list va;
+    va_start(va, format);
+    log_put_internal("%s\t%s\t", log_priority_to_str(priority), category);
+    log_vput_internal(format, va);
+    log_put_internal("\n");
+    va_end(va);
   }
 }
 
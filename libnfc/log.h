@@ -72,16 +72,45 @@ const char *log_priority_to_str(const int priority);
 #  endif
 
 void log_init(const nfc_context *context);
-void log_exit(void);
+void log_exit(const nfc_context *context);
+void log_mute(const bool mute);
 void log_put(const uint8_t group, const char *category, const uint8_t priority, const char *format, ...)
 #  if __has_attribute_format
 __attribute__((format(printf, 4, 5)))
 #  endif
 ;
+
+/*
+ * Effective level of each group for the live contexts, 3 bits per group:
+ * level + 1, or 0 when logging is disabled. All bits are set until a context
+ * exists, log_put() then decides from the environment.
+ */
+extern volatile uint32_t log_thresholds;
+#  define LOG_THRESHOLDS_UNDECIDED 0xffffffff
+
+#  if defined(__GNUC__)
+#    define LOG_THRESHOLDS_LOAD() __atomic_load_n(&log_thresholds, __ATOMIC_RELAXED)
+#  else
+#    define LOG_THRESHOLDS_LOAD() (log_thresholds)
+#  endif
+
+/*
+ * Whether a message of this group and priority could be output: checked
+ * before the arguments of log_put() are evaluated and before LOG_HEX formats
+ * anything, so disabled logging costs one load and one compare.
+ */
+#  define log_enabled(group, priority) (((LOG_THRESHOLDS_LOAD() >> ((group) * 3)) & 0x7) > (uint32_t)(priority))
+
+#  define log_put(group, category, priority, ...) do { \
+    if (log_enabled(group, priority)) \
+      log_put(group, category, priority, __VA_ARGS__); \
+  } while (0)
 #else
 // No logging
 #define log_init(nfc_context) ((void) 0)
-#define log_exit() ((void) 0)
+#define log_exit(nfc_context) ((void) 0)
+#define log_mute(mute) ((void) 0)
+#define log_enabled(group, priority) (false)
 #define log_put(group, category, priority, format, ...) do {} while (0)
 
 #endif // LOG
@@ -96,18 +125,24 @@ __attribute__((format(printf, 4, 5)))
     size_t	 __szPos; \
     char	 __acBuf[1024]; \
     size_t	 __szBuf = 0; \
+    static const char __acHex[] = "0123456789abcdef"; \
     if ((int)szBytes < 0) { \
       fprintf (stderr, "%s:%d: Attempt to print %d bytes!\n", __FILE__, __LINE__, (int)szBytes); \
       log_put (group, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s:%d: Attempt to print %d bytes!\n", __FILE__, __LINE__, (int)szBytes); \
       abort(); \
       break; \
     } \
+    if (!log_enabled(group, NFC_LOG_PRIORITY_DEBUG)) { \
+      break; \
+    } \
     snprintf (__acBuf + __szBuf, sizeof(__acBuf) - __szBuf, "%s: ", pcTag); \
     __szBuf += strlen (pcTag) + 2; \
-    for (__szPos=0; (__szPos < (size_t)(szBytes)) && (__szBuf < sizeof(__acBuf)); __szPos++) { \
-      snprintf (__acBuf + __szBuf, sizeof(__acBuf) - __szBuf, "%02x ",((uint8_t *)(pbtData))[__szPos]); \
-      __szBuf += 3; \
+    for (__szPos=0; (__szPos < (size_t)(szBytes)) && (__szBuf + 4 <= sizeof(__acBuf)); __szPos++) { \
+      __acBuf[__szBuf++] = __acHex[((uint8_t *)(pbtData))[__szPos] >> 4]; \
+      __acBuf[__szBuf++] = __acHex[((uint8_t *)(pbtData))[__szPos] & 0x0f]; \
+      __acBuf[__szBuf++] = ' '; \
     } \
+    __acBuf[MIN(__szBuf, sizeof(__acBuf) - 1)] = '\0'; \
     log_put (group, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", __acBuf); \
   } while (0);
 #  else
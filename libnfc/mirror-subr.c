@@ -34,6 +34,7 @@
 #endif // HAVE_CONFIG_H
 
 #include <stdio.h>
+#include <string.h>
 
 #include "mirror-subr.h"
 
@@ -66,17 +67,47 @@ mirror(uint8_t bt)
   return ByteMirror[bt];
 }
 
-static void
-mirror_bytes(uint8_t *pbts, size_t szLen)
+/**
+ * @brief Mirror the bits of every byte in a 64-bit word
+ */
+static inline uint64_t
+mirror_word(uint64_t x)
 {
-  size_t  szByteNr;
+  x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+  x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+  x = ((x >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((x & 0x0f0f0f0f0f0f0f0fULL) << 4);
+  return x;
+}
 
-  for (szByteNr = 0; szByteNr < szLen; szByteNr++) {
-    *pbts = ByteMirror[*pbts];
-    pbts++;
+/**
+ * @brief Copy \a szLen bytes from \a pbtSrc to \a pbtDst, mirroring each of them
+ *
+ * Bytes are mirrored eight at a time, the remaining ones through the table.
+ * \a pbtDst may be \a pbtSrc, buffers must not overlap otherwise.
+ */
+void
+mirror_buffer(uint8_t *pbtDst, const uint8_t *pbtSrc, size_t szLen)
+{
+  while (szLen >= sizeof(uint64_t)) {
+    uint64_t w;
+    memcpy(&w, pbtSrc, sizeof(w));
+    w = mirror_word(w);
+    memcpy(pbtDst, &w, sizeof(w));
+    pbtSrc += sizeof(w);
+    pbtDst += sizeof(w);
+    szLen -= sizeof(w);
+  }
+  while (szLen--) {
+    *pbtDst++ = ByteMirror[*pbtSrc++];
   }
 }
 
+static void
+mirror_bytes(uint8_t *pbts, size_t szLen)
+{
+  mirror_buffer(pbts, pbts, szLen);
+}
+
 uint32_t
 mirror32(uint32_t ui32Bits)
 {
@@ -0,0 +1,428 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-cache.c
+ * @brief Device discovery cache
+ *
+ * Devices found by auto-detection are stored in the file named by the
+ * scan_cache option, as the scan reported them, together with a fingerprint
+ * of the device nodes present in /dev and sysfs. No device is opened to
+ * fill or check the cache.
+ *
+ * A later nfc_list_devices() reuses the cached devices if the fingerprint
+ * still matches. In a given process, the cache is also kept in memory and
+ * trusted without hashing directories again until inotify reports a change
+ * in the watched directories. The watch is closed, and the cache kept in
+ * memory forgotten, when the last context exits. A cached device failing to
+ * open marks the file stale, so the next nfc_list_devices() scans again,
+ * whatever the process.
+ *
+ * Cached devices are only identified by their connstring: their firmware is
+ * not recorded, as reading it would mean opening every device.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifndef WIN32
+#  include <dirent.h>
+#  include <unistd.h>
+#endif
+#ifdef __linux__
+#  include <sys/inotify.h>
+#endif
+
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.general"
+
+#define SCAN_CACHE_MAX_DEVICES 16
+#define SCAN_CACHE_MAGIC       "libnfc-scan-cache 2"
+// Fingerprint of a cache file known to be stale, never matching the devices
+#define SCAN_CACHE_STALE       0
+
+struct scan_cache {
+  char     path[SCAN_CACHE_PATH_LENGTH];
+  uint64_t fingerprint;
+  bool     allow_intrusive_scan;
+  size_t   count;
+  nfc_connstring connstrings[SCAN_CACHE_MAX_DEVICES];
+};
+
+#ifndef WIN32
+
+// Last cache loaded or stored by this process
+static struct scan_cache scan_cache_memory;
+static bool scan_cache_memory_valid = false;
+// A device listed by the cache file failed to open, a scan must rewrite it
+static bool scan_cache_stale = false;
+static nfc_mutex scan_cache_lock = NFC_MUTEX_INITIALIZER;
+// Live contexts, the watch is closed with the last one
+static size_t scan_cache_contexts = 0;
+#ifdef __linux__
+static int scan_cache_inotify_fd = -1;
+#endif
+
+// Directories whose entries change when a device is plugged or unplugged
+static const char *scan_cache_watched_dirs[] = {
+  "/dev",
+  "/dev/bus/usb",
+  "/sys/bus/usb/devices",
+  NULL
+};
+
+static uint64_t
+fnv1a(const char *s)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  while (*s) {
+    h ^= (uint8_t) * s++;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/*
+ * Order-independent hash of the entries of dir, and of the entries of its
+ * subdirectories when recurse is set (used for /dev/bus/usb/NNN).
+ */
+static void
+scan_cache_hash_dir(const char *dir, const bool recurse, uint64_t *sum, uint64_t *count)
+{
+  DIR *d = opendir(dir);
+  if (!d)
+    return;
+
+  struct dirent *de;
+  while ((de = readdir(d)) != NULL) {
+    if (de->d_name[0] == '.')
+      continue;
+    *sum += fnv1a(de->d_name) ^ fnv1a(dir);
+    (*count)++;
+    if (recurse) {
+      char sub[SCAN_CACHE_PATH_LENGTH];
+      if (snprintf(sub, sizeof(sub), "%s/%s", dir, de->d_name) < (int) sizeof(sub))
+        scan_cache_hash_dir(sub, false, sum, count);
+    }
+  }
+  closedir(d);
+}
+
+static uint64_t
+scan_cache_fingerprint(void)
+{
+  uint64_t sum = 0, count = 0;
+  for (size_t i = 0; scan_cache_watched_dirs[i]; i++) {
+    scan_cache_hash_dir(scan_cache_watched_dirs[i], strcmp(scan_cache_watched_dirs[i], "/dev/bus/usb") == 0, &sum, &count);
+  }
+  const uint64_t fingerprint = sum ^ (count * 0x9e3779b97f4a7c15ULL);
+  return (fingerprint == SCAN_CACHE_STALE) ? fingerprint + 1 : fingerprint;
+}
+
+/*
+ * Start watching for hotplug events, or report whether some happened since
+ * last call. Returns true if the in-memory cache can still be trusted.
+ * Must be called with scan_cache_lock held.
+ */
+static bool
+scan_cache_watch(void)
+{
+#ifdef __linux__
+  if (scan_cache_inotify_fd < 0) {
+    if ((scan_cache_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+      return false;
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+    for (size_t i = 0; scan_cache_watched_dirs[i]; i++) {
+      inotify_add_watch(scan_cache_inotify_fd, scan_cache_watched_dirs[i], mask);
+      if (strcmp(scan_cache_watched_dirs[i], "/dev/bus/usb") == 0) {
+        DIR *d = opendir(scan_cache_watched_dirs[i]);
+        struct dirent *de;
+        while (d && (de = readdir(d)) != NULL) {
+          if (de->d_name[0] == '.')
+            continue;
+          char sub[SCAN_CACHE_PATH_LENGTH];
+          if (snprintf(sub, sizeof(sub), "%s/%s", scan_cache_watched_dirs[i], de->d_name) < (int) sizeof(sub))
+            inotify_add_watch(scan_cache_inotify_fd, sub, mask);
+        }
+        if (d)
+          closedir(d);
+      }
+    }
+    // Nothing could have been observed yet
+    return false;
+  }
+
+  bool changed = false;
+  char buf[4096];
+  while (read(scan_cache_inotify_fd, buf, sizeof(buf)) > 0)
+    changed = true;
+  return !changed;
+#else
+  return false;
+#endif
+}
+
+static void
+scan_cache_write(const struct scan_cache *cache)
+{
+  char tmp[SCAN_CACHE_PATH_LENGTH + 24];
+  if (snprintf(tmp, sizeof(tmp), "%s.%ld", cache->path, (long) getpid()) >= (int) sizeof(tmp))
+    return;
+
+  FILE *f = fopen(tmp, "w");
+  if (!f) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Unable to write scan cache %s", tmp);
+    return;
+  }
+  fprintf(f, "%s\n", SCAN_CACHE_MAGIC);
+  fprintf(f, "%016" PRIx64 " %d\n", cache->fingerprint, cache->allow_intrusive_scan ? 1 : 0);
+  for (size_t i = 0; i < cache->count; i++) {
+    fprintf(f, "%s\n", cache->connstrings[i]);
+  }
+  if ((fclose(f) != 0) || (rename(tmp, cache->path) != 0)) {
+    unlink(tmp);
+  }
+}
+
+static bool
+scan_cache_read(const char *path, struct scan_cache *cache)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return false;
+
+  char line[NFC_BUFSIZE_CONNSTRING + 1];
+  bool res = false;
+  int intrusive;
+
+  if (!fgets(line, sizeof(line), f) || strncmp(line, SCAN_CACHE_MAGIC "\n", sizeof(line)) != 0)
+    goto out;
+  if (!fgets(line, sizeof(line), f) || sscanf(line, "%" SCNx64 " %d", &cache->fingerprint, &intrusive) != 2)
+    goto out;
+  cache->allow_intrusive_scan = intrusive != 0;
+  cache->count = 0;
+  while (fgets(line, sizeof(line), f)) {
+    char *eol = strchr(line, '\n');
+    if (!eol || (cache->count == SCAN_CACHE_MAX_DEVICES))
+      goto out;
+    *eol = '\0';
+    strcpy(cache->connstrings[cache->count], line);
+    cache->count++;
+  }
+  snprintf(cache->path, sizeof(cache->path), "%s", path);
+  res = true;
+out:
+  fclose(f);
+  return res;
+}
+
+#endif // WIN32
+
+/*
+ * Account for a new context.
+ */
+void
+nfc_scan_cache_context_new(void)
+{
+#ifndef WIN32
+  nfc_mutex_lock(&scan_cache_lock);
+  scan_cache_contexts++;
+  nfc_mutex_unlock(&scan_cache_lock);
+#endif
+}
+
+/*
+ * Account for a context going away. With the last one, hotplug events can no
+ * longer be followed: close the watch and forget the cache kept in memory.
+ */
+void
+nfc_scan_cache_context_free(void)
+{
+#ifndef WIN32
+  nfc_mutex_lock(&scan_cache_lock);
+  if (scan_cache_contexts > 0)
+    scan_cache_contexts--;
+  if (scan_cache_contexts == 0) {
+#ifdef __linux__
+    if (scan_cache_inotify_fd >= 0) {
+      close(scan_cache_inotify_fd);
+      scan_cache_inotify_fd = -1;
+    }
+#endif
+    scan_cache_memory_valid = false;
+    scan_cache_stale = false;
+  }
+  nfc_mutex_unlock(&scan_cache_lock);
+#endif
+}
+
+/*
+ * Look for devices in the scan cache.
+ * Returns the number of devices copied to connstrings, or -1 if the cache
+ * is disabled, stale or unusable and a real scan is needed.
+ */
+int
+nfc_scan_cache_load(nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+#ifndef WIN32
+  if (context->scan_cache[0] == '\0')
+    return -1;
+
+  struct scan_cache cache;
+  bool trusted = false;
+
+  nfc_mutex_lock(&scan_cache_lock);
+  bool unchanged = scan_cache_watch();
+  if (scan_cache_stale && (strcmp(scan_cache_memory.path, context->scan_cache) == 0)) {
+    nfc_mutex_unlock(&scan_cache_lock);
+    return -1;
+  }
+  if (scan_cache_memory_valid && unchanged && (strcmp(scan_cache_memory.path, context->scan_cache) == 0)) {
+    memcpy(&cache, &scan_cache_memory, sizeof(cache));
+    trusted = true;
+  } else {
+    scan_cache_memory_valid = false;
+  }
+  nfc_mutex_unlock(&scan_cache_lock);
+
+  if (!trusted) {
+    if (!scan_cache_read(context->scan_cache, &cache))
+      return -1;
+    if (cache.fingerprint != scan_cache_fingerprint()) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Scan cache is stale: devices changed");
+      return -1;
+    }
+  }
+  if ((cache.allow_intrusive_scan != context->allow_intrusive_scan) || (cache.count > connstrings_len))
+    return -1;
+  if (!trusted) {
+    nfc_mutex_lock(&scan_cache_lock);
+    memcpy(&scan_cache_memory, &cache, sizeof(cache));
+    scan_cache_memory_valid = true;
+    nfc_mutex_unlock(&scan_cache_lock);
+  }
+
+  for (size_t i = 0; i < cache.count; i++)
+    memcpy(connstrings[i], cache.connstrings[i], sizeof(nfc_connstring));
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%ld device(s) found in scan cache", (unsigned long) cache.count);
+  return (int) cache.count;
+#else
+  (void) context;
+  (void) connstrings;
+  (void) connstrings_len;
+  return -1;
+#endif
+}
+
+/*
+ * Store the result of a real scan in the scan cache, if enabled.
+ */
+void
+nfc_scan_cache_store(nfc_context *context, const nfc_connstring connstrings[], const size_t szDevices)
+{
+#ifndef WIN32
+  if ((context->scan_cache[0] == '\0') || (szDevices > SCAN_CACHE_MAX_DEVICES))
+    return;
+
+  struct scan_cache cache;
+  snprintf(cache.path, sizeof(cache.path), "%s", context->scan_cache);
+  cache.allow_intrusive_scan = context->allow_intrusive_scan;
+  cache.count = szDevices;
+  memcpy(cache.connstrings, connstrings, szDevices * sizeof(nfc_connstring));
+
+  nfc_mutex_lock(&scan_cache_lock);
+  // Arm the watch before taking the fingerprint so no change is missed
+  scan_cache_watch();
+  nfc_mutex_unlock(&scan_cache_lock);
+  cache.fingerprint = scan_cache_fingerprint();
+
+  scan_cache_write(&cache);
+  nfc_mutex_lock(&scan_cache_lock);
+  memcpy(&scan_cache_memory, &cache, sizeof(cache));
+  scan_cache_memory_valid = true;
+  scan_cache_stale = false;
+  nfc_mutex_unlock(&scan_cache_lock);
+#else
+  (void) context;
+  (void) connstrings;
+  (void) szDevices;
+#endif
+}
+
+/*
+ * Mark the scan cache stale if it lists connstring, a device which failed to
+ * open. The file is rewritten with a fingerprint matching no devices, so the
+ * next nfc_list_devices() scans again, in this process or another one.
+ * Devices not coming from the cache are left alone.
+ * Returns true if connstring was listed by the cache.
+ */
+bool
+nfc_scan_cache_open_failed(const nfc_context *context, const nfc_connstring connstring)
+{
+#ifndef WIN32
+  if (context->scan_cache[0] == '\0')
+    return false;
+
+  struct scan_cache cache;
+  bool loaded = false;
+  nfc_mutex_lock(&scan_cache_lock);
+  if (scan_cache_memory_valid && (strcmp(scan_cache_memory.path, context->scan_cache) == 0)) {
+    memcpy(&cache, &scan_cache_memory, sizeof(cache));
+    loaded = true;
+  }
+  nfc_mutex_unlock(&scan_cache_lock);
+  // The cache may have been loaded by a context gone since
+  if (!loaded && (!scan_cache_read(context->scan_cache, &cache) || (cache.fingerprint == SCAN_CACHE_STALE)))
+    return false;
+
+  bool listed = false;
+  for (size_t i = 0; (i < cache.count) && !listed; i++)
+    listed = (strcmp(cache.connstrings[i], connstring) == 0);
+  if (!listed)
+    return false;
+
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Scan cache is stale: %s failed to open", connstring);
+  cache.fingerprint = SCAN_CACHE_STALE;
+  scan_cache_write(&cache);
+  nfc_mutex_lock(&scan_cache_lock);
+  scan_cache_memory_valid = false;
+  scan_cache_stale = true;
+  nfc_mutex_unlock(&scan_cache_lock);
+  return true;
+#else
+  (void) context;
+  (void) connstring;
+  return false;
+#endif
+}
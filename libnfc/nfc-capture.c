@@ -0,0 +1,241 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-capture.c
+ * @brief pcapng capture of the frames exchanged by all devices of a context
+ *
+ * Enabled by the capture_file option. Each device gets two interfaces when it
+ * first exchanges a frame: its host link, with PN53x frames (TFI, command code
+ * and data, without link framing) as LINKTYPE_USER0, and its RF side, with the
+ * frames carried by InDataExchange and InCommunicateThru as LINKTYPE_ISO_14443.
+ * Blocks are assembled in memory and written when the buffer is full or the
+ * context is freed.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#  include <time.h>
+#endif
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+#include "pcapng.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.capture"
+
+#define CAPTURE_BUFFER_SIZE (256 * 1024)
+
+struct nfc_capture {
+  nfc_mutex lock;
+  FILE   *f;
+  /** Interfaces described so far */
+  uint32_t interfaces;
+  /** Wall clock minus monotonic clock, in microseconds */
+  int64_t clock_offset_us;
+  size_t  szBuffer;
+  uint8_t abtBuffer[CAPTURE_BUFFER_SIZE];
+};
+
+static void
+nfc_capture_flush(struct nfc_capture *capture)
+{
+  if (capture->szBuffer && (fwrite(capture->abtBuffer, capture->szBuffer, 1, capture->f) != 1)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to write capture file");
+  }
+  capture->szBuffer = 0;
+}
+
+/*
+ * Room for a block of szBlock bytes, flushing the buffer first if needed
+ */
+static uint8_t *
+nfc_capture_block(struct nfc_capture *capture, const size_t szBlock)
+{
+  if (capture->szBuffer + szBlock > sizeof(capture->abtBuffer))
+    nfc_capture_flush(capture);
+  uint8_t *pbtBlock = capture->abtBuffer + capture->szBuffer;
+  capture->szBuffer += szBlock;
+  memset(pbtBlock, 0x00, szBlock);
+  return pbtBlock;
+}
+
+static uint8_t *
+put32(uint8_t *pbt, const uint32_t v)
+{
+  memcpy(pbt, &v, sizeof(v));
+  return pbt + sizeof(v);
+}
+
+static uint8_t *
+put16(uint8_t *pbt, const uint16_t v)
+{
+  memcpy(pbt, &v, sizeof(v));
+  return pbt + sizeof(v);
+}
+
+static uint8_t *
+put_option(uint8_t *pbt, const uint16_t code, const void *pValue, const size_t szValue)
+{
+  pbt = put16(pbt, code);
+  pbt = put16(pbt, (uint16_t) szValue);
+  if (szValue)
+    memcpy(pbt, pValue, szValue);
+  return pbt + PAD4(szValue);
+}
+
+static void
+nfc_capture_interface(struct nfc_capture *capture, const uint16_t linktype, const char *pcName, const char *pcDescription)
+{
+  const size_t szName = MIN(strlen(pcName), UINT16_MAX);
+  const size_t szDescription = MIN(strlen(pcDescription), UINT16_MAX);
+  const size_t szBlock = 20 + 4 + PAD4(szName) + 4 + PAD4(szDescription) + 4;
+  uint8_t *pbt = nfc_capture_block(capture, szBlock);
+
+  pbt = put32(pbt, PCAPNG_IDB);
+  pbt = put32(pbt, (uint32_t) szBlock);
+  pbt = put16(pbt, linktype);
+  pbt = put16(pbt, 0);
+  pbt = put32(pbt, 0);  // No snapshot length
+  pbt = put_option(pbt, PCAPNG_OPT_IF_NAME, pcName, szName);
+  pbt = put_option(pbt, PCAPNG_OPT_IF_DESCRIPTION, pcDescription, szDescription);
+  pbt = put_option(pbt, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+  put32(pbt, (uint32_t) szBlock);
+  capture->interfaces++;
+}
+
+int
+nfc_capture_open(nfc_context *context)
+{
+  struct nfc_capture *capture = malloc(sizeof(struct nfc_capture));
+  if (!capture) {
+    return NFC_ESOFT;
+  }
+  if (!(capture->f = fopen(context->capture_file, "wb"))) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to open capture file %s", context->capture_file);
+    free(capture);
+    return NFC_EIO;
+  }
+#ifndef WIN32
+  pthread_mutex_init(&capture->lock, NULL);
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  const int64_t now_us = ((int64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#else
+  InitializeSRWLock(&capture->lock);
+  FILETIME ft;
+  GetSystemTimeAsFileTime(&ft);
+  // 100 ns units since 1601-01-01
+  const int64_t now_us = (int64_t)((((uint64_t) ft.dwHighDateTime << 32) | ft.dwLowDateTime) / 10) - 11644473600000000LL;
+#endif
+  capture->clock_offset_us = now_us - (int64_t) nfc_monotonic_us();
+  capture->interfaces = 0;
+  capture->szBuffer = 0;
+
+  // Section header block, without options
+  uint8_t *pbt = nfc_capture_block(capture, 28);
+  pbt = put32(pbt, PCAPNG_SHB);
+  pbt = put32(pbt, 28);
+  pbt = put32(pbt, PCAPNG_BYTE_ORDER_MAGIC);
+  pbt = put16(pbt, 1);
+  pbt = put16(pbt, 0);
+  pbt = put32(pbt, 0xffffffff);  // Section length is not specified
+  pbt = put32(pbt, 0xffffffff);
+  put32(pbt, 28);
+
+  context->capture = capture;
+  return NFC_SUCCESS;
+}
+
+void
+nfc_capture_close(nfc_context *context)
+{
+  struct nfc_capture *capture = context->capture;
+  if (!capture)
+    return;
+  nfc_capture_flush(capture);
+  fclose(capture->f);
+#ifndef WIN32
+  pthread_mutex_destroy(&capture->lock);
+#endif
+  free(capture);
+  context->capture = NULL;
+}
+
+/*
+ * Write a frame exchanged by pnd, bIncoming telling whether it was received
+ * by the host (host link) or by the initiator (RF).
+ */
+void
+nfc_capture_frame(nfc_device *pnd, const nfc_capture_link ncl, const bool bIncoming, const uint8_t *pbtFrame, const size_t szFrame)
+{
+  struct nfc_capture *capture = pnd->context->capture;
+  const uint64_t timestamp = (uint64_t)((int64_t) nfc_monotonic_us() + capture->clock_offset_us);
+  const size_t szHeader = (ncl == NCL_RF) ? 4 : 0;
+  const size_t szPacket = szHeader + szFrame;
+  const size_t szBlock = 28 + PAD4(szPacket) + 8 + 4 + 4;
+
+  nfc_mutex_lock(&capture->lock);
+  if (pnd->capture_interface < 0) {
+    pnd->capture_interface = (int) capture->interfaces;
+    char acName[DEVICE_NAME_LENGTH + 8];
+    snprintf(acName, sizeof(acName), "%s host", pnd->name);
+    nfc_capture_interface(capture, LINKTYPE_USER0, acName, pnd->connstring);
+    snprintf(acName, sizeof(acName), "%s rf", pnd->name);
+    nfc_capture_interface(capture, LINKTYPE_ISO_14443, acName, pnd->connstring);
+  }
+
+  uint8_t *pbt = nfc_capture_block(capture, szBlock);
+  pbt = put32(pbt, PCAPNG_EPB);
+  pbt = put32(pbt, (uint32_t) szBlock);
+  pbt = put32(pbt, (uint32_t) pnd->capture_interface + ncl);
+  pbt = put32(pbt, (uint32_t)(timestamp >> 32));
+  pbt = put32(pbt, (uint32_t) timestamp);
+  pbt = put32(pbt, (uint32_t) szPacket);
+  pbt = put32(pbt, (uint32_t) szPacket);
+  if (ncl == NCL_RF) {
+    // Version, event, big endian length
+    *pbt++ = 0;
+    *pbt++ = bIncoming ? ISO14443_DATA_PICC_PCD : ISO14443_DATA_PCD_PICC;
+    *pbt++ = (uint8_t)(szFrame >> 8);
+    *pbt++ = (uint8_t) szFrame;
+  }
+  memcpy(pbt, pbtFrame, szFrame);
+  pbt += PAD4(szPacket) - szHeader;
+  const uint32_t flags = bIncoming ? PCAPNG_EPB_INBOUND : PCAPNG_EPB_OUTBOUND;
+  pbt = put_option(pbt, PCAPNG_OPT_EPB_FLAGS, &flags, sizeof(flags));
+  pbt = put_option(pbt, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+  put32(pbt, (uint32_t) szBlock);
+  nfc_mutex_unlock(&capture->lock);
+}
@@ -29,13 +29,13 @@
  * @brief Provide internal function to manipulate nfc_device type
  */
 
-#include <stdlib.h>
-#include <string.h>
-
 #ifdef HAVE_CONFIG_H
 #  include "config.h"
 #endif // HAVE_CONFIG_H
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "nfc-internal.h"
 
 nfc_device *
@@ -60,9 +60,24 @@ nfc_device_new(const nfc_context *context, const nfc_connstring connstring)
   res->bInfiniteSelect = false;
   res->bAutoIso14443_4 = false;
   res->last_error  = 0;
+  memset(&res->async, 0x00, sizeof(res->async));
   memcpy(res->connstring, connstring, sizeof(res->connstring));
   res->driver_data = NULL;
   res->chip_data   = NULL;
+  res->inventory   = NULL;
+  memset(&res->stats, 0x00, sizeof(res->stats));
+  res->trace       = NULL;
+  res->capture_interface = -1;
+
+#ifndef WIN32
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&res->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+#else
+  InitializeCriticalSection(&res->lock);
+#endif
 
   return res;
 }
@@ -71,6 +86,13 @@ void
 nfc_device_free(nfc_device *dev)
 {
   if (dev) {
+#ifndef WIN32
+    pthread_mutex_destroy(&dev->lock);
+#else
+    DeleteCriticalSection(&dev->lock);
+#endif
+    nfc_inventory_free(dev);
+    nfc_trace_free(dev);
     free(dev->driver_data);
     free(dev);
   }
@@ -30,13 +30,13 @@
 * @brief Provide some useful internal functions
 */
 
-#include <nfc/nfc.h>
-#include "nfc-internal.h"
-
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include <nfc/nfc.h>
+#include "nfc-internal.h"
+
 #ifdef CONFFILES
 #include "conf.h"
 #endif
@@ -44,6 +44,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#ifndef WIN32
+#  include <time.h>
+#endif
 
 #define LOG_GROUP    NFC_LOG_GROUP_GENERAL
 #define LOG_CATEGORY "libnfc.general"
@@ -70,6 +73,73 @@ string_as_boolean(const char *s, bool *value)
   }
 }
 
+uint64_t
+nfc_monotonic_ms(void)
+{
+#ifndef WIN32
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#else
+  return GetTickCount64();
+#endif
+}
+
+uint64_t
+nfc_monotonic_us(void)
+{
+#ifndef WIN32
+  // Served by the vDSO on Linux: no system call
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#else
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (uint64_t)((now.QuadPart / freq.QuadPart) * 1000000) + (uint64_t)(((now.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart);
+#endif
+}
+
+/*
+ * Count a latency of us microseconds in a log2-bucketed histogram.
+ */
+void
+nfc_stats_latency(uint64_t histogram[NFC_STATS_LATENCY_BUCKETS], const uint64_t us)
+{
+  size_t bucket = 0;
+  for (uint64_t v = us; v && (bucket < NFC_STATS_LATENCY_BUCKETS - 1); v >>= 1)
+    bucket++;
+  NFC_STATS_ADD(histogram[bucket], 1);
+}
+
+void
+nfc_sleep_ms(const int ms)
+{
+  if (ms <= 0)
+    return;
+#ifndef WIN32
+  struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+  nanosleep(&ts, NULL);
+#else
+  Sleep(ms);
+#endif
+}
+
+void
+nfc_sleep_us(const uint64_t us)
+{
+  if (!us)
+    return;
+#ifndef WIN32
+  struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000L };
+  nanosleep(&ts, NULL);
+#else
+  // Millisecond granularity, rounded up
+  Sleep((DWORD)((us + 999) / 1000));
+#endif
+}
+
 nfc_context *
 nfc_context_new(void)
 {
@@ -82,6 +152,14 @@ nfc_context_new(void)
   // Set default context values
   res->allow_autoscan = true;
   res->allow_intrusive_scan = false;
+  res->scan_timeout = 0;
+  res->scan_cache[0] = '\0';
+  res->capture_file[0] = '\0';
+  res->capture = NULL;
+  res->reactor = nfc_reactor_new();
+  res->scan_batch = NULL;
+  res->i2c_backend = NULL;
+  nfc_scan_cache_context_new();
 #ifdef DEBUG
   res->log_level = 3;
 #else
@@ -133,6 +211,26 @@ nfc_context_new(void)
   envvar = getenv("LIBNFC_INTRUSIVE_SCAN");
   string_as_boolean(envvar, &(res->allow_intrusive_scan));
 
+  // Load "scan timeout" option
+  envvar = getenv("LIBNFC_SCAN_TIMEOUT");
+  if (envvar) {
+    res->scan_timeout = atoi(envvar);
+  }
+
+  // Load "scan cache" option
+  envvar = getenv("LIBNFC_SCAN_CACHE");
+  if (envvar) {
+    strncpy(res->scan_cache, envvar, SCAN_CACHE_PATH_LENGTH - 1);
+    res->scan_cache[SCAN_CACHE_PATH_LENGTH - 1] = '\0';
+  }
+
+  // Load "capture file" option
+  envvar = getenv("LIBNFC_CAPTURE_FILE");
+  if (envvar) {
+    strncpy(res->capture_file, envvar, SCAN_CACHE_PATH_LENGTH - 1);
+    res->capture_file[SCAN_CACHE_PATH_LENGTH - 1] = '\0';
+  }
+
   // log level
   envvar = getenv("LIBNFC_LOG_LEVEL");
   if (envvar) {
@@ -151,18 +249,29 @@ nfc_context_new(void)
 #endif
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "allow_autoscan is set to %s", (res->allow_autoscan) ? "true" : "false");
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "allow_intrusive_scan is set to %s", (res->allow_intrusive_scan) ? "true" : "false");
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "scan_timeout is set to %d ms", res->scan_timeout);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "scan_cache is set to \"%s\"", res->scan_cache);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "capture_file is set to \"%s\"", res->capture_file);
 
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%d device(s) defined by user", res->user_defined_device_count);
   for (uint32_t i = 0; i < res->user_defined_device_count; i++) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "  #%d name: \"%s\", connstring: \"%s\"", i, res->user_defined_devices[i].name, res->user_defined_devices[i].connstring);
   }
+
+  // Capture is best effort: the context is usable without it
+  if (res->capture_file[0]) {
+    nfc_capture_open(res);
+  }
   return res;
 }
 
 void
 nfc_context_free(nfc_context *context)
 {
-  log_exit();
+  nfc_capture_close(context);
+  nfc_reactor_free(context->reactor);
+  nfc_scan_cache_context_free();
+  log_exit(context);
   free(context);
 }
 
@@ -260,3 +369,22 @@ connstring_decode(const nfc_connstring connstring, const char *driver_name, cons
   return res;
 }
 
+
+/*
+ * Tell if a batch of transceive has to stop after an item returned res
+ */
+bool
+nfc_batch_stop_on(const nfc_batch_stop stop, const int res)
+{
+  switch (res) {
+    case NFC_ERFTRANS:
+    case NFC_EMFCAUTHFAIL:
+    case NFC_ETGRELEASED:
+      return (stop & NBS_TARGET_ERROR) != 0;
+    default:
+      if (res < 0) {
+        return (stop & NBS_DEVICE_ERROR) != 0;
+      }
+  }
+  return false;
+}
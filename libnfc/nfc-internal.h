@@ -37,6 +37,11 @@
 #if !defined(_MSC_VER)
 #  include <sys/time.h>
 #endif
+#ifndef WIN32
+#  include <pthread.h>
+#else
+#  include <windows.h>
+#endif
 
 #include "nfc/nfc.h"
 
@@ -54,6 +59,30 @@
     return false; \
   }
 
+/**
+ * @brief Statically initialisable mutex guarding library-wide state
+ */
+#ifndef WIN32
+typedef pthread_mutex_t nfc_mutex;
+#  define NFC_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#  define nfc_mutex_lock(m)   pthread_mutex_lock(m)
+#  define nfc_mutex_unlock(m) pthread_mutex_unlock(m)
+#else
+typedef SRWLOCK nfc_mutex;
+#  define NFC_MUTEX_INITIALIZER SRWLOCK_INIT
+#  define nfc_mutex_lock(m)   AcquireSRWLockExclusive(m)
+#  define nfc_mutex_unlock(m) ReleaseSRWLockExclusive(m)
+#endif
+
+/**
+ * @brief Recursive mutex backing nfc_device_lock()
+ */
+#ifndef WIN32
+typedef pthread_mutex_t nfc_device_mutex;
+#else
+typedef CRITICAL_SECTION nfc_device_mutex;
+#endif
+
 #ifndef MIN
 #define MIN(a,b) (((a) < (b)) ? (a) : (b))
 #endif
@@ -140,6 +169,10 @@ struct nfc_driver {
   int (*initiator_transceive_bytes_timed)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx, uint32_t *cycles);
   int (*initiator_transceive_bits_timed)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar, uint8_t *pbtRx, uint8_t *pbtRxPar, uint32_t *cycles);
   int (*initiator_target_is_present)(struct nfc_device *pnd, const nfc_target *pnt);
+  int (*initiator_transceive_batch)(struct nfc_device *pnd, nfc_transceive_item items[], const size_t szItems, const nfc_batch_stop stop, int timeout);
+  int (*initiator_transceive_bytes_submit)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
+  int (*initiator_transceive_bytes_complete)(struct nfc_device *pnd, uint8_t *pbtRx, const size_t szRx);
+  int (*initiator_transceive_bytes_cancel)(struct nfc_device *pnd);
 
   int (*target_init)(struct nfc_device *pnd, nfc_target *pnt, uint8_t *pbtRx, const size_t szRx, int timeout);
   int (*target_send_bytes)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
@@ -149,9 +182,11 @@ struct nfc_driver {
 
   int (*device_set_property_bool)(struct nfc_device *pnd, const nfc_property property, const bool bEnable);
   int (*device_set_property_int)(struct nfc_device *pnd, const nfc_property property, const int value);
+  int (*device_set_properties)(struct nfc_device *pnd, const nfc_property_setting settings[], const size_t szSettings);
   int (*get_supported_modulation)(struct nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type **const supported_mt);
   int (*get_supported_baud_rate)(struct nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br);
   int (*device_get_information_about)(struct nfc_device *pnd, char **buf);
+  int (*device_get_pollfd)(struct nfc_device *pnd);
 
   int (*abort_command)(struct nfc_device *pnd);
   int (*idle)(struct nfc_device *pnd);
@@ -162,6 +197,7 @@ struct nfc_driver {
 #  define DEVICE_PORT_LENGTH  64
 
 #define MAX_USER_DEFINED_DEVICES 4
+#define SCAN_CACHE_PATH_LENGTH 256
 
 struct nfc_user_defined_device {
   char name[DEVICE_NAME_LENGTH];
@@ -177,6 +213,19 @@ struct nfc_user_defined_device {
 struct nfc_context {
   bool allow_autoscan;
   bool allow_intrusive_scan;
+  /** Time (in ms) given to device auto-detection, 0 waits for all drivers */
+  int scan_timeout;
+  /** File caching auto-detected devices, empty if disabled */
+  char scan_cache[SCAN_CACHE_PATH_LENGTH];
+  /** pcapng file capturing exchanged frames, empty if disabled */
+  char capture_file[SCAN_CACHE_PATH_LENGTH];
+  struct nfc_capture *capture;
+  /** Devices waiting for an asynchronous completion, NULL if unavailable */
+  struct nfc_reactor *reactor;
+  /** Driver scan this context is a copy for, NULL outside of scans */
+  struct nfc_scan_batch *scan_batch;
+  /** Bus behind I2C drivers, NULL for Linux i2c-dev: lets tests and benchmarks emulate a chip */
+  const struct i2c_backend *i2c_backend;
   uint32_t  log_level;
   struct nfc_user_defined_device user_defined_devices[MAX_USER_DEFINED_DEVICES];
   unsigned int user_defined_device_count;
@@ -185,6 +234,41 @@ struct nfc_context {
 nfc_context *nfc_context_new(void);
 void nfc_context_free(nfc_context *context);
 
+/**
+ * @brief Probe a single bus port
+ * @return true and fills \a connstring if a device answered on \a port
+ */
+typedef bool (*nfc_port_probe)(const nfc_context *context, const char *port, nfc_connstring connstring);
+
+size_t nfc_scan_drivers(const nfc_context *context, const struct nfc_driver *drivers[], const size_t szDrivers, nfc_connstring connstrings[], const size_t connstrings_len, bool *pbComplete);
+size_t nfc_scan_ports(const nfc_context *context, char *const ports[], nfc_port_probe probe, nfc_connstring connstrings[], const size_t connstrings_len);
+
+void nfc_scan_cache_context_new(void);
+void nfc_scan_cache_context_free(void);
+int  nfc_scan_cache_load(nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len);
+void nfc_scan_cache_store(nfc_context *context, const nfc_connstring connstrings[], const size_t szDevices);
+bool nfc_scan_cache_open_failed(const nfc_context *context, const nfc_connstring connstring);
+
+/**
+ * @struct nfc_async_transceive
+ * @brief Pending asynchronous transceive
+ */
+struct nfc_async_transceive {
+  /** Is a command submitted and waiting for its reply */
+  bool    pending;
+  /** Caller's receive buffer */
+  uint8_t *pbtRx;
+  size_t  szRx;
+  /** Timeout in milliseconds (0 means no timeout) */
+  int     timeout;
+  /** Monotonic date (in milliseconds) of the submission */
+  uint64_t submitted_ms;
+  nfc_transceive_callback callback;
+  void   *user_data;
+  /** File descriptor watched by the context reactor */
+  int     pollfd;
+};
+
 /**
  * @struct nfc_device
  * @brief NFC device information
@@ -214,17 +298,77 @@ struct nfc_device {
   uint8_t  btSupportByte;
   /** Last reported error */
   int     last_error;
+  /** Asynchronous transceive state */
+  struct nfc_async_transceive async;
+  /** Lock for callers sharing this device between threads */
+  nfc_device_mutex lock;
+  /** Inventory engine state, see nfc_inventory_start() */
+  struct nfc_inventory *inventory;
+  /** Performance counters, see nfc_device_get_stats() */
+  nfc_device_stats stats;
+  /** Binary frame trace, see nfc_device_trace_start() */
+  struct nfc_trace *trace;
+  /** First of the two capture interfaces of the device, -1 until described */
+  int     capture_interface;
 };
 
+/*
+ * Statistics are only updated by the thread using the device but may be read
+ * from any other: relaxed atomic accesses keep counters whole without locking.
+ */
+#if defined(__GNUC__)
+#  define NFC_STATS_LOAD(counter)     __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+#  define NFC_STATS_STORE(counter, v) __atomic_store_n(&(counter), (v), __ATOMIC_RELAXED)
+#else
+#  define NFC_STATS_LOAD(counter)     (counter)
+#  define NFC_STATS_STORE(counter, v) ((counter) = (v))
+#endif
+#define NFC_STATS_ADD(counter, n) NFC_STATS_STORE(counter, NFC_STATS_LOAD(counter) + (n))
+
 nfc_device *nfc_device_new(const nfc_context *context, const nfc_connstring connstring);
 void        nfc_device_free(nfc_device *dev);
 
 void string_as_boolean(const char *s, bool *value);
 
+void nfc_inventory_free(nfc_device *pnd);
+
+nfc_trace_record *nfc_trace_begin(nfc_device *pnd, const nfc_trace_direction ntd, const uint8_t btCmd, const size_t szFrame);
+void nfc_trace_commit(nfc_device *pnd, nfc_trace_record *pntr);
+void nfc_trace_error(nfc_device *pnd, const uint8_t btCmd, const int res);
+void nfc_trace_free(nfc_device *pnd);
+
+/**
+ * @enum nfc_capture_link
+ * @brief Side of the device a captured frame was exchanged on
+ */
+typedef enum {
+  /** Between the host and the chip */
+  NCL_HOST = 0,
+  /** Between the chip and the target */
+  NCL_RF = 1,
+} nfc_capture_link;
+
+int  nfc_capture_open(nfc_context *context);
+void nfc_capture_close(nfc_context *context);
+void nfc_capture_frame(nfc_device *pnd, const nfc_capture_link ncl, const bool bIncoming, const uint8_t *pbtFrame, const size_t szFrame);
+
+struct nfc_reactor *nfc_reactor_new(void);
+void nfc_reactor_free(struct nfc_reactor *reactor);
+int  nfc_reactor_add(nfc_device *pnd, const int fd);
+void nfc_reactor_remove(nfc_device *pnd);
+
+uint64_t nfc_monotonic_ms(void);
+uint64_t nfc_monotonic_us(void);
+void nfc_stats_latency(uint64_t histogram[NFC_STATS_LATENCY_BUCKETS], const uint64_t us);
+void nfc_sleep_ms(const int ms);
+void nfc_sleep_us(const uint64_t us);
+
 void iso14443_cascade_uid(const uint8_t abtUID[], const size_t szUID, uint8_t *pbtCascadedUID, size_t *pszCascadedUID);
 
 void prepare_initiator_data(const nfc_modulation nm, uint8_t **ppbtInitiatorData, size_t *pszInitiatorData);
 
 int connstring_decode(const nfc_connstring connstring, const char *driver_name, const char *bus_name, char **pparam1, char **pparam2);
 
+bool nfc_batch_stop_on(const nfc_batch_stop stop, const int res);
+
 #endif // __NFC_INTERNAL_H__
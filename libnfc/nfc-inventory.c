@@ -0,0 +1,308 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-inventory.c
+ * @brief Track targets entering and leaving the field
+ *
+ * The engine runs at most one RF operation per latency period: while a target
+ * is in the field it is pinged with nfc_initiator_target_is_present() (a
+ * single exchange with the selected target), otherwise the field is polled
+ * once with nfc_initiator_poll_target() (InAutoPoll on PN532), listening for
+ * up to a latency period or the time left to the caller. A failed ping
+ * is confirmed by a poll before a departure is reported, so a target which
+ * merely lost its selection state is not reported as gone.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.inventory"
+
+#define NFC_INVENTORY_MAX_MODULATIONS 16
+#define NFC_INVENTORY_EVENTS          32
+#define NFC_INVENTORY_DEFAULT_LATENCY 300
+
+struct nfc_inventory {
+  nfc_modulation anm[NFC_INVENTORY_MAX_MODULATIONS];
+  size_t  szModulations;
+  int     latency;
+  uint64_t next_round_ms;
+  /** Targets in the field: PN53x keep a single selected target */
+  bool    bPresent;
+  nfc_target nt;
+  /** No presence check for this target type, poll instead */
+  bool    bPresenceByPoll;
+  /** Pending events */
+  nfc_inventory_event events[NFC_INVENTORY_EVENTS];
+  size_t  head;
+  size_t  count;
+};
+
+static bool
+nfc_inventory_same_target(const nfc_target *pnt1, const nfc_target *pnt2)
+{
+  if (pnt1->nm.nmt != pnt2->nm.nmt)
+    return false;
+
+  const nfc_target_info *a = &pnt1->nti, *b = &pnt2->nti;
+  switch (pnt1->nm.nmt) {
+    case NMT_ISO14443A:
+      return (a->nai.szUidLen == b->nai.szUidLen) && (memcmp(a->nai.abtUid, b->nai.abtUid, a->nai.szUidLen) == 0);
+    case NMT_JEWEL:
+      return memcmp(a->nji.btId, b->nji.btId, sizeof(a->nji.btId)) == 0;
+    case NMT_BARCODE:
+      return (a->nti.szDataLen == b->nti.szDataLen) && (memcmp(a->nti.abtData, b->nti.abtData, a->nti.szDataLen) == 0);
+    case NMT_ISO14443B:
+      return memcmp(a->nbi.abtPupi, b->nbi.abtPupi, sizeof(a->nbi.abtPupi)) == 0;
+    case NMT_ISO14443BI:
+      return memcmp(a->nii.abtDIV, b->nii.abtDIV, sizeof(a->nii.abtDIV)) == 0;
+    case NMT_ISO14443B2SR:
+      return memcmp(a->nsi.abtUID, b->nsi.abtUID, sizeof(a->nsi.abtUID)) == 0;
+    case NMT_ISO14443B2CT:
+      return memcmp(a->nci.abtUID, b->nci.abtUID, sizeof(a->nci.abtUID)) == 0;
+    case NMT_ISO14443BICLASS:
+      return memcmp(a->nhi.abtUID, b->nhi.abtUID, sizeof(a->nhi.abtUID)) == 0;
+    case NMT_FELICA:
+      return memcmp(a->nfi.abtId, b->nfi.abtId, sizeof(a->nfi.abtId)) == 0;
+    case NMT_DEP:
+      return memcmp(a->ndi.abtNFCID3, b->ndi.abtNFCID3, sizeof(a->ndi.abtNFCID3)) == 0;
+  }
+  return false;
+}
+
+static void
+nfc_inventory_push(struct nfc_inventory *inv, const nfc_inventory_event_type type, const nfc_target *pnt)
+{
+  if (inv->count == NFC_INVENTORY_EVENTS) {
+    // Keep the most recent events
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "%s", "Event queue is full, oldest event dropped");
+    inv->head = (inv->head + 1) % NFC_INVENTORY_EVENTS;
+    inv->count--;
+  }
+  nfc_inventory_event *pnie = &inv->events[(inv->head + inv->count) % NFC_INVENTORY_EVENTS];
+  pnie->type = type;
+  pnie->nt = *pnt;
+  inv->count++;
+}
+
+static int
+nfc_inventory_round(nfc_device *pnd, struct nfc_inventory *inv, const uint64_t budget_ms)
+{
+  int res;
+
+  if (inv->bPresent && !inv->bPresenceByPoll) {
+    res = nfc_initiator_target_is_present(pnd, NULL);
+    switch (res) {
+      case NFC_SUCCESS:
+        return 0;
+      case NFC_EDEVNOTSUPP:
+        // No presence check for this target type
+        inv->bPresenceByPoll = true;
+        break;
+      case NFC_ETGRELEASED:
+      case NFC_ERFTRANS:
+      case NFC_ETIMEOUT:
+        // Confirm with a poll below
+        break;
+      default:
+        return res;
+    }
+  }
+
+  // Each modulation is polled for uiPeriod * 150 ms: fit the poll in the budget
+  uint64_t period = budget_ms / (150 * inv->szModulations);
+  period = MAX(1, MIN(period, 0x0F));
+
+  nfc_target nt;
+  memset(&nt, 0x00, sizeof(nt));
+  if ((res = nfc_initiator_poll_target(pnd, inv->anm, inv->szModulations, 1, (uint8_t)period, &nt)) < 0) {
+    if (res != NFC_ETIMEOUT)
+      return res;
+    res = 0;
+  }
+
+  if (res > 0) {
+    if (inv->bPresent && nfc_inventory_same_target(&inv->nt, &nt)) {
+      if (memcmp(&inv->nt.nti, &nt.nti, sizeof(nt.nti)) != 0)
+        nfc_inventory_push(inv, NIE_CHANGED, &nt);
+    } else {
+      if (inv->bPresent)
+        nfc_inventory_push(inv, NIE_DEPARTED, &inv->nt);
+      nfc_inventory_push(inv, NIE_ARRIVED, &nt);
+      inv->bPresent = true;
+      inv->bPresenceByPoll = false;
+    }
+    inv->nt = nt;
+  } else if (inv->bPresent) {
+    nfc_inventory_push(inv, NIE_DEPARTED, &inv->nt);
+    inv->bPresent = false;
+  }
+  return 0;
+}
+
+void
+nfc_inventory_free(nfc_device *pnd)
+{
+  free(pnd->inventory);
+  pnd->inventory = NULL;
+}
+
+/** @ingroup initiator
+ * @brief Start tracking targets entering and leaving the field
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ * @param pnmModulations desired modulations
+ * @param szModulations size of \a pnmModulations
+ * @param latency maximal detection latency in milliseconds (0 for default)
+ *
+ * The device has to be configured with nfc_initiator_init() first. Events are
+ * then retrieved with nfc_inventory_next_event(), which drives the polling
+ * and presence checks: one RF operation is done each \a latency period at most.
+ *
+ * @note The device must not be used for anything else until nfc_inventory_stop()
+ * except to exchange frames with the target reported by the last NIE_ARRIVED event.
+ */
+int
+nfc_inventory_start(nfc_device *pnd, const nfc_modulation *pnmModulations, const size_t szModulations, const int latency)
+{
+  if ((!szModulations) || (szModulations > NFC_INVENTORY_MAX_MODULATIONS) || (latency < 0)) {
+    return pnd->last_error = NFC_EINVARG;
+  }
+  if (pnd->async.pending) {
+    return pnd->last_error = NFC_EBUSY;
+  }
+
+  nfc_inventory_free(pnd);
+  struct nfc_inventory *inv = malloc(sizeof(struct nfc_inventory));
+  if (!inv) {
+    return pnd->last_error = NFC_ESOFT;
+  }
+  memcpy(inv->anm, pnmModulations, szModulations * sizeof(nfc_modulation));
+  inv->szModulations = szModulations;
+  inv->latency = latency ? latency : NFC_INVENTORY_DEFAULT_LATENCY;
+  inv->next_round_ms = 0;
+  inv->bPresent = false;
+  inv->bPresenceByPoll = false;
+  inv->head = 0;
+  inv->count = 0;
+  pnd->inventory = inv;
+
+  return pnd->last_error = NFC_SUCCESS;
+}
+
+/** @ingroup initiator
+ * @brief Wait for the next inventory event
+ * @return Returns 1 if an event was stored in \a pnie, 0 if \a timeout expired, otherwise returns libnfc's error code (negative value)
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ * @param[out] pnie event which happened
+ * @param timeout in milliseconds
+ *
+ * Events are reported in the order they were detected. Up to 32 events are
+ * kept when they are not retrieved, older ones are then dropped.
+ *
+ * If timeout equals to 0, the function blocks until an event occurs (or an error is raised).
+ * If timeout is positive, no round is started past it; a round may still
+ * overrun it by its minimal duration (150 ms per modulation polled).
+ * If timeout is negative, a round is run only if one is due and the function never sleeps.
+ */
+int
+nfc_inventory_next_event(nfc_device *pnd, nfc_inventory_event *pnie, const int timeout)
+{
+  struct nfc_inventory *inv = pnd->inventory;
+  if (!inv) {
+    return pnd->last_error = NFC_EINVARG;
+  }
+
+  const uint64_t deadline = nfc_monotonic_ms() + ((timeout > 0) ? timeout : 0);
+  for (;;) {
+    if (inv->count) {
+      *pnie = inv->events[inv->head];
+      inv->head = (inv->head + 1) % NFC_INVENTORY_EVENTS;
+      inv->count--;
+      return 1;
+    }
+
+    const uint64_t now = nfc_monotonic_ms();
+    if (now < inv->next_round_ms) {
+      if (timeout < 0)
+        return 0;
+      uint64_t wake = inv->next_round_ms;
+      if (timeout > 0) {
+        if (now >= deadline)
+          return 0;
+        wake = MIN(wake, deadline);
+      }
+      nfc_sleep_ms((int)(wake - now));
+      continue;
+    }
+
+    // Rounds may last a latency period or more: check the deadline before each
+    uint64_t budget = inv->latency;
+    if (timeout > 0) {
+      if (now >= deadline)
+        return 0;
+      budget = MIN(budget, deadline - now);
+    }
+
+    inv->next_round_ms = now + inv->latency;
+    int res;
+    if ((res = nfc_inventory_round(pnd, inv, budget)) < 0) {
+      return pnd->last_error = res;
+    }
+    if ((timeout < 0) && !inv->count)
+      return 0;
+  }
+}
+
+/** @ingroup initiator
+ * @brief Stop tracking targets
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ *
+ * Pending events are discarded. The last target seen, if any, stays selected.
+ */
+int
+nfc_inventory_stop(nfc_device *pnd)
+{
+  if (!pnd->inventory) {
+    return pnd->last_error = NFC_EINVARG;
+  }
+  nfc_inventory_free(pnd);
+  return pnd->last_error = NFC_SUCCESS;
+}
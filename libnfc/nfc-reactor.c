@@ -0,0 +1,353 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+
+/**
+ * @file nfc-reactor.c
+ * @brief Wait for asynchronous completions of all devices of a context
+ *
+ * Devices are watched from the submission of an asynchronous transceive to
+ * the delivery of its completion, so a single thread can drive any number of
+ * readers with nfc_context_process_events(). On Linux the watched descriptors
+ * are kept in an epoll set, which is not rebuilt for each wait and has no
+ * FD_SETSIZE limit; elsewhere poll(2) is used.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#  include <poll.h>
+#  include <unistd.h>
+#endif
+#ifdef __linux__
+#  include <sys/epoll.h>
+#endif
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.reactor"
+
+// Events handled per wait, others are left for the next call
+#define REACTOR_MAX_EVENTS 64
+
+struct nfc_reactor {
+  nfc_mutex lock;
+#ifdef __linux__
+  int     epfd;
+#else
+  /** Device polled first for events, so that none is starved */
+  size_t  szPollStart;
+#endif
+  /** Devices with a pending asynchronous transceive */
+  nfc_device **ppnd;
+  size_t  szDevices;
+  size_t  szAlloc;
+};
+
+struct nfc_reactor *
+nfc_reactor_new(void)
+{
+#ifndef WIN32
+  struct nfc_reactor *reactor = malloc(sizeof(struct nfc_reactor));
+  if (!reactor) {
+    return NULL;
+  }
+#  ifdef __linux__
+  if ((reactor->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to create epoll set: %s", strerror(errno));
+    free(reactor);
+    return NULL;
+  }
+#  else
+  reactor->szPollStart = 0;
+#  endif
+  pthread_mutex_init(&reactor->lock, NULL);
+  reactor->ppnd = NULL;
+  reactor->szDevices = 0;
+  reactor->szAlloc = 0;
+  return reactor;
+#else
+  return NULL;
+#endif
+}
+
+void
+nfc_reactor_free(struct nfc_reactor *reactor)
+{
+  if (!reactor) {
+    return;
+  }
+#ifdef __linux__
+  close(reactor->epfd);
+#endif
+#ifndef WIN32
+  pthread_mutex_destroy(&reactor->lock);
+#endif
+  free(reactor->ppnd);
+  free(reactor);
+}
+
+/**
+ * @brief Watch \a pnd until its pending asynchronous transceive completes
+ *
+ * The descriptor watched is the one of nfc_device_get_pollfd(), saved in the
+ * device until nfc_reactor_remove().
+ */
+int
+nfc_reactor_add(nfc_device *pnd, const int fd)
+{
+  struct nfc_reactor *reactor = pnd->context->reactor;
+  int res = NFC_SUCCESS;
+
+  pnd->async.pollfd = fd;
+  if (!reactor) {
+    return res;
+  }
+  nfc_mutex_lock(&reactor->lock);
+  if (reactor->szDevices == reactor->szAlloc) {
+    const size_t szAlloc = reactor->szAlloc ? reactor->szAlloc * 2 : 8;
+    nfc_device **ppnd = realloc(reactor->ppnd, szAlloc * sizeof(nfc_device *));
+    if (!ppnd) {
+      res = NFC_ESOFT;
+      goto out;
+    }
+    reactor->ppnd = ppnd;
+    reactor->szAlloc = szAlloc;
+  }
+#ifdef __linux__
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = pnd;
+  if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to watch %s: %s", pnd->name, strerror(errno));
+    res = NFC_ESOFT;
+    goto out;
+  }
+#endif
+  reactor->ppnd[reactor->szDevices++] = pnd;
+out:
+  nfc_mutex_unlock(&reactor->lock);
+  return res;
+}
+
+void
+nfc_reactor_remove(nfc_device *pnd)
+{
+  struct nfc_reactor *reactor = pnd->context->reactor;
+
+  if (!reactor) {
+    return;
+  }
+  nfc_mutex_lock(&reactor->lock);
+  for (size_t i = 0; i < reactor->szDevices; i++) {
+    if (reactor->ppnd[i] == pnd) {
+#ifdef __linux__
+      epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, pnd->async.pollfd, NULL);
+#endif
+      reactor->ppnd[i] = reactor->ppnd[--reactor->szDevices];
+      break;
+    }
+  }
+  nfc_mutex_unlock(&reactor->lock);
+}
+
+#ifndef WIN32
+/*
+ * Milliseconds until the earliest timeout of a watched transceive, bounded by
+ * \a timeout (negative if none)
+ */
+static int
+nfc_reactor_wait_time(struct nfc_reactor *reactor, int timeout)
+{
+  const uint64_t now_ms = nfc_monotonic_ms();
+
+  nfc_mutex_lock(&reactor->lock);
+  for (size_t i = 0; i < reactor->szDevices; i++) {
+    const nfc_device *pnd = reactor->ppnd[i];
+    if (pnd->async.timeout <= 0) {
+      continue;
+    }
+    const uint64_t deadline_ms = pnd->async.submitted_ms + (uint64_t) pnd->async.timeout;
+    const int remaining = (deadline_ms > now_ms) ? (int) MIN(deadline_ms - now_ms, (uint64_t) INT32_MAX) : 0;
+    if ((timeout < 0) || (remaining < timeout)) {
+      timeout = remaining;
+    }
+  }
+  nfc_mutex_unlock(&reactor->lock);
+  return timeout;
+}
+
+/*
+ * A watched device whose transceive timed out, or NULL
+ */
+static nfc_device *
+nfc_reactor_expired(struct nfc_reactor *reactor)
+{
+  const uint64_t now_ms = nfc_monotonic_ms();
+  nfc_device *res = NULL;
+
+  nfc_mutex_lock(&reactor->lock);
+  for (size_t i = 0; i < reactor->szDevices; i++) {
+    nfc_device *pnd = reactor->ppnd[i];
+    if ((pnd->async.timeout > 0) && ((now_ms - pnd->async.submitted_ms) >= (uint64_t) pnd->async.timeout)) {
+      res = pnd;
+      break;
+    }
+  }
+  nfc_mutex_unlock(&reactor->lock);
+  return res;
+}
+#endif
+
+/** @ingroup dev
+ * @brief Get a file descriptor to wait for asynchronous events on all devices of a context
+ * @return Returns a file descriptor on success, otherwise returns libnfc's error code (negative value)
+ * @param context The context to operate on
+ *
+ * The returned file descriptor becomes readable when any device of \a context
+ * has an asynchronous transceive ready to be completed by
+ * nfc_context_process_events(), so it can be nested into another event loop.
+ * It is owned by the context and must not be closed by the caller.
+ *
+ * @note Only available on Linux, NFC_EDEVNOTSUPP is returned elsewhere.
+ */
+int
+nfc_context_get_pollfd(nfc_context *context)
+{
+  if (!context->reactor) {
+    return NFC_ESOFT;
+  }
+#ifdef __linux__
+  return context->reactor->epfd;
+#else
+  return NFC_EDEVNOTSUPP;
+#endif
+}
+
+/** @ingroup dev
+ * @brief Process asynchronous events on all devices of a context
+ * @return Returns the number of completions delivered, otherwise returns libnfc's error code (negative value)
+ * @param context The context to operate on
+ * @param timeout in milliseconds to wait for an event: 0 does not wait, a negative value waits until an event occurs
+ *
+ * This function waits for the answer of any asynchronous transceive submitted
+ * with nfc_initiator_transceive_bytes_async() on a device of \a context, then
+ * calls nfc_device_process_events() on the devices which got one. Transceives
+ * which timed out are completed with NFC_ETIMEOUT: the wait never outlasts the
+ * earliest of their timeouts.
+ */
+int
+nfc_context_process_events(nfc_context *context, int timeout)
+{
+#ifndef WIN32
+  struct nfc_reactor *reactor = context->reactor;
+  nfc_device *apnd[REACTOR_MAX_EVENTS];
+  int n;
+  int delivered = 0;
+
+  if (!reactor) {
+    return NFC_ESOFT;
+  }
+
+  timeout = nfc_reactor_wait_time(reactor, timeout);
+#  ifdef __linux__
+  struct epoll_event events[REACTOR_MAX_EVENTS];
+  n = epoll_wait(reactor->epfd, events, REACTOR_MAX_EVENTS, timeout);
+  for (int i = 0; i < n; i++) {
+    apnd[i] = events[i].data.ptr;
+  }
+#  else
+  // Every device is polled, only the events handled are capped
+  nfc_mutex_lock(&reactor->lock);
+  const nfds_t nfds = reactor->szDevices;
+  struct pollfd *pfds = malloc(nfds * sizeof(struct pollfd));
+  nfc_device **ppnd = malloc(nfds * sizeof(nfc_device *));
+  if (nfds && (!pfds || !ppnd)) {
+    nfc_mutex_unlock(&reactor->lock);
+    free(pfds);
+    free(ppnd);
+    return NFC_ESOFT;
+  }
+  for (nfds_t i = 0; i < nfds; i++) {
+    ppnd[i] = reactor->ppnd[i];
+    pfds[i].fd = ppnd[i]->async.pollfd;
+    pfds[i].events = POLLIN;
+    pfds[i].revents = 0;
+  }
+  const size_t szStart = nfds ? reactor->szPollStart % nfds : 0;
+  nfc_mutex_unlock(&reactor->lock);
+  if ((n = poll(pfds, nfds, timeout)) > 0) {
+    size_t szNext = szStart;
+    n = 0;
+    for (nfds_t i = 0; (i < nfds) && (n < REACTOR_MAX_EVENTS); i++) {
+      const size_t j = (szStart + i) % nfds;
+      if (pfds[j].revents) {
+        apnd[n++] = ppnd[j];
+        szNext = j + 1;
+      }
+    }
+    // Devices left over are looked at first next time
+    nfc_mutex_lock(&reactor->lock);
+    reactor->szPollStart = szNext;
+    nfc_mutex_unlock(&reactor->lock);
+  }
+  free(pfds);
+  free(ppnd);
+#  endif
+  if (n < 0) {
+    if (EINTR == errno) {
+      return 0;
+    }
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to wait for events: %s", strerror(errno));
+    return NFC_EIO;
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (nfc_device_process_events(apnd[i]) > 0)
+      delivered++;
+  }
+  // Completing a device removes it from the reactor
+  nfc_device *pnd;
+  while ((pnd = nfc_reactor_expired(reactor)) != NULL) {
+    if ((n = nfc_device_process_events(pnd)) < 0)
+      return n;
+    delivered += n;
+  }
+  return delivered;
+#else
+  (void) context;
+  (void) timeout;
+  return NFC_EDEVNOTSUPP;
+#endif
+}
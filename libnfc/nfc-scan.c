@@ -0,0 +1,387 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-scan.c
+ * @brief Concurrent device discovery
+ *
+ * Driver scans, and port probes inside bus scanners, are independent and
+ * mostly spent waiting on I/O timeouts: they are run concurrently, each one
+ * filling its own slots, and results are merged in submission order so the
+ * outcome does not depend on scheduling.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.general"
+
+struct nfc_scan_task {
+  /** Driver to scan, or NULL for a port probe */
+  const struct nfc_driver *driver;
+  nfc_port_probe probe;
+  char    port[NFC_BUFSIZE_CONNSTRING];
+  /** Task's own output slots */
+  nfc_connstring *connstrings;
+  size_t  connstrings_len;
+  size_t  found;
+  bool    done;
+  /** Completed after the deadline: found devices are not reported */
+  bool    late;
+  /** Next task probing a port, see nfc_scan_port_claim() */
+  struct nfc_scan_task *next_probing;
+  struct nfc_scan_batch *batch;
+#ifndef WIN32
+  pthread_t thread;
+  bool    bThread;
+#endif
+};
+
+struct nfc_scan_batch {
+  /** Copy of the caller's context, which tasks see as their own */
+  nfc_context context;
+  /** Outermost batch of the scan: this one, or the driver scan it is run from */
+  struct nfc_scan_batch *root;
+  size_t  pending;
+#ifndef WIN32
+  pthread_mutex_t lock;
+  pthread_cond_t  cond;
+  /** Root only: the scan is given up, ports are not probed anymore */
+  bool    aborted;
+  /** Root only: ports being probed, by any driver, and their changes */
+  struct nfc_scan_task *probing;
+  pthread_cond_t  port_cond;
+#endif
+  size_t  task_count;
+  struct nfc_scan_task tasks[];
+};
+
+/*
+ * Wait until no other driver probes the port of task, and claim it: drivers
+ * sharing a bus would otherwise open the same port at once and mix their
+ * settings and frames. Returns false when the scan has been given up.
+ */
+static bool
+nfc_scan_port_claim(struct nfc_scan_task *task)
+{
+#ifndef WIN32
+  struct nfc_scan_batch *root = task->batch->root;
+  bool claimed = false;
+
+  pthread_mutex_lock(&root->lock);
+  while (!root->aborted) {
+    const struct nfc_scan_task *probing = root->probing;
+    while (probing && strcmp(probing->port, task->port))
+      probing = probing->next_probing;
+    if (!probing) {
+      task->next_probing = root->probing;
+      root->probing = task;
+      claimed = true;
+      break;
+    }
+    pthread_cond_wait(&root->port_cond, &root->lock);
+  }
+  pthread_mutex_unlock(&root->lock);
+  return claimed;
+#else
+  (void) task;
+  return true;
+#endif
+}
+
+static void
+nfc_scan_port_release(struct nfc_scan_task *task)
+{
+#ifndef WIN32
+  struct nfc_scan_batch *root = task->batch->root;
+
+  pthread_mutex_lock(&root->lock);
+  struct nfc_scan_task **pp = &root->probing;
+  while (*pp != task)
+    pp = &(*pp)->next_probing;
+  *pp = task->next_probing;
+  pthread_cond_broadcast(&root->port_cond);
+  pthread_mutex_unlock(&root->lock);
+#else
+  (void) task;
+#endif
+}
+
+static void
+nfc_scan_task_run(struct nfc_scan_task *task)
+{
+  const nfc_context *context = &task->batch->context;
+
+  if (task->driver) {
+    task->found = task->driver->scan(context, task->connstrings, task->connstrings_len);
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%ld device(s) found using %s driver", (unsigned long) task->found, task->driver->name);
+  } else if (nfc_scan_port_claim(task)) {
+    task->found = task->probe(context, task->port, task->connstrings[0]) ? 1 : 0;
+    nfc_scan_port_release(task);
+  }
+}
+
+static struct nfc_scan_batch *
+nfc_scan_batch_new(const nfc_context *context, const size_t task_count, const size_t slots_per_task)
+{
+  struct nfc_scan_batch *batch = malloc(sizeof(struct nfc_scan_batch) + (task_count * sizeof(struct nfc_scan_task)));
+  if (!batch)
+    return NULL;
+  nfc_connstring *slots = malloc(task_count * slots_per_task * sizeof(nfc_connstring));
+  if (!slots) {
+    free(batch);
+    return NULL;
+  }
+
+  memcpy(&batch->context, context, sizeof(nfc_context));
+  // Port probes run from a driver scan share the driver scan's claims
+  batch->root = context->scan_batch ? context->scan_batch : batch;
+  batch->context.scan_batch = batch->root;
+  batch->pending = 0;
+  batch->task_count = task_count;
+  for (size_t i = 0; i < task_count; i++) {
+    struct nfc_scan_task *task = &batch->tasks[i];
+    task->driver = NULL;
+    task->probe = NULL;
+    task->port[0] = '\0';
+    task->connstrings = slots + (i * slots_per_task);
+    task->connstrings_len = slots_per_task;
+    task->found = 0;
+    task->done = false;
+    task->late = false;
+    task->next_probing = NULL;
+    task->batch = batch;
+#ifndef WIN32
+    task->bThread = false;
+#endif
+  }
+#ifndef WIN32
+  pthread_mutex_init(&batch->lock, NULL);
+  pthread_cond_init(&batch->cond, NULL);
+  batch->aborted = false;
+  batch->probing = NULL;
+  pthread_cond_init(&batch->port_cond, NULL);
+#endif
+  return batch;
+}
+
+static void
+nfc_scan_batch_free(struct nfc_scan_batch *batch)
+{
+#ifndef WIN32
+  pthread_cond_destroy(&batch->port_cond);
+  pthread_cond_destroy(&batch->cond);
+  pthread_mutex_destroy(&batch->lock);
+#endif
+  // Slots of all tasks are allocated at once
+  free(batch->tasks[0].connstrings);
+  free(batch);
+}
+
+#ifndef WIN32
+static void *
+nfc_scan_task_thread(void *arg)
+{
+  struct nfc_scan_task *task = arg;
+  struct nfc_scan_batch *batch = task->batch;
+
+  nfc_scan_task_run(task);
+
+  pthread_mutex_lock(&batch->lock);
+  task->done = true;
+  batch->pending--;
+  pthread_cond_signal(&batch->cond);
+  pthread_mutex_unlock(&batch->lock);
+  return NULL;
+}
+
+/*
+ * Give up the scan: ports not probed yet are skipped, and tasks waiting to
+ * probe a port return at once.
+ */
+static void
+nfc_scan_batch_abort(struct nfc_scan_batch *root)
+{
+  pthread_mutex_lock(&root->lock);
+  root->aborted = true;
+  pthread_cond_broadcast(&root->port_cond);
+  pthread_mutex_unlock(&root->lock);
+}
+#endif
+
+/*
+ * Run all tasks of batch, report at most timeout ms (0 waits for all) of
+ * results and merge them in task order. Tasks still running at the deadline
+ * are aborted and waited for, since they use the caller's context and may
+ * hold ports opened: none outlives the call. The batch is released.
+ */
+static size_t
+nfc_scan_batch_run(struct nfc_scan_batch *batch, const int timeout, nfc_connstring connstrings[], const size_t connstrings_len, bool *pbComplete)
+{
+  size_t device_found = 0;
+  bool bComplete = true;
+
+#ifndef WIN32
+  struct timespec deadline;
+  if (timeout > 0) {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+  }
+
+  for (size_t i = 0; i < batch->task_count; i++) {
+    struct nfc_scan_task *task = &batch->tasks[i];
+
+    pthread_mutex_lock(&batch->lock);
+    batch->pending++;
+    pthread_mutex_unlock(&batch->lock);
+    if (pthread_create(&task->thread, NULL, nfc_scan_task_thread, task) == 0) {
+      task->bThread = true;
+    } else {
+      // Out of threads: do it ourselves
+      nfc_scan_task_run(task);
+      pthread_mutex_lock(&batch->lock);
+      task->done = true;
+      batch->pending--;
+      pthread_mutex_unlock(&batch->lock);
+    }
+  }
+
+  pthread_mutex_lock(&batch->lock);
+  while (batch->pending) {
+    if (timeout > 0) {
+      if (pthread_cond_timedwait(&batch->cond, &batch->lock, &deadline) == ETIMEDOUT)
+        break;
+    } else {
+      pthread_cond_wait(&batch->cond, &batch->lock);
+    }
+  }
+  const bool bLate = (batch->pending > 0);
+  for (size_t i = 0; i < batch->task_count; i++)
+    batch->tasks[i].late = !batch->tasks[i].done;
+  pthread_mutex_unlock(&batch->lock);
+
+  if (bLate)
+    nfc_scan_batch_abort(batch->root);
+  for (size_t i = 0; i < batch->task_count; i++) {
+    if (batch->tasks[i].bThread)
+      pthread_join(batch->tasks[i].thread, NULL);
+  }
+#else
+  (void) timeout;
+  for (size_t i = 0; i < batch->task_count; i++) {
+    nfc_scan_task_run(&batch->tasks[i]);
+    batch->tasks[i].done = true;
+  }
+#endif
+
+  for (size_t i = 0; i < batch->task_count; i++) {
+    const struct nfc_scan_task *task = &batch->tasks[i];
+    if (task->late) {
+      bComplete = false;
+      if (task->driver)
+        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "%s driver scan exceeded the %d ms scan timeout", task->driver->name, timeout);
+      continue;
+    }
+    for (size_t j = 0; (j < task->found) && (device_found < connstrings_len); j++) {
+      memcpy(connstrings[device_found], task->connstrings[j], sizeof(nfc_connstring));
+      device_found++;
+    }
+  }
+
+  nfc_scan_batch_free(batch);
+
+  if (pbComplete)
+    *pbComplete = bComplete;
+  return device_found;
+}
+
+/*
+ * Run the scan of every driver concurrently and merge found devices in
+ * drivers order. Drivers still scanning after the context's scan_timeout
+ * are aborted, their devices are not reported and *pbComplete is set to
+ * false. Ports they are probing are closed before returning.
+ */
+size_t
+nfc_scan_drivers(const nfc_context *context, const struct nfc_driver *drivers[], const size_t szDrivers, nfc_connstring connstrings[], const size_t connstrings_len, bool *pbComplete)
+{
+  *pbComplete = true;
+  if (!szDrivers || !connstrings_len)
+    return 0;
+
+  struct nfc_scan_batch *batch = nfc_scan_batch_new(context, szDrivers, connstrings_len);
+  if (!batch) {
+    perror("malloc");
+    *pbComplete = false;
+    return 0;
+  }
+  for (size_t i = 0; i < szDrivers; i++)
+    batch->tasks[i].driver = drivers[i];
+
+  return nfc_scan_batch_run(batch, context->scan_timeout, connstrings, connstrings_len, pbComplete);
+}
+
+/*
+ * Probe every port of the NULL terminated ports array concurrently and merge
+ * found devices in ports order.
+ */
+size_t
+nfc_scan_ports(const nfc_context *context, char *const ports[], nfc_port_probe probe, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  size_t port_count = 0;
+  while (ports[port_count])
+    port_count++;
+  if (!port_count || !connstrings_len)
+    return 0;
+
+  struct nfc_scan_batch *batch = nfc_scan_batch_new(context, port_count, 1);
+  if (!batch) {
+    perror("malloc");
+    return 0;
+  }
+  for (size_t i = 0; i < port_count; i++) {
+    batch->tasks[i].probe = probe;
+    strncpy(batch->tasks[i].port, ports[i], sizeof(batch->tasks[i].port) - 1);
+    batch->tasks[i].port[sizeof(batch->tasks[i].port) - 1] = '\0';
+  }
+
+  // The deadline, if any, is enforced on the whole driver scan
+  return nfc_scan_batch_run(batch, 0, connstrings, connstrings_len, NULL);
+}
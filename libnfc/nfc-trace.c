@@ -0,0 +1,245 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-trace.c
+ * @brief Binary trace of the frames exchanged with the chip
+ *
+ * Records are written in a ring by the thread using the device, without
+ * locking nor formatting, and may be dumped from any thread: each record
+ * carries its sequence number, cleared while the record is written, so the
+ * dump skips records overwritten under its feet (seqlock).
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.trace"
+
+#define NFC_TRACE_DEFAULT_RECORDS 4096
+#define NFC_TRACE_MAX_RECORDS     (1 << 20)
+#define NFC_TRACE_PATH_LENGTH     1024
+
+#if defined(__GNUC__)
+#  define NFC_TRACE_LOAD(v)      __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#  define NFC_TRACE_STORE(v, n)  __atomic_store_n(&(v), (n), __ATOMIC_RELEASE)
+#  define NFC_TRACE_WMB()        __atomic_thread_fence(__ATOMIC_RELEASE)
+#  define NFC_TRACE_RMB()        __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#else
+#  define NFC_TRACE_LOAD(v)      (v)
+#  define NFC_TRACE_STORE(v, n)  ((v) = (n))
+#  define NFC_TRACE_WMB()        ((void) 0)
+#  define NFC_TRACE_RMB()        ((void) 0)
+#endif
+
+struct nfc_trace {
+  /** Number of records minus one, the ring size is a power of two */
+  size_t  szMask;
+  /** Records written so far */
+  uint64_t head;
+  /** Dump the ring there when an exchange fails, unless empty */
+  char    acErrorDump[NFC_TRACE_PATH_LENGTH];
+  nfc_trace_record records[];
+};
+
+void
+nfc_trace_free(nfc_device *pnd)
+{
+  free(pnd->trace);
+  pnd->trace = NULL;
+}
+
+/*
+ * Reserve the next record of the ring, to be filled by the caller then
+ * published with nfc_trace_commit(). Returns NULL when tracing is off.
+ */
+nfc_trace_record *
+nfc_trace_begin(nfc_device *pnd, const nfc_trace_direction ntd, const uint8_t btCmd, const size_t szFrame)
+{
+  struct nfc_trace *trace = pnd->trace;
+  if (!trace)
+    return NULL;
+
+  nfc_trace_record *pntr = &trace->records[trace->head & trace->szMask];
+  NFC_TRACE_STORE(pntr->sequence, 0);
+  NFC_TRACE_WMB();
+  pntr->timestamp = nfc_monotonic_us();
+  pntr->length = (uint16_t) MIN(szFrame, UINT16_MAX);
+  pntr->direction = (uint8_t) ntd;
+  pntr->command = btCmd;
+  return pntr;
+}
+
+void
+nfc_trace_commit(nfc_device *pnd, nfc_trace_record *pntr)
+{
+  struct nfc_trace *trace = pnd->trace;
+  const uint64_t head = trace->head + 1;
+  NFC_TRACE_STORE(pntr->sequence, (uint32_t) head);
+  NFC_TRACE_STORE(trace->head, head);
+}
+
+/*
+ * Record a failed exchange, then dump the ring if requested for failures
+ * other than timeouts and aborts.
+ */
+void
+nfc_trace_error(nfc_device *pnd, const uint8_t btCmd, const int res)
+{
+  nfc_trace_record *pntr;
+  if (!(pntr = nfc_trace_begin(pnd, NTD_ERROR, btCmd, sizeof(int32_t))))
+    return;
+  const int32_t error = res;
+  memcpy(pntr->payload, &error, sizeof(error));
+  nfc_trace_commit(pnd, pntr);
+
+  if (pnd->trace->acErrorDump[0] && (res != NFC_ETIMEOUT) && (res != NFC_EOPABORTED)) {
+    if (nfc_device_trace_dump(pnd, pnd->trace->acErrorDump) < 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to dump trace to %s", pnd->trace->acErrorDump);
+    }
+  }
+}
+
+/** @ingroup dev
+ * @brief Start recording frames exchanged with the chip
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ * @param szRecords number of records kept, rounded up to a power of two (0 for default)
+ * @param pcErrorDump file where the trace is dumped each time an exchange fails, or NULL
+ *
+ * Commands, replies and failures are recorded as \a nfc_trace_record in a ring
+ * which keeps the most recent ones. Any previous trace is discarded.
+ * A trace file is rendered by the nfc-trace-decode utility.
+ */
+int
+nfc_device_trace_start(nfc_device *pnd, const size_t szRecords, const char *pcErrorDump)
+{
+  if ((szRecords > NFC_TRACE_MAX_RECORDS) || (pcErrorDump && (strlen(pcErrorDump) >= NFC_TRACE_PATH_LENGTH))) {
+    return pnd->last_error = NFC_EINVARG;
+  }
+  size_t szRing = 1;
+  while (szRing < (szRecords ? szRecords : NFC_TRACE_DEFAULT_RECORDS))
+    szRing <<= 1;
+
+  nfc_trace_free(pnd);
+  // Zeroed records have no valid sequence number
+  struct nfc_trace *trace = calloc(1, sizeof(struct nfc_trace) + szRing * sizeof(nfc_trace_record));
+  if (!trace) {
+    return pnd->last_error = NFC_ESOFT;
+  }
+  trace->szMask = szRing - 1;
+  if (pcErrorDump)
+    strcpy(trace->acErrorDump, pcErrorDump);
+  pnd->trace = trace;
+
+  return pnd->last_error = NFC_SUCCESS;
+}
+
+/** @ingroup dev
+ * @brief Write recorded frames to a file
+ * @return Returns the number of records written, otherwise returns libnfc's error code (negative value)
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ * @param pcPath file to write, replaced if it exists
+ *
+ * This function can be called from any thread while the device is used, but
+ * not concurrently with nfc_device_trace_start() or nfc_device_trace_stop().
+ * Records overwritten while they are read are skipped.
+ */
+int
+nfc_device_trace_dump(nfc_device *pnd, const char *pcPath)
+{
+  const struct nfc_trace *trace = pnd->trace;
+  if (!trace) {
+    return NFC_EINVARG;
+  }
+
+  const size_t szRing = trace->szMask + 1;
+  nfc_trace_record *records = malloc(szRing * sizeof(nfc_trace_record));
+  if (!records) {
+    return NFC_ESOFT;
+  }
+
+  const uint64_t head = NFC_TRACE_LOAD(trace->head);
+  const uint64_t first = (head > szRing) ? head - szRing : 0;
+  uint32_t count = 0;
+  for (uint64_t seq = first + 1; seq <= head; seq++) {
+    const nfc_trace_record *pntr = &trace->records[(seq - 1) & trace->szMask];
+    const uint32_t before = NFC_TRACE_LOAD(pntr->sequence);
+    memcpy(&records[count], pntr, sizeof(nfc_trace_record));
+    NFC_TRACE_RMB();
+    if ((before == (uint32_t) seq) && (NFC_TRACE_LOAD(pntr->sequence) == before))
+      count++;
+  }
+
+  nfc_trace_header header;
+  memset(&header, 0x00, sizeof(header));
+  memcpy(header.magic, NFC_TRACE_MAGIC, sizeof(header.magic));
+  header.version = NFC_TRACE_VERSION;
+  header.record_size = sizeof(nfc_trace_record);
+  header.count = count;
+  header.dropped = (uint32_t) MIN(head - count, UINT32_MAX);
+  // Truncated, header.device was zeroed
+  memcpy(header.device, pnd->name, MIN(strlen(pnd->name), sizeof(header.device) - 1));
+
+  int res = (int) count;
+  FILE *f = fopen(pcPath, "wb");
+  if (!f) {
+    res = NFC_EIO;
+  } else {
+    if ((fwrite(&header, sizeof(header), 1, f) != 1) ||
+        (count && (fwrite(records, sizeof(nfc_trace_record), count, f) != count)))
+      res = NFC_EIO;
+    if (fclose(f) != 0)
+      res = NFC_EIO;
+  }
+  free(records);
+  return res;
+}
+
+/** @ingroup dev
+ * @brief Stop recording frames and discard the trace
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ */
+int
+nfc_device_trace_stop(nfc_device *pnd)
+{
+  if (!pnd->trace) {
+    return pnd->last_error = NFC_EINVARG;
+  }
+  nfc_trace_free(pnd);
+  return pnd->last_error = NFC_SUCCESS;
+}
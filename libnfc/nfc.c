@@ -81,6 +81,10 @@
 #include <stddef.h>
 #include <string.h>
 #include <assert.h>
+#ifndef WIN32
+#  include <poll.h>
+#  include <time.h>
+#endif
 
 #include <nfc/nfc.h>
 
@@ -116,6 +120,14 @@
 #  include "drivers/pn532_uart.h"
 #endif /* DRIVER_PN532_UART_ENABLED */
 
+#if defined (DRIVER_REPLAY_ENABLED)
+#  include "drivers/replay.h"
+#endif /* DRIVER_REPLAY_ENABLED */
+
+#if defined (DRIVER_SIM_ENABLED)
+#  include "drivers/sim.h"
+#endif /* DRIVER_SIM_ENABLED */
+
 #if defined (DRIVER_PN532_SPI_ENABLED)
 #  include "drivers/pn532_spi.h"
 #endif /* DRIVER_PN532_SPI_ENABLED */
@@ -138,6 +150,12 @@ struct nfc_driver_list {
 };
 
 const struct nfc_driver_list *nfc_drivers = NULL;
+// Guards nfc_drivers and nfc_drivers_refcount; list entries are only ever
+// prepended, so a head snapshot stays valid until the last nfc_exit()
+static nfc_mutex nfc_drivers_lock = NFC_MUTEX_INITIALIZER;
+static unsigned int nfc_drivers_refcount = 0;
+
+#define NFC_MAX_SCANNED_DRIVERS 32
 
 // descritions for debugging
 const char *nfc_property_name[] = {
@@ -158,44 +176,74 @@ const char *nfc_property_name[] = {
   "NP_FORCE_SPEED_106"
 };
 
+static int
+nfc_register_driver_locked(const struct nfc_driver *ndr)
+{
+  struct nfc_driver_list *pndl = (struct nfc_driver_list *)malloc(sizeof(struct nfc_driver_list));
+  if (!pndl)
+    return NFC_ESOFT;
+
+  pndl->driver = ndr;
+  pndl->next = nfc_drivers;
+  nfc_drivers = pndl;
+
+  return NFC_SUCCESS;
+}
+
+// Must be called with nfc_drivers_lock held
 static void
 nfc_drivers_init(void)
 {
 #if defined (DRIVER_PN53X_USB_ENABLED)
-  nfc_register_driver(&pn53x_usb_driver);
+  nfc_register_driver_locked(&pn53x_usb_driver);
 #endif /* DRIVER_PN53X_USB_ENABLED */
 #if defined (DRIVER_PCSC_ENABLED)
-  nfc_register_driver(&pcsc_driver);
+  nfc_register_driver_locked(&pcsc_driver);
 #endif /* DRIVER_ACR122_PCSC_ENABLED */
 #if defined (DRIVER_ACR122_PCSC_ENABLED)
-  nfc_register_driver(&acr122_pcsc_driver);
+  nfc_register_driver_locked(&acr122_pcsc_driver);
 #endif /* DRIVER_ACR122_PCSC_ENABLED */
 #if defined (DRIVER_ACR122_USB_ENABLED)
-  nfc_register_driver(&acr122_usb_driver);
+  nfc_register_driver_locked(&acr122_usb_driver);
 #endif /* DRIVER_ACR122_USB_ENABLED */
 #if defined (DRIVER_ACR122S_ENABLED)
-  nfc_register_driver(&acr122s_driver);
+  nfc_register_driver_locked(&acr122s_driver);
 #endif /* DRIVER_ACR122S_ENABLED */
 #if defined (DRIVER_PN532_UART_ENABLED)
-  nfc_register_driver(&pn532_uart_driver);
+  nfc_register_driver_locked(&pn532_uart_driver);
 #endif /* DRIVER_PN532_UART_ENABLED */
 #if defined (DRIVER_PN532_SPI_ENABLED)
-  nfc_register_driver(&pn532_spi_driver);
+  nfc_register_driver_locked(&pn532_spi_driver);
 #endif /* DRIVER_PN532_SPI_ENABLED */
 #if defined (DRIVER_PN532_I2C_ENABLED)
-  nfc_register_driver(&pn532_i2c_driver);
+  nfc_register_driver_locked(&pn532_i2c_driver);
 #endif /* DRIVER_PN532_I2C_ENABLED */
 #if defined (DRIVER_ARYGON_ENABLED)
-  nfc_register_driver(&arygon_driver);
+  nfc_register_driver_locked(&arygon_driver);
 #endif /* DRIVER_ARYGON_ENABLED */
 #if defined (DRIVER_PN71XX_ENABLED)
-  nfc_register_driver(&pn71xx_driver);
+  nfc_register_driver_locked(&pn71xx_driver);
 #endif /* DRIVER_PN71XX_ENABLED */
+#if defined (DRIVER_REPLAY_ENABLED)
+  nfc_register_driver_locked(&replay_driver);
+#endif /* DRIVER_REPLAY_ENABLED */
+#if defined (DRIVER_SIM_ENABLED)
+  nfc_register_driver_locked(&sim_driver);
+#endif /* DRIVER_SIM_ENABLED */
 }
 
 static int
 nfc_device_validate_modulation(nfc_device *pnd, const nfc_mode mode, const nfc_modulation *nm);
 
+static const struct nfc_driver_list *
+nfc_drivers_head(void)
+{
+  nfc_mutex_lock(&nfc_drivers_lock);
+  const struct nfc_driver_list *pndl = nfc_drivers;
+  nfc_mutex_unlock(&nfc_drivers_lock);
+  return pndl;
+}
+
 /** @ingroup lib
  * @brief Register an NFC device driver with libnfc.
  * This function registers a driver with libnfc, the caller is responsible of managing the lifetime of the
@@ -211,21 +259,20 @@ nfc_register_driver(const struct nfc_driver *ndr)
     return NFC_EINVARG;
   }
 
-  struct nfc_driver_list *pndl = (struct nfc_driver_list *)malloc(sizeof(struct nfc_driver_list));
-  if (!pndl)
-    return NFC_ESOFT;
+  nfc_mutex_lock(&nfc_drivers_lock);
+  int res = nfc_register_driver_locked(ndr);
+  nfc_mutex_unlock(&nfc_drivers_lock);
 
-  pndl->driver = ndr;
-  pndl->next = nfc_drivers;
-  nfc_drivers = pndl;
-
-  return NFC_SUCCESS;
+  return res;
 }
 
 /** @ingroup lib
  * @brief Initialize libnfc.
  * This function must be called before calling any other libnfc function
  * @param context Output location for nfc_context
+ *
+ * @note Several contexts may coexist, possibly created from different threads:
+ * built-in drivers are registered by the first one and released by the last nfc_exit().
  */
 void
 nfc_init(nfc_context **context)
@@ -235,8 +282,11 @@ nfc_init(nfc_context **context)
     perror("malloc");
     return;
   }
+  nfc_mutex_lock(&nfc_drivers_lock);
+  nfc_drivers_refcount++;
   if (!nfc_drivers)
     nfc_drivers_init();
+  nfc_mutex_unlock(&nfc_drivers_lock);
 }
 
 /** @ingroup lib
@@ -247,49 +297,31 @@ nfc_init(nfc_context **context)
 void
 nfc_exit(nfc_context *context)
 {
-  while (nfc_drivers) {
-    struct nfc_driver_list *pndl = (struct nfc_driver_list *) nfc_drivers;
-    nfc_drivers = pndl->next;
-    free(pndl);
+  nfc_mutex_lock(&nfc_drivers_lock);
+  if (nfc_drivers_refcount)
+    nfc_drivers_refcount--;
+  if (!nfc_drivers_refcount) {
+    while (nfc_drivers) {
+      struct nfc_driver_list *pndl = (struct nfc_driver_list *) nfc_drivers;
+      nfc_drivers = pndl->next;
+      free(pndl);
+    }
   }
+  nfc_mutex_unlock(&nfc_drivers_lock);
 
   nfc_context_free(context);
 }
 
-/** @ingroup dev
- * @brief Open a NFC device
- * @param context The context to operate on.
- * @param connstring The device connection string if specific device is wanted, \c NULL otherwise
- * @return Returns pointer to a \a nfc_device struct if successfull; otherwise returns \c NULL value.
- *
- * If \e connstring is \c NULL, the first available device from \a nfc_list_devices function is used.
- *
- * If \e connstring is set, this function will try to claim the right device using information provided by \e connstring.
- *
- * When it has successfully claimed a NFC device, memory is allocated to save the device information.
- * It will return a pointer to a \a nfc_device struct.
- * This pointer should be supplied by every next functions of libnfc that should perform an action with this device.
- *
- * @note Depending on the desired operation mode, the device needs to be configured by using nfc_initiator_init() or nfc_target_init(),
- * optionally followed by manual tuning of the parameters if the default parameters are not suiting your goals.
+/*
+ * Open the device named by ncs with the first driver able to.
  */
-nfc_device *
-nfc_open(nfc_context *context, const nfc_connstring connstring)
+static nfc_device *
+nfc_open_connstring(nfc_context *context, const nfc_connstring ncs)
 {
   nfc_device *pnd = NULL;
 
-  nfc_connstring ncs;
-  if (connstring == NULL) {
-    if (!nfc_list_devices(context, &ncs, 1)) {
-      return NULL;
-    }
-  } else {
-    strncpy(ncs, connstring, sizeof(nfc_connstring));
-    ncs[sizeof(nfc_connstring) - 1] = '\0';
-  }
-
   // Search through the device list for an available device
-  const struct nfc_driver_list *pndl = nfc_drivers;
+  const struct nfc_driver_list *pndl = nfc_drivers_head();
   while (pndl) {
     const struct nfc_driver *ndr = pndl->driver;
 
@@ -329,6 +361,53 @@ nfc_open(nfc_context *context, const nfc_connstring connstring)
   return NULL;
 }
 
+/** @ingroup dev
+ * @brief Open a NFC device
+ * @param context The context to operate on.
+ * @param connstring The device connection string if specific device is wanted, \c NULL otherwise
+ * @return Returns pointer to a \a nfc_device struct if successfull; otherwise returns \c NULL value.
+ *
+ * If \e connstring is \c NULL, the first available device from \a nfc_list_devices function is used.
+ * If that device came from the scan cache and fails to open, devices are scanned again once.
+ *
+ * If \e connstring is set, this function will try to claim the right device using information provided by \e connstring.
+ *
+ * When it has successfully claimed a NFC device, memory is allocated to save the device information.
+ * It will return a pointer to a \a nfc_device struct.
+ * This pointer should be supplied by every next functions of libnfc that should perform an action with this device.
+ *
+ * @note Depending on the desired operation mode, the device needs to be configured by using nfc_initiator_init() or nfc_target_init(),
+ * optionally followed by manual tuning of the parameters if the default parameters are not suiting your goals.
+ */
+nfc_device *
+nfc_open(nfc_context *context, const nfc_connstring connstring)
+{
+  nfc_device *pnd = NULL;
+
+  nfc_connstring ncs;
+  if (connstring == NULL) {
+    if (!nfc_list_devices(context, &ncs, 1)) {
+      return NULL;
+    }
+    if ((pnd = nfc_open_connstring(context, ncs)) != NULL)
+      return pnd;
+    // The device may have come from a stale scan cache: scan for real once
+    if (!nfc_scan_cache_open_failed(context, ncs) || !nfc_list_devices(context, &ncs, 1))
+      return NULL;
+    if ((pnd = nfc_open_connstring(context, ncs)) == NULL)
+      nfc_scan_cache_open_failed(context, ncs);
+    return pnd;
+  }
+
+  strncpy(ncs, connstring, sizeof(nfc_connstring));
+  ncs[sizeof(nfc_connstring) - 1] = '\0';
+  if ((pnd = nfc_open_connstring(context, ncs)) == NULL) {
+    // The device may have come from a stale scan cache
+    nfc_scan_cache_open_failed(context, ncs);
+  }
+  return pnd;
+}
+
 /** @ingroup dev
  * @brief Close from a NFC device
  * @param pnd \a nfc_device struct pointer that represent currently used device
@@ -339,6 +418,9 @@ void
 nfc_close(nfc_device *pnd)
 {
   if (pnd) {
+    if (pnd->async.pending) {
+      nfc_reactor_remove(pnd);
+    }
     // Close, clean up and release the device
     pnd->driver->close(pnd);
   }
@@ -365,30 +447,10 @@ nfc_list_devices(nfc_context *context, nfc_connstring connstrings[], const size_
       // let's make sure the device exists
       nfc_device *pnd = NULL;
 
-#ifdef ENVVARS
-      char *env_log_level = getenv("LIBNFC_LOG_LEVEL");
-      char *old_env_log_level = NULL;
-      // do it silently
-      if (env_log_level) {
-        if ((old_env_log_level = malloc(strlen(env_log_level) + 1)) == NULL) {
-          log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to malloc()");
-          return 0;
-        }
-        strcpy(old_env_log_level, env_log_level);
-      }
-      setenv("LIBNFC_LOG_LEVEL", "0", 1);
-#endif // ENVVARS
-
+      // do it silently, without touching the process environment
+      log_mute(true);
       pnd = nfc_open(context, context->user_defined_devices[i].connstring);
-
-#ifdef ENVVARS
-      if (old_env_log_level) {
-        setenv("LIBNFC_LOG_LEVEL", old_env_log_level, 1);
-        free(old_env_log_level);
-      } else {
-        unsetenv("LIBNFC_LOG_LEVEL");
-      }
-#endif // ENVVARS
+      log_mute(false);
 
       if (pnd) {
         nfc_close(pnd);
@@ -410,20 +472,27 @@ nfc_list_devices(nfc_context *context, nfc_connstring connstrings[], const size_
 
   // Device auto-detection
   if (context->allow_autoscan) {
-    const struct nfc_driver_list *pndl = nfc_drivers;
-    while (pndl) {
+    const int cached = nfc_scan_cache_load(context, connstrings + device_found, connstrings_len - device_found);
+    if (cached >= 0)
+      return device_found + cached;
+
+    const struct nfc_driver *drivers[NFC_MAX_SCANNED_DRIVERS];
+    size_t szDrivers = 0;
+    const struct nfc_driver_list *pndl = nfc_drivers_head();
+    while (pndl && (szDrivers < NFC_MAX_SCANNED_DRIVERS)) {
       const struct nfc_driver *ndr = pndl->driver;
       if ((ndr->scan_type == NOT_INTRUSIVE) || ((context->allow_intrusive_scan) && (ndr->scan_type == INTRUSIVE))) {
-        size_t _device_found = ndr->scan(context, connstrings + (device_found), connstrings_len - (device_found));
-        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%ld device(s) found using %s driver", (unsigned long) _device_found, ndr->name);
-        if (_device_found > 0) {
-          device_found += _device_found;
-          if (device_found == connstrings_len)
-            break;
-        }
+        drivers[szDrivers++] = ndr;
       } // scan_type is INTRUSIVE but not allowed or NOT_AVAILABLE
       pndl = pndl->next;
     }
+    // Drivers are scanned concurrently, found devices are kept in drivers order
+    bool bComplete;
+    const size_t scanned = nfc_scan_drivers(context, drivers, szDrivers, connstrings + device_found, connstrings_len - device_found, &bComplete);
+    // Only cache results that were neither cut by the deadline nor by connstrings_len
+    if (bComplete && (device_found + scanned < connstrings_len))
+      nfc_scan_cache_store(context, (const nfc_connstring *)(connstrings + device_found), scanned);
+    device_found += scanned;
   } else if (context->user_defined_device_count == 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "Warning: %s", "user must specify device(s) manually when autoscan is disabled");
   }
@@ -469,6 +538,59 @@ nfc_device_set_property_bool(nfc_device *pnd, const nfc_property property, const
   HAL(device_set_property_bool, pnd, property, bEnable);
 }
 
+/** @ingroup properties
+ * @brief Set several device properties at once
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ * @param settings array of \a nfc_property_setting
+ * @param szSettings number of settings in \a settings
+ *
+ * Has the same effect as setting each property with nfc_device_set_property_int()
+ * (timeouts) or nfc_device_set_property_bool() (other properties), but devices
+ * which support it check all settings before changing anything, skip the ones
+ * matching the current state and group the others into as few commands as
+ * possible.
+ *
+ * Settings are not applied in a given order and the last setting of a property
+ * wins: e.g. dropping then raising the RF field needs two calls.
+ *
+ * The call is not atomic. Invalid or unsupported settings are reported before
+ * anything changes on devices checking them up front, but if a command to the
+ * device fails, the settings applied before it are kept and the device state
+ * is unspecified: set the properties again, or call nfc_initiator_init().
+ */
+int
+nfc_device_set_properties(nfc_device *pnd, const nfc_property_setting settings[], const size_t szSettings)
+{
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "set_properties (%u settings)", (unsigned) szSettings);
+  pnd->last_error = 0;
+  if (pnd->driver->device_set_properties) {
+    return pnd->driver->device_set_properties(pnd, settings, szSettings);
+  }
+
+  // Fallback: set each property on its own
+  for (size_t i = 0; i < szSettings; i++) {
+    int res;
+    if ((unsigned) settings[i].property > NP_FORCE_SPEED_106) {
+      pnd->last_error = NFC_EINVARG;
+      return pnd->last_error;
+    }
+    switch (settings[i].property) {
+      case NP_TIMEOUT_COMMAND:
+      case NP_TIMEOUT_ATR:
+      case NP_TIMEOUT_COM:
+        res = nfc_device_set_property_int(pnd, settings[i].property, settings[i].value);
+        break;
+      default:
+        res = nfc_device_set_property_bool(pnd, settings[i].property, settings[i].value != 0);
+        break;
+    }
+    if (res < 0)
+      return res;
+  }
+  return NFC_SUCCESS;
+}
+
 /** @ingroup initiator
  * @brief Initialize NFC device as initiator (reader)
  * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
@@ -493,29 +615,26 @@ int
 nfc_initiator_init(nfc_device *pnd)
 {
   int res = 0;
+  const nfc_property_setting settings[] = {
+    // Enable field so more power consuming cards can power themselves up
+    { NP_ACTIVATE_FIELD, true },
+    // Let the device try forever to find a target/tag
+    { NP_INFINITE_SELECT, true },
+    // Activate auto ISO14443-4 switching by default
+    { NP_AUTO_ISO14443_4, true },
+    // Force 14443-A mode
+    { NP_FORCE_ISO14443_A, true },
+    // Force speed at 106kbps
+    { NP_FORCE_SPEED_106, true },
+    // Disallow invalid frame
+    { NP_ACCEPT_INVALID_FRAMES, false },
+    // Disallow multiple frames
+    { NP_ACCEPT_MULTIPLE_FRAMES, false },
+  };
   // Drop the field for a while
   if ((res = nfc_device_set_property_bool(pnd, NP_ACTIVATE_FIELD, false)) < 0)
     return res;
-  // Enable field so more power consuming cards can power themselves up
-  if ((res = nfc_device_set_property_bool(pnd, NP_ACTIVATE_FIELD, true)) < 0)
-    return res;
-  // Let the device try forever to find a target/tag
-  if ((res = nfc_device_set_property_bool(pnd, NP_INFINITE_SELECT, true)) < 0)
-    return res;
-  // Activate auto ISO14443-4 switching by default
-  if ((res = nfc_device_set_property_bool(pnd, NP_AUTO_ISO14443_4, true)) < 0)
-    return res;
-  // Force 14443-A mode
-  if ((res = nfc_device_set_property_bool(pnd, NP_FORCE_ISO14443_A, true)) < 0)
-    return res;
-  // Force speed at 106kbps
-  if ((res = nfc_device_set_property_bool(pnd, NP_FORCE_SPEED_106, true)) < 0)
-    return res;
-  // Disallow invalid frame
-  if ((res = nfc_device_set_property_bool(pnd, NP_ACCEPT_INVALID_FRAMES, false)) < 0)
-    return res;
-  // Disallow multiple frames
-  if ((res = nfc_device_set_property_bool(pnd, NP_ACCEPT_MULTIPLE_FRAMES, false)) < 0)
+  if ((res = nfc_device_set_properties(pnd, settings, sizeof(settings) / sizeof(settings[0]))) < 0)
     return res;
   HAL(initiator_init, pnd);
 }
@@ -576,19 +695,24 @@ nfc_initiator_select_passive_target(nfc_device *pnd,
   if (szInitData == 0) {
     // Provide default values, if any
     prepare_initiator_data(nm, &abtInit, &szInit);
-    free(abtTmpInit);
   } else if (nm.nmt == NMT_ISO14443A) {
     abtInit = abtTmpInit;
     iso14443_cascade_uid(pbtInitData, szInitData, abtInit, &szInit);
   } else {
     abtInit = abtTmpInit;
     memcpy(abtInit, pbtInitData, szInitData);
-    free(abtTmpInit);
     szInit = szInitData;
   }
-  HAL(initiator_select_passive_target, pnd, nm, abtInit, szInit, pnt);
-
+  // abtInit may point to abtTmpInit, which is only freed once the driver is done
+  pnd->last_error = 0;
+  if (pnd->driver->initiator_select_passive_target) {
+    res = pnd->driver->initiator_select_passive_target(pnd, nm, abtInit, szInit, pnt);
+  } else {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    res = false;
+  }
   free(abtTmpInit);
+  return res;
 }
 
 /** @ingroup initiator
@@ -834,7 +958,8 @@ nfc_initiator_transceive_bytes(nfc_device *pnd, const uint8_t *pbtTx, const size
  * respond. More information about this can be found in the anti-collision
  * example (\e nfc-anticol).
  *
- * @param pbtTxPar parameter contains a byte array of the corresponding parity bits needed to send per byte.
+ * @param pbtTxPar parameter contains a byte array of the corresponding parity bits needed to send per byte,
+ * or NULL for odd parity (see iso14443a_odd_parity()).
  *
  * @note For example if you send the SELECT_ALL (0x93, 0x20) = [ 10010011,
  * 00100000 ] command, you have to supply the following parity bytes (0x01,
@@ -915,6 +1040,131 @@ nfc_initiator_target_is_present(nfc_device *pnd, const nfc_target *pnt)
   HAL(initiator_target_is_present, pnd, pnt);
 }
 
+/** @ingroup initiator
+ * @brief Send several frames to target and retrieve their answers
+ * @return Returns the number of processed items on success, otherwise returns libnfc's error code
+ *
+ * @param pnd \a nfc_device struct pointer that represents currently used device
+ * @param items array of \a nfc_transceive_item, each one holding a frame to transmit and a buffer for its answer
+ * @param szItems number of items in \a items
+ * @param stop error classes which stop the batch early (see \a nfc_batch_stop)
+ * @param timeout in milliseconds, applies to each item
+ *
+ * This function behaves like calling nfc_initiator_transceive_bytes() on each
+ * item, in order, and stores its return value in the \a res field of the
+ * item. Devices which support it run the whole batch back-to-back, without
+ * per-command setup, which is much faster for long sequences of small frames
+ * (e.g. dumping a card).
+ *
+ * When an item fails with an error matching \a stop, the remaining items are
+ * not processed: the returned count includes the failing item. The \a res
+ * field of unprocessed items is left untouched.
+ *
+ * If timeout equals to 0, the function blocks indefinitely on each item
+ * If timeout equals to -1, the default timeout will be used
+ */
+int
+nfc_initiator_transceive_batch(nfc_device *pnd, nfc_transceive_item items[], const size_t szItems, const nfc_batch_stop stop, int timeout)
+{
+  if (pnd->async.pending) {
+    pnd->last_error = NFC_EBUSY;
+    return pnd->last_error;
+  }
+  pnd->last_error = 0;
+  if (pnd->driver->initiator_transceive_batch) {
+    return pnd->driver->initiator_transceive_batch(pnd, items, szItems, stop, timeout);
+  }
+  if (!pnd->driver->initiator_transceive_bytes) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+
+  // Fallback: transceive each item on its own
+  size_t szProcessed = 0;
+  while (szProcessed < szItems) {
+    nfc_transceive_item *pti = &items[szProcessed++];
+    pti->res = pnd->driver->initiator_transceive_bytes(pnd, pti->pbtTx, pti->szTx, pti->pbtRx, pti->szRx, timeout);
+    if (nfc_batch_stop_on(stop, pti->res)) {
+      break;
+    }
+  }
+  return (int)szProcessed;
+}
+
+/** @ingroup initiator
+ * @brief Send data to target without waiting for its answer
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ *
+ * @param pnd \a nfc_device struct pointer that represents currently used device
+ * @param pbtTx contains a byte array of the frame that needs to be transmitted.
+ * @param szTx contains the length in bytes.
+ * @param[out] pbtRx response from the target, must stay valid until \a callback is called
+ * @param szRx size of \a pbtRx (\a callback will get NFC_EOVFLOW if RX exceeds this size)
+ * @param timeout in milliseconds
+ * @param callback function called by nfc_device_process_events() once the answer is received
+ * @param user_data opaque pointer handed to \a callback
+ *
+ * This function is the non-blocking counterpart of nfc_initiator_transceive_bytes():
+ * the frame is handed to the device and the function returns as soon as the
+ * device acknowledged it. The caller then waits for the file descriptor
+ * returned by nfc_device_get_pollfd() to become readable (e.g. using poll(2)
+ * along with other devices) and calls nfc_device_process_events() which
+ * fetches the answer and calls \a callback.
+ *
+ * Only one asynchronous transceive can be pending per device: NFC_EBUSY is
+ * returned otherwise. No other command should be issued on \a pnd before the
+ * completion has been delivered.
+ *
+ * The device is also watched by nfc_context_process_events(), which waits
+ * for completions of all devices of the context at once.
+ *
+ * If timeout equals to 0, the answer is awaited indefinitely
+ * If timeout equals to -1, the default timeout will be used
+ */
+int
+nfc_initiator_transceive_bytes_async(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx,
+                                     const size_t szRx, int timeout, nfc_transceive_callback callback, void *user_data)
+{
+  int res;
+
+  if (!callback) {
+    pnd->last_error = NFC_EINVARG;
+    return pnd->last_error;
+  }
+  if (pnd->async.pending) {
+    pnd->last_error = NFC_EBUSY;
+    return pnd->last_error;
+  }
+  const int fd = nfc_device_get_pollfd(pnd);
+  if (fd < 0) {
+    return fd;
+  }
+  if (!pnd->driver->initiator_transceive_bytes_submit || !pnd->driver->initiator_transceive_bytes_complete) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+
+  pnd->last_error = 0;
+  // Driver may resolve the timeout value (ie. -1) while submitting
+  pnd->async.timeout = timeout;
+  if ((res = pnd->driver->initiator_transceive_bytes_submit(pnd, pbtTx, szTx, timeout)) < 0) {
+    return res;
+  }
+  pnd->async.pbtRx = pbtRx;
+  pnd->async.szRx = szRx;
+  pnd->async.submitted_ms = nfc_monotonic_ms();
+  pnd->async.callback = callback;
+  pnd->async.user_data = user_data;
+  pnd->async.pending = true;
+  // Let nfc_context_process_events() wait for it along with other devices
+  if ((res = nfc_reactor_add(pnd, fd)) < 0) {
+    pnd->async.pending = false;
+    pnd->last_error = res;
+    return res;
+  }
+  return NFC_SUCCESS;
+}
+
 /** @ingroup initiator
  * @brief Transceive raw bit-frames to a target
  * @return Returns received bits count on success, otherwise returns libnfc's error code
@@ -984,28 +1234,24 @@ int
 nfc_target_init(nfc_device *pnd, nfc_target *pnt, uint8_t *pbtRx, const size_t szRx, int timeout)
 {
   int res = 0;
-  // Disallow invalid frame
-  if ((res = nfc_device_set_property_bool(pnd, NP_ACCEPT_INVALID_FRAMES, false)) < 0)
-    return res;
-  // Disallow multiple frames
-  if ((res = nfc_device_set_property_bool(pnd, NP_ACCEPT_MULTIPLE_FRAMES, false)) < 0)
-    return res;
-  // Make sure we reset the CRC and parity to chip handling.
-  if ((res = nfc_device_set_property_bool(pnd, NP_HANDLE_CRC, true)) < 0)
-    return res;
-  if ((res = nfc_device_set_property_bool(pnd, NP_HANDLE_PARITY, true)) < 0)
-    return res;
-  // Activate auto ISO14443-4 switching by default
-  if ((res = nfc_device_set_property_bool(pnd, NP_AUTO_ISO14443_4, true)) < 0)
-    return res;
-  // Activate "easy framing" feature by default
-  if ((res = nfc_device_set_property_bool(pnd, NP_EASY_FRAMING, true)) < 0)
-    return res;
-  // Deactivate the CRYPTO1 cipher, it may could cause problems when still active
-  if ((res = nfc_device_set_property_bool(pnd, NP_ACTIVATE_CRYPTO1, false)) < 0)
-    return res;
-  // Drop explicitely the field
-  if ((res = nfc_device_set_property_bool(pnd, NP_ACTIVATE_FIELD, false)) < 0)
+  const nfc_property_setting settings[] = {
+    // Disallow invalid frame
+    { NP_ACCEPT_INVALID_FRAMES, false },
+    // Disallow multiple frames
+    { NP_ACCEPT_MULTIPLE_FRAMES, false },
+    // Make sure we reset the CRC and parity to chip handling.
+    { NP_HANDLE_CRC, true },
+    { NP_HANDLE_PARITY, true },
+    // Activate auto ISO14443-4 switching by default
+    { NP_AUTO_ISO14443_4, true },
+    // Activate "easy framing" feature by default
+    { NP_EASY_FRAMING, true },
+    // Deactivate the CRYPTO1 cipher, it may could cause problems when still active
+    { NP_ACTIVATE_CRYPTO1, false },
+    // Drop explicitely the field
+    { NP_ACTIVATE_FIELD, false },
+  };
+  if ((res = nfc_device_set_properties(pnd, settings, sizeof(settings) / sizeof(settings[0]))) < 0)
     return res;
 
   HAL(target_init, pnd, pnt, pbtRx, szRx, timeout);
@@ -1044,6 +1290,44 @@ nfc_abort_command(nfc_device *pnd)
   HAL(abort_command, pnd);
 }
 
+/** @ingroup dev
+ * @brief Acquire exclusive use of a device
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ *
+ * libnfc does not serialize calls made on a given device: distinct devices may
+ * be driven from distinct threads without any locking, but threads sharing a
+ * device must bracket each sequence of operations (e.g. select, authenticate,
+ * read) with nfc_device_lock() and nfc_device_unlock().
+ *
+ * @note The lock is recursive. nfc_abort_command() is meant to be called
+ * without holding it.
+ */
+void
+nfc_device_lock(nfc_device *pnd)
+{
+#ifndef WIN32
+  pthread_mutex_lock(&pnd->lock);
+#else
+  EnterCriticalSection(&pnd->lock);
+#endif
+}
+
+/** @ingroup dev
+ * @brief Release a device previously acquired with nfc_device_lock()
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ */
+void
+nfc_device_unlock(nfc_device *pnd)
+{
+#ifndef WIN32
+  pthread_mutex_unlock(&pnd->lock);
+#else
+  LeaveCriticalSection(&pnd->lock);
+#endif
+}
+
 /** @ingroup target
  * @brief Send bytes and APDU frames
  * @return Returns sent bytes count on success, otherwise returns libnfc's error code
@@ -1092,7 +1376,8 @@ nfc_target_receive_bytes(nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, int
  * @param pnd \a nfc_device struct pointer that represent currently used device
  * @param pbtTx pointer to Tx buffer
  * @param szTxBits size of Tx buffer
- * @param pbtTxPar parameter contains a byte array of the corresponding parity bits needed to send per byte.
+ * @param pbtTxPar parameter contains a byte array of the corresponding parity bits needed to send per byte,
+ * or NULL for odd parity (see iso14443a_odd_parity()).
  * This function can be used to transmit (raw) bit-frames to the \e initiator
  * using the specified NFC device (configured as \e target).
  */
@@ -1139,6 +1424,7 @@ static struct sErrorMessage {
   { NFC_EOPABORTED, "Operation Aborted" },
   { NFC_ENOTIMPL, "Not (yet) Implemented" },
   { NFC_ETGRELEASED, "Target Released" },
+  { NFC_EBUSY, "Device Busy" },
   { NFC_EMFCAUTHFAIL, "Mifare Authentication Failed" },
   { NFC_ERFTRANS, "RF Transmission Error" },
   { NFC_ECHIP, "Device's Internal Chip Error" },
@@ -1271,6 +1557,117 @@ nfc_device_get_supported_baud_rate_target_mode(nfc_device *pnd, const nfc_modula
   HAL(get_supported_baud_rate, pnd, N_TARGET, nmt, supported_br);
 }
 
+/** @ingroup dev
+ * @brief Get a file descriptor to wait for asynchronous events on the device
+ * @return Returns a file descriptor on success, otherwise returns libnfc's error code (negative value)
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ *
+ * The returned file descriptor becomes readable when an answer to a command
+ * submitted by nfc_initiator_transceive_bytes_async() is available. It is
+ * owned by the device and must not be read from nor closed by the caller.
+ */
+int
+nfc_device_get_pollfd(nfc_device *pnd)
+{
+  if (!pnd->driver->device_get_pollfd) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+  return pnd->driver->device_get_pollfd(pnd);
+}
+
+/** @ingroup dev
+ * @brief Process pending asynchronous events on the device
+ * @return Returns the number of completions delivered (0 or 1), otherwise returns libnfc's error code (negative value)
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ *
+ * This function never blocks waiting for the device: if the answer of the
+ * pending asynchronous transceive is not available yet it returns 0, unless
+ * the transceive timed out in which case the completion is delivered with
+ * NFC_ETIMEOUT. It is meant to be called when the file descriptor returned
+ * by nfc_device_get_pollfd() is readable, or periodically to enforce timeouts.
+ *
+ * Before a timeout is delivered, the command is aborted on the device and any
+ * late reply is discarded, which may take a few tens of milliseconds.
+ */
+int
+nfc_device_process_events(nfc_device *pnd)
+{
+  int res;
+
+  if (!pnd->async.pending) {
+    return 0;
+  }
+
+#ifndef WIN32
+  struct pollfd pfd;
+  if ((pfd.fd = nfc_device_get_pollfd(pnd)) < 0) {
+    return pfd.fd;
+  }
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  res = poll(&pfd, 1, 0);
+  if (res < 0) {
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  if (res == 0) {
+    if ((pnd->async.timeout <= 0) || ((nfc_monotonic_ms() - pnd->async.submitted_ms) < (uint64_t)pnd->async.timeout)) {
+      // Nothing to do yet
+      return 0;
+    }
+    res = NFC_ETIMEOUT;
+    // The chip may still answer: stop it and drop what it already sent, so
+    // its reply is not read as the answer to the next command
+    if (pnd->driver->initiator_transceive_bytes_cancel)
+      pnd->driver->initiator_transceive_bytes_cancel(pnd);
+  } else
+#endif
+    res = pnd->driver->initiator_transceive_bytes_complete(pnd, pnd->async.pbtRx, pnd->async.szRx);
+
+  // Completion is delivered once: the callback is allowed to submit a new transceive
+  nfc_reactor_remove(pnd);
+  pnd->async.pending = false;
+  pnd->last_error = (res < 0) ? res : 0;
+  pnd->async.callback(pnd, res, pnd->async.user_data);
+  return 1;
+}
+
+/** @ingroup dev
+ * @brief Get performance counters of the device
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ * @param[out] pstats counters since the device was opened or nfc_device_reset_stats() was called
+ *
+ * Counters are updated without locking, this function can be called from any
+ * thread while the device is used: each counter is read whole, but the set
+ * of counters is not a consistent snapshot.
+ */
+int
+nfc_device_get_stats(nfc_device *pnd, nfc_device_stats *pstats)
+{
+  // nfc_device_stats is only made of uint64_t counters
+  const uint64_t *src = (const uint64_t *) &pnd->stats;
+  uint64_t *dst = (uint64_t *) pstats;
+  for (size_t i = 0; i < sizeof(nfc_device_stats) / sizeof(uint64_t); i++) {
+    dst[i] = NFC_STATS_LOAD(src[i]);
+  }
+  return NFC_SUCCESS;
+}
+
+/** @ingroup dev
+ * @brief Reset performance counters of the device
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ */
+void
+nfc_device_reset_stats(nfc_device *pnd)
+{
+  uint64_t *counters = (uint64_t *) &pnd->stats;
+  for (size_t i = 0; i < sizeof(nfc_device_stats) / sizeof(uint64_t); i++) {
+    NFC_STATS_STORE(counters[i], 0);
+  }
+}
+
 /** @ingroup data
  * @brief Validate combination of modulation and baud rate on the currently used device.
  * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
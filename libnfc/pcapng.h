@@ -0,0 +1,57 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file pcapng.h
+ * @brief pcapng blocks written by the capture and read by the replay driver
+ */
+
+#ifndef __NFC_PCAPNG_H__
+#define __NFC_PCAPNG_H__
+
+#define PCAPNG_SHB 0x0A0D0D0A
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+
+#define PCAPNG_OPT_ENDOFOPT     0
+#define PCAPNG_OPT_IF_NAME      2
+#define PCAPNG_OPT_IF_DESCRIPTION 3
+#define PCAPNG_OPT_EPB_FLAGS    2
+
+#define PCAPNG_EPB_INBOUND  0x00000001
+#define PCAPNG_EPB_OUTBOUND 0x00000002
+
+#define LINKTYPE_USER0     147
+#define LINKTYPE_ISO_14443 264
+
+// LINKTYPE_ISO_14443 pseudo-header events
+#define ISO14443_DATA_PCD_PICC 0xFF
+#define ISO14443_DATA_PICC_PCD 0xFE
+
+#define PAD4(n) (((n) + 3) & ~(size_t) 3)
+
+#endif // __NFC_PCAPNG_H__
@@ -0,0 +1,124 @@
+#include <cutter.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "../bench/pn532-emulator.h"
+
+/*
+ * Check asynchronous transceives on a PN532 emulated on a pseudo-terminal,
+ * which answers exchanges EXCHANGE_DELAY ms late.
+ */
+void cut_setup(void);
+void cut_teardown(void);
+void test_async_transceive_complete(void);
+void test_async_transceive_timeout(void);
+
+#define EXCHANGE_DELAY 100
+
+static struct pn532_emulator emulator;
+static bool emulator_started;
+static nfc_context *context;
+static nfc_device *device;
+
+// MIFARE READ of block 4, answered with 16 bytes by the emulator
+static const uint8_t abtRead[] = { 0x30, 0x04 };
+
+struct completion {
+  int count;
+  int res;
+};
+
+static void
+on_complete(nfc_device *pnd, int res, void *user_data)
+{
+  struct completion *c = user_data;
+  (void) pnd;
+  c->count++;
+  c->res = res;
+}
+
+void
+cut_setup(void)
+{
+  nfc_connstring connstring;
+
+  if (pn532_emulator_start_ext(&emulator, EXCHANGE_DELAY) < 0)
+    cut_omit("Unable to start the PN532 emulator");
+  emulator_started = true;
+  pn532_emulator_connstring(&emulator, connstring);
+
+  nfc_init(&context);
+  cut_assert_not_null(context, cut_message("Unable to init libnfc (malloc)"));
+  device = nfc_open(context, connstring);
+  cut_assert_not_null(device, cut_message("nfc_open"));
+  cut_assert_equal_int(0, nfc_initiator_init(device), cut_message("nfc_initiator_init"));
+}
+
+void
+cut_teardown(void)
+{
+  if (device)
+    nfc_close(device);
+  device = NULL;
+  if (context)
+    nfc_exit(context);
+  context = NULL;
+  if (emulator_started)
+    pn532_emulator_stop(&emulator);
+  emulator_started = false;
+}
+
+// Wait on the device fd and process events until the completion is delivered
+static void
+wait_completion(struct completion *c, int max_ms)
+{
+  struct pollfd pfd = { .fd = nfc_device_get_pollfd(device), .events = POLLIN };
+  cut_assert_operator_int(pfd.fd, >=, 0, cut_message("nfc_device_get_pollfd"));
+  for (int elapsed = 0; (c->count == 0) && (elapsed < max_ms); elapsed += 10) {
+    poll(&pfd, 1, 10);
+    cut_assert_operator_int(nfc_device_process_events(device), >=, 0, cut_message("nfc_device_process_events"));
+  }
+}
+
+void
+test_async_transceive_complete(void)
+{
+  uint8_t abtRx[16];
+  struct completion c = { 0, 0 };
+
+  cut_assert_equal_int(0, nfc_initiator_transceive_bytes_async(device, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), 1000, on_complete, &c), cut_message("submit"));
+  cut_assert_equal_int(NFC_EBUSY, nfc_initiator_transceive_bytes_async(device, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), 1000, on_complete, &c), cut_message("second submit"));
+  cut_assert_equal_int(0, nfc_device_process_events(device), cut_message("nothing yet"));
+  cut_assert_equal_int(0, c.count, cut_message("no early completion"));
+
+  wait_completion(&c, 1000);
+  cut_assert_equal_int(1, c.count, cut_message("completion delivered once"));
+  cut_assert_equal_int(sizeof(abtRx), c.res, cut_message("reply length"));
+  for (uint8_t n = 0; n < sizeof(abtRx); n++)
+    cut_assert_equal_int(n, abtRx[n], cut_message("reply byte %d", n));
+  cut_assert_equal_int(0, nfc_device_process_events(device), cut_message("nothing pending"));
+}
+
+void
+test_async_transceive_timeout(void)
+{
+  uint8_t abtRx[16];
+  struct completion c = { 0, 0 };
+
+  cut_assert_equal_int(0, nfc_initiator_transceive_bytes_async(device, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), EXCHANGE_DELAY / 4, on_complete, &c), cut_message("submit"));
+  wait_completion(&c, 1000);
+  cut_assert_equal_int(1, c.count, cut_message("completion delivered once"));
+  cut_assert_equal_int(NFC_ETIMEOUT, c.res, cut_message("timeout"));
+
+  // The command was aborted: no late reply shows up
+  struct pollfd pfd = { .fd = nfc_device_get_pollfd(device), .events = POLLIN };
+  cut_assert_equal_int(0, poll(&pfd, 1, 2 * EXCHANGE_DELAY), cut_message("late reply"));
+
+  // And the next transceive gets its own reply
+  memset(abtRx, 0xff, sizeof(abtRx));
+  cut_assert_equal_int(sizeof(abtRx), nfc_initiator_transceive_bytes(device, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), 1000), cut_message("transceive after timeout"));
+  cut_assert_equal_int(15, abtRx[15], cut_message("reply"));
+}
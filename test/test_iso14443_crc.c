@@ -0,0 +1,104 @@
+#include <cutter.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+/*
+ * Check CRC_A and CRC_B against the former bit-wise implementation, on every
+ * message of up to two bytes, then on longer ones at every length and
+ * alignment, so that the table and carry-less multiplication paths are all
+ * covered. No device is needed.
+ */
+void test_iso14443_crc_short(void);
+void test_iso14443_crc_long(void);
+void test_iso14443a_crc_update(void);
+
+#define MAX_LEN 1100
+
+static uint16_t
+reference_crc(const uint8_t *pbtData, size_t szLen, uint32_t wCrc)
+{
+  while (szLen--) {
+    uint8_t bt = *pbtData++;
+    bt = (bt ^ (uint8_t)(wCrc & 0x00FF));
+    bt = (bt ^ (bt << 4));
+    wCrc = (wCrc >> 8) ^ ((uint32_t) bt << 8) ^ ((uint32_t) bt << 3) ^ ((uint32_t) bt >> 4);
+  }
+  return (uint16_t) wCrc;
+}
+
+static void
+check_crc(uint8_t *pbtData, const size_t szLen)
+{
+  uint8_t abtCrc[2];
+
+  const uint16_t wCrcA = reference_crc(pbtData, szLen, 0x6363);
+  iso14443a_crc(pbtData, szLen, abtCrc);
+  cut_assert_equal_uint(wCrcA, abtCrc[0] | (abtCrc[1] << 8), cut_message("CRC_A of %u bytes", (unsigned) szLen));
+
+  const uint16_t wCrcB = (uint16_t) ~reference_crc(pbtData, szLen, 0xFFFF);
+  iso14443b_crc(pbtData, szLen, abtCrc);
+  cut_assert_equal_uint(wCrcB, abtCrc[0] | (abtCrc[1] << 8), cut_message("CRC_B of %u bytes", (unsigned) szLen));
+}
+
+static void
+fill(uint8_t *pbtData, const size_t szLen, uint32_t seed)
+{
+  for (size_t i = 0; i < szLen; i++) {
+    seed = (seed * 1103515245) + 12345;
+    pbtData[i] = (uint8_t)(seed >> 16);
+  }
+}
+
+void
+test_iso14443_crc_short(void)
+{
+  uint8_t abtData[2];
+
+  for (unsigned int b0 = 0; b0 < 256; b0++) {
+    abtData[0] = (uint8_t) b0;
+    check_crc(abtData, 1);
+    for (unsigned int b1 = 0; b1 < 256; b1++) {
+      abtData[1] = (uint8_t) b1;
+      check_crc(abtData, 2);
+    }
+  }
+}
+
+void
+test_iso14443_crc_long(void)
+{
+  uint8_t abtData[MAX_LEN + 16];
+
+  fill(abtData, sizeof(abtData), 1);
+  for (size_t szOffset = 0; szOffset < 16; szOffset++) {
+    for (size_t szLen = 3; szLen <= MAX_LEN; szLen++)
+      check_crc(abtData + szOffset, szLen);
+  }
+  // Runs of identical bytes
+  memset(abtData, 0x00, sizeof(abtData));
+  check_crc(abtData, MAX_LEN);
+  memset(abtData, 0xff, sizeof(abtData));
+  check_crc(abtData, MAX_LEN);
+}
+
+void
+test_iso14443a_crc_update(void)
+{
+  uint8_t abtData[300];
+
+  fill(abtData, sizeof(abtData), 2);
+  const uint16_t wCrc = reference_crc(abtData, sizeof(abtData), 0x6363);
+  cut_assert_equal_uint(0x6363, iso14443a_crc_update(0x6363, abtData, 0));
+  // Any split gives the CRC of the whole
+  for (size_t szSplit = 0; szSplit <= sizeof(abtData); szSplit++) {
+    uint16_t wPartial = iso14443a_crc_update(0x6363, abtData, szSplit);
+    wPartial = iso14443a_crc_update(wPartial, abtData + szSplit, sizeof(abtData) - szSplit);
+    cut_assert_equal_uint(wCrc, wPartial, cut_message("split at %u", (unsigned) szSplit));
+  }
+  // Byte by byte
+  uint16_t wStream = 0x6363;
+  for (size_t i = 0; i < sizeof(abtData); i++)
+    wStream = iso14443a_crc_update(wStream, abtData + i, 1);
+  cut_assert_equal_uint(wCrc, wStream);
+}
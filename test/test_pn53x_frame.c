@@ -0,0 +1,192 @@
+#include <cutter.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "chips/pn53x.h"
+
+/*
+ * Check frame wrapping and unwrapping, used when parity is not handled by the
+ * chip, against the former bit by bit implementation on random data. No
+ * device is needed.
+ */
+void test_pn53x_wrap_frame(void);
+void test_pn53x_unwrap_frame(void);
+void test_iso14443a_odd_parity(void);
+
+#define ROUNDS   20
+#define MAX_BITS 700
+// Room for the bytes the former implementation reads past the frame
+#define FRAME_BUFFER_SIZE ((MAX_BITS / 8) + 16)
+
+static uint8_t
+reference_mirror(uint8_t bt)
+{
+  uint8_t btMirror = 0;
+  for (int i = 0; i < 8; i++) {
+    btMirror = (uint8_t)((btMirror << 1) | (bt & 0x01));
+    bt >>= 1;
+  }
+  return btMirror;
+}
+
+static int
+reference_wrap_frame(const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar, uint8_t *pbtFrame)
+{
+  uint8_t  btData;
+  uint32_t uiBitPos;
+  uint32_t uiDataPos = 0;
+  size_t  szBitsLeft = szTxBits;
+  size_t szFrameBits = 0;
+
+  if (szBitsLeft == 0)
+    return NFC_ECHIP;
+  if (szBitsLeft < 9) {
+    *pbtFrame = *pbtTx;
+    szFrameBits = szTxBits;
+    return szFrameBits;
+  }
+  szFrameBits = szTxBits + (szTxBits / 8);
+  while (true) {
+    uint8_t  btFrame = 0;
+    for (uiBitPos = 0; uiBitPos < 8; uiBitPos++) {
+      btData = reference_mirror(pbtTx[uiDataPos]);
+      btFrame |= (btData >> uiBitPos);
+      *pbtFrame = reference_mirror(btFrame);
+      btFrame = (btData << (8 - uiBitPos));
+      btFrame |= ((pbtTxPar[uiDataPos] & 0x01) << (7 - uiBitPos));
+      pbtFrame++;
+      *pbtFrame = reference_mirror(btFrame);
+      uiDataPos++;
+      if (szBitsLeft < 9)
+        return szFrameBits;
+      szBitsLeft -= 8;
+    }
+    pbtFrame++;
+  }
+}
+
+static int
+reference_unwrap_frame(const uint8_t *pbtFrame, const size_t szFrameBits, uint8_t *pbtRx, uint8_t *pbtRxPar)
+{
+  uint8_t  btFrame;
+  uint8_t  btData;
+  uint8_t uiBitPos;
+  uint32_t uiDataPos = 0;
+  uint8_t *pbtFramePos = (uint8_t *) pbtFrame;
+  size_t  szBitsLeft = szFrameBits;
+  size_t szRxBits = 0;
+
+  if (szBitsLeft == 0)
+    return NFC_ECHIP;
+  if (szBitsLeft < 9) {
+    *pbtRx = *pbtFrame;
+    szRxBits = szFrameBits;
+    return szRxBits;
+  }
+  szRxBits = szFrameBits - (szFrameBits / 9);
+  while (true) {
+    for (uiBitPos = 0; uiBitPos < 8; uiBitPos++) {
+      btFrame = reference_mirror(pbtFramePos[uiDataPos]);
+      btData = (btFrame << uiBitPos);
+      btFrame = reference_mirror(pbtFramePos[uiDataPos + 1]);
+      btData |= (btFrame >> (8 - uiBitPos));
+      pbtRx[uiDataPos] = reference_mirror(btData);
+      if (pbtRxPar != NULL)
+        pbtRxPar[uiDataPos] = ((btFrame >> (7 - uiBitPos)) & 0x01);
+      uiDataPos++;
+      if (szBitsLeft < 9)
+        return szRxBits;
+      szBitsLeft -= 9;
+    }
+    pbtFramePos++;
+  }
+}
+
+static void
+fill_random(uint8_t *pbt, const size_t sz)
+{
+  for (size_t i = 0; i < sz; i++)
+    pbt[i] = (uint8_t) rand();
+}
+
+void
+test_pn53x_wrap_frame(void)
+{
+  uint8_t abtTx[FRAME_BUFFER_SIZE], abtTxPar[FRAME_BUFFER_SIZE], abtOddPar[FRAME_BUFFER_SIZE];
+  uint8_t abtExpected[FRAME_BUFFER_SIZE], abtFrame[FRAME_BUFFER_SIZE];
+
+  srand(1);
+  cut_assert_equal_int(NFC_ECHIP, pn53x_wrap_frame(abtTx, 0, abtTxPar, abtFrame));
+  for (int round = 0; round < ROUNDS; round++) {
+    for (size_t szBits = 1; szBits <= MAX_BITS; szBits++) {
+      fill_random(abtTx, sizeof(abtTx));
+      // Only the least significant bit of parity bytes is used
+      fill_random(abtTxPar, sizeof(abtTxPar));
+      memset(abtExpected, 0x5a, sizeof(abtExpected));
+      memset(abtFrame, 0x5a, sizeof(abtFrame));
+      const int res = reference_wrap_frame(abtTx, szBits, abtTxPar, abtExpected);
+      cut_assert_equal_int(res, pn53x_wrap_frame(abtTx, szBits, abtTxPar, abtFrame), cut_message("%u bits", (unsigned) szBits));
+      cut_assert_equal_memory(abtExpected, sizeof(abtExpected), abtFrame, sizeof(abtFrame), cut_message("%u bits", (unsigned) szBits));
+
+      // Without parity bits, odd parity is computed
+      iso14443a_odd_parity(abtTx, sizeof(abtTx), abtOddPar);
+      memset(abtExpected, 0x5a, sizeof(abtExpected));
+      memset(abtFrame, 0x5a, sizeof(abtFrame));
+      reference_wrap_frame(abtTx, szBits, abtOddPar, abtExpected);
+      pn53x_wrap_frame(abtTx, szBits, NULL, abtFrame);
+      cut_assert_equal_memory(abtExpected, sizeof(abtExpected), abtFrame, sizeof(abtFrame), cut_message("%u bits, odd parity", (unsigned) szBits));
+    }
+  }
+}
+
+void
+test_pn53x_unwrap_frame(void)
+{
+  uint8_t abtFrame[FRAME_BUFFER_SIZE];
+  uint8_t abtExpected[FRAME_BUFFER_SIZE], abtExpectedPar[FRAME_BUFFER_SIZE];
+  uint8_t abtRx[FRAME_BUFFER_SIZE], abtRxPar[FRAME_BUFFER_SIZE];
+
+  srand(2);
+  cut_assert_equal_int(NFC_ECHIP, pn53x_unwrap_frame(abtFrame, 0, abtRx, abtRxPar));
+  for (int round = 0; round < ROUNDS; round++) {
+    for (size_t szBits = 1; szBits <= MAX_BITS; szBits++) {
+      fill_random(abtFrame, sizeof(abtFrame));
+      memset(abtExpected, 0x5a, sizeof(abtExpected));
+      memset(abtExpectedPar, 0x5a, sizeof(abtExpectedPar));
+      memset(abtRx, 0x5a, sizeof(abtRx));
+      memset(abtRxPar, 0x5a, sizeof(abtRxPar));
+      const int res = reference_unwrap_frame(abtFrame, szBits, abtExpected, abtExpectedPar);
+      cut_assert_equal_int(res, pn53x_unwrap_frame(abtFrame, szBits, abtRx, abtRxPar), cut_message("%u bits", (unsigned) szBits));
+      cut_assert_equal_memory(abtExpected, sizeof(abtExpected), abtRx, sizeof(abtRx), cut_message("%u bits", (unsigned) szBits));
+      cut_assert_equal_memory(abtExpectedPar, sizeof(abtExpectedPar), abtRxPar, sizeof(abtRxPar), cut_message("%u bits", (unsigned) szBits));
+
+      // Parity bits may be dropped
+      memset(abtRx, 0x5a, sizeof(abtRx));
+      pn53x_unwrap_frame(abtFrame, szBits, abtRx, NULL);
+      cut_assert_equal_memory(abtExpected, sizeof(abtExpected), abtRx, sizeof(abtRx), cut_message("%u bits, no parity", (unsigned) szBits));
+    }
+  }
+}
+
+void
+test_iso14443a_odd_parity(void)
+{
+  uint8_t abtData[256 + 8], abtPar[256 + 8];
+
+  for (size_t i = 0; i < sizeof(abtData); i++)
+    abtData[i] = (uint8_t) i;
+  // Every length and alignment covers every byte value in both loops
+  for (size_t szOffset = 0; szOffset < 8; szOffset++) {
+    for (size_t szLen = 0; szLen <= 256; szLen++) {
+      memset(abtPar, 0x5a, sizeof(abtPar));
+      iso14443a_odd_parity(abtData + szOffset, szLen, abtPar);
+      for (size_t i = 0; i < szLen; i++) {
+        const uint8_t bt = abtData[szOffset + i];
+        cut_assert_equal_uint((0x9669 >> ((bt ^ (bt >> 4)) & 0xF)) & 1, abtPar[i], cut_message("0x%02x", bt));
+      }
+      cut_assert_equal_uint(0x5a, abtPar[szLen]);
+    }
+  }
+}
@@ -0,0 +1,204 @@
+#include <cutter.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nfc/nfc.h>
+
+#include "buses/ready.h"
+
+/*
+ * Check the ready notifiers used by the SPI and I2C drivers with fake probes
+ * standing for the chip, and a fake notifier standing for an IRQ line. No
+ * device is needed.
+ */
+void test_ready_poller(void);
+void test_ready_poller_backoff(void);
+void test_ready_poller_timeout(void);
+void test_ready_probe_error(void);
+void test_ready_abort(void);
+void test_ready_fake_notifier(void);
+
+#define MAX_PROBES 16
+
+struct fake_chip {
+  /** Probes answered "not ready" before the chip gets ready, -1 for never */
+  int     busy_probes;
+  /** Value returned once ready */
+  int     ready;
+  int     probes;
+  int64_t probe_ms[MAX_PROBES];
+};
+
+static int64_t
+now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static int
+fake_probe(void *data)
+{
+  struct fake_chip *chip = data;
+  if (chip->probes < MAX_PROBES)
+    chip->probe_ms[chip->probes] = now_ms();
+  chip->probes++;
+  if ((chip->busy_probes < 0) || (chip->probes <= chip->busy_probes))
+    return 0;
+  return chip->ready;
+}
+
+void
+test_ready_poller(void)
+{
+  struct ready_notifier *rn = ready_notifier_new_poller(1, 8);
+  cut_assert_not_null(rn, cut_message("poller creation"));
+
+  struct fake_chip chip = { .busy_probes = 0, .ready = 1 };
+  cut_assert_equal_int(NFC_SUCCESS, ready_notifier_wait(rn, fake_probe, &chip, 1000), cut_message("ready at once"));
+  cut_assert_equal_int(1, chip.probes, cut_message("a ready chip is probed once"));
+
+  chip = (struct fake_chip) { .busy_probes = 3, .ready = 1 };
+  cut_assert_equal_int(NFC_SUCCESS, ready_notifier_wait(rn, fake_probe, &chip, 0), cut_message("ready after a while, no timeout"));
+  cut_assert_equal_int(4, chip.probes, cut_message("probed until ready"));
+  ready_notifier_free(rn);
+}
+
+void
+test_ready_poller_backoff(void)
+{
+  struct ready_notifier *rn = ready_notifier_new_poller(2, 8);
+  struct fake_chip chip = { .busy_probes = 6, .ready = 1 };
+  cut_assert_equal_int(NFC_SUCCESS, ready_notifier_wait(rn, fake_probe, &chip, 1000), cut_message("ready after 6 probes"));
+  ready_notifier_free(rn);
+
+  // Intervals are 2, 4, 8, 8... ms, give or take the scheduler
+  const int expected[] = { 2, 4, 8, 8, 8, 8 };
+  for (int i = 0; i < 6; i++) {
+    const int64_t interval = chip.probe_ms[i + 1] - chip.probe_ms[i];
+    cut_assert_operator_int(interval, >=, expected[i] - 1, cut_message("interval %d too short", i));
+    cut_assert_operator_int(interval, <, expected[i] + 20, cut_message("interval %d too long", i));
+  }
+}
+
+void
+test_ready_poller_timeout(void)
+{
+  struct ready_notifier *rn = ready_notifier_new_poller(1, 8);
+  struct fake_chip chip = { .busy_probes = -1 };
+  const int64_t start = now_ms();
+  cut_assert_equal_int(NFC_ETIMEOUT, ready_notifier_wait(rn, fake_probe, &chip, 30), cut_message("never ready"));
+  const int64_t elapsed = now_ms() - start;
+  cut_assert_operator_int(elapsed, >=, 30, cut_message("timeout honoured"));
+  cut_assert_operator_int(elapsed, <, 30 + 50, cut_message("timeout not overshot"));
+  ready_notifier_free(rn);
+}
+
+void
+test_ready_probe_error(void)
+{
+  struct ready_notifier *rn = ready_notifier_new_poller(1, 8);
+  struct fake_chip chip = { .busy_probes = 2, .ready = NFC_EIO };
+  cut_assert_equal_int(NFC_EIO, ready_notifier_wait(rn, fake_probe, &chip, 1000), cut_message("probe errors are returned"));
+  cut_assert_equal_int(3, chip.probes, cut_message("no probe after an error"));
+  ready_notifier_free(rn);
+}
+
+static void *
+abort_later(void *arg)
+{
+  usleep(20000);
+  ready_notifier_abort(arg);
+  return NULL;
+}
+
+void
+test_ready_abort(void)
+{
+  struct ready_notifier *rn = ready_notifier_new_poller(50, 50);
+  struct fake_chip chip = { .busy_probes = -1 };
+
+  // An abort before the wait is kept for it, then consumed
+  cut_assert_equal_int(NFC_SUCCESS, ready_notifier_abort(rn), cut_message("abort"));
+  cut_assert_equal_int(NFC_EOPABORTED, ready_notifier_wait(rn, fake_probe, &chip, 0), cut_message("pending abort"));
+  chip = (struct fake_chip) { .busy_probes = 1, .ready = 1 };
+  cut_assert_equal_int(NFC_SUCCESS, ready_notifier_wait(rn, fake_probe, &chip, 1000), cut_message("abort consumed"));
+
+  // An abort from another thread interrupts the sleep between probes
+  chip = (struct fake_chip) { .busy_probes = -1 };
+  pthread_t thread;
+  pthread_create(&thread, NULL, abort_later, rn);
+  const int64_t start = now_ms();
+  cut_assert_equal_int(NFC_EOPABORTED, ready_notifier_wait(rn, fake_probe, &chip, 0), cut_message("abort while waiting"));
+  pthread_join(thread, NULL);
+  cut_assert_operator_int(now_ms() - start, <, 45, cut_message("abort does not wait for the next probe"));
+  ready_notifier_free(rn);
+}
+
+/*
+ * Fake IRQ line: asserted after a given number of waits on it.
+ */
+struct fake_irq {
+  struct ready_notifier rn;
+  int     edges_before_ready;
+  int     edges;
+};
+
+static int
+fake_irq_wait(struct ready_notifier *rn, ready_probe probe, void *data, int timeout)
+{
+  struct fake_irq *irq = (struct fake_irq *) rn;
+  (void) timeout;
+  for (;;) {
+    int res;
+    if ((res = ready_notifier_sleep(rn, 1)) < 0)
+      return res;
+    if (++irq->edges < irq->edges_before_ready)
+      continue;
+    if ((res = probe(data)) != 0)
+      return (res < 0) ? res : NFC_SUCCESS;
+  }
+}
+
+static bool *fake_irq_closed;
+
+static void
+fake_irq_close(struct ready_notifier *rn)
+{
+  (void) rn;
+  *fake_irq_closed = true;
+}
+
+static const struct ready_notifier_ops fake_irq_ops = {
+  .wait  = fake_irq_wait,
+  .close = fake_irq_close,
+};
+
+void
+test_ready_fake_notifier(void)
+{
+  struct fake_irq *irq = calloc(1, sizeof(struct fake_irq));
+  cut_assert_not_null(irq, cut_message("malloc"));
+  cut_assert_equal_int(NFC_SUCCESS, ready_notifier_init(&irq->rn, &fake_irq_ops), cut_message("init"));
+  irq->edges_before_ready = 3;
+
+  // The chip is only probed once the line is asserted
+  struct fake_chip chip = { .busy_probes = 0, .ready = 1 };
+  cut_assert_equal_int(NFC_SUCCESS, ready_notifier_wait(&irq->rn, fake_probe, &chip, 0), cut_message("wait"));
+  cut_assert_equal_int(3, irq->edges, cut_message("edges"));
+  cut_assert_equal_int(1, chip.probes, cut_message("probes"));
+
+  // Aborts go through the common part
+  ready_notifier_abort(&irq->rn);
+  cut_assert_equal_int(NFC_EOPABORTED, ready_notifier_wait(&irq->rn, fake_probe, &chip, 0), cut_message("abort"));
+
+  bool closed = false;
+  fake_irq_closed = &closed;
+  ready_notifier_free(&irq->rn);
+  cut_assert_equal_int(true, closed, cut_message("close called"));
+}
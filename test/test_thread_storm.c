@@ -0,0 +1,160 @@
+#include <cutter.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "../bench/pn532-emulator.h"
+
+#define DEVICE_COUNT  4
+#define NTESTS        200
+#define SHARED_THREADS 2
+
+/*
+ * This is a stress-test to ensure distinct devices can be driven from
+ * distinct threads, and that threads sharing a device are serialized by
+ * nfc_device_lock(). Devices are PN532 emulated on pseudo-terminals.
+ */
+void cut_setup(void);
+void cut_teardown(void);
+void test_thread_storm(void);
+
+static struct pn532_emulator emulators[DEVICE_COUNT + 1];
+static size_t emulator_count;
+
+struct storm_job {
+  nfc_context *context;
+  nfc_connstring connstring;
+  nfc_device *device;
+  int res;
+  int count;
+};
+
+// MIFARE READ of block 4, answered with 16 bytes by the emulator
+static const uint8_t abtRead[] = { 0x30, 0x04 };
+
+static void *
+storm_transceive(void *arg)
+{
+  struct storm_job *job = arg;
+  uint8_t abtRx[16];
+
+  for (int n = 0; n < NTESTS; n++) {
+    nfc_device_lock(job->device);
+    // Initialize and exchange as one sequence on the shared device
+    if ((job->res = nfc_initiator_init(job->device)) == 0)
+      job->res = nfc_initiator_transceive_bytes(job->device, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), -1);
+    nfc_device_unlock(job->device);
+    if (job->res != sizeof(abtRx))
+      return NULL;
+    job->count++;
+  }
+  return NULL;
+}
+
+static void *
+storm_private_device(void *arg)
+{
+  struct storm_job *job = arg;
+  uint8_t abtRx[16];
+
+  // Each thread opens its own device, exchanges and closes it again
+  for (int n = 0; n < NTESTS / 10; n++) {
+    nfc_device *pnd = nfc_open(job->context, job->connstring);
+    if (!pnd) {
+      job->res = NFC_EIO;
+      return NULL;
+    }
+    if ((job->res = nfc_initiator_init(pnd)) == 0) {
+      for (int i = 0; (i < 10) && (job->res >= 0); i++) {
+        job->res = nfc_initiator_transceive_bytes(pnd, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), -1);
+        if (job->res == sizeof(abtRx))
+          job->count++;
+      }
+    }
+    nfc_close(pnd);
+    if (job->res != sizeof(abtRx))
+      return NULL;
+  }
+  return NULL;
+}
+
+static void *
+storm_context(void *arg)
+{
+  struct storm_job *job = arg;
+
+  // Contexts come and go while devices are in use
+  for (int n = 0; n < NTESTS; n++) {
+    nfc_context *context;
+    nfc_init(&context);
+    if (!context) {
+      job->res = NFC_ESOFT;
+      return NULL;
+    }
+    nfc_exit(context);
+    job->count++;
+  }
+  return NULL;
+}
+
+void
+cut_setup(void)
+{
+  // Emulators are forked before any thread is started
+  for (emulator_count = 0; emulator_count < DEVICE_COUNT + 1; emulator_count++) {
+    if (pn532_emulator_start(&emulators[emulator_count]) < 0)
+      cut_omit("Unable to start PN532 emulator");
+  }
+}
+
+void
+cut_teardown(void)
+{
+  while (emulator_count)
+    pn532_emulator_stop(&emulators[--emulator_count]);
+}
+
+void
+test_thread_storm(void)
+{
+  pthread_t threads[DEVICE_COUNT + SHARED_THREADS + 1];
+  struct storm_job jobs[DEVICE_COUNT + SHARED_THREADS + 1];
+  size_t thread_count = 0;
+  nfc_device *shared;
+
+  nfc_context *context;
+  nfc_init(&context);
+  cut_assert_not_null(context, cut_message("nfc_init"));
+
+  nfc_connstring connstring;
+  pn532_emulator_connstring(&emulators[DEVICE_COUNT], connstring);
+  shared = nfc_open(context, connstring);
+  cut_assert_not_null(shared, cut_message("nfc_open"));
+
+  memset(jobs, 0, sizeof(jobs));
+  for (size_t i = 0; i < DEVICE_COUNT; i++) {
+    jobs[thread_count].context = context;
+    pn532_emulator_connstring(&emulators[i], jobs[thread_count].connstring);
+    cut_assert_equal_int(0, pthread_create(&threads[thread_count], NULL, storm_private_device, &jobs[thread_count]));
+    thread_count++;
+  }
+  for (size_t i = 0; i < SHARED_THREADS; i++) {
+    jobs[thread_count].device = shared;
+    cut_assert_equal_int(0, pthread_create(&threads[thread_count], NULL, storm_transceive, &jobs[thread_count]));
+    thread_count++;
+  }
+  cut_assert_equal_int(0, pthread_create(&threads[thread_count], NULL, storm_context, &jobs[thread_count]));
+  thread_count++;
+
+  for (size_t i = 0; i < thread_count; i++)
+    pthread_join(threads[i], NULL);
+
+  for (size_t i = 0; i < thread_count; i++) {
+    cut_assert_operator_int(jobs[i].res, >=, 0, cut_message("thread %d failed", (int) i));
+    cut_assert_equal_int(NTESTS, jobs[i].count, cut_message("thread %d exchanges", (int) i));
+  }
+
+  nfc_close(shared);
+  nfc_exit(context);
+}
@@ -0,0 +1,244 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1) Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *  2 )Redistributions in binary form must reproduce the above copyright
+ *  notice, this list of conditions and the following disclaimer in the
+ *  documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Note that this license only applies on the examples, NFC library itself is under LGPL
+ *
+ */
+
+/**
+ * @file nfc-trace-decode.c
+ * @brief Render a binary trace written by nfc_device_trace_dump()
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <err.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "nfc-utils.h"
+
+// PN53x command codes, replies use the code plus one
+static const struct {
+  uint8_t code;
+  const char *name;
+} commands[] = {
+  { 0x00, "Diagnose" },
+  { 0x02, "GetFirmwareVersion" },
+  { 0x04, "GetGeneralStatus" },
+  { 0x06, "ReadRegister" },
+  { 0x08, "WriteRegister" },
+  { 0x0c, "ReadGPIO" },
+  { 0x0e, "WriteGPIO" },
+  { 0x10, "SetSerialBaudRate" },
+  { 0x12, "SetParameters" },
+  { 0x14, "SAMConfiguration" },
+  { 0x16, "PowerDown" },
+  { 0x18, "AlparCommandForTDA" },
+  { 0x32, "RFConfiguration" },
+  { 0x38, "InQuartetByteExchange" },
+  { 0x40, "InDataExchange" },
+  { 0x42, "InCommunicateThru" },
+  { 0x44, "InDeselect" },
+  { 0x46, "InJumpForPSL" },
+  { 0x48, "InActivateDeactivatePaypass" },
+  { 0x4a, "InListPassiveTarget" },
+  { 0x4e, "InPSL" },
+  { 0x50, "InATR" },
+  { 0x52, "InRelease" },
+  { 0x54, "InSelect" },
+  { 0x56, "InJumpForDEP" },
+  { 0x58, "RFRegulationTest" },
+  { 0x60, "InAutoPoll" },
+  { 0x86, "TgGetData" },
+  { 0x88, "TgGetInitiatorCommand" },
+  { 0x8a, "TgGetTargetStatus" },
+  { 0x8c, "TgInitAsTarget" },
+  { 0x8e, "TgSetData" },
+  { 0x90, "TgResponseToInitiator" },
+  { 0x92, "TgSetGeneralBytes" },
+  { 0x94, "TgSetMetaData" },
+  { 0x96, "TgSetDataSecure" },
+  { 0x98, "TgSetMetaDataSecure" },
+};
+
+static const char *
+command_name(const uint8_t code)
+{
+  for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+    if (commands[i].code == code)
+      return commands[i].name;
+  }
+  return "Unknown";
+}
+
+static const char *
+error_name(const int error)
+{
+  switch (error) {
+    case NFC_EIO:
+      return "Input / Output Error";
+    case NFC_EINVARG:
+      return "Invalid argument(s)";
+    case NFC_EDEVNOTSUPP:
+      return "Not Supported by Device";
+    case NFC_ENOTSUCHDEV:
+      return "No Such Device";
+    case NFC_EOVFLOW:
+      return "Buffer Overflow";
+    case NFC_ETIMEOUT:
+      return "Timeout";
+    case NFC_EOPABORTED:
+      return "Operation Aborted";
+    case NFC_ENOTIMPL:
+      return "Not (yet) Implemented";
+    case NFC_ETGRELEASED:
+      return "Target Released";
+    case NFC_EBUSY:
+      return "Device Busy";
+    case NFC_ERFTRANS:
+      return "RF Transmission Error";
+    case NFC_EMFCAUTHFAIL:
+      return "Mifare Authentication Failed";
+    case NFC_ESOFT:
+      return "Software Error";
+    case NFC_ECHIP:
+      return "Device's Internal Chip Error";
+  }
+  return "Unknown error";
+}
+
+static void
+print_usage(const char *argv[])
+{
+  printf("Usage: %s [OPTIONS] FILE\n", argv[0]);
+  printf("Options:\n");
+  printf("\t-h\tPrint this help message.\n");
+  printf("\t-q\tDo not print frame payloads.\n");
+}
+
+int
+main(int argc, const char *argv[])
+{
+  const char *pcPath = NULL;
+  bool quiet = false;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (0 == strcmp(argv[arg], "-h")) {
+      print_usage(argv);
+      exit(EXIT_SUCCESS);
+    } else if (0 == strcmp(argv[arg], "-q")) {
+      quiet = true;
+    } else if ((argv[arg][0] != '-') && !pcPath) {
+      pcPath = argv[arg];
+    } else {
+      ERR("%s is not supported option.", argv[arg]);
+      print_usage(argv);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (!pcPath) {
+    print_usage(argv);
+    exit(EXIT_FAILURE);
+  }
+
+  FILE *f = fopen(pcPath, "rb");
+  if (!f) {
+    err(EXIT_FAILURE, "%s", pcPath);
+  }
+
+  nfc_trace_header header;
+  if ((fread(&header, sizeof(header), 1, f) != 1) || (memcmp(header.magic, NFC_TRACE_MAGIC, sizeof(header.magic)) != 0)) {
+    errx(EXIT_FAILURE, "%s: not a libnfc trace", pcPath);
+  }
+  if ((header.version != NFC_TRACE_VERSION) || (header.record_size != sizeof(nfc_trace_record))) {
+    errx(EXIT_FAILURE, "%s: unsupported trace version or byte order", pcPath);
+  }
+  header.device[sizeof(header.device) - 1] = '\0';
+  printf("Device: %s\n", header.device);
+  printf("Records: %" PRIu32 " (%" PRIu32 " older ones lost)\n", header.count, header.dropped);
+  printf("%10s %12s %10s  %-5s %-28s %5s\n", "#", "time (ms)", "delta (us)", "dir", "command", "len");
+
+  nfc_trace_record ntr;
+  uint64_t first = 0, previous = 0;
+  uint32_t n;
+  for (n = 0; n < header.count; n++) {
+    if (fread(&ntr, sizeof(ntr), 1, f) != 1) {
+      warnx("%s: truncated after %" PRIu32 " records", pcPath, n);
+      break;
+    }
+    if (n == 0)
+      first = previous = ntr.timestamp;
+
+    const char *pcDirection;
+    switch (ntr.direction) {
+      case NTD_TX:
+        pcDirection = "TX";
+        break;
+      case NTD_RX:
+        pcDirection = "RX";
+        break;
+      case NTD_ERROR:
+        pcDirection = "ERROR";
+        break;
+      default:
+        pcDirection = "?";
+        break;
+    }
+    printf("%10" PRIu32 " %12.3f %10" PRIu64 "  %-5s %-28s %5u",
+           ntr.sequence, (ntr.timestamp - first) / 1000.0, ntr.timestamp - previous,
+           pcDirection, command_name(ntr.command), (unsigned) ntr.length);
+    previous = ntr.timestamp;
+
+    if (ntr.direction == NTD_ERROR) {
+      int32_t error;
+      memcpy(&error, ntr.payload, sizeof(error));
+      printf("  %s (%d)", error_name(error), (int) error);
+    } else if (!quiet) {
+      const size_t szPayload = (ntr.length < NFC_TRACE_PAYLOAD_LEN) ? ntr.length : NFC_TRACE_PAYLOAD_LEN;
+      printf(" ");
+      for (size_t i = 0; i < szPayload; i++)
+        printf(" %02x", ntr.payload[i]);
+      if (szPayload < ntr.length)
+        printf(" ...");
+    }
+    printf("\n");
+  }
+  fclose(f);
+  exit((n == header.count) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -52,11 +52,8 @@ oddparity(const uint8_t bt)
 void
 oddparity_bytes_ts(const uint8_t *pbtData, const size_t szLen, uint8_t *pbtPar)
 {
-  size_t  szByteNr;
   // Calculate the parity bits for the command
-  for (szByteNr = 0; szByteNr < szLen; szByteNr++) {
-    pbtPar[szByteNr] = oddparity(pbtData[szByteNr]);
-  }
+  iso14443a_odd_parity(pbtData, szLen, pbtPar);
 }
 
 void